@@ -0,0 +1,41 @@
+#ifndef __DWT_TIMEBASE_H
+#define __DWT_TIMEBASE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+
+/**
+  * @brief  High resolution monotonic time source shared by log timestamps,
+  *         FreeRTOS run-time statistics and benchmark commands.
+  *         Built on the DWT cycle counter, extended to 64 bits and rescaled
+  *         on every SwitchSystemClock(). HAL_GetTick() is used as a floor so
+  *         time spent in sleep (CYCCNT stopped) is not lost.
+  */
+
+void Timebase_Init(void);
+void Timebase_Update(void);
+uint64_t Timebase_GetCycles(void);
+uint64_t Timebase_GetUs(void);
+uint32_t Timebase_GetCoreClock(void);
+uint32_t Timebase_CyclesToUs(uint64_t cycles);
+void Timebase_ClockChangeBegin(void);
+void Timebase_ClockChangeEnd(uint32_t core_clock);
+
+/**
+  * @brief  Raw 32-bit cycle counter for short intervals (wraps after 7.8 s at
+  *         550 MHz), cheaper than Timebase_GetCycles() on hot paths
+  * @retval CYCCNT
+  */
+static inline uint32_t Timebase_GetCycles32(void)
+{
+    return DWT->CYCCNT;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DWT_TIMEBASE_H */
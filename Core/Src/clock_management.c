@@ -1,5 +1,7 @@
 #include "clock_management.h"
+#include "dwt_timebase.h"
 #include "shell_log.h"
+#include "shell_port.h"
 #include "cmsis_os.h"
 #include <stdio.h>
 
@@ -275,6 +277,12 @@ HAL_StatusTypeDef SwitchSystemClock(ClockProfile_t profile)
 
     printf("[INFO] Starting clock switch to %lu Hz...\r\n", target_freq);
 
+    // 等待shell串口DMA发送完成，切换后会重新初始化UART
+    shell_uart_flush(100);
+
+    // 冻结高精度时基，切换完成后按新频率重新开始计时
+    Timebase_ClockChangeBegin();
+
     /* Use global interrupt disable for maximum safety during clock switching. */
     __disable_irq();
 
@@ -308,6 +316,8 @@ HAL_StatusTypeDef SwitchSystemClock(ClockProfile_t profile)
             if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
             {
                 __enable_irq();
+                SystemCoreClockUpdate();
+                Timebase_ClockChangeEnd(SystemCoreClock);
                 printf("[ERROR] LSI configuration failed\r\n");
                 return HAL_ERROR;
             }
@@ -318,6 +328,8 @@ HAL_StatusTypeDef SwitchSystemClock(ClockProfile_t profile)
             if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, flash_latency) != HAL_OK)
             {
                 __enable_irq();
+                SystemCoreClockUpdate();
+                Timebase_ClockChangeEnd(SystemCoreClock);
                 printf("[ERROR] LSI clock switch failed\r\n");
                 return HAL_ERROR;
             }
@@ -332,6 +344,8 @@ HAL_StatusTypeDef SwitchSystemClock(ClockProfile_t profile)
         if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_1) != HAL_OK)
         {
             __enable_irq();
+            SystemCoreClockUpdate();
+            Timebase_ClockChangeEnd(SystemCoreClock);
             printf("[ERROR] HSI temporary switch failed\r\n");
             return HAL_ERROR;
         }
@@ -353,6 +367,8 @@ HAL_StatusTypeDef SwitchSystemClock(ClockProfile_t profile)
         if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
         {
             __enable_irq();
+            SystemCoreClockUpdate();
+            Timebase_ClockChangeEnd(SystemCoreClock);
             printf("[ERROR] PLL configuration failed\r\n");
             return HAL_ERROR;
         }
@@ -366,6 +382,8 @@ HAL_StatusTypeDef SwitchSystemClock(ClockProfile_t profile)
         if (timeout == 0)
         {
             __enable_irq();
+            SystemCoreClockUpdate();
+            Timebase_ClockChangeEnd(SystemCoreClock);
             printf("[ERROR] PLL lock timeout\r\n");
             return HAL_ERROR;
         }
@@ -386,6 +404,8 @@ HAL_StatusTypeDef SwitchSystemClock(ClockProfile_t profile)
         if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, flash_latency) != HAL_OK)
         {
             __enable_irq();
+            SystemCoreClockUpdate();
+            Timebase_ClockChangeEnd(SystemCoreClock);
             printf("[ERROR] PLL clock switch failed\r\n");
             return HAL_ERROR;
         }
@@ -404,6 +424,7 @@ HAL_StatusTypeDef SwitchSystemClock(ClockProfile_t profile)
 
     // --- Step 4: 更新系统时钟变量和重新初始化关键外设 ---
     SystemCoreClockUpdate();
+    Timebase_ClockChangeEnd(SystemCoreClock);
     
     // 重新配置SysTick，确保始终保持1ms时基
     // 无论系统时钟如何变化，都要保证SysTick产生准确的1ms中断
@@ -431,8 +452,9 @@ HAL_StatusTypeDef SwitchSystemClock(ClockProfile_t profile)
     // 添加延时确保SysTick稳定后再重新初始化UART
     DelayNoCycles(100000); // 约1ms延时
     
-    // 重新初始化UART（因为时钟变化会影响波特率）
-    if (HAL_UART_Init(&huart3) != HAL_OK) 
+    // 按新的内核时钟重新初始化UART并重启shell的DMA接收，
+    // 当前波特率在新时钟下无法实现时回退到默认波特率
+    if (shell_uart_apply_clock() != HAL_OK) 
     { 
         printf("[ERROR] UART reinit failed\r\n");
         return HAL_ERROR;
@@ -0,0 +1,215 @@
+#include "dwt_timebase.h"
+
+/* CoreSight lock access key, the M7 DWT ignores writes while locked */
+#define DWT_LAR_KEY         0xC5ACCE55U
+#define US_PER_SECOND       1000000U
+
+/* All state is updated with interrupts masked; readers may be ISRs */
+static uint64_t tb_cycles;          /* CYCCNT extended to 64 bits */
+static uint32_t tb_last_cyccnt;     /* CYCCNT at the last extension */
+static uint32_t tb_core_clock;      /* CPU clock the counter runs at */
+static uint32_t tb_cycles_per_us;   /* core_clock / 1 MHz, 0 if not a whole MHz */
+static uint64_t tb_seg_cycles;      /* Counter value at the start of the segment */
+static uint64_t tb_seg_us;          /* Time at the start of the segment */
+static uint64_t tb_last_us;         /* Last returned time, keeps the result monotonic */
+static uint8_t tb_frozen;           /* Clock switch in progress */
+
+static inline uint32_t Timebase_Lock(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+}
+
+static inline void Timebase_Unlock(uint32_t primask)
+{
+    __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Fold the elapsed CYCCNT delta into the 64-bit counter (lock held)
+  * @retval 64-bit cycle count
+  */
+static uint64_t Timebase_Extend(void)
+{
+    uint32_t now = DWT->CYCCNT;
+    tb_cycles += (uint32_t)(now - tb_last_cyccnt);
+    tb_last_cyccnt = now;
+    return tb_cycles;
+}
+
+/**
+  * @brief  Select the counter frequency of the current segment (lock held)
+  * @param  core_clock CPU clock in Hz
+  * @retval None
+  */
+static void Timebase_SetClock(uint32_t core_clock)
+{
+    tb_core_clock = core_clock;
+    tb_cycles_per_us = (core_clock % US_PER_SECOND == 0) ? core_clock / US_PER_SECOND : 0;
+}
+
+/**
+  * @brief  Compute the current time (lock held)
+  * @retval Microseconds since boot
+  */
+static uint64_t Timebase_Compute(void)
+{
+    uint64_t now_cycles = Timebase_Extend();
+    uint64_t floor_us = (uint64_t)HAL_GetTick() * 1000U;
+    uint64_t us = tb_last_us;
+
+    if (!tb_frozen && tb_core_clock != 0)
+    {
+        uint64_t delta = now_cycles - tb_seg_cycles;
+
+        // 每满一秒推进一次分段起点，保证余量小于32位
+        if (delta >= tb_core_clock)
+        {
+            uint32_t seconds = (uint32_t)(delta / tb_core_clock);
+            tb_seg_cycles += (uint64_t)seconds * tb_core_clock;
+            tb_seg_us += (uint64_t)seconds * US_PER_SECOND;
+            delta -= (uint64_t)seconds * tb_core_clock;
+        }
+
+        if (tb_cycles_per_us != 0)
+        {
+            us = tb_seg_us + (uint32_t)delta / tb_cycles_per_us;
+        }
+        else
+        {
+            us = tb_seg_us + delta * US_PER_SECOND / tb_core_clock;
+        }
+    }
+
+    // 睡眠时CYCCNT停止计数，落后于ms节拍时以节拍为准重新对齐
+    if (us < floor_us)
+    {
+        tb_seg_us = floor_us;
+        tb_seg_cycles = now_cycles;
+        us = floor_us;
+    }
+    if (us < tb_last_us)
+    {
+        us = tb_last_us;
+    }
+    tb_last_us = us;
+    return us;
+}
+
+/**
+  * @brief  Enable the DWT cycle counter and start the timebase
+  * @note   Call once after SystemClock_Config()
+  * @retval None
+  */
+void Timebase_Init(void)
+{
+    uint32_t primask = Timebase_Lock();
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->LAR = DWT_LAR_KEY;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    tb_cycles = 0;
+    tb_last_cyccnt = 0;
+    tb_seg_cycles = 0;
+    tb_seg_us = (uint64_t)HAL_GetTick() * 1000U;
+    tb_last_us = tb_seg_us;
+    tb_frozen = 0;
+    Timebase_SetClock(SystemCoreClock);
+
+    Timebase_Unlock(primask);
+}
+
+/**
+  * @brief  Extend the cycle counter, call at least once per CYCCNT wrap
+  *         (7.8 s at 550 MHz); done from the FreeRTOS tick hook
+  * @retval None
+  */
+void Timebase_Update(void)
+{
+    uint32_t primask = Timebase_Lock();
+    Timebase_Extend();
+    Timebase_Unlock(primask);
+}
+
+/**
+  * @brief  Get the 64-bit CPU cycle count
+  * @note   Only meaningful for intervals within one clock profile
+  * @retval Cycles since Timebase_Init()
+  */
+uint64_t Timebase_GetCycles(void)
+{
+    uint32_t primask = Timebase_Lock();
+    uint64_t cycles = Timebase_Extend();
+    Timebase_Unlock(primask);
+    return cycles;
+}
+
+/**
+  * @brief  Get monotonic time in microseconds
+  * @retval Microseconds since boot (HAL tick origin)
+  */
+uint64_t Timebase_GetUs(void)
+{
+    uint32_t primask = Timebase_Lock();
+    uint64_t us = Timebase_Compute();
+    Timebase_Unlock(primask);
+    return us;
+}
+
+/**
+  * @brief  Get the CPU clock the cycle counter currently runs at
+  * @retval Frequency in Hz
+  */
+uint32_t Timebase_GetCoreClock(void)
+{
+    return tb_core_clock;
+}
+
+/**
+  * @brief  Convert a cycle interval measured at the current clock to microseconds
+  * @param  cycles Cycle interval
+  * @retval Microseconds (saturated to 32 bits)
+  */
+uint32_t Timebase_CyclesToUs(uint64_t cycles)
+{
+    if (tb_core_clock == 0)
+    {
+        return 0;
+    }
+    uint64_t us = cycles * US_PER_SECOND / tb_core_clock;
+    return (us > 0xFFFFFFFFU) ? 0xFFFFFFFFU : (uint32_t)us;
+}
+
+/**
+  * @brief  Close the current segment before the CPU clock changes
+  * @note   Time reads during the switch return the last value
+  * @retval None
+  */
+void Timebase_ClockChangeBegin(void)
+{
+    uint32_t primask = Timebase_Lock();
+    Timebase_Compute();
+    tb_frozen = 1;
+    Timebase_Unlock(primask);
+}
+
+/**
+  * @brief  Start a new segment at the new CPU clock
+  * @param  core_clock New CPU clock in Hz
+  * @retval None
+  */
+void Timebase_ClockChangeEnd(uint32_t core_clock)
+{
+    uint32_t primask = Timebase_Lock();
+    uint64_t floor_us = (uint64_t)HAL_GetTick() * 1000U;
+
+    tb_seg_cycles = Timebase_Extend();
+    tb_seg_us = (tb_last_us > floor_us) ? tb_last_us : floor_us;
+    tb_frozen = 0;
+    Timebase_SetClock(core_clock);
+
+    Timebase_Unlock(primask);
+}
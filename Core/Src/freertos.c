@@ -25,6 +25,7 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "stm32h7xx_hal.h"
+#include "dwt_timebase.h"
 #include <stdio.h>
 #include <string.h>
 /* USER CODE END Includes */
@@ -67,12 +68,12 @@ void vApplicationDaemonTaskStartupHook(void);
 /* Functions needed when configGENERATE_RUN_TIME_STATS is on */
 __weak void configureTimerForRunTimeStats(void)
 {
-
+  /* DWT timebase is started in main() before the scheduler */
 }
 
 __weak unsigned long getRunTimeCounterValue(void)
 {
-return 0;
+  return (unsigned long)Timebase_GetUs();
 }
 /* USER CODE END 1 */
 
@@ -99,6 +100,7 @@ void vApplicationTickHook( void )
    added here, but the tick hook is called from an interrupt context, so
    code must not attempt to block, and only the interrupt safe FreeRTOS API
    functions can be used (those that end in FromISR()). */
+  Timebase_Update();
 }
 /* USER CODE END 3 */
 
@@ -27,9 +27,11 @@
 #include "string.h"
 #include "ffconf.h"
 #include "clock_management.h"
+#include "dwt_timebase.h"
 #include "shell_port.h"
 #include "shell.h"
 #include "shell_log.h"
+#include "sd_cache.h"
 #include <stdio.h>
 /* USER CODE END Includes */
 
@@ -40,7 +42,11 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
-
+/* OCTOSPI1 PSRAM（AP Memory八线DDR）：同步读/写命令及默认模式寄存器下的延迟周期 */
+#define PSRAM_CMD_READ              0x00U
+#define PSRAM_CMD_WRITE             0x80U
+#define PSRAM_READ_LATENCY          5U
+#define PSRAM_WRITE_LATENCY         4U
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -95,6 +101,9 @@ void mic2isp_task(void *argument);
 /* USER CODE BEGIN PFP */
 // 声明UART接收回调函数
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
+#if SD_CACHE_STORE == SD_CACHE_STORE_PSRAM
+static void PSRAM_EnableMemoryMapped(void);
+#endif
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
@@ -137,6 +146,9 @@ int main(void)
   SystemClock_Config();
 
   /* USER CODE BEGIN SysInit */
+  /* 启动DWT高精度时基（日志时间戳、运行时统计共用） */
+  Timebase_Init();
+
   /*
    * 根本原因修复: 禁用USB电压检测器。
    * 此调用与PCD配置(vbus_sensing_enable = DISABLE)冲突。
@@ -366,7 +378,10 @@ static void MX_OCTOSPI1_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN OCTOSPI1_Init 2 */
-
+#if SD_CACHE_STORE == SD_CACHE_STORE_PSRAM
+  /* SD扇区缓存放在PSRAM中 */
+  PSRAM_EnableMemoryMapped();
+#endif
   /* USER CODE END OCTOSPI1_Init 2 */
 
 }
@@ -579,7 +594,55 @@ static void MX_GPIO_Init(void)
 }
 
 /* USER CODE BEGIN 4 */
+#if SD_CACHE_STORE == SD_CACHE_STORE_PSRAM
+/**
+  * @brief  Map the OCTOSPI1 PSRAM at 0x90000000 (MPU region 6, cacheable)
+  *         Octal DDR address and data, DQS driven by the memory
+  * @retval None
+  */
+static void PSRAM_EnableMemoryMapped(void)
+{
+  OSPI_RegularCmdTypeDef sCommand = {0};
+  OSPI_MemoryMappedTypeDef sMemMappedCfg = {0};
+
+  sCommand.FlashId = HAL_OSPI_FLASH_ID_1;
+  sCommand.InstructionMode = HAL_OSPI_INSTRUCTION_8_LINES;
+  sCommand.InstructionSize = HAL_OSPI_INSTRUCTION_8_BITS;
+  sCommand.InstructionDtrMode = HAL_OSPI_INSTRUCTION_DTR_DISABLE;
+  sCommand.AddressMode = HAL_OSPI_ADDRESS_8_LINES;
+  sCommand.AddressSize = HAL_OSPI_ADDRESS_32_BITS;
+  sCommand.AddressDtrMode = HAL_OSPI_ADDRESS_DTR_ENABLE;
+  sCommand.AlternateBytesMode = HAL_OSPI_ALTERNATE_BYTES_NONE;
+  sCommand.DataMode = HAL_OSPI_DATA_8_LINES;
+  sCommand.DataDtrMode = HAL_OSPI_DATA_DTR_ENABLE;
+  sCommand.DQSMode = HAL_OSPI_DQS_ENABLE;
+  sCommand.SIOOMode = HAL_OSPI_SIOO_INST_EVERY_CMD;
+
+  sCommand.OperationType = HAL_OSPI_OPTYPE_WRITE_CFG;
+  sCommand.Instruction = PSRAM_CMD_WRITE;
+  sCommand.DummyCycles = PSRAM_WRITE_LATENCY;
+  if (HAL_OSPI_Command(&hospi1, &sCommand, HAL_OSPI_TIMEOUT_DEFAULT_VALUE) != HAL_OK)
+  {
+    Error_Handler();
+  }
 
+  sCommand.OperationType = HAL_OSPI_OPTYPE_READ_CFG;
+  sCommand.Instruction = PSRAM_CMD_READ;
+  sCommand.DummyCycles = PSRAM_READ_LATENCY;
+  if (HAL_OSPI_Command(&hospi1, &sCommand, HAL_OSPI_TIMEOUT_DEFAULT_VALUE) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  /* 空闲时释放片选，PSRAM才能自刷新 */
+  sMemMappedCfg.TimeOutActivation = HAL_OSPI_TIMEOUT_COUNTER_ENABLE;
+  sMemMappedCfg.TimeOutPeriod = 0x34;
+  if (HAL_OSPI_MemoryMapped(&hospi1, &sMemMappedCfg) != HAL_OK)
+  {
+    Error_Handler();
+  }
+}
+#endif
 /* USER CODE END 4 */
 
 /* USER CODE BEGIN Header_StartDefaultTask */
@@ -781,6 +844,20 @@ void MPU_Config(void)
   MPU_InitStruct.IsBufferable = MPU_ACCESS_NOT_BUFFERABLE; // Strongly-ordered
   HAL_MPU_ConfigRegion(&MPU_InitStruct);
 
+  /** SDMMC1 IDMA buffers: first 32KB of AXI SRAM (.sd_dma_buffer), non-cacheable
+  */
+  MPU_InitStruct.Number = MPU_REGION_NUMBER10;
+  MPU_InitStruct.BaseAddress = 0x24000000;
+  MPU_InitStruct.Size = MPU_REGION_SIZE_32KB;
+  MPU_InitStruct.SubRegionDisable = 0x0;
+  MPU_InitStruct.TypeExtField = MPU_TEX_LEVEL1;
+  MPU_InitStruct.AccessPermission = MPU_REGION_FULL_ACCESS;
+  MPU_InitStruct.DisableExec = MPU_INSTRUCTION_ACCESS_DISABLE;
+  MPU_InitStruct.IsShareable = MPU_ACCESS_NOT_SHAREABLE;
+  MPU_InitStruct.IsCacheable = MPU_ACCESS_NOT_CACHEABLE;
+  MPU_InitStruct.IsBufferable = MPU_ACCESS_NOT_BUFFERABLE;
+  HAL_MPU_ConfigRegion(&MPU_InitStruct);
+
 
   /* Enables the MPU */
   HAL_MPU_Enable(MPU_HFNMI_PRIVDEF);
@@ -143,6 +143,9 @@ extern UART_HandleTypeDef huart3;
 extern TIM_HandleTypeDef htim1;
 
 /* USER CODE BEGIN EV */
+extern DMA_HandleTypeDef hdma_usart3_tx;
+extern DMA_HandleTypeDef hdma_usart3_rx;
+extern SD_HandleTypeDef hsd1;
 
 /* USER CODE END EV */
 
@@ -272,6 +275,7 @@ void TIM1_UP_IRQHandler(void)
 void USART3_IRQHandler(void)
 {
   /* USER CODE BEGIN USART3_IRQn 0 */
+  shell_uart_stats.irq_uart++;
 
   /* USER CODE END USART3_IRQn 0 */
   HAL_UART_IRQHandler(&huart3);
@@ -352,4 +356,30 @@ void BDMA_Channel0_IRQHandler(void)
 
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief This function handles DMA1 stream0 global interrupt (USART3 TX).
+  */
+void DMA1_Stream0_IRQHandler(void)
+{
+  shell_uart_stats.irq_dma_tx++;
+  HAL_DMA_IRQHandler(&hdma_usart3_tx);
+}
+
+/**
+  * @brief This function handles DMA1 stream1 global interrupt (USART3 RX).
+  */
+void DMA1_Stream1_IRQHandler(void)
+{
+  shell_uart_stats.irq_dma_rx++;
+  HAL_DMA_IRQHandler(&hdma_usart3_rx);
+}
+
+/**
+  * @brief This function handles SDMMC1 global interrupt (FatFs IDMA transfers).
+  */
+void SDMMC1_IRQHandler(void)
+{
+  HAL_SD_IRQHandler(&hsd1);
+}
+
 /* USER CODE END 1 */
@@ -25,7 +25,7 @@ FATFS USERFatFS __attribute__((section(".dma_buffer"))) __attribute__((aligned(3
 FIL USERFile;       /* File object for USER */
 
 /* USER CODE BEGIN Variables */
-
+static uint8_t userMounted = 0;
 
 /* USER CODE END Variables */
 
@@ -52,5 +52,29 @@ DWORD get_fattime(void)
 }
 
 /* USER CODE BEGIN Application */
+/**
+  * @brief  Mount the USER logical drive on first use
+  * @retval FR_OK if the volume is mounted
+  */
+FRESULT FATFS_Mount(void)
+{
+  FRESULT res;
+
+  if (userMounted)
+  {
+    return FR_OK;
+  }
+  if (retUSER != 0)
+  {
+    return FR_NOT_READY;
+  }
+
+  res = f_mount(&USERFatFS, USERPath, 1);
+  if (res == FR_OK)
+  {
+    userMounted = 1;
+  }
+  return res;
+}
 
 /* USER CODE END Application */
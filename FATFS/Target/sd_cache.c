@@ -0,0 +1,653 @@
+/**
+  ******************************************************************************
+  * @file    sd_cache.c
+  * @brief   Set-associative write-back sector cache in front of the SD driver
+  *
+  *          SD_CACHE_SETS x SD_CACHE_WAYS lines of one sector, the set is the
+  *          sector number modulo SD_CACHE_SETS, LRU replacement within a set.
+  *          Single-sector requests that do not continue the previous request of
+  *          the same context are cached: FAT and directory sectors, which FatFs
+  *          and the USB host read and rewrite again and again. Sequential
+  *          streams and multi-sector requests go to the lower layer (write
+  *          behind, read-ahead); cached copies in their range are kept up to date.
+  *          Writes to cached sectors only dirty the line; dirty lines go to the
+  *          card when replaced, on SD_CacheClean() (CTRL_SYNC, idle timeout) or
+  *          when the cache is disabled.
+  *
+  *          The USB MSC callbacks run in the OTG_HS interrupt and may interrupt
+  *          a task in the middle of an operation. Line state and data change
+  *          only under ops->lock() in a task, and I/O runs outside it, so:
+  *          - only the task context writes back dirty lines; the interrupt
+  *            context replaces clean lines only and otherwise does not cache
+  *          - a line being written back or written through is marked busy and
+  *            is not replaced until the card has the data; an interrupt write
+  *            to it dirties the line again
+  *          - an interrupt write to the sector a task is filling makes the fill
+  *            stale, the task then does not install what it read
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "sd_cache.h"
+
+/* Private define ------------------------------------------------------------*/
+#define SD_CACHE_VALID        0x01U
+#define SD_CACHE_DIRTY        0x02U
+#define SD_CACHE_BUSY         0x04U   /* 正在写回或直写，卡上还不是最新数据，不能替换 */
+
+#define SD_CACHE_NO_SECTOR    0xFFFFFFFFUL
+
+#if (SD_CACHE_SETS & (SD_CACHE_SETS - 1U)) != 0U
+#error "SD_CACHE_SETS must be a power of two"
+#endif
+
+/* Private variables ---------------------------------------------------------*/
+static const SD_CacheOps_t *cache_ops;
+static uint8_t *cache_store;                  /* SD_CACHE_LINES个扇区 */
+static volatile uint8_t cache_enabled;
+
+static DWORD cache_tag[SD_CACHE_LINES];
+static volatile uint8_t cache_flags[SD_CACHE_LINES];
+static uint8_t cache_age[SD_CACHE_LINES];     /* 组内LRU次序，0为最近使用 */
+
+/* 每个上下文读、写请求的下一个扇区，接着上一次请求的是顺序流，不分配缓存行 */
+static DWORD cache_next[2][2];
+
+/* 任务上下文正在填充的扇区，期间中断上下文写入它时不保留读到的数据 */
+static volatile uint8_t cache_filling;
+static DWORD cache_fill_sector;
+static volatile uint8_t cache_fill_stale;
+
+/* 写回时脏行的副本，只有任务（或调度器启动前）使用 */
+static uint8_t cache_tmp[SD_CACHE_SECTOR_SIZE] __attribute__((aligned(32)));
+
+static SD_CacheStats_t cache_stats;
+
+/* Private functions ---------------------------------------------------------*/
+static inline void SD_CacheLock(uint8_t ctx)
+{
+  if (cache_ops->lock) cache_ops->lock(ctx);
+}
+
+static inline void SD_CacheUnlock(uint8_t ctx)
+{
+  if (cache_ops->unlock) cache_ops->unlock(ctx);
+}
+
+static inline uint8_t *SD_CacheData(uint32_t line)
+{
+  return &cache_store[line * SD_CACHE_SECTOR_SIZE];
+}
+
+/**
+  * @brief  First line of the set a sector maps to
+  * @param  sector: Sector number
+  * @retval Line index
+  */
+static inline uint32_t SD_CacheSet(DWORD sector)
+{
+  return (sector & (SD_CACHE_SETS - 1U)) * SD_CACHE_WAYS;
+}
+
+/**
+  * @brief  Look up a sector
+  * @param  sector: Sector number
+  * @retval Line index, -1 if not cached
+  */
+static int32_t SD_CacheFind(DWORD sector)
+{
+  uint32_t base = SD_CacheSet(sector);
+
+  for (uint32_t way = 0; way < SD_CACHE_WAYS; way++)
+  {
+    if ((cache_flags[base + way] & SD_CACHE_VALID) && cache_tag[base + way] == sector)
+    {
+      return (int32_t)(base + way);
+    }
+  }
+  return -1;
+}
+
+/**
+  * @brief  Make a line the most recently used of its set
+  * @param  line: Line index
+  */
+static void SD_CacheTouch(uint32_t line)
+{
+  uint32_t base = line - (line % SD_CACHE_WAYS);
+  uint8_t age = cache_age[line];
+
+  for (uint32_t way = 0; way < SD_CACHE_WAYS; way++)
+  {
+    if (cache_age[base + way] < age)
+    {
+      cache_age[base + way]++;
+    }
+  }
+  cache_age[line] = 0U;
+}
+
+/**
+  * @brief  Mark a line dirty
+  * @param  line: Line index
+  */
+static void SD_CacheSetDirty(uint32_t line)
+{
+  if (!(cache_flags[line] & SD_CACHE_DIRTY))
+  {
+    cache_flags[line] |= SD_CACHE_DIRTY;
+    cache_stats.dirty++;
+  }
+}
+
+/**
+  * @brief  Pick the line to replace in a set: a free line, else the oldest clean one
+  * @param  base: First line of the set
+  * @retval Line index, -1 if every line is dirty or busy
+  */
+static int32_t SD_CacheVictim(uint32_t base)
+{
+  int32_t victim = -1;
+
+  for (uint32_t way = 0; way < SD_CACHE_WAYS; way++)
+  {
+    uint32_t line = base + way;
+    uint8_t flags = cache_flags[line];
+
+    if (!(flags & SD_CACHE_VALID))
+    {
+      return (int32_t)line;
+    }
+    if (!(flags & (SD_CACHE_DIRTY | SD_CACHE_BUSY))
+        && (victim < 0 || cache_age[line] > cache_age[victim]))
+    {
+      victim = (int32_t)line;
+    }
+  }
+  return victim;
+}
+
+/**
+  * @brief  Oldest dirty line of a set that is not being written
+  * @param  base: First line of the set
+  * @retval Line index, -1 if none
+  */
+static int32_t SD_CacheOldestDirty(uint32_t base)
+{
+  int32_t victim = -1;
+
+  for (uint32_t way = 0; way < SD_CACHE_WAYS; way++)
+  {
+    uint32_t line = base + way;
+
+    if ((cache_flags[line] & (SD_CACHE_DIRTY | SD_CACHE_BUSY)) == SD_CACHE_DIRTY
+        && (victim < 0 || cache_age[line] > cache_age[victim]))
+    {
+      victim = (int32_t)line;
+    }
+  }
+  return victim;
+}
+
+/**
+  * @brief  Write one dirty line to the card (task context, never in an interrupt)
+  *         The data is copied out under the lock and the line stays busy until
+  *         the lower layer has taken it
+  * @param  ctx: Context
+  * @param  line: Line index
+  * @retval DRESULT: Result of the lower layer write
+  */
+static DRESULT SD_CacheWriteBack(uint8_t ctx, uint32_t line)
+{
+  DRESULT res;
+  DWORD sector;
+
+  SD_CacheLock(ctx);
+  if ((cache_flags[line] & (SD_CACHE_VALID | SD_CACHE_DIRTY | SD_CACHE_BUSY)) != (SD_CACHE_VALID | SD_CACHE_DIRTY))
+  {
+    SD_CacheUnlock(ctx);
+    return RES_OK;
+  }
+  sector = cache_tag[line];
+  memcpy(cache_tmp, SD_CacheData(line), SD_CACHE_SECTOR_SIZE);
+  cache_flags[line] = (uint8_t)((cache_flags[line] & ~SD_CACHE_DIRTY) | SD_CACHE_BUSY);
+  cache_stats.dirty--;
+  SD_CacheUnlock(ctx);
+
+  res = cache_ops->write(ctx, cache_tmp, sector, 1U);
+
+  SD_CacheLock(ctx);
+  cache_flags[line] &= (uint8_t)~SD_CACHE_BUSY;
+  if (res != RES_OK)
+  {
+    SD_CacheSetDirty(line);
+  }
+  else
+  {
+    cache_stats.writebacks++;
+  }
+  SD_CacheUnlock(ctx);
+  return res;
+}
+
+/**
+  * @brief  Put a sector into the cache
+  *         Writes update a line the sector already has; a task writes back the
+  *         oldest dirty line when its set has no clean line
+  * @param  ctx: Context
+  * @param  data: Sector data
+  * @param  sector: Sector number
+  * @param  write: 1 to store dirty data of a write, 0 to install a read
+  * @retval 1 if the data is in the cache
+  */
+static uint8_t SD_CacheAllocate(uint8_t ctx, const BYTE *data, DWORD sector, uint8_t write)
+{
+  uint32_t base = SD_CacheSet(sector);
+
+  for (uint32_t tries = 0; tries <= SD_CACHE_WAYS; tries++)
+  {
+    int32_t line;
+    int32_t dirty;
+
+    SD_CacheLock(ctx);
+    line = SD_CacheFind(sector);
+    if (line >= 0)
+    {
+      /* 读取期间中断上下文已经放入了这个扇区 */
+      if (write)
+      {
+        memcpy(SD_CacheData((uint32_t)line), data, SD_CACHE_SECTOR_SIZE);
+        SD_CacheSetDirty((uint32_t)line);
+        SD_CacheTouch((uint32_t)line);
+        cache_stats.write_hits++;
+      }
+      SD_CacheUnlock(ctx);
+      return 1U;
+    }
+    if (!write && ctx == SD_CACHE_CTX_TASK && cache_fill_stale)
+    {
+      SD_CacheUnlock(ctx);
+      return 0U;
+    }
+    line = SD_CacheVictim(base);
+    if (line >= 0)
+    {
+      if (cache_flags[line] & SD_CACHE_VALID)
+      {
+        cache_stats.evictions++;
+      }
+      else
+      {
+        cache_stats.valid++;
+      }
+      cache_tag[line] = sector;
+      cache_flags[line] = SD_CACHE_VALID;
+      memcpy(SD_CacheData((uint32_t)line), data, SD_CACHE_SECTOR_SIZE);
+      SD_CacheTouch((uint32_t)line);
+      if (write)
+      {
+        SD_CacheSetDirty((uint32_t)line);
+        cache_stats.write_allocs++;
+      }
+      SD_CacheUnlock(ctx);
+      return 1U;
+    }
+    dirty = SD_CacheOldestDirty(base);
+    SD_CacheUnlock(ctx);
+
+    /* 组内全是脏行：中断中不能写回，放弃缓存 */
+    if (ctx != SD_CACHE_CTX_TASK || dirty < 0
+        || SD_CacheWriteBack(ctx, (uint32_t)dirty) != RES_OK)
+    {
+      return 0U;
+    }
+  }
+  return 0U;
+}
+
+/**
+  * @brief  Read one sector if it is cached
+  * @param  ctx: Context
+  * @param  buff: Output buffer
+  * @param  sector: Sector number
+  * @retval 1 on a hit
+  */
+static uint8_t SD_CacheLookup(uint8_t ctx, BYTE *buff, DWORD sector)
+{
+  int32_t line;
+
+  SD_CacheLock(ctx);
+  line = SD_CacheFind(sector);
+  if (line >= 0)
+  {
+    memcpy(buff, SD_CacheData((uint32_t)line), SD_CACHE_SECTOR_SIZE);
+    SD_CacheTouch((uint32_t)line);
+  }
+  SD_CacheUnlock(ctx);
+  return line >= 0;
+}
+
+/**
+  * @brief  Decide whether a request may allocate lines
+  * @param  ctx: Context
+  * @param  write: 1 for a write
+  * @param  sector: Start sector
+  * @param  count: Number of sectors
+  * @retval 1 to cache the request
+  */
+static uint8_t SD_CacheAdmit(uint8_t ctx, uint8_t write, DWORD sector, UINT count)
+{
+  uint8_t sequential = (sector == cache_next[ctx][write]);
+
+  cache_next[ctx][write] = sector + count;
+  return cache_enabled && count == 1U && !sequential;
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Initialize the cache, empty and disabled
+  * @param  ops: Lower layer
+  * @param  store: SD_CACHE_LINES * SD_CACHE_SECTOR_SIZE bytes for the line data
+  */
+void SD_CacheInit(const SD_CacheOps_t *ops, uint8_t *store)
+{
+  cache_ops = ops;
+  cache_store = store;
+  for (uint32_t line = 0; line < SD_CACHE_LINES; line++)
+  {
+    cache_flags[line] = 0U;
+    cache_age[line] = (uint8_t)(line % SD_CACHE_WAYS);
+  }
+  for (uint32_t i = 0; i < 2U; i++)
+  {
+    cache_next[i][0] = SD_CACHE_NO_SECTOR;
+    cache_next[i][1] = SD_CACHE_NO_SECTOR;
+  }
+  cache_filling = 0U;
+  memset(&cache_stats, 0, sizeof(cache_stats));
+  cache_enabled = 0U;
+}
+
+/**
+  * @brief  Read sectors through the cache
+  * @param  ctx: Context, caller holds the driver
+  * @param  buff: Output buffer
+  * @param  sector: Start sector
+  * @param  count: Number of sectors
+  * @retval DRESULT: Operation result
+  */
+DRESULT SD_CacheRead(uint8_t ctx, BYTE *buff, DWORD sector, UINT count)
+{
+  uint8_t admit = SD_CacheAdmit(ctx, 0U, sector, count);
+  DRESULT res;
+
+  if (count == 1U && cache_stats.valid > 0U && SD_CacheLookup(ctx, buff, sector))
+  {
+    cache_stats.hits++;
+    return RES_OK;
+  }
+  if (!admit)
+  {
+    if (cache_enabled)
+    {
+      cache_stats.bypassed++;
+    }
+    res = cache_ops->read(ctx, buff, sector, count);
+    if (res != RES_OK || cache_stats.valid == 0U || count == 1U)
+    {
+      return res;
+    }
+    /* 缓存中的扇区（可能是脏的）比卡上的新 */
+    for (UINT i = 0; i < count; i++)
+    {
+      SD_CacheLookup(ctx, &buff[i * SD_CACHE_SECTOR_SIZE], sector + i);
+    }
+    return res;
+  }
+
+  cache_stats.misses++;
+  if (ctx == SD_CACHE_CTX_TASK)
+  {
+    SD_CacheLock(ctx);
+    cache_fill_sector = sector;
+    cache_fill_stale = 0U;
+    cache_filling = 1U;
+    SD_CacheUnlock(ctx);
+  }
+  res = cache_ops->read(ctx, buff, sector, 1U);
+  if (res == RES_OK)
+  {
+    SD_CacheAllocate(ctx, buff, sector, 0U);
+  }
+  if (ctx == SD_CACHE_CTX_TASK)
+  {
+    cache_filling = 0U;
+  }
+  return res;
+}
+
+/**
+  * @brief  Write sectors through the cache
+  * @param  ctx: Context, caller holds the driver
+  * @param  buff: Data
+  * @param  sector: Start sector
+  * @param  count: Number of sectors
+  * @retval DRESULT: Operation result
+  */
+DRESULT SD_CacheWrite(uint8_t ctx, const BYTE *buff, DWORD sector, UINT count)
+{
+  uint8_t admit = SD_CacheAdmit(ctx, 1U, sector, count);
+  uint8_t cached = 0U;
+  uint8_t dirtied = 0U;
+  DRESULT res;
+
+  if (ctx != SD_CACHE_CTX_TASK && cache_filling
+      && cache_fill_sector >= sector && cache_fill_sector < sector + count)
+  {
+    /* 打断了任务对这个扇区的填充 */
+    cache_fill_stale = 1U;
+  }
+
+  if (admit && SD_CacheAllocate(ctx, buff, sector, 1U))
+  {
+    if (cache_ops->dirtied) cache_ops->dirtied(ctx);
+    return RES_OK;
+  }
+  if (cache_enabled)
+  {
+    cache_stats.bypassed++;
+  }
+
+  /*
+   * 直写：先更新已缓存的副本，卡上写入完成前标记为忙，不会被替换掉。
+   * 中断打断了任务对同一行的写回时，任务写出的是旧数据，把行重新标记为脏。
+   */
+  if (cache_stats.valid > 0U)
+  {
+    for (UINT i = 0; i < count; i++)
+    {
+      int32_t line;
+
+      SD_CacheLock(ctx);
+      line = SD_CacheFind(sector + i);
+      if (line >= 0)
+      {
+        memcpy(SD_CacheData((uint32_t)line), &buff[i * SD_CACHE_SECTOR_SIZE], SD_CACHE_SECTOR_SIZE);
+        if (ctx == SD_CACHE_CTX_TASK)
+        {
+          cache_flags[line] |= SD_CACHE_BUSY;
+        }
+        else if (cache_flags[line] & SD_CACHE_BUSY)
+        {
+          SD_CacheSetDirty((uint32_t)line);
+          dirtied = 1U;
+        }
+        cached = 1U;
+      }
+      SD_CacheUnlock(ctx);
+    }
+  }
+
+  res = cache_ops->write(ctx, buff, sector, count);
+
+  if (dirtied && cache_ops->dirtied)
+  {
+    cache_ops->dirtied(ctx);
+  }
+  if (cached && ctx == SD_CACHE_CTX_TASK)
+  {
+    for (UINT i = 0; i < count; i++)
+    {
+      int32_t line;
+
+      SD_CacheLock(ctx);
+      line = SD_CacheFind(sector + i);
+      if (line >= 0)
+      {
+        cache_flags[line] &= (uint8_t)~SD_CACHE_BUSY;
+        if (res != RES_OK)
+        {
+          SD_CacheSetDirty((uint32_t)line);
+        }
+      }
+      SD_CacheUnlock(ctx);
+    }
+  }
+  return res;
+}
+
+/**
+  * @brief  Write all dirty lines to the card, ascending runs of sectors so the
+  *         lower layer can merge them into multi-block writes
+  *         Task context or before the scheduler starts, never in an interrupt
+  * @param  ctx: Context, caller holds the driver
+  * @retval DRESULT: RES_ERROR if a write failed, the line stays dirty
+  */
+DRESULT SD_CacheClean(uint8_t ctx)
+{
+  uint32_t budget = SD_CACHE_LINES;
+
+  /* 中断上下文不断写入时也会结束 */
+  while (cache_stats.dirty > 0U && budget > 0U)
+  {
+    int32_t first = -1;
+    DWORD sector;
+
+    /* 不加锁扫描，SD_CacheWriteBack()会重新检查 */
+    for (uint32_t line = 0; line < SD_CACHE_LINES; line++)
+    {
+      if ((cache_flags[line] & (SD_CACHE_DIRTY | SD_CACHE_BUSY)) == SD_CACHE_DIRTY
+          && (first < 0 || cache_tag[line] < cache_tag[first]))
+      {
+        first = (int32_t)line;
+      }
+    }
+    if (first < 0)
+    {
+      break;
+    }
+
+    sector = cache_tag[first];
+    for (int32_t line = first; line >= 0 && budget > 0U; budget--)
+    {
+      if (SD_CacheWriteBack(ctx, (uint32_t)line) != RES_OK)
+      {
+        return RES_ERROR;
+      }
+      sector++;
+      line = SD_CacheFind(sector);
+      if (line >= 0 && (cache_flags[line] & (SD_CACHE_DIRTY | SD_CACHE_BUSY)) != SD_CACHE_DIRTY)
+      {
+        line = -1;
+      }
+    }
+  }
+  return RES_OK;
+}
+
+/**
+  * @brief  Enable or disable the cache
+  *         Disabling writes back the dirty lines and drops everything
+  * @param  ctx: Context, caller holds the driver
+  * @param  enable: 1 to enable
+  * @retval DRESULT: RES_ERROR if the write-back failed, the cache stays enabled
+  */
+DRESULT SD_CacheSetEnabled(uint8_t ctx, uint8_t enable)
+{
+  if (enable)
+  {
+    cache_enabled = (cache_store != NULL);
+    return cache_enabled ? RES_OK : RES_NOTRDY;
+  }
+  if (!cache_enabled)
+  {
+    return RES_OK;
+  }
+  cache_enabled = 0U;
+  for (uint32_t tries = 0; tries < 4U; tries++)
+  {
+    if (SD_CacheClean(ctx) != RES_OK)
+    {
+      break;
+    }
+    SD_CacheLock(ctx);
+    if (cache_stats.dirty == 0U)
+    {
+      for (uint32_t line = 0; line < SD_CACHE_LINES; line++)
+      {
+        cache_flags[line] = 0U;
+      }
+      cache_stats.valid = 0U;
+      SD_CacheUnlock(ctx);
+      return RES_OK;
+    }
+    SD_CacheUnlock(ctx);
+  }
+  cache_enabled = 1U;
+  return RES_ERROR;
+}
+
+/**
+  * @brief  Check whether the cache is enabled
+  * @retval 1 if enabled
+  */
+uint8_t SD_CacheEnabled(void)
+{
+  return cache_enabled;
+}
+
+/**
+  * @brief  Number of dirty lines
+  * @retval Dirty lines
+  */
+uint32_t SD_CacheDirtyCount(void)
+{
+  return cache_stats.dirty;
+}
+
+/**
+  * @brief  Get the cache statistics
+  * @param  stats: Output statistics
+  */
+void SD_CacheGetStats(SD_CacheStats_t *stats)
+{
+  if (stats != NULL)
+  {
+    *stats = cache_stats;
+  }
+}
+
+/**
+  * @brief  Clear the cache counters, the line counts are kept
+  */
+void SD_CacheResetStats(void)
+{
+  uint32_t dirty = cache_stats.dirty;
+  uint32_t valid = cache_stats.valid;
+
+  memset(&cache_stats, 0, sizeof(cache_stats));
+  cache_stats.dirty = dirty;
+  cache_stats.valid = valid;
+}
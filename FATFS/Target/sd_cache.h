@@ -0,0 +1,93 @@
+/**
+  ******************************************************************************
+  * @file    sd_cache.h
+  * @brief   Set-associative write-back sector cache in front of the SD driver
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SD_CACHE_H
+#define __SD_CACHE_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "diskio.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define SD_CACHE_SECTOR_SIZE  512U
+
+/* 缓存行存放位置：AXI SRAM（RAM_D1）或OCTOSPI1上的PSRAM（内存映射到0x90000000） */
+#define SD_CACHE_STORE_AXI    0
+#define SD_CACHE_STORE_PSRAM  1
+
+#ifndef SD_CACHE_STORE
+#define SD_CACHE_STORE        SD_CACHE_STORE_AXI
+#endif
+
+/* 每组路数，组数须为2的幂；AXI SRAM中64行共32KB，PSRAM中2048行共1MB */
+#define SD_CACHE_WAYS         4U
+#ifndef SD_CACHE_SETS
+#if SD_CACHE_STORE == SD_CACHE_STORE_PSRAM
+#define SD_CACHE_SETS         512U
+#else
+#define SD_CACHE_SETS         16U
+#endif
+#endif
+#define SD_CACHE_LINES        (SD_CACHE_SETS * SD_CACHE_WAYS)
+
+/* 调用上下文，与user_diskio.c的传输上下文相同 */
+#define SD_CACHE_CTX_TASK     0U
+#define SD_CACHE_CTX_POLL     1U
+
+/* Exported types ------------------------------------------------------------*/
+/**
+  * @brief  Lower layer used by the cache
+  *         read/write go to the uncached driver; lock/unlock keep the other
+  *         context (USB interrupt) out while cache lines are changed and may be
+  *         empty when the caller cannot be interrupted
+  */
+typedef struct
+{
+  DRESULT (*read)(uint8_t ctx, BYTE *buff, DWORD sector, UINT count);
+  DRESULT (*write)(uint8_t ctx, const BYTE *buff, DWORD sector, UINT count);
+  void (*lock)(uint8_t ctx);
+  void (*unlock)(uint8_t ctx);
+  void (*dirtied)(uint8_t ctx);   /* A line became dirty, start the write-back timer */
+} SD_CacheOps_t;
+
+/**
+  * @brief  Sector cache statistics
+  */
+typedef struct
+{
+  uint32_t hits;            /* Sectors read from the cache */
+  uint32_t misses;          /* Sector reads that went to the card and were cached */
+  uint32_t bypassed;        /* Requests not cached (multi-sector, sequential or disabled) */
+  uint32_t write_hits;      /* Sector writes absorbed by a cached line */
+  uint32_t write_allocs;    /* Sector writes that allocated a dirty line */
+  uint32_t evictions;       /* Valid lines replaced */
+  uint32_t writebacks;      /* Dirty lines written to the card */
+  uint32_t dirty;           /* Dirty lines now */
+  uint32_t valid;           /* Valid lines now */
+} SD_CacheStats_t;
+
+/* Exported functions ------------------------------------------------------- */
+void SD_CacheInit(const SD_CacheOps_t *ops, uint8_t *store);
+DRESULT SD_CacheRead(uint8_t ctx, BYTE *buff, DWORD sector, UINT count);
+DRESULT SD_CacheWrite(uint8_t ctx, const BYTE *buff, DWORD sector, UINT count);
+DRESULT SD_CacheClean(uint8_t ctx);
+DRESULT SD_CacheSetEnabled(uint8_t ctx, uint8_t enable);
+uint8_t SD_CacheEnabled(void);
+uint32_t SD_CacheDirtyCount(void);
+void SD_CacheGetStats(SD_CacheStats_t *stats);
+void SD_CacheResetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SD_CACHE_H */
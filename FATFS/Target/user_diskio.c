@@ -35,10 +35,54 @@
 /* Includes ------------------------------------------------------------------*/
 #include <string.h>
 #include "ff_gen_drv.h"
+#include "user_diskio.h"
+#include "sd_cache.h"
 #include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "dwt_timebase.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+#define SD_SECTOR_SIZE        512U
+
+/* SDMMC1的IDMA只能访问AXI SRAM（链接脚本中的RAM_D1），D2/DTCM中的缓冲区经中转缓冲区传输 */
+#define SD_DMA_AXI_START      0x24000000UL
+#define SD_DMA_AXI_END        (SD_DMA_AXI_START + 320UL * 1024UL)
+
+/* 中转缓冲区扇区数，更大的传输分块进行；两个上下文共32KB，填满MPU区域10 */
+#define SD_BOUNCE_SECTORS     32U
+
+/* 缓冲区的DMA方式，由SD_DmaMode()统一判断 */
+#define SD_DMA_BOUNCE         0U    /* IDMA不可达或未按Cache行对齐：经中转缓冲区 */
+#define SD_DMA_COHERENT       1U    /* 不可缓存的中转缓冲区：无需维护Cache */
+#define SD_DMA_CACHED         2U    /* AXI SRAM中整行对齐：原地传输，前后各维护一次 */
+
+/* 一次传输或一次卡忙等待的超时时间 */
+#define SD_TIMEOUT_MS         2000U
+
+/* 写缓冲：每个缓冲区的扇区数，至少多少扇区的写入先发ACMD23预擦除，写入停顿多久后自动写出 */
+#define SD_WB_SECTORS         32U
+#define SD_WB_PREERASE_MIN    8U
+#define SD_WB_IDLE_MS         50U
+#define SD_WB_TASK_STACK      256U
+#define SD_WB_TASK_PRIORITY   2U
+
+/* 预读缓存的最大扇区数在user_diskio.h中定义（USER_READ_AHEAD_MAX） */
+
+/* 扇区缓存：脏行在写入停顿多久后写回；存放位置和大小在sd_cache.h中配置 */
+#define SD_CACHE_IDLE_MS      500U
+#define SD_CACHE_PSRAM_BASE   0x90000000UL
+
+/* 传输上下文：任务阻塞等待 / 中断或调度器启动前轮询等待，各用一个中转缓冲区 */
+#define SD_CTX_TASK           0U
+#define SD_CTX_POLL           1U
+
+#define SD_XFER_IDLE          0U
+#define SD_XFER_BUSY          1U
+#define SD_XFER_DONE          2U
+#define SD_XFER_ERROR         3U
 
 /* Private variables ---------------------------------------------------------*/
 extern SD_HandleTypeDef hsd1;
@@ -46,6 +90,1040 @@ extern SD_HandleTypeDef hsd1;
 /* Disk status */
 static volatile DSTATUS Stat = STA_NOINIT;
 
+/* 任务上下文：互斥访问SD卡，阻塞在完成信号量上直到IDMA完成或出错 */
+static SemaphoreHandle_t sd_mutex;
+static StaticSemaphore_t sd_mutex_buf;
+static SemaphoreHandle_t sd_done;
+static StaticSemaphore_t sd_done_buf;
+
+/* 当前IDMA传输所属上下文及各上下文的传输状态，由完成/错误回调更新 */
+static volatile uint8_t sd_xfer_ctx;
+static volatile uint8_t sd_xfer_state[2];
+
+/* 写入数据已全部发出，卡可能仍在编程，下一条命令前需等待 */
+static volatile uint8_t sd_card_busy;
+
+/*
+ * 中转缓冲区位于.sd_dma_buffer：AXI SRAM开头由MPU区域10设为不可缓存，IDMA可直接访问，
+ * CPU拷贝进出即可，不做Cache维护，也就不会波及调用者缓冲区的相邻数据。
+ * USB MSC在OTG_HS中断中调用，可能打断正在使用缓冲区的任务，因此两个上下文各用一个。
+ */
+static uint8_t sd_bounce[2][SD_BOUNCE_SECTORS * SD_SECTOR_SIZE] __attribute__((section(".sd_dma_buffer"))) __attribute__((aligned(32)));
+
+/*
+ * 写缓冲（write-behind）：连续扇区的小写入先收集在sd_wb_buf[sd_wb_fill]中，
+ * 不连续、放不下、读到这些扇区、CTRL_SYNC或写入停顿SD_WB_IDLE_MS后一次多块写出。
+ * 后台写出的错误计入统计并由下一次CTRL_SYNC返回。
+ * 任务上下文写出时不等待IDMA完成，改为收集另一个缓冲区，下一次访问卡时再等待，
+ * 这样写入与卡编程时间重叠。
+ */
+static uint8_t sd_wb_buf[2][SD_WB_SECTORS * SD_SECTOR_SIZE] __attribute__((aligned(32)));
+static uint8_t sd_wb_fill;
+static DWORD sd_wb_sector;
+static UINT sd_wb_count;
+static volatile TickType_t sd_wb_last;
+static volatile uint8_t sd_wb_inflight;   /* 另一个缓冲区正在由任务上下文写出 */
+static volatile uint8_t sd_wb_error;      /* 后台写出失败 */
+static TaskHandle_t sd_wb_task;           /* 停顿后写出，创建失败时不使用写缓冲 */
+
+/*
+ * 预读缓存：未命中时从请求的扇区起一次读入sd_ra_sectors个扇区，之后落在其中的
+ * 读取（USB MSC每次只读一个扇区）直接从RAM拷出。写入与缓存重叠时使其失效。
+ * 任务使用缓存期间置sd_ra_busy，此时USB中断中的读取绕过缓存。
+ */
+static uint8_t sd_ra_buf[USER_READ_AHEAD_MAX * SD_SECTOR_SIZE] __attribute__((aligned(32)));
+static uint32_t sd_ra_sectors = USER_READ_AHEAD_MAX;
+static DWORD sd_ra_sector;
+static volatile UINT sd_ra_count;         /* 有效扇区数，0为空 */
+static volatile uint8_t sd_ra_busy;
+static volatile uint8_t sd_ra_stale;      /* 填充期间有重叠写入，结果不保留 */
+
+/*
+ * 扇区缓存（sd_cache.c）位于以上各层之前，缓存FAT和目录等反复读写的单扇区。
+ * 与写缓冲一样在写出任务创建后启用，USB中断中的访问也经过它。
+ */
+#if SD_CACHE_STORE == SD_CACHE_STORE_PSRAM
+/* OCTOSPI1在main.c中切换到内存映射模式 */
+#define SD_CACHE_STORE_BUF    ((uint8_t *)SD_CACHE_PSRAM_BASE)
+#else
+static uint8_t sd_cache_buf[SD_CACHE_LINES * SD_CACHE_SECTOR_SIZE] __attribute__((aligned(32)));
+#define SD_CACHE_STORE_BUF    sd_cache_buf
+#endif
+static volatile uint8_t sd_cache_ready;
+
+static USER_DiskioStats_t sd_stats;
+
+/* Private functions ---------------------------------------------------------*/
+static DRESULT SD_WbFlush(uint8_t ctx);
+static DRESULT SD_Idle(uint8_t ctx);
+static DRESULT SD_CacheLowerRead(uint8_t ctx, BYTE *buff, DWORD sector, UINT count);
+static DRESULT SD_CacheLowerWrite(uint8_t ctx, const BYTE *buff, DWORD sector, UINT count);
+static void SD_CacheEnter(uint8_t ctx);
+static void SD_CacheExit(uint8_t ctx);
+static void SD_CacheDirtied(uint8_t ctx);
+
+static const SD_CacheOps_t sd_cache_ops =
+{
+  SD_CacheLowerRead,
+  SD_CacheLowerWrite,
+  SD_CacheEnter,
+  SD_CacheExit,
+  SD_CacheDirtied,
+};
+
+/**
+  * @brief  Check whether the caller may block on an RTOS object
+  * @retval 1 in a task with the scheduler running, 0 in an ISR or before it starts
+  */
+static uint8_t SD_CanBlock(void)
+{
+  return (__get_IPSR() == 0U) && (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING);
+}
+
+/**
+  * @brief  Write-behind task: writes the collected sectors out once writes pause,
+  *         and the dirty cache lines after a longer pause
+  * @param  argument: Not used
+  */
+static void SD_WbTask(void *argument)
+{
+  for (;;)
+  {
+    /* 开始收集新的一段或缓存行变脏时被唤醒 */
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    while (sd_wb_count > 0U || SD_CacheDirtyCount() > 0U)
+    {
+      TickType_t idle = xTaskGetTickCount() - sd_wb_last;
+      TickType_t limit = pdMS_TO_TICKS((sd_wb_count > 0U) ? SD_WB_IDLE_MS : SD_CACHE_IDLE_MS);
+      DRESULT res = RES_OK;
+
+      if (idle < limit)
+      {
+        vTaskDelay(limit - idle);
+        continue;
+      }
+      xSemaphoreTake(sd_mutex, portMAX_DELAY);
+      if (idle >= pdMS_TO_TICKS(SD_CACHE_IDLE_MS))
+      {
+        /* 写回的扇区进入写缓冲，连续的合并为一次多块写 */
+        res = SD_CacheClean(SD_CTX_TASK);
+      }
+      SD_WbFlush(SD_CTX_TASK);
+      SD_Idle(SD_CTX_TASK);
+      xSemaphoreGive(sd_mutex);
+      if (res != RES_OK)
+      {
+        vTaskDelay(pdMS_TO_TICKS(SD_CACHE_IDLE_MS));
+      }
+    }
+  }
+}
+
+/**
+  * @brief  Set up the sector cache on first use, disabled until the write-back task exists
+  */
+static void SD_CacheSetup(void)
+{
+  uint8_t block = SD_CanBlock();
+
+  if (sd_cache_ready)
+  {
+    return;
+  }
+  if (block) taskENTER_CRITICAL();
+  if (!sd_cache_ready)
+  {
+    SD_CacheInit(&sd_cache_ops, SD_CACHE_STORE_BUF);
+    sd_cache_ready = 1U;
+  }
+  if (block) taskEXIT_CRITICAL();
+}
+
+/**
+  * @brief  Create the mutex, the completion semaphore and the write-behind task on first use from a task
+  */
+static void SD_OsInit(void)
+{
+  if (sd_done != NULL)
+  {
+    return;
+  }
+  taskENTER_CRITICAL();
+  if (sd_done == NULL)
+  {
+    sd_mutex = xSemaphoreCreateMutexStatic(&sd_mutex_buf);
+    sd_done = xSemaphoreCreateBinaryStatic(&sd_done_buf);
+  }
+  taskEXIT_CRITICAL();
+
+  xSemaphoreTake(sd_mutex, portMAX_DELAY);
+  if (sd_wb_task == NULL)
+  {
+    TaskHandle_t handle = NULL;
+
+    if (xTaskCreate(SD_WbTask, "SDWrite", SD_WB_TASK_STACK, NULL, SD_WB_TASK_PRIORITY, &handle) == pdPASS)
+    {
+      sd_wb_task = handle;
+      /* 脏行由这个任务按时写回，之后才能启用缓存 */
+      SD_CacheSetEnabled(SD_CTX_TASK, 1U);
+    }
+  }
+  xSemaphoreGive(sd_mutex);
+}
+
+/**
+  * @brief  Get exclusive use of the SD driver
+  * @retval Transfer context of the caller
+  */
+static uint8_t SD_Lock(void)
+{
+  SD_CacheSetup();
+  if (!SD_CanBlock())
+  {
+    /* 中断中运行到结束，本身就不会被任务打断 */
+    return SD_CTX_POLL;
+  }
+  SD_OsInit();
+  xSemaphoreTake(sd_mutex, portMAX_DELAY);
+  return SD_CTX_TASK;
+}
+
+/**
+  * @brief  Release the SD driver
+  * @param  ctx: Context returned by SD_Lock()
+  */
+static void SD_Unlock(uint8_t ctx)
+{
+  if (ctx == SD_CTX_TASK)
+  {
+    xSemaphoreGive(sd_mutex);
+  }
+}
+
+/**
+  * @brief  Decide how IDMA accesses a buffer
+  *         The only place that looks at buffer addresses; Cache maintenance is done
+  *         by SD_DmaPrepare()/SD_DmaComplete() for SD_DMA_CACHED buffers only
+  * @param  buff: Buffer
+  * @param  len: Length in bytes, a multiple of the sector size
+  * @retval SD_DMA_BOUNCE, SD_DMA_COHERENT or SD_DMA_CACHED
+  */
+static uint8_t SD_DmaMode(const BYTE *buff, uint32_t len)
+{
+  uint32_t addr = (uint32_t)buff;
+
+  if (addr >= (uint32_t)sd_bounce && addr + len <= (uint32_t)sd_bounce + sizeof(sd_bounce))
+  {
+    return SD_DMA_COHERENT;
+  }
+  /* 起始按Cache行对齐且长度为整扇区，维护只涉及缓冲区自身的行 */
+  if (addr >= SD_DMA_AXI_START && addr + len <= SD_DMA_AXI_END && (addr & 31U) == 0U)
+  {
+    return SD_DMA_CACHED;
+  }
+  return SD_DMA_BOUNCE;
+}
+
+/**
+  * @brief  Cache maintenance before IDMA accesses a buffer
+  * @param  buf: Buffer reachable by IDMA
+  * @param  len: Length in bytes
+  * @param  write: 1 if IDMA reads the buffer (card write), 0 if it fills it
+  */
+static void SD_DmaPrepare(const BYTE *buf, uint32_t len, uint8_t write)
+{
+  if (SD_DmaMode(buf, len) != SD_DMA_CACHED)
+  {
+    return;
+  }
+  if (write)
+  {
+    SCB_CleanDCache_by_Addr((uint32_t *)buf, len);
+  }
+  else
+  {
+    /* 整行属于缓冲区，脏行直接丢弃，避免传输期间被写回覆盖IDMA数据 */
+    SCB_InvalidateDCache_by_Addr((uint32_t *)buf, len);
+  }
+}
+
+/**
+  * @brief  Cache maintenance after IDMA has filled a buffer
+  * @param  buf: Buffer reachable by IDMA
+  * @param  len: Length in bytes
+  */
+static void SD_DmaComplete(const BYTE *buf, uint32_t len)
+{
+  if (SD_DmaMode(buf, len) == SD_DMA_CACHED)
+  {
+    /* IDMA写入期间CPU可能预取了旧数据 */
+    SCB_InvalidateDCache_by_Addr((uint32_t *)buf, len);
+  }
+}
+
+/**
+  * @brief  Wait until the card has left the programming state
+  *         A task sleeps one tick between CMD13 polls instead of keeping
+  *         the CPU and the SDMMC bus busy for the whole programming time
+  * @param  block: 1 if the caller may block
+  * @retval 0 when the card is in transfer state, -1 on timeout
+  */
+static int SD_WaitReady(uint8_t block)
+{
+  uint64_t start = Timebase_GetUs();
+  HAL_SD_CardStateTypeDef state;
+
+  for (;;)
+  {
+    /* CMD13不能被中断上下文的传输打断 */
+    if (block) taskENTER_CRITICAL();
+    state = HAL_SD_GetCardState(&hsd1);
+    if (block) taskEXIT_CRITICAL();
+
+    if (state == HAL_SD_CARD_TRANSFER)
+    {
+      return 0;
+    }
+    if (Timebase_GetUs() - start >= SD_TIMEOUT_MS * 1000ULL)
+    {
+      return -1;
+    }
+    if (block)
+    {
+      /* 编程通常需要数毫秒，taskYIELD只让给同优先级任务，低优先级任务仍被饿死 */
+      vTaskDelay(1);
+    }
+  }
+}
+
+/**
+  * @brief  Spin until a transfer of the given context has finished
+  * @param  ctx: Transfer context
+  * @retval 0 when finished, -1 on timeout
+  */
+static int SD_PollXfer(uint8_t ctx)
+{
+  uint64_t start = Timebase_GetUs();
+
+  /* SDMMC1中断优先级高于OTG_HS，在USB中断中也能完成 */
+  while (sd_xfer_state[ctx] == SD_XFER_BUSY)
+  {
+    if (Timebase_GetUs() - start >= SD_TIMEOUT_MS * 1000ULL)
+    {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+  * @brief  Send ACMD23 (SET_WR_BLK_ERASE_COUNT) before a multi-block write
+  *         Lets the card erase the whole run up front; a failure only costs speed
+  * @param  count: Number of sectors about to be written
+  */
+static void SD_PreErase(UINT count)
+{
+  if (SDMMC_CmdAppCommand(hsd1.Instance, hsd1.SdCard.RelCardAdd << 16U) == SDMMC_ERROR_NONE
+      && SDMMC_CmdBlockCount(hsd1.Instance, count) == SDMMC_ERROR_NONE)
+  {
+    sd_stats.preerased++;
+  }
+}
+
+/**
+  * @brief  Start one IDMA transfer
+  *         The bus must be idle (SD_Acquire()); in a task this runs in its critical section
+  * @param  ctx: Transfer context
+  * @param  buf: Buffer reachable by IDMA
+  * @param  sector: Start sector
+  * @param  count: Number of sectors
+  * @param  write: 1 to write, 0 to read
+  * @retval DRESULT: Operation result
+  */
+static DRESULT SD_DmaStart(uint8_t ctx, BYTE *buf, DWORD sector, UINT count, uint8_t write)
+{
+  HAL_StatusTypeDef hal_res;
+
+  if (ctx == SD_CTX_TASK)
+  {
+    xSemaphoreTake(sd_done, 0);
+  }
+  sd_xfer_ctx = ctx;
+  sd_xfer_state[ctx] = SD_XFER_BUSY;
+  if (write)
+  {
+    if (count >= SD_WB_PREERASE_MIN)
+    {
+      SD_PreErase(count);
+    }
+    hal_res = HAL_SD_WriteBlocks_DMA(&hsd1, (const uint8_t *)buf, sector, count);
+  }
+  else
+  {
+    hal_res = HAL_SD_ReadBlocks_DMA(&hsd1, (uint8_t *)buf, sector, count);
+  }
+  if (hal_res != HAL_OK)
+  {
+    sd_xfer_state[ctx] = SD_XFER_IDLE;
+    sd_stats.errors++;
+    return RES_ERROR;
+  }
+  if (write)
+  {
+    sd_card_busy = 1U;
+  }
+  return RES_OK;
+}
+
+/**
+  * @brief  Wait for the IDMA transfer of a context to finish
+  * @param  ctx: Transfer context
+  * @retval DRESULT: Result of the transfer, RES_OK if none was started
+  */
+static DRESULT SD_DmaWait(uint8_t ctx)
+{
+  uint8_t state;
+  int timeout = 0;
+
+  if (sd_xfer_state[ctx] == SD_XFER_IDLE)
+  {
+    return RES_OK;
+  }
+  if (ctx == SD_CTX_TASK)
+  {
+    while (sd_xfer_state[ctx] == SD_XFER_BUSY && !timeout)
+    {
+      timeout = (xSemaphoreTake(sd_done, pdMS_TO_TICKS(SD_TIMEOUT_MS)) != pdTRUE);
+    }
+  }
+  else
+  {
+    sd_stats.polled++;
+    timeout = (SD_PollXfer(ctx) != 0);
+  }
+  if (timeout)
+  {
+    HAL_SD_Abort(&hsd1);
+    sd_xfer_state[ctx] = SD_XFER_IDLE;
+    sd_stats.timeouts++;
+    return RES_ERROR;
+  }
+  state = sd_xfer_state[ctx];
+  sd_xfer_state[ctx] = SD_XFER_IDLE;
+  if (state != SD_XFER_DONE)
+  {
+    sd_stats.errors++;
+    return RES_ERROR;
+  }
+  return RES_OK;
+}
+
+/**
+  * @brief  Wait until no transfer is running and the card accepts commands
+  * @param  ctx: Transfer context of the caller
+  * @retval DRESULT: RES_ERROR on a timeout
+  */
+static DRESULT SD_Idle(uint8_t ctx)
+{
+  if (ctx == SD_CTX_POLL)
+  {
+    /* 打断了任务：等待它已启动的传输结束，结果留给任务读取 */
+    if (SD_PollXfer(SD_CTX_TASK) != 0)
+    {
+      sd_stats.timeouts++;
+      return RES_ERROR;
+    }
+  }
+  else if (sd_wb_inflight)
+  {
+    if (SD_DmaWait(SD_CTX_TASK) != RES_OK)
+    {
+      sd_wb_error = 1U;
+    }
+    sd_wb_inflight = 0U;
+  }
+  if (sd_card_busy)
+  {
+    if (SD_WaitReady(ctx == SD_CTX_TASK) != 0)
+    {
+      sd_stats.timeouts++;
+      return RES_ERROR;
+    }
+    sd_card_busy = 0U;
+  }
+  return RES_OK;
+}
+
+/**
+  * @brief  Make the bus idle for a new transfer
+  *         In a task returns inside a critical section, so that the USB interrupt
+  *         cannot issue commands before the caller has started its transfer
+  * @param  ctx: Transfer context of the caller
+  * @retval DRESULT: RES_OK with the bus idle, otherwise no critical section is held
+  */
+static DRESULT SD_Acquire(uint8_t ctx)
+{
+  for (;;)
+  {
+    DRESULT res = SD_Idle(ctx);
+
+    if (res != RES_OK || ctx != SD_CTX_TASK)
+    {
+      return res;
+    }
+    taskENTER_CRITICAL();
+    /* 等待期间中断上下文可能又写了卡 */
+    if (!sd_card_busy)
+    {
+      return RES_OK;
+    }
+    taskEXIT_CRITICAL();
+  }
+}
+
+/**
+  * @brief  Run one IDMA transfer and wait for its data phase
+  * @param  ctx: Transfer context
+  * @param  buf: Buffer reachable by IDMA
+  * @param  sector: Start sector
+  * @param  count: Number of sectors
+  * @param  write: 1 to write, 0 to read
+  * @retval DRESULT: Operation result
+  */
+static DRESULT SD_DmaTransfer(uint8_t ctx, BYTE *buf, DWORD sector, UINT count, uint8_t write)
+{
+  DRESULT res;
+
+  SD_DmaPrepare(buf, count * SD_SECTOR_SIZE, write);
+  res = SD_Acquire(ctx);
+  if (res != RES_OK)
+  {
+    return res;
+  }
+  res = SD_DmaStart(ctx, buf, sector, count, write);
+  if (ctx == SD_CTX_TASK)
+  {
+    taskEXIT_CRITICAL();
+  }
+  if (res == RES_OK)
+  {
+    res = SD_DmaWait(ctx);
+  }
+  if (res == RES_OK && !write)
+  {
+    SD_DmaComplete(buf, count * SD_SECTOR_SIZE);
+  }
+  return res;
+}
+
+/**
+  * @brief  Transfer sectors through IDMA, bouncing buffers IDMA cannot use
+  *         Caller buffers that are not in AXI SRAM or not cache line aligned are
+  *         only touched by memcpy(), never by Cache maintenance
+  * @param  ctx: Transfer context
+  * @param  buff: Caller buffer
+  * @param  sector: Start sector
+  * @param  count: Number of sectors
+  * @param  write: 1 to write, 0 to read
+  * @retval DRESULT: Operation result
+  */
+static DRESULT SD_Transfer(uint8_t ctx, BYTE *buff, DWORD sector, UINT count, uint8_t write)
+{
+  DRESULT res = RES_OK;
+
+  if (SD_DmaMode(buff, count * SD_SECTOR_SIZE) != SD_DMA_BOUNCE)
+  {
+    return SD_DmaTransfer(ctx, buff, sector, count, write);
+  }
+
+  while (count > 0U && res == RES_OK)
+  {
+    uint8_t *bounce = sd_bounce[ctx];
+    UINT n = (count > SD_BOUNCE_SECTORS) ? SD_BOUNCE_SECTORS : count;
+    uint32_t n_len = n * SD_SECTOR_SIZE;
+
+    if (write)
+    {
+      memcpy(bounce, buff, n_len);
+      res = SD_DmaTransfer(ctx, bounce, sector, n, 1U);
+    }
+    else
+    {
+      res = SD_DmaTransfer(ctx, bounce, sector, n, 0U);
+      if (res == RES_OK)
+      {
+        memcpy(buff, bounce, n_len);
+      }
+    }
+    sd_stats.bounced++;
+    buff += n_len;
+    sector += n;
+    count -= n;
+  }
+  return res;
+}
+
+/**
+  * @brief  Write out the sectors collected in the write-behind buffer
+  *         A task only starts the transfer and collects into the other buffer;
+  *         in an interrupt the transfer is waited for
+  * @param  ctx: Transfer context
+  * @retval DRESULT: Operation result
+  */
+static DRESULT SD_WbFlush(uint8_t ctx)
+{
+  DRESULT res;
+  uint8_t *buf;
+
+  if (sd_wb_count == 0U)
+  {
+    return RES_OK;
+  }
+  res = SD_Acquire(ctx);
+  if (res != RES_OK)
+  {
+    return res;
+  }
+  /* 等待期间中断上下文可能已经写出 */
+  if (sd_wb_count == 0U)
+  {
+    if (ctx == SD_CTX_TASK) taskEXIT_CRITICAL();
+    return RES_OK;
+  }
+
+  buf = sd_wb_buf[sd_wb_fill];
+  SD_DmaPrepare(buf, sd_wb_count * SD_SECTOR_SIZE, 1U);
+  res = SD_DmaStart(ctx, buf, sd_wb_sector, sd_wb_count, 1U);
+  sd_wb_count = 0U;
+  sd_stats.flushes++;
+  if (res != RES_OK)
+  {
+    sd_wb_error = 1U;
+  }
+  if (ctx == SD_CTX_TASK)
+  {
+    if (res == RES_OK)
+    {
+      sd_wb_inflight = 1U;
+      sd_wb_fill ^= 1U;
+    }
+    taskEXIT_CRITICAL();
+  }
+  else if (res == RES_OK)
+  {
+    res = SD_DmaWait(ctx);
+    if (res != RES_OK)
+    {
+      sd_wb_error = 1U;
+    }
+  }
+  return res;
+}
+
+/**
+  * @brief  Write out everything buffered and wait until the card has programmed it
+  * @param  ctx: Transfer context, driver locked
+  * @retval DRESULT: RES_ERROR if this or an earlier background write failed
+  */
+static DRESULT SD_WbSync(uint8_t ctx)
+{
+  DRESULT res = SD_WbFlush(ctx);
+
+  if (SD_Idle(ctx) != RES_OK)
+  {
+    res = RES_ERROR;
+  }
+  if (sd_wb_error)
+  {
+    sd_wb_error = 0U;
+    res = RES_ERROR;
+  }
+  return res;
+}
+
+/**
+  * @brief  Wake the write-behind task
+  */
+static void SD_WbNotify(void)
+{
+  if (sd_wb_task == NULL)
+  {
+    return;
+  }
+  if (__get_IPSR() == 0U)
+  {
+    xTaskNotifyGive(sd_wb_task);
+  }
+  else
+  {
+    BaseType_t woken = pdFALSE;
+
+    vTaskNotifyGiveFromISR(sd_wb_task, &woken);
+    portYIELD_FROM_ISR(woken);
+  }
+}
+
+/**
+  * @brief  Put a write into the write-behind buffer if it fits
+  *         It fits when it starts inside or right after the collected run and
+  *         ends within the buffer; rewritten sectors are overwritten in place
+  * @param  ctx: Transfer context
+  * @param  buff: Data
+  * @param  sector: Start sector
+  * @param  count: Number of sectors
+  * @retval 1 if queued
+  */
+static uint8_t SD_WbQueue(uint8_t ctx, const BYTE *buff, DWORD sector, UINT count)
+{
+  uint8_t queued = 0U;
+  uint8_t start = 0U;
+
+  if (sd_wb_task == NULL || count >= SD_WB_SECTORS)
+  {
+    return 0U;
+  }
+  /* 任务中追加期间不能被USB中断的写入打断 */
+  if (ctx == SD_CTX_TASK) taskENTER_CRITICAL();
+  if (sd_wb_count == 0U)
+  {
+    sd_wb_sector = sector;
+    start = 1U;
+  }
+  if (sector >= sd_wb_sector && sector <= sd_wb_sector + sd_wb_count
+      && sector + count <= sd_wb_sector + SD_WB_SECTORS)
+  {
+    uint32_t offset = sector - sd_wb_sector;
+
+    memcpy(&sd_wb_buf[sd_wb_fill][offset * SD_SECTOR_SIZE], buff, count * SD_SECTOR_SIZE);
+    if (offset + count > sd_wb_count)
+    {
+      sd_wb_count = offset + count;
+    }
+    sd_wb_last = (ctx == SD_CTX_TASK) ? xTaskGetTickCount() : xTaskGetTickCountFromISR();
+    sd_stats.queued++;
+    queued = 1U;
+  }
+  if (ctx == SD_CTX_TASK) taskEXIT_CRITICAL();
+
+  if (queued && start)
+  {
+    SD_WbNotify();
+  }
+  return queued;
+}
+
+/**
+  * @brief  Check whether a sector range overlaps the collected run
+  * @param  sector: Start sector
+  * @param  count: Number of sectors
+  * @retval 1 on overlap
+  */
+static uint8_t SD_WbOverlap(DWORD sector, UINT count)
+{
+  return (sd_wb_count > 0U) && (sector < sd_wb_sector + sd_wb_count) && (sd_wb_sector < sector + count);
+}
+
+/**
+  * @brief  Invalidate read-ahead data overlapping a write
+  *         Called after the write is queued or issued, so a later fill sees it
+  * @param  ctx: Transfer context
+  * @param  sector: Start sector
+  * @param  count: Number of sectors
+  */
+static void SD_RaInvalidate(uint8_t ctx, DWORD sector, UINT count)
+{
+  if (ctx == SD_CTX_TASK) taskENTER_CRITICAL();
+  if (sd_ra_busy)
+  {
+    /* USB中断打断了任务的填充 */
+    sd_ra_stale = 1U;
+  }
+  if (sd_ra_count > 0U && sector < sd_ra_sector + sd_ra_count && sd_ra_sector < sector + count)
+  {
+    sd_ra_count = 0U;
+    sd_stats.ra_invalidated++;
+  }
+  if (ctx == SD_CTX_TASK) taskEXIT_CRITICAL();
+}
+
+/**
+  * @brief  Read sectors through the read-ahead cache
+  * @param  ctx: Transfer context
+  * @param  buff: Caller buffer
+  * @param  sector: Start sector
+  * @param  count: Number of sectors
+  * @retval DRESULT: Operation result
+  */
+static DRESULT SD_RaRead(uint8_t ctx, BYTE *buff, DWORD sector, UINT count)
+{
+  UINT n = sd_ra_sectors;
+  uint8_t own = 0U;
+  DRESULT res = RES_OK;
+
+  if (ctx == SD_CTX_TASK) taskENTER_CRITICAL();
+  if (!sd_ra_busy)
+  {
+    sd_ra_busy = 1U;
+    sd_ra_stale = 0U;
+    own = 1U;
+  }
+  if (ctx == SD_CTX_TASK) taskEXIT_CRITICAL();
+
+  /* 缓存被任务占用、预读关闭或请求本身不小于预读长度时直接读 */
+  if (!own || count >= n)
+  {
+    if (own)
+    {
+      sd_ra_busy = 0U;
+    }
+    sd_stats.ra_bypassed++;
+    return SD_Transfer(ctx, buff, sector, count, 0U);
+  }
+
+  if (sd_ra_count > 0U && sector >= sd_ra_sector && sector + count <= sd_ra_sector + sd_ra_count)
+  {
+    memcpy(buff, &sd_ra_buf[(sector - sd_ra_sector) * SD_SECTOR_SIZE], count * SD_SECTOR_SIZE);
+    sd_stats.ra_hits++;
+    sd_ra_busy = 0U;
+    return RES_OK;
+  }
+
+  /* 未命中：从请求的扇区起读入n个扇区，不超过卡的末尾 */
+  if (sector + n > hsd1.SdCard.LogBlockNbr)
+  {
+    n = (hsd1.SdCard.LogBlockNbr > sector + count) ? hsd1.SdCard.LogBlockNbr - sector : count;
+  }
+  sd_ra_count = 0U;
+  sd_stats.ra_misses++;
+  /* 预读范围内可能有尚未写出的扇区 */
+  if (SD_WbOverlap(sector, n))
+  {
+    res = SD_WbFlush(ctx);
+  }
+  if (res == RES_OK)
+  {
+    res = SD_DmaTransfer(ctx, sd_ra_buf, sector, n, 0U);
+  }
+  if (res == RES_OK)
+  {
+    memcpy(buff, sd_ra_buf, count * SD_SECTOR_SIZE);
+    sd_stats.ra_sectors += n;
+    if (!sd_ra_stale)
+    {
+      sd_ra_sector = sector;
+      sd_ra_count = n;
+    }
+  }
+  sd_ra_busy = 0U;
+  return res;
+}
+
+/**
+  * @brief  Sector cache lower layer: read through write-behind and read-ahead
+  * @param  ctx: Transfer context, driver locked
+  * @param  buff: Caller buffer
+  * @param  sector: Start sector
+  * @param  count: Number of sectors
+  * @retval DRESULT: Operation result
+  */
+static DRESULT SD_CacheLowerRead(uint8_t ctx, BYTE *buff, DWORD sector, UINT count)
+{
+  DRESULT res = RES_OK;
+
+  if (SD_WbOverlap(sector, count))
+  {
+    /* 写缓冲中有更新的数据，先写出 */
+    res = SD_WbFlush(ctx);
+  }
+  if (res == RES_OK)
+  {
+    res = SD_RaRead(ctx, buff, sector, count);
+  }
+  return res;
+}
+
+/**
+  * @brief  Sector cache lower layer: write through write-behind
+  *         小写入放入写缓冲后立即返回；放不下时先写出已收集的扇区再放入，
+  *         大于写缓冲的写入直接传输，不等待卡编程结束（下一条命令前等待）。
+  *         Cache清理在写出时进行。
+  * @param  ctx: Transfer context, driver locked
+  * @param  buff: Data
+  * @param  sector: Start sector
+  * @param  count: Number of sectors
+  * @retval DRESULT: Operation result
+  */
+static DRESULT SD_CacheLowerWrite(uint8_t ctx, const BYTE *buff, DWORD sector, UINT count)
+{
+  DRESULT res = RES_OK;
+
+  if (!SD_WbQueue(ctx, buff, sector, count))
+  {
+    res = SD_WbFlush(ctx);
+    if (res == RES_OK && !SD_WbQueue(ctx, buff, sector, count))
+    {
+      res = SD_Transfer(ctx, (BYTE *)buff, sector, count, 1U);
+    }
+  }
+  SD_RaInvalidate(ctx, sector, count);
+  return res;
+}
+
+/**
+  * @brief  Sector cache lock: keep the USB interrupt out while a task changes lines
+  * @param  ctx: Transfer context
+  */
+static void SD_CacheEnter(uint8_t ctx)
+{
+  if (ctx == SD_CTX_TASK) taskENTER_CRITICAL();
+}
+
+/**
+  * @brief  Sector cache unlock
+  * @param  ctx: Transfer context
+  */
+static void SD_CacheExit(uint8_t ctx)
+{
+  if (ctx == SD_CTX_TASK) taskEXIT_CRITICAL();
+}
+
+/**
+  * @brief  A write dirtied a cache line: restart the idle timer of the write-back task
+  * @param  ctx: Transfer context
+  */
+static void SD_CacheDirtied(uint8_t ctx)
+{
+  sd_wb_last = (ctx == SD_CTX_TASK) ? xTaskGetTickCount() : xTaskGetTickCountFromISR();
+  SD_WbNotify();
+}
+
+/**
+  * @brief  Finish the transfer of the current context
+  * @param  state: SD_XFER_DONE or SD_XFER_ERROR
+  */
+static void SD_XferComplete(uint8_t state)
+{
+  uint8_t ctx = sd_xfer_ctx;
+  BaseType_t woken = pdFALSE;
+
+  if (sd_xfer_state[ctx] != SD_XFER_BUSY)
+  {
+    return;
+  }
+  sd_xfer_state[ctx] = state;
+  if (ctx == SD_CTX_TASK && sd_done != NULL)
+  {
+    xSemaphoreGiveFromISR(sd_done, &woken);
+    portYIELD_FROM_ISR(woken);
+  }
+}
+
+/**
+  * @brief  SD Rx transfer complete callback (SDMMC1 interrupt)
+  */
+void HAL_SD_RxCpltCallback(SD_HandleTypeDef *hsd)
+{
+  SD_XferComplete(SD_XFER_DONE);
+}
+
+/**
+  * @brief  SD Tx transfer complete callback (SDMMC1 interrupt)
+  */
+void HAL_SD_TxCpltCallback(SD_HandleTypeDef *hsd)
+{
+  SD_XferComplete(SD_XFER_DONE);
+}
+
+/**
+  * @brief  SD error callback (SDMMC1 interrupt)
+  */
+void HAL_SD_ErrorCallback(SD_HandleTypeDef *hsd)
+{
+  SD_XferComplete(SD_XFER_ERROR);
+}
+
+/**
+  * @brief  Get the transfer statistics
+  * @param  stats: Output statistics
+  */
+void USER_GetStats(USER_DiskioStats_t *stats)
+{
+  if (stats != NULL)
+  {
+    *stats = sd_stats;
+    SD_CacheGetStats(&stats->cache);
+  }
+}
+
+/**
+  * @brief  Clear the transfer statistics
+  */
+void USER_ResetStats(void)
+{
+  memset(&sd_stats, 0, sizeof(sd_stats));
+  SD_CacheResetStats();
+}
+
+/**
+  * @brief  Set the read-ahead length
+  * @param  sectors: Sectors fetched on a miss, 0 disables; limited to USER_READ_AHEAD_MAX
+  */
+void USER_SetReadAhead(uint32_t sectors)
+{
+  uint8_t ctx = SD_Lock();
+
+  if (ctx == SD_CTX_TASK) taskENTER_CRITICAL();
+  sd_ra_sectors = (sectors > USER_READ_AHEAD_MAX) ? USER_READ_AHEAD_MAX : sectors;
+  sd_ra_count = 0U;
+  if (ctx == SD_CTX_TASK) taskEXIT_CRITICAL();
+  SD_Unlock(ctx);
+}
+
+/**
+  * @brief  Get the read-ahead length
+  * @retval Sectors fetched on a miss, 0 if disabled
+  */
+uint32_t USER_GetReadAhead(void)
+{
+  return sd_ra_sectors;
+}
+
+/**
+  * @brief  Enable or disable the sector cache
+  *         Disabling writes the dirty lines to the card first
+  * @param  enable: 1 to enable
+  * @retval 0 on success, -1 on a write-back error or without the write-back task
+  */
+int USER_SetCache(uint8_t enable)
+{
+  uint8_t ctx = SD_Lock();
+  DRESULT res;
+
+  if (enable && sd_wb_task == NULL)
+  {
+    res = RES_NOTRDY;
+  }
+  else
+  {
+    res = SD_CacheSetEnabled(ctx, enable);
+    if (res == RES_OK && !enable)
+    {
+      res = SD_WbSync(ctx);
+    }
+  }
+  SD_Unlock(ctx);
+  return (res == RES_OK) ? 0 : -1;
+}
+
+/**
+  * @brief  Check whether the sector cache is enabled
+  * @retval 1 if enabled
+  */
+uint8_t USER_GetCache(void)
+{
+  return SD_CacheEnabled();
+}
+
 /* USER CODE END DECL */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -99,10 +1177,24 @@ DSTATUS USER_status (
 )
 {
   /* USER CODE BEGIN STATUS */
+  HAL_SD_CardStateTypeDef state;
+  uint8_t block = SD_CanBlock();
+
   if (pdrv != 0) return STA_NOINIT; /* We only support one drive */
 
+  /* IDMA传输进行中或卡在编程时卡不在transfer状态，也不能插入CMD13，沿用上次的状态 */
+  if (sd_xfer_state[SD_CTX_TASK] == SD_XFER_BUSY || sd_xfer_state[SD_CTX_POLL] == SD_XFER_BUSY
+      || sd_card_busy || sd_wb_inflight)
+  {
+    return Stat;
+  }
+
+  if (block) taskENTER_CRITICAL();
+  state = HAL_SD_GetCardState(&hsd1);
+  if (block) taskEXIT_CRITICAL();
+
   Stat = STA_NOINIT;
-  if (HAL_SD_GetCardState(&hsd1) == HAL_SD_CARD_TRANSFER)
+  if (state == HAL_SD_CARD_TRANSFER)
   {
     Stat &= ~STA_NOINIT;
   }
@@ -126,47 +1218,22 @@ DRESULT USER_read (
 )
 {
   /* USER CODE BEGIN READ */
-  DRESULT res = RES_ERROR;
-  HAL_StatusTypeDef hal_res;
+  DRESULT res = RES_OK;
+  uint8_t ctx;
 
   if (pdrv != 0) return RES_PARERR;
 
   // INFO_PRINTF("USER_read: sector=%lu, count=%u", sector, count);
-  
-  /*
-   * SDMMC DMA缓存一致性的正确实现
-   * 关键：使用内存屏障确保操作顺序，避免乱序执行
-   */
-  uint32_t cache_size = count * 512;
-  
-  /* 1. DMA前：清理并失效缓存，为DMA写入做准备 */
-  SCB_CleanInvalidateDCache_by_Addr((uint32_t*)buff, cache_size);
-  
-  /* 2. 内存屏障：确保缓存操作完成 */
-  __DSB();
-  __ISB();
-  
-  /* 3. 执行SDMMC DMA读取 */
-  hal_res = HAL_SD_ReadBlocks(&hsd1, (uint8_t *)buff, sector, count, HAL_MAX_DELAY);
-  
-  if (hal_res == HAL_OK)
-  {
-    /* 4. 内存屏障：确保DMA操作完成 */
-    __DSB();
-    
-    /* 5. DMA后：失效缓存，确保CPU看到DMA写入的最新数据 */
-    SCB_InvalidateDCache_by_Addr((uint32_t*)buff, cache_size);
-    
-    /* 6. 内存屏障：确保缓存失效完成 */
-    __DSB();
-    __ISB();
-    
-    res = RES_OK;
-  }
-  else
+
+  /* IDMA传输，任务中阻塞等待完成中断，CPU留给音频和USB任务 */
+  ctx = SD_Lock();
+  res = SD_CacheRead(ctx, buff, sector, count);
+  SD_Unlock(ctx);
+
+  sd_stats.reads++;
+  if (res == RES_OK)
   {
-    // ERROR_PRINTF("USER_read failed! HAL_SD_ReadBlocks returned %d", hal_res);
-    res = RES_ERROR;
+    sd_stats.read_sectors += count;
   }
   return res;
   /* USER CODE END READ */
@@ -189,27 +1256,22 @@ DRESULT USER_write (
 )
 {
   /* USER CODE BEGIN WRITE */
-  DRESULT res = RES_ERROR;
-  HAL_StatusTypeDef hal_res;
+  DRESULT res;
+  uint8_t ctx;
 
   if (pdrv != 0) return RES_PARERR;
 
   // INFO_PRINTF("USER_write: sector=%lu, count=%u", sector, count);
-  /*
-   * 根本原因修复: 缓存一致性问题。
-   * 在DMA从内存读取数据写入SD卡之前，必须先将D-Cache中已修改但未写回内存的数据“清理”回内存。
-   * 这确保DMA读取到的是最新的数据。
-   */
-  SCB_CleanDCache_by_Addr((uint32_t*)buff, count * 512);
-  hal_res = HAL_SD_WriteBlocks(&hsd1, (const uint8_t *)buff, sector, count, HAL_MAX_DELAY);
-  if (hal_res == HAL_OK)
-  {
-    res = RES_OK;
-  }
-  else
+
+  /* 扇区缓存吸收重复写入的单扇区，其余经写缓冲写出 */
+  ctx = SD_Lock();
+  res = SD_CacheWrite(ctx, buff, sector, count);
+  SD_Unlock(ctx);
+
+  sd_stats.writes++;
+  if (res == RES_OK)
   {
-    // ERROR_PRINTF("USER_write failed! HAL_SD_WriteBlocks returned %d. SD Error Code: 0x%lX", hal_res, hsd1.ErrorCode);
-    res = RES_ERROR;
+    sd_stats.write_sectors += count;
   }
   return res;
   /* USER CODE END WRITE */
@@ -241,8 +1303,17 @@ DRESULT USER_ioctl (
   {
   /* Make sure that no pending write process */
   case CTRL_SYNC :
-    res = RES_OK;
+  {
+    /* 写回脏缓存行，写出写缓冲并等待卡编程结束 */
+    uint8_t ctx = SD_Lock();
+    res = SD_CacheClean(ctx);
+    if (SD_WbSync(ctx) != RES_OK)
+    {
+      res = RES_ERROR;
+    }
+    SD_Unlock(ctx);
     break;
+  }
 
   /* Get number of sectors on the disk (DWORD) */
   case GET_SECTOR_COUNT :
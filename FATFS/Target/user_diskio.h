@@ -29,11 +29,48 @@
 /* USER CODE BEGIN 0 */
 
 /* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "sd_cache.h"
+
 /* Exported types ------------------------------------------------------------*/
+/**
+  * @brief  SD transfer statistics of the USER driver
+  */
+typedef struct
+{
+  uint32_t reads;           /* USER_read() calls */
+  uint32_t read_sectors;    /* Sectors read */
+  uint32_t writes;          /* USER_write() calls */
+  uint32_t write_sectors;   /* Sectors written */
+  uint32_t bounced;         /* Chunks through the non-cacheable bounce buffer */
+  uint32_t polled;          /* Transfers waited for by polling (ISR / before scheduler) */
+  uint32_t queued;          /* Writes absorbed by the write-behind buffer */
+  uint32_t flushes;         /* Multi-block writes of the write-behind buffer */
+  uint32_t preerased;       /* ACMD23 pre-erase counts sent before multi-block writes */
+  uint32_t ra_hits;         /* Reads served from the read-ahead cache */
+  uint32_t ra_misses;       /* Reads that filled the read-ahead cache */
+  uint32_t ra_bypassed;     /* Reads not using the cache (disabled, too long or busy) */
+  uint32_t ra_invalidated;  /* Cache contents dropped by overlapping writes */
+  uint32_t ra_sectors;      /* Sectors fetched into the cache */
+  uint32_t errors;          /* HAL start or transfer errors */
+  uint32_t timeouts;        /* Transfers aborted after SD_TIMEOUT_MS */
+  SD_CacheStats_t cache;    /* Sector cache in front of the layers above */
+} USER_DiskioStats_t;
+
 /* Exported constants --------------------------------------------------------*/
+/* Largest read-ahead length in sectors (cache buffer size, 32 KB) */
+#define USER_READ_AHEAD_MAX   64U
+
 /* Exported functions ------------------------------------------------------- */
 extern Diskio_drvTypeDef  USER_Driver;
 
+void USER_GetStats(USER_DiskioStats_t *stats);
+void USER_ResetStats(void);
+void USER_SetReadAhead(uint32_t sectors);
+uint32_t USER_GetReadAhead(void);
+int USER_SetCache(uint8_t enable);
+uint8_t USER_GetCache(void);
+
 /* USER CODE END 0 */
 
 #ifdef __cplusplus
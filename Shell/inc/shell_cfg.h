@@ -266,4 +266,31 @@
 #define     SHELL_SUPPORT_ARRAY_PARAM   0
 #endif /** SHELL_SUPPORT_ARRAY_PARAM */
 
+#ifndef SHELL_USING_CMD_INDEX
+/**
+ * @brief 使用命令索引
+ *        使能后，`shellInit()`时建立按名称排序的命令下标表和按键表，
+ *        命令查找为二分查找，按键匹配只遍历按键定义
+ */
+#define     SHELL_USING_CMD_INDEX       1
+#endif /** SHELL_USING_CMD_INDEX */
+
+#ifndef SHELL_CMD_INDEX_MAX
+/**
+ * @brief 命令索引最大条目数
+ *        命令表条目数超过此值时不建立索引，退回线性查找
+ */
+#define     SHELL_CMD_INDEX_MAX         256
+#endif /** SHELL_CMD_INDEX_MAX */
+
+#ifndef SHELL_USING_PIPE
+/**
+ * @brief 使用管道和输出重定向
+ *        使能后，命令行中未加引号的`|`把前一段命令的输出存入内存缓冲区，
+ *        作为后一段命令的输入，`>`/`>>`把最后一段命令的输出写入文件，
+ *        需要实现`shell_pipe.h`中的`shellPipeExec()`
+ */
+#define     SHELL_USING_PIPE            0
+#endif /** SHELL_USING_PIPE */
+
 #endif
@@ -16,6 +16,12 @@
 #include "FreeRTOS.h"
 #include "portable.h"
 
+/**
+ * @brief 不使用shellTask()内部的轮询循环
+ *        shell_port.c中的任务阻塞等待输入，每次唤醒处理全部已收到的字节
+ */
+#define     SHELL_TASK_WHILE            0
+
 /**
  * @brief 是否使用shell伴生对象
  *        一些扩展的组件(文件系统支持，日志工具等)需要使用伴生对象
@@ -141,4 +147,9 @@
  */
 #define     SHELL_EXEC_UNDEF_FUNC       1
 
+/**
+ * @brief 使用管道和输出重定向（shell_pipe.c）
+ */
+#define     SHELL_USING_PIPE            1
+
 #endif /* __SHELL_CFG_USER_H__ */
\ No newline at end of file
@@ -0,0 +1,59 @@
+/**
+ * @file shell_fmt.h
+ * @author Letter (NevermindZZT@gmail.com)
+ * @brief Small reentrant printf engine for the shell and log output paths
+ * @version 1.0.0
+ * @date 2025-01-16
+ *
+ * @copyright (c) 2025 Letter
+ *
+ */
+
+#ifndef __SHELL_FMT_H__
+#define __SHELL_FMT_H__
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Largest precision formatted exactly by %f
+ *        Higher precisions are padded with zeros
+ */
+#define SHELL_FMT_FLOAT_PREC_MAX            9
+
+/**
+ * @brief Format into a buffer (C99 vsnprintf semantics)
+ *        Supports flags "-+ #0", width and precision (also "*"), length
+ *        modifiers hh/h/l/ll/z/j/t and the conversions d i u o x X c s p %,
+ *        plus fixed-point f/F (L accepted, formatted as double). Other
+ *        conversions (e, g, a, n) are copied to the output unformatted, an
+ *        incomplete conversion at the end of the format ends the output.
+ *        Uses no heap, no locks and no static state.
+ * @param buffer Output buffer (may be NULL if size is 0)
+ * @param size Buffer size
+ * @param format Format string
+ * @param args Arguments
+ * @return Untruncated output length
+ */
+int shellFmtVsnprintf(char *buffer, size_t size, const char *format, va_list args);
+
+/**
+ * @brief Format into a buffer (C99 snprintf semantics)
+ * @param buffer Output buffer
+ * @param size Buffer size
+ * @param format Format string
+ * @param ... Arguments
+ * @return Untruncated output length
+ */
+int shellFmtSnprintf(char *buffer, size_t size, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SHELL_FMT_H__ */
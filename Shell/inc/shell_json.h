@@ -0,0 +1,139 @@
+/**
+ * @file shell_json.h
+ * @author Letter (NevermindZZT@gmail.com)
+ * @brief Compact JSON records for machine-readable command output
+ * @version 1.0.0
+ * @date 2025-01-16
+ * 
+ * @copyright (c) 2025 Letter
+ * 
+ */
+
+#ifndef __SHELL_JSON_H__
+#define __SHELL_JSON_H__
+
+#include "shell.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Output chunk size of a record writer (bytes, on the caller's stack)
+ *        Only used when the record buffer cannot be allocated
+ */
+#ifndef SHELL_JSON_BUF_SIZE
+#define SHELL_JSON_BUF_SIZE                 192
+#endif
+
+/**
+ * @brief Largest record written in one piece (bytes, from the FreeRTOS heap)
+ *        At most SHELL_LOG_RAW_RECORD_MAX, so the record is one console write
+ */
+#ifndef SHELL_JSON_RECORD_MAX
+#define SHELL_JSON_RECORD_MAX               2048
+#endif
+
+/**
+ * @brief Record writer
+ *        Builds one JSON object on a single line without timestamps, color
+ *        codes or printf, and writes it to the shell in one piece so log
+ *        lines of other tasks cannot land inside it. Records longer than
+ *        SHELL_JSON_RECORD_MAX, or built while the heap is exhausted, are
+ *        written in chunks.
+ */
+typedef struct {
+    Shell *shell;                   /*!< Output shell */
+    char *buf;                      /*!< Record buffer, or chunk if not allocated */
+    uint16_t size;                  /*!< Buffer size */
+    uint16_t len;                   /*!< Bytes buffered */
+    uint8_t comma;                  /*!< Next member needs a separator */
+    char chunk[SHELL_JSON_BUF_SIZE];
+} ShellJson_t;
+
+/**
+ * @brief Select the output format of the diagnostic commands
+ * @param enable 1 for JSON records, 0 for text
+ */
+void shellJsonSetMode(uint8_t enable);
+
+/**
+ * @brief Get the output format of the diagnostic commands
+ * @return 1 for JSON records, 0 for text
+ */
+uint8_t shellJsonMode(void);
+
+/**
+ * @brief Start a record: {"cmd":"<cmd>"
+ * @param json Writer
+ * @param shell Output shell
+ * @param cmd Command name
+ */
+void shellJsonBegin(ShellJson_t *json, Shell *shell, const char *cmd);
+
+/**
+ * @brief Finish the record with "}\r\n" and write it out
+ * @param json Writer
+ * @note Must be called for every shellJsonBegin(), it frees the record buffer
+ */
+void shellJsonEnd(ShellJson_t *json);
+
+/**
+ * @brief Add an unsigned number
+ * @param json Writer
+ * @param key Member name, NULL inside an array
+ * @param value Value
+ */
+void shellJsonU64(ShellJson_t *json, const char *key, uint64_t value);
+
+/**
+ * @brief Add a signed number
+ * @param json Writer
+ * @param key Member name, NULL inside an array
+ * @param value Value
+ */
+void shellJsonInt(ShellJson_t *json, const char *key, int32_t value);
+
+/**
+ * @brief Add a string (quotes, backslashes and control characters escaped)
+ * @param json Writer
+ * @param key Member name, NULL inside an array
+ * @param value String
+ */
+void shellJsonStr(ShellJson_t *json, const char *key, const char *value);
+
+/**
+ * @brief Add true or false
+ * @param json Writer
+ * @param key Member name, NULL inside an array
+ * @param value Value
+ */
+void shellJsonBool(ShellJson_t *json, const char *key, uint8_t value);
+
+/**
+ * @brief Open a nested object
+ * @param json Writer
+ * @param key Member name, NULL inside an array
+ */
+void shellJsonObject(ShellJson_t *json, const char *key);
+
+/**
+ * @brief Open a nested array
+ * @param json Writer
+ * @param key Member name, NULL inside an array
+ */
+void shellJsonArray(ShellJson_t *json, const char *key);
+
+/**
+ * @brief Close the innermost object or array
+ * @param json Writer
+ * @param close '}' or ']'
+ */
+void shellJsonClose(ShellJson_t *json, char close);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SHELL_JSON_H__ */
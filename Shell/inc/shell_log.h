@@ -14,11 +14,164 @@
 
 #include "shell.h"
 #include <stdint.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Asynchronous output configuration */
+/**
+ * @brief Asynchronous log output
+ *        1: producers only copy the line into a RAM ring buffer and return,
+ *           a low-priority drain task owns the UART
+ *        0: legacy blocking output through shellPrint()
+ */
+#ifndef SHELL_LOG_ASYNC
+#define SHELL_LOG_ASYNC                     1
+#endif
+
+/**
+ * @brief Ring buffer size in bytes (must be a power of two)
+ */
+#ifndef SHELL_LOG_RING_SIZE
+#define SHELL_LOG_RING_SIZE                 8192
+#endif
+
+/**
+ * @brief Raw console writes up to this size are queued as one ring record,
+ *        so no other task's output can land inside them
+ */
+#ifndef SHELL_LOG_RAW_RECORD_MAX
+#define SHELL_LOG_RAW_RECORD_MAX            (SHELL_LOG_RING_SIZE / 4)
+#endif
+
+/**
+ * @brief Maximum length of one formatted log line
+ */
+#ifndef SHELL_LOG_LINE_MAX
+#define SHELL_LOG_LINE_MAX                  512
+#endif
+
+/**
+ * @brief Drain task priority and stack size (bytes)
+ *        Must stay below the shell task so that interactive work wins
+ */
+#ifndef SHELL_LOG_DRAIN_TASK_PRIORITY
+#define SHELL_LOG_DRAIN_TASK_PRIORITY       2
+#endif
+
+#ifndef SHELL_LOG_DRAIN_TASK_STACK_SIZE
+#define SHELL_LOG_DRAIN_TASK_STACK_SIZE     2048
+#endif
+
+/**
+ * @brief Maximum number of 32-bit arguments of a deferred log record
+ */
+#ifndef SHELL_LOG_DEFER_MAX_ARGS
+#define SHELL_LOG_DEFER_MAX_ARGS            6
+#endif
+
+/**
+ * @brief Whether a format or %s address of a deferred record read back after
+ *        a reset may be dereferenced (default: inside the internal flash)
+ */
+#ifndef SHELL_LOG_DEFER_PTR_VALID
+#define SHELL_LOG_DEFER_PTR_VALID(p)        ((uintptr_t)(p) >= 0x08000000U && (uintptr_t)(p) < 0x08080000U)
+#endif
+
+/* Compile-time level configuration */
+/**
+ * @brief Lowest level compiled into the image
+ *        0=DEBUG, 1=INFO, 2=WARNING, 3=ERROR, 4=NONE
+ *        Calls below this level compile to nothing: no argument evaluation,
+ *        no call and no format string in flash. The runtime levels set with
+ *        logctl only apply to the levels that remain.
+ */
+#ifndef SHELL_LOG_COMPILE_LEVEL
+#define SHELL_LOG_COMPILE_LEVEL             0
+#endif
+
+/**
+ * @brief Per-module compile levels, default to SHELL_LOG_COMPILE_LEVEL
+ *        except USER: shell commands print their output through
+ *        SHELL_LOG_USER_*, so it stays at 0 unless set explicitly
+ */
+#ifndef SHELL_LOG_COMPILE_LEVEL_SYSTEM
+#define SHELL_LOG_COMPILE_LEVEL_SYSTEM      SHELL_LOG_COMPILE_LEVEL
+#endif
+#ifndef SHELL_LOG_COMPILE_LEVEL_CLOCK
+#define SHELL_LOG_COMPILE_LEVEL_CLOCK       SHELL_LOG_COMPILE_LEVEL
+#endif
+#ifndef SHELL_LOG_COMPILE_LEVEL_MEMORY
+#define SHELL_LOG_COMPILE_LEVEL_MEMORY      SHELL_LOG_COMPILE_LEVEL
+#endif
+#ifndef SHELL_LOG_COMPILE_LEVEL_TASK
+#define SHELL_LOG_COMPILE_LEVEL_TASK        SHELL_LOG_COMPILE_LEVEL
+#endif
+#ifndef SHELL_LOG_COMPILE_LEVEL_UART
+#define SHELL_LOG_COMPILE_LEVEL_UART        SHELL_LOG_COMPILE_LEVEL
+#endif
+#ifndef SHELL_LOG_COMPILE_LEVEL_FATFS
+#define SHELL_LOG_COMPILE_LEVEL_FATFS       SHELL_LOG_COMPILE_LEVEL
+#endif
+#ifndef SHELL_LOG_COMPILE_LEVEL_USER
+#define SHELL_LOG_COMPILE_LEVEL_USER        0   /* Command output, not diagnostics */
+#endif
+
+/**
+ * @brief Compile level of a module
+ *        Folds to a constant for constant module IDs, still correct for
+ *        module IDs only known at runtime
+ */
+#define SHELL_LOG_COMPILE_LEVEL_OF(module) \
+    ((module) == SHELL_LOG_MODULE_SYSTEM ? SHELL_LOG_COMPILE_LEVEL_SYSTEM : \
+     (module) == SHELL_LOG_MODULE_CLOCK  ? SHELL_LOG_COMPILE_LEVEL_CLOCK  : \
+     (module) == SHELL_LOG_MODULE_MEMORY ? SHELL_LOG_COMPILE_LEVEL_MEMORY : \
+     (module) == SHELL_LOG_MODULE_TASK   ? SHELL_LOG_COMPILE_LEVEL_TASK   : \
+     (module) == SHELL_LOG_MODULE_UART   ? SHELL_LOG_COMPILE_LEVEL_UART   : \
+     (module) == SHELL_LOG_MODULE_FATFS  ? SHELL_LOG_COMPILE_LEVEL_FATFS  : \
+     (module) == SHELL_LOG_MODULE_USER   ? SHELL_LOG_COMPILE_LEVEL_USER   : \
+     SHELL_LOG_COMPILE_LEVEL)
+
+/**
+ * @brief Delay before a pending "last message repeated N times" is printed,
+ *        also the summary interval while the same line keeps repeating
+ */
+#ifndef SHELL_LOG_DEDUP_FLUSH_MS
+#define SHELL_LOG_DEDUP_FLUSH_MS            1000
+#endif
+
+/**
+ * @brief Log timestamp resolution
+ *        1: "[sec.usec]" from the DWT timebase, 0: "[sec.msec]" from HAL_GetTick()
+ */
+#ifndef SHELL_LOG_TIMESTAMP_US
+#define SHELL_LOG_TIMESTAMP_US              1
+#endif
+
+/**
+ * @brief Maximum number of registered output sinks
+ */
+#ifndef SHELL_LOG_SINK_MAX
+#define SHELL_LOG_SINK_MAX                  4
+#endif
+
+/**
+ * @brief Idle time after which the drain task flushes buffered sinks
+ */
+#ifndef SHELL_LOG_SINK_FLUSH_MS
+#define SHELL_LOG_SINK_FLUSH_MS             2000
+#endif
+
+/**
+ * @brief Per-module/level statistics (logctl stats)
+ *        Counts messages and the CPU cycles spent formatting and writing them
+ */
+#ifndef SHELL_LOG_STATS
+#define SHELL_LOG_STATS                     1
+#endif
+
 /* ANSI Color Codes */
 #define SHELL_COLOR_RESET       "\033[0m"
 #define SHELL_COLOR_BLACK       "\033[30m"
@@ -92,8 +245,92 @@ typedef struct {
     ShellLogLevel_t module_levels[SHELL_LOG_MODULE_MAX];    /*!< Per-module log levels */
     uint8_t color_enabled;                                  /*!< Color output enabled */
     uint8_t timestamp_enabled;                              /*!< Timestamp output enabled */
+    uint8_t dedup_enabled;                                  /*!< Collapse repeated messages */
 } ShellLogConfig_t;
 
+/**
+ * @brief Per-call-site rate limiter state (token bucket)
+ */
+typedef struct {
+    uint32_t last_tick;     /*!< Tick of the last refill */
+    uint32_t tokens;        /*!< Available tokens in 1/1000 units */
+    uint32_t suppressed;    /*!< Calls suppressed since the last allowed one */
+    uint8_t initialized;    /*!< Bucket filled on first use */
+} ShellLogRateLimit_t;
+
+/**
+ * @brief Log ring buffer status
+ */
+typedef struct {
+    uint32_t size;          /*!< Ring size in bytes */
+    uint32_t used;          /*!< Bytes currently queued */
+    uint32_t high_water;    /*!< Maximum bytes ever queued */
+    uint32_t dropped;       /*!< Messages dropped because the ring was full */
+    uint32_t dropped_bytes; /*!< Bytes dropped because the ring was full */
+} ShellLogRingStatus_t;
+
+/**
+ * @brief Log statistics of one module/level pair
+ *        cycles covers formatting in the caller plus the drain task writing
+ *        the line to the sinks; time spent preempted is included
+ */
+typedef struct {
+    uint32_t emitted;       /*!< Messages that passed the runtime filter */
+    uint32_t suppressed;    /*!< Messages filtered by level or rate limit */
+    uint32_t bytes;         /*!< Bytes of formatted output */
+    uint64_t cycles;        /*!< CPU cycles spent on these messages */
+} ShellLogStats_t;
+
+/**
+ * @brief Binary log frame (little endian), decoded by Tools/logdecode.py
+ *        TEXT:  payload is the formatted line, its timestamp is in the text
+ *        DEFER: payload is the format string address followed by the raw
+ *               32-bit arguments; the host resolves the format from the ELF
+ */
+#define SHELL_LOG_BIN_SYNC                  0xA55AU
+#define SHELL_LOG_BIN_TEXT                  1U
+#define SHELL_LOG_BIN_DEFER                 2U
+
+typedef struct __attribute__((packed)) {
+    uint16_t sync;          /*!< SHELL_LOG_BIN_SYNC */
+    uint8_t type;           /*!< SHELL_LOG_BIN_* */
+    uint8_t level;          /*!< ShellLogLevel_t */
+    uint8_t module;         /*!< ShellLogModule_t, 0xFF for text frames */
+    uint8_t reserved;
+    uint16_t len;           /*!< Payload length */
+    uint32_t seq;           /*!< Frame counter, set by the sink (gaps = drops) */
+    uint64_t time_us;       /*!< Timestamp, 0 for text frames */
+} ShellLogBinHeader_t;
+
+/**
+ * @brief Log output sink
+ *        Every complete log line is passed to each enabled sink whose level
+ *        threshold it meets. Sinks are called from the drain task, or from the
+ *        logging context while the drain task is not running.
+ *        An at_produce sink is always called from the logging context (task or
+ *        ISR) when the line is produced and never from the drain task; its write
+ *        must not block. Deferred records are never formatted for it: they go
+ *        unformatted to its write_bin, or are skipped if it has none.
+ *        A sink with write_bin receives binary frames instead of text; deferred
+ *        records then reach it unformatted.
+ */
+typedef struct {
+    const char *name;                               /*!< Sink name (logctl sink) */
+    ShellLogLevel_t level;                          /*!< Minimum level written */
+    uint8_t enabled;                                /*!< Sink enabled */
+    uint8_t task_only;                              /*!< May block: drain task only */
+    uint8_t at_produce;                             /*!< Written when logged, any context */
+    void (*write)(const char *data, uint16_t len);  /*!< Write one log line */
+    void (*write_raw)(const char *data, uint16_t len); /*!< Console echo/prompt, NULL if not a console */
+    void (*flush)(void);                            /*!< Flush buffered data, may be NULL */
+    void (*write_bin)(const ShellLogBinHeader_t *hdr, const void *payload); /*!< Binary frames, NULL for text sinks */
+} ShellLogSink_t;
+
+/**
+ * @brief Output capture callback, called in the context of the capturing task
+ */
+typedef void (*ShellLogCapture_t)(const char *data, uint16_t len);
+
 /* Global log configuration */
 extern ShellLogConfig_t g_shell_log_config;
 
@@ -127,6 +364,60 @@ void shellLogSetColorEnabled(uint8_t enable);
  */
 void shellLogSetTimestampEnabled(uint8_t enable);
 
+/**
+ * @brief Enable/disable collapsing of repeated messages
+ *        Identical consecutive lines (ignoring the timestamp) are printed
+ *        once, followed by "Last message repeated N times". USER lines
+ *        (shell command output) are never collapsed
+ * @param enable 1 to enable, 0 to disable
+ */
+void shellLogSetDedupEnabled(uint8_t enable);
+
+/**
+ * @brief Check if a level is enabled at runtime
+ * @param module Module ID
+ * @param level Log level
+ * @return 1 if enabled, 0 otherwise
+ */
+uint8_t shellLogIsEnabled(ShellLogModule_t module, ShellLogLevel_t level);
+
+/**
+ * @brief Per-call-site token bucket
+ * @param limit Call site state
+ * @param rate Tokens refilled per second
+ * @param burst Bucket depth
+ * @param suppressed Output number of calls suppressed since the last allowed one
+ * @return 1 if the message may be printed, 0 if it is suppressed
+ */
+uint8_t shellLogRateLimit(ShellLogRateLimit_t *limit, uint32_t rate, uint32_t burst,
+                          uint32_t *suppressed);
+
+/**
+ * @brief Count a message suppressed outside shellLogPrint (rate limiter)
+ * @param module Module ID
+ * @param level Log level
+ */
+void shellLogCountSuppressed(ShellLogModule_t module, ShellLogLevel_t level);
+
+/**
+ * @brief Get log statistics of one module/level pair
+ * @param module Module ID
+ * @param level Log level
+ * @param stats Output statistics (zero if SHELL_LOG_STATS is disabled)
+ */
+void shellLogGetStats(ShellLogModule_t module, ShellLogLevel_t level, ShellLogStats_t *stats);
+
+/**
+ * @brief Clear all log statistics
+ */
+void shellLogResetStats(void);
+
+/**
+ * @brief Get the time the statistics were last cleared
+ * @return Microseconds since boot
+ */
+uint64_t shellLogStatsSince(void);
+
 /**
  * @brief Get module name string
  * @param module Module ID
@@ -157,11 +448,189 @@ const char* shellLogGetLevelColor(ShellLogLevel_t level);
  */
 void shellLogPrint(ShellLogModule_t module, ShellLogLevel_t level, const char* format, ...);
 
+/**
+ * @brief Create the drain task that owns the console output
+ * @return 0 on success, -1 if the task could not be created
+ * @note Until this succeeds all output is written synchronously
+ */
+int shellLogStartDrain(void);
+
+/**
+ * @brief Register the task whose output must not be dropped
+ *        Output from this task (normally the shell task running a command)
+ *        waits for ring space instead of being discarded
+ * @param task FreeRTOS task handle
+ */
+void shellLogSetConsoleTask(void *task);
+
+/**
+ * @brief Queue raw console output (shell echo, prompt) behind pending logs
+ *        Up to SHELL_LOG_RAW_RECORD_MAX bytes stay together on the console
+ * @param data Data to write
+ * @param len Data length
+ * @return 0 if queued, -1 if the caller has to write it directly
+ */
+int shellLogWriteRaw(const char *data, uint16_t len);
+
+/**
+ * @brief Wait until all queued output has been written
+ * @param timeout_ms Maximum time to wait
+ * @return 0 if the ring is empty, -1 on timeout
+ */
+int shellLogFlush(uint32_t timeout_ms);
+
+/**
+ * @brief Divert the output of one task to a callback
+ *        Log lines and raw console output produced by the task are passed
+ *        to capture synchronously instead of the sinks. Output of other
+ *        tasks, ISRs and deferred records is not captured.
+ * @param task FreeRTOS task handle, NULL to stop capturing
+ * @param capture Callback
+ */
+void shellLogSetCapture(void *task, ShellLogCapture_t capture);
+
+/**
+ * @brief Get the current output capture (to restore it later)
+ * @param task Output capturing task (NULL if none)
+ * @param capture Output callback (NULL if none)
+ */
+void shellLogGetCapture(void **task, ShellLogCapture_t *capture);
+
+/**
+ * @brief Get log ring buffer status
+ * @param status Output status
+ */
+void shellLogGetRingStatus(ShellLogRingStatus_t *status);
+
+/**
+ * @brief Register an output sink
+ * @param sink Sink descriptor (must stay valid)
+ * @return 0 on success, -1 if the table is full
+ */
+int shellLogAddSink(ShellLogSink_t *sink);
+
+/**
+ * @brief Get a registered sink by index
+ * @param index Sink index
+ * @return Sink or NULL
+ */
+ShellLogSink_t* shellLogGetSink(uint8_t index);
+
+/**
+ * @brief Find a registered sink by name
+ * @param name Sink name
+ * @return Sink or NULL
+ */
+ShellLogSink_t* shellLogFindSink(const char *name);
+
+/**
+ * @brief Deferred logging function
+ *        Stores tick, module, level, format address and raw arguments;
+ *        the line is formatted later by the drain task. While the drain task
+ *        runs nothing is formatted in the caller, at_produce sinks included
+ * @param module Module ID
+ * @param level Log level
+ * @param format Format string (must stay valid until drained)
+ * @param args Raw 32-bit arguments
+ * @param nargs Number of arguments
+ * @note Use through SHELL_LOG_DEFER_*. Only 32-bit conversions are supported
+ *       (%d/%i/%u/%x/%X/%o/%c with optional l/h/z, %p and %s). Pointers must be
+ *       cast to uint32_t and %s must reference a string that outlives the
+ *       record, e.g. a literal. 64-bit, wide character and floating point
+ *       values are not supported and are printed as "<%spec?>"; they still
+ *       take one argument slot, so the following conversions stay in step.
+ */
+void shellLogDeferred(ShellLogModule_t module, ShellLogLevel_t level, const char *format,
+                      const uint32_t *args, uint32_t nargs);
+
+/**
+ * @brief Format a deferred record read back from storage (e.g. after a reset)
+ *        Like the drain task, but %s addresses failing SHELL_LOG_DEFER_PTR_VALID
+ *        are printed as "<str 0x...>" instead of being dereferenced
+ * @param buffer Output buffer
+ * @param size Buffer size
+ * @param time_us Record timestamp
+ * @param module Module ID
+ * @param level Log level
+ * @param format Format string, already validated by the caller
+ * @param args Raw 32-bit arguments
+ * @param nargs Number of arguments
+ * @return Line length
+ */
+int shellLogFormatRecord(char *buffer, size_t size, uint64_t time_us, ShellLogModule_t module,
+                         ShellLogLevel_t level, const char *format, const uint32_t *args, uint32_t nargs);
+
+/* Compile-time filter: calls below the compile level of their module expand to dead code */
+#define SHELL_LOG_ENABLED(module, level)    ((int)(level) >= SHELL_LOG_COMPILE_LEVEL_OF(module))
+
+/* Deferred logging macros for hot paths (ISRs, USB/SD callbacks) */
+#define SHELL_LOG_DEFER(module, level, format, ...) \
+    do { \
+        if (SHELL_LOG_ENABLED(module, level)) { \
+            const uint32_t _shell_log_args[] = { 0, ##__VA_ARGS__ }; \
+            _Static_assert(sizeof(_shell_log_args) / sizeof(uint32_t) - 1 <= SHELL_LOG_DEFER_MAX_ARGS, \
+                           "too many deferred log arguments"); \
+            shellLogDeferred(module, level, format, &_shell_log_args[1], \
+                             sizeof(_shell_log_args) / sizeof(uint32_t) - 1); \
+        } \
+    } while (0)
+
+#define SHELL_LOG_DEFER_DEBUG(module, format, ...)   SHELL_LOG_DEFER(module, SHELL_LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#define SHELL_LOG_DEFER_INFO(module, format, ...)    SHELL_LOG_DEFER(module, SHELL_LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#define SHELL_LOG_DEFER_WARNING(module, format, ...) SHELL_LOG_DEFER(module, SHELL_LOG_LEVEL_WARNING, format, ##__VA_ARGS__)
+#define SHELL_LOG_DEFER_ERROR(module, format, ...)   SHELL_LOG_DEFER(module, SHELL_LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+
 /* Convenience macros for different log levels */
-#define SHELL_LOG_DEBUG(module, format, ...)   shellLogPrint(module, SHELL_LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
-#define SHELL_LOG_INFO(module, format, ...)    shellLogPrint(module, SHELL_LOG_LEVEL_INFO, format, ##__VA_ARGS__)
-#define SHELL_LOG_WARNING(module, format, ...) shellLogPrint(module, SHELL_LOG_LEVEL_WARNING, format, ##__VA_ARGS__)
-#define SHELL_LOG_ERROR(module, format, ...)   shellLogPrint(module, SHELL_LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+#define SHELL_LOG_PRINT(module, level, format, ...) \
+    do { \
+        if (SHELL_LOG_ENABLED(module, level)) { \
+            shellLogPrint(module, level, format, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define SHELL_LOG_DEBUG(module, format, ...)   SHELL_LOG_PRINT(module, SHELL_LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#define SHELL_LOG_INFO(module, format, ...)    SHELL_LOG_PRINT(module, SHELL_LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#define SHELL_LOG_WARNING(module, format, ...) SHELL_LOG_PRINT(module, SHELL_LOG_LEVEL_WARNING, format, ##__VA_ARGS__)
+#define SHELL_LOG_ERROR(module, format, ...)   SHELL_LOG_PRINT(module, SHELL_LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+
+/*
+ * Rate limited variants: at most `burst` messages at once and `rate` per
+ * second from this call site. The number of suppressed calls is reported
+ * with the next message that gets through.
+ */
+#define SHELL_LOG_RATELIMIT(module, level, rate, burst, format, ...) \
+    do { \
+        if (SHELL_LOG_ENABLED(module, level) && shellLogIsEnabled(module, level)) { \
+            static ShellLogRateLimit_t _shell_log_limit; \
+            uint32_t _shell_log_suppressed; \
+            if (shellLogRateLimit(&_shell_log_limit, rate, burst, &_shell_log_suppressed)) { \
+                if (_shell_log_suppressed) { \
+                    shellLogPrint(module, level, "(%lu similar messages suppressed)", \
+                                  (unsigned long)_shell_log_suppressed); \
+                } \
+                shellLogPrint(module, level, format, ##__VA_ARGS__); \
+            } else { \
+                shellLogCountSuppressed(module, level); \
+            } \
+        } \
+    } while (0)
+
+#define SHELL_LOG_DEFER_RATELIMIT(module, level, rate, burst, format, ...) \
+    do { \
+        if (SHELL_LOG_ENABLED(module, level) && shellLogIsEnabled(module, level)) { \
+            static ShellLogRateLimit_t _shell_log_limit; \
+            uint32_t _shell_log_suppressed; \
+            if (shellLogRateLimit(&_shell_log_limit, rate, burst, &_shell_log_suppressed)) { \
+                if (_shell_log_suppressed) { \
+                    SHELL_LOG_DEFER(module, level, "(%lu similar messages suppressed)", \
+                                    _shell_log_suppressed); \
+                } \
+                SHELL_LOG_DEFER(module, level, format, ##__VA_ARGS__); \
+            } else { \
+                shellLogCountSuppressed(module, level); \
+            } \
+        } \
+    } while (0)
 
 /* Module-specific convenience macros */
 #define SHELL_LOG_SYS_DEBUG(format, ...)       SHELL_LOG_DEBUG(SHELL_LOG_MODULE_SYSTEM, format, ##__VA_ARGS__)
@@ -0,0 +1,146 @@
+/**
+ * @file shell_log_sink.h
+ * @author Letter (NevermindZZT@gmail.com)
+ * @brief Shell log sinks: RAM crash buffer and SD-card log file,
+ *        command output capture to a file or a RAM buffer
+ * @version 1.0.0
+ * @date 2025-01-16
+ * 
+ * @copyright (c) 2025 Letter
+ * 
+ */
+
+#ifndef __SHELL_LOG_SINK_H__
+#define __SHELL_LOG_SINK_H__
+
+#include "shell_log.h"
+#include "ff.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Size of the crash log buffer (bytes, kept in .noinit across resets)
+ */
+#ifndef SHELL_LOG_CRASH_SIZE
+#define SHELL_LOG_CRASH_SIZE                8192
+#endif
+
+/**
+ * @brief Size of the log file write buffer (bytes, multiple of the sector size)
+ *        Writes are issued in whole clusters up to this size
+ */
+#ifndef SHELL_LOG_FILE_BUF_SIZE
+#define SHELL_LOG_FILE_BUF_SIZE             4096
+#endif
+
+/**
+ * @brief Register the crash and file sinks
+ * @note Call after the console sink has been registered
+ */
+void shellLogSinkInit(void);
+
+/**
+ * @brief Get the number of bytes held in the crash buffer
+ * @return Byte count
+ */
+uint32_t shellLogCrashUsed(void);
+
+/**
+ * @brief Read from the crash buffer, oldest data first
+ * @param pos Offset from the oldest byte
+ * @param buf Output buffer
+ * @param len Maximum bytes to read
+ * @return Bytes read
+ */
+uint32_t shellLogCrashRead(uint32_t pos, char *buf, uint32_t len);
+
+/**
+ * @brief Write out the crash buffer, oldest data first
+ *        Deferred records are stored unformatted and formatted here
+ * @param write Output callback
+ * @return Bytes held in the buffer
+ */
+uint32_t shellLogCrashDump(void (*write)(const char *data, uint16_t len));
+
+/**
+ * @brief Clear the crash buffer
+ */
+void shellLogCrashClear(void);
+
+/**
+ * @brief Get the number of resets seen by the crash buffer
+ * @return Reset count since the last power-on or clear
+ */
+uint32_t shellLogCrashBoots(void);
+
+/**
+ * @brief Mount the volume and start appending log lines to a file
+ * @param path File path
+ * @return FR_OK on success
+ * @note Lines are written by the drain task (SHELL_LOG_ASYNC must be enabled)
+ */
+FRESULT shellLogFileOpen(const char *path);
+
+/**
+ * @brief Flush and close the log file
+ * @return FR_OK on success
+ */
+FRESULT shellLogFileClose(void);
+
+/**
+ * @brief Write buffered data and sync the log file
+ * @return FR_OK on success
+ */
+FRESULT shellLogFileFlush(void);
+
+/**
+ * @brief Get log file state
+ * @param path Output current file path (may be NULL)
+ * @return Last FatFs error (FR_OK if none)
+ */
+FRESULT shellLogFileStatus(const char **path);
+
+/**
+ * @brief Redirect the output of the calling task to a file
+ *        Log lines and console output of the task are written to the file
+ *        (without color codes) instead of the sinks until
+ *        shellLogRedirectClose(), which restores the previous capture;
+ *        other tasks still log normally
+ * @param path File path
+ * @param append 1 to append, 0 to truncate
+ * @return FR_OK on success, FR_LOCKED if a redirect is already active
+ */
+FRESULT shellLogRedirectOpen(const char *path, uint8_t append);
+
+/**
+ * @brief End the redirect and close the file
+ * @param bytes Output bytes written to the file (may be NULL)
+ * @return First write error, or the close result
+ */
+FRESULT shellLogRedirectClose(uint32_t *bytes);
+
+/**
+ * @brief Capture the output of the calling task in a RAM buffer
+ *        Like shellLogRedirectOpen(), but into memory (without color codes);
+ *        output beyond size is counted and discarded
+ * @param buf Buffer
+ * @param size Buffer size
+ * @return 0 on success, -1 if a buffer capture is already active
+ */
+int shellLogBufferOpen(char *buf, uint32_t size);
+
+/**
+ * @brief End the RAM buffer capture and restore the previous capture
+ * @param dropped Output bytes that did not fit (may be NULL)
+ * @return Bytes captured
+ */
+uint32_t shellLogBufferClose(uint32_t *dropped);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SHELL_LOG_SINK_H__ */
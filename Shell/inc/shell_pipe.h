@@ -0,0 +1,67 @@
+/**
+ * @file shell_pipe.h
+ * @author Letter (NevermindZZT@gmail.com)
+ * @brief Shell pipes and output redirection
+ * @version 1.0.0
+ * @date 2025-01-16
+ * 
+ * @copyright (c) 2025 Letter
+ * 
+ */
+
+#ifndef __SHELL_PIPE_H__
+#define __SHELL_PIPE_H__
+
+#include "shell.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Size of each of the two pipe buffers (bytes)
+ *        The output of a stage beyond this size is dropped and reported
+ */
+#ifndef SHELL_PIPE_BUF_SIZE
+#define SHELL_PIPE_BUF_SIZE                 8192
+#endif
+
+/**
+ * @brief Maximum number of commands in one pipeline
+ */
+#ifndef SHELL_PIPE_STAGE_MAX
+#define SHELL_PIPE_STAGE_MAX                4
+#endif
+
+/**
+ * @brief Run the command line as a pipeline if it contains `|` or `>`
+ *        "cmd1 | cmd2 | cmd3 > file": the output of every stage but the last
+ *        is captured in RAM and becomes the input of the next stage, which
+ *        reads it with shellPipeReadLine(). `>` (truncate) or `>>` (append)
+ *        after the last stage writes its output to a FatFs file.
+ * @param shell Shell object, the line is in parser.buffer
+ * @return 0 if the line was handled, -1 if it is a plain command
+ */
+int shellPipeExec(Shell *shell);
+
+/**
+ * @brief Get the input of the running pipeline stage
+ * @param len Output input length (may be NULL)
+ * @return Input data, NULL if the command is not reading from a pipe
+ */
+const char* shellPipeInput(uint32_t *len);
+
+/**
+ * @brief Get the next line of the pipe input
+ * @param pos Read offset, start at 0
+ * @param len Output line length without the line end
+ * @return Line (not terminated), NULL at the end of the input
+ */
+const char* shellPipeReadLine(uint32_t *pos, uint32_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SHELL_PIPE_H__ */
@@ -23,15 +23,46 @@ extern "C" {
 
 /* Exported constants --------------------------------------------------------*/
 #define SHELL_UART                  &huart3
-#define SHELL_BUFFER_SIZE           512
-#define SHELL_RX_QUEUE_SIZE         64
+#define SHELL_BUFFER_SIZE           1024    /* 命令行与历史记录共用，每行 SIZE/(历史数+1) 字节 */
+#define SHELL_RX_STREAM_SIZE        1024    /* 接收流缓冲区大小 */
+#define SHELL_UART_RX_BUF_SIZE      256     /* 接收缓冲区大小（循环DMA或中断接收） */
 #define SHELL_TASK_STACK_SIZE       2048
 #define SHELL_TASK_PRIORITY         3
+#define SHELL_UART_TX_BUF_SIZE      1024    /* 每个DMA发送缓冲区大小（共两个） */
+#define SHELL_UART_DEFAULT_BAUD     115200  /* 上电及回退时的波特率 */
+#define SHELL_UART_BAUD_ERR_MAX     20      /* 允许的最大波特率误差（千分比） */
+#define SHELL_UART_FE_FALLBACK      16      /* 1秒内帧错误达到此数时回退到默认波特率 */
+
+#ifndef SHELL_UART_USE_DMA
+/**
+ * @brief 控制台UART收发方式
+ *        1: DMA收发（接收为循环DMA + 空闲线检测）
+ *        0: FIFO阈值中断收发，每次中断最多搬运8字节
+ */
+#define SHELL_UART_USE_DMA          1
+#endif
 
 /* Exported types ------------------------------------------------------------*/
+/**
+ * @brief 控制台UART统计（中断中累加）
+ */
+typedef struct {
+    uint32_t irq_uart;          /* USART3中断次数 */
+    uint32_t irq_dma_rx;        /* 接收DMA中断次数 */
+    uint32_t irq_dma_tx;        /* 发送DMA中断次数 */
+    uint32_t rx_events;         /* 接收事件次数（半满、全满、空闲） */
+    uint32_t rx_bytes;          /* 接收字节数 */
+    uint32_t rx_dropped;        /* 流缓冲区满丢弃的字节数 */
+    uint32_t tx_bytes;          /* 发送字节数 */
+    uint32_t err_pe;            /* 校验错误 */
+    uint32_t err_ne;            /* 噪声错误 */
+    uint32_t err_fe;            /* 帧错误 */
+    uint32_t err_ore;           /* 溢出错误 */
+} ShellUartStats_t;
 
 /* Exported variables --------------------------------------------------------*/
 extern UART_HandleTypeDef huart3;
+extern volatile ShellUartStats_t shell_uart_stats;
 
 /* Exported functions prototypes ---------------------------------------------*/
 void shell_init(void);
@@ -40,6 +71,18 @@ Shell* shell_get_instance(void);
 void shell_printf(const char *fmt, ...);
 int shell_exec(const char *cmd);
 uint8_t* shell_get_rx_buffer(void);
+short shell_uart_write(const char *data, unsigned short len);
+int shell_uart_flush(uint32_t timeout_ms);
+void shell_uart_rx_restart(void);
+uint32_t shell_uart_get_baud(void);
+uint32_t shell_uart_max_baud(void);
+int shell_uart_set_baud(uint32_t baud);
+int shell_uart_negotiate_baud(uint32_t baud, uint32_t timeout_ms);
+HAL_StatusTypeDef shell_uart_apply_clock(void);
+int shell_uart_set_fifo(uint8_t enable);
+uint8_t shell_uart_get_fifo(void);
+void shell_uart_stats_reset(void);
+void shell_refresh_line(void);
 
 #ifdef __cplusplus
 }
@@ -14,6 +14,10 @@
 #include "stdio.h"
 #include "stdarg.h"
 #include "shell_ext.h"
+#include "shell_fmt.h"
+#if SHELL_USING_PIPE == 1
+#include "shell_pipe.h"
+#endif
 
 
 #if SHELL_USING_CMD_EXPORT == 1
@@ -39,8 +43,9 @@ SHELL_USED const ShellCommand shellUserDefault SHELL_SECTION("shellCommand") =
     #elif defined(__ICCARM__) || defined(__ICCRX__)
         #pragma section="shellCommand"
     #elif defined(__GNUC__)
-        extern const unsigned int _shell_command_start;
-        extern const unsigned int _shell_command_end;
+        /* 不完整数组类型：编译器不知道大小，内联后按命令表下标访问不会被当成越界 */
+        extern const unsigned int _shell_command_start[];
+        extern const unsigned int _shell_command_end[];
     #endif
 #else
     extern const ShellCommand shellCommandList[];
@@ -162,6 +167,23 @@ unsigned char pairedChars[][2] = {
  */
 static Shell *shellList[SHELL_MAX_NUMBER] = {NULL};
 
+#if SHELL_USING_CMD_INDEX == 1
+/**
+ * @brief 命令索引
+ *        item前nameCount项为按名称排序的命令下标（同名时保持命令表顺序），
+ *        其后keyCount项为按键定义的下标；keyFirst为按键键值首字节的位图
+ */
+static struct
+{
+    ShellCommand *base;                                         /**< 建立索引的命令表 */
+    unsigned short count;                                       /**< 命令表条目数 */
+    unsigned short nameCount;                                   /**< 名称索引条目数 */
+    unsigned short keyCount;                                    /**< 按键条目数 */
+    unsigned int keyFirst[8];                                   /**< 按键首字节位图 */
+    unsigned short item[SHELL_CMD_INDEX_MAX];                   /**< 命令下标 */
+} shellCommandIndex;
+#endif /** SHELL_USING_CMD_INDEX == 1 */
+
 
 static void shellAdd(Shell *shell);
 static void shellWritePrompt(Shell *shell, unsigned char newline);
@@ -173,6 +195,9 @@ ShellCommand* shellSeekCommand(Shell *shell,
                                ShellCommand *base,
                                unsigned short compareLength);
 static void shellWriteCommandHelp(Shell *shell, char *cmd);
+#if SHELL_USING_CMD_INDEX == 1
+static void shellBuildCommandIndex(Shell *shell);
+#endif
 
 /**
  * @brief shell 初始化
@@ -224,6 +249,10 @@ void shellInit(Shell *shell, char *buffer, unsigned short size)
     shell->commandList.count = shellCommandCount;
 #endif
 
+#if SHELL_USING_CMD_INDEX == 1
+    shellBuildCommandIndex(shell);
+#endif
+
     shellAdd(shell);
 
     shellSetUser(shell, shellSeekCommand(shell,
@@ -396,7 +425,7 @@ void shellPrint(Shell *shell, const char *fmt, ...)
     SHELL_ASSERT(shell, return);
 
     va_start(vargs, fmt);
-    len = vsnprintf(buffer, SHELL_PRINT_BUFFER, fmt, vargs);
+    len = shellFmtVsnprintf(buffer, SHELL_PRINT_BUFFER, fmt, vargs);
     va_end(vargs);
     if (len > SHELL_PRINT_BUFFER)
     {
@@ -575,10 +604,6 @@ static unsigned short shellStringCompare(char* dest, char *src)
 static const char* shellGetCommandName(ShellCommand *command)
 {
     static char buffer[9];
-    for (unsigned char i = 0; i < 9; i++)
-    {
-        buffer[i] = '0';
-    }
     if (command->attr.attrs.type <= SHELL_TYPE_CMD_FUNC)
     {
         return command->data.cmd.name;
@@ -599,6 +624,10 @@ static const char* shellGetCommandName(ShellCommand *command)
 #endif
     else
     {
+        for (unsigned char i = 0; i < 9; i++)
+        {
+            buffer[i] = '0';
+        }
         shellToHex(command->data.key.value, buffer);
         return buffer;
     }
@@ -1013,6 +1042,131 @@ static void shellRemoveParamQuotes(Shell *shell)
 }
 
 
+#if SHELL_USING_CMD_INDEX == 1
+/**
+ * @brief shell 建立命令索引
+ *        多个shell使用同一命令表时只建立一次
+ * 
+ * @param shell shell对象
+ */
+static void shellBuildCommandIndex(Shell *shell)
+{
+    ShellCommand *base = shell->commandList.base;
+    unsigned short count = shell->commandList.count;
+    unsigned short names = 0;
+    unsigned short keys = 0;
+
+    if (shellCommandIndex.base == base && shellCommandIndex.count == count)
+    {
+        return;
+    }
+    shellCommandIndex.base = NULL;
+    if (count > SHELL_CMD_INDEX_MAX)
+    {
+        return;
+    }
+
+    for (unsigned short i = 0; i < count; i++)
+    {
+        if (base[i].attr.attrs.type == SHELL_TYPE_KEY)
+        {
+            keys++;
+        }
+    }
+    shellCommandIndex.nameCount = count - keys;
+    shellCommandIndex.keyCount = keys;
+    memset(shellCommandIndex.keyFirst, 0, sizeof(shellCommandIndex.keyFirst));
+
+    keys = 0;
+    for (unsigned short i = 0; i < count; i++)
+    {
+        if (base[i].attr.attrs.type == SHELL_TYPE_KEY)
+        {
+            unsigned char first = (unsigned char)(base[i].data.key.value >> 24);
+            shellCommandIndex.keyFirst[first >> 5] |= 1U << (first & 0x1F);
+            shellCommandIndex.item[shellCommandIndex.nameCount + keys++] = i;
+        }
+        else
+        {
+            /* 插入排序，稳定，同名时保持命令表顺序 */
+            const char *name = shellGetCommandName(&base[i]);
+            unsigned short j = names++;
+            while (j > 0
+                   && strcmp(shellGetCommandName(&base[shellCommandIndex.item[j - 1]]), name) > 0)
+            {
+                shellCommandIndex.item[j] = shellCommandIndex.item[j - 1];
+                j--;
+            }
+            shellCommandIndex.item[j] = i;
+        }
+    }
+    shellCommandIndex.count = count;
+    shellCommandIndex.base = base;
+}
+
+
+/**
+ * @brief shell 通过索引匹配命令
+ *        结果与线性查找相同：返回命令表中第一个有权限的匹配项
+ * 
+ * @param shell shell对象
+ * @param cmd 命令
+ * @param compareLength 匹配字符串长度，0为完整匹配
+ * @return ShellCommand* 匹配到的命令
+ */
+static ShellCommand* shellSeekCommandIndexed(Shell *shell,
+                                            const char *cmd,
+                                            unsigned short compareLength)
+{
+    ShellCommand *base = shellCommandIndex.base;
+    const unsigned short *item = shellCommandIndex.item;
+    unsigned short low = 0;
+    unsigned short high = shellCommandIndex.nameCount;
+    ShellCommand *match = NULL;
+
+    /* 二分查找第一个不小于cmd的名称，前缀比较同样保持有序 */
+    while (low < high)
+    {
+        unsigned short mid = (low + high) / 2;
+        const char *name = shellGetCommandName(&base[item[mid]]);
+        int diff = compareLength ? strncmp(name, cmd, compareLength) : strcmp(name, cmd);
+        if (diff < 0)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    for (; low < shellCommandIndex.nameCount; low++)
+    {
+        ShellCommand *command = &base[item[low]];
+        const char *name = shellGetCommandName(command);
+        if ((compareLength ? strncmp(name, cmd, compareLength) : strcmp(name, cmd)) != 0)
+        {
+            break;
+        }
+        if (shellCheckPermission(shell, command) != 0)
+        {
+            continue;
+        }
+        /* 完整匹配时同名项按命令表顺序排列；前缀匹配取命令表中最靠前的一项 */
+        if (!compareLength)
+        {
+            return command;
+        }
+        if (match == NULL || command < match)
+        {
+            match = command;
+        }
+    }
+    return match;
+}
+#endif /** SHELL_USING_CMD_INDEX == 1 */
+
+
 /**
  * @brief shell匹配命令
  * 
@@ -1028,6 +1182,14 @@ ShellCommand* shellSeekCommand(Shell *shell,
                                unsigned short compareLength)
 {
     const char *name;
+#if SHELL_USING_CMD_INDEX == 1
+    if (base == shellCommandIndex.base
+        && shell->commandList.base == base
+        && shell->commandList.count == shellCommandIndex.count)
+    {
+        return shellSeekCommandIndexed(shell, cmd, compareLength);
+    }
+#endif
     unsigned short count = shell->commandList.count -
         ((size_t)base - (size_t)shell->commandList.base) / sizeof(ShellCommand);
     for (unsigned short i = 0; i < count; i++)
@@ -1449,6 +1611,28 @@ void shellNormalInput(Shell *shell, char data)
 }
 
 
+/**
+ * @brief shell查找并运行已解析的命令
+ * 
+ * @param shell shell对象
+ */
+static void shellExecParam(Shell *shell)
+{
+    ShellCommand *command = shellSeekCommand(shell,
+                                             shell->parser.param[0],
+                                             shell->commandList.base,
+                                             0);
+    if (command != NULL)
+    {
+        shellRunCommand(shell, command);
+    }
+    else
+    {
+        shellWriteString(shell, shellText[SHELL_TEXT_CMD_NOT_FOUND]);
+    }
+}
+
+
 /**
  * @brief shell运行命令
  * 
@@ -1469,6 +1653,12 @@ void shellExec(Shell *shell)
     #if SHELL_HISTORY_MAX_NUMBER > 0
         shellHistoryAdd(shell);
     #endif /** SHELL_HISTORY_MAX_NUMBER > 0 */
+    #if SHELL_USING_PIPE == 1
+        if (shellPipeExec(shell) == 0)
+        {
+            return;
+        }
+    #endif /** SHELL_USING_PIPE == 1 */
         shellParserParam(shell);
         shell->parser.length = shell->parser.cursor = 0;
         if (shell->parser.paramCount == 0)
@@ -1476,19 +1666,7 @@ void shellExec(Shell *shell)
             return;
         }
         shellWriteString(shell, "\r\n");
-
-        ShellCommand *command = shellSeekCommand(shell,
-                                                 shell->parser.param[0],
-                                                 shell->commandList.base,
-                                                 0);
-        if (command != NULL)
-        {
-            shellRunCommand(shell, command);
-        }
-        else
-        {
-            shellWriteString(shell, shellText[SHELL_TEXT_CMD_NOT_FOUND]);
-        }
+        shellExecParam(shell);
     }
     else
     {
@@ -1497,6 +1675,25 @@ void shellExec(Shell *shell)
 }
 
 
+/**
+ * @brief shell运行解析缓冲区中的命令
+ *        不加入历史记录，也不输出换行，供管道逐段执行
+ * 
+ * @param shell shell对象
+ */
+void shellExecBuffer(Shell *shell)
+{
+    shell->parser.buffer[shell->parser.length] = 0;
+    shellParserParam(shell);
+    shell->parser.length = shell->parser.cursor = 0;
+    if (shell->parser.paramCount == 0)
+    {
+        return;
+    }
+    shellExecParam(shell);
+}
+
+
 #if SHELL_HISTORY_MAX_NUMBER > 0
 /**
  * @brief shell上方向键输入
@@ -1802,26 +1999,43 @@ void shellHandler(Shell *shell, char data)
 
     /* 遍历ShellCommand列表，尝试进行按键键值匹配 */
     ShellCommand *base = (ShellCommand *)shell->commandList.base;
-    for (short i = 0; i < shell->commandList.count; i++)
+    unsigned short keyCount = shell->commandList.count;
+    const unsigned short *keyItem = NULL;
+#if SHELL_USING_CMD_INDEX == 1
+    /* 有索引时只遍历按键定义，不是任何按键首字节的普通字符直接跳过 */
+    if (base == shellCommandIndex.base && keyCount == shellCommandIndex.count)
+    {
+        keyItem = &shellCommandIndex.item[shellCommandIndex.nameCount];
+        keyCount = shellCommandIndex.keyCount;
+        if (keyByteOffset == 24
+            && (shellCommandIndex.keyFirst[(unsigned char)data >> 5]
+                & (1U << ((unsigned char)data & 0x1F))) == 0)
+        {
+            keyCount = 0;
+        }
+    }
+#endif
+    for (unsigned short i = 0; i < keyCount; i++)
     {
+        ShellCommand *key = keyItem ? &base[keyItem[i]] : &base[i];
         /* 判断是否是按键定义并验证权限 */
-        if (base[i].attr.attrs.type == SHELL_TYPE_KEY
-            && shellCheckPermission(shell, &(base[i])) == 0)
+        if (key->attr.attrs.type == SHELL_TYPE_KEY
+            && shellCheckPermission(shell, key) == 0)
         {
             /* 对输入的字节同按键键值进行匹配 */
-            if ((base[i].data.key.value & keyFilter) == shell->parser.keyValue
-                && (base[i].data.key.value & (0xFF << keyByteOffset))
+            if ((key->data.key.value & keyFilter) == shell->parser.keyValue
+                && (key->data.key.value & (0xFF << keyByteOffset))
                     == (data << keyByteOffset))
             {
                 shell->parser.keyValue |= data << keyByteOffset;
                 data = 0x00;
                 if (keyByteOffset == 0 
-                    || (base[i].data.key.value & (0xFF << (keyByteOffset - 8)))
+                    || (key->data.key.value & (0xFF << (keyByteOffset - 8)))
                         == 0x00000000)
                 {
-                    if (base[i].data.key.function)
+                    if (key->data.key.function)
                     {
-                        base[i].data.key.function(shell);
+                        key->data.key.function(shell);
                     }
                     shell->parser.keyValue = 0x00000000;
                     break;
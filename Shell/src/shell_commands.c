@@ -12,17 +12,25 @@
 #include "shell.h"
 #include "shell_port.h"
 #include "shell_log.h"
+#include "shell_log_sink.h"
+#include "shell_fmt.h"
+#include "shell_pipe.h"
+#include "shell_json.h"
 #include "main.h"
 #include "clock_management.h"
+#include "dwt_timebase.h"
 #include "FreeRTOS.h"
 #include "task.h"
 #include "cmsis_os.h"
 #include "ff.h"
+#include "fatfs.h"
 #include "diskio.h"
 #include "usbd_core.h"
 #include "usb_device.h"
 #include "usbd_storage_if.h"
+#include "usbd_log_if.h"
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -56,6 +64,10 @@ int cmd_sysinfo(int argc, char *argv[])
     SHELL_LOG_SYS_INFO("PCLK1: %lu Hz", HAL_RCC_GetPCLK1Freq());
     SHELL_LOG_SYS_INFO("PCLK2: %lu Hz", HAL_RCC_GetPCLK2Freq());
     SHELL_LOG_SYS_INFO("Tick: %lu ms", HAL_GetTick());
+    uint64_t uptime_us = Timebase_GetUs();
+    SHELL_LOG_SYS_INFO("Uptime: %lu.%06lu s (DWT @ %lu Hz)", 
+           (uint32_t)(uptime_us / 1000000U), (uint32_t)(uptime_us % 1000000U),
+           Timebase_GetCoreClock());
     SHELL_LOG_SYS_INFO("HAL Version: %lu", HAL_GetHalVersion());
     
     // 记录系统状态到日志
@@ -68,12 +80,72 @@ int cmd_sysinfo(int argc, char *argv[])
 SHELL_EXPORT_CMD(SHELL_CMD_PERMISSION(0)|SHELL_CMD_TYPE(SHELL_TYPE_CMD_MAIN), 
                  sysinfo, cmd_sysinfo, show system information);
 
+/**
+ * @brief sddiag as one JSON record
+ * @param shell Shell object
+ * @return 0 on success, -1 on error
+ */
+static int sddiagJson(Shell *shell)
+{
+    static uint8_t sector_buffer[512];
+    ShellJson_t json;
+    HAL_SD_CardInfoTypeDef cardInfo;
+    HAL_SD_CardStateTypeDef cardState = HAL_SD_GetCardState(&hsd1);
+    int ret = -1;
+    
+    shellJsonBegin(&json, shell, "sddiag");
+    shellJsonU64(&json, "state", cardState);
+    if (cardState != HAL_SD_CARD_TRANSFER) {
+        shellJsonStr(&json, "error", "not in transfer state");
+    } else if (HAL_SD_GetCardInfo(&hsd1, &cardInfo) != HAL_OK) {
+        shellJsonStr(&json, "error", "card info");
+    } else {
+        shellJsonU64(&json, "type", cardInfo.CardType);
+        shellJsonU64(&json, "version", cardInfo.CardVersion);
+        shellJsonU64(&json, "blocks", cardInfo.BlockNbr);
+        shellJsonU64(&json, "block_size", cardInfo.BlockSize);
+        shellJsonU64(&json, "log_blocks", cardInfo.LogBlockNbr);
+        shellJsonU64(&json, "log_block_size", cardInfo.LogBlockSize);
+        shellJsonU64(&json, "capacity", (uint64_t)cardInfo.LogBlockNbr * cardInfo.LogBlockSize);
+        if (disk_read(0, sector_buffer, 0, 1) != RES_OK) {
+            shellJsonStr(&json, "error", "MBR read");
+        } else {
+            shellJsonBool(&json, "mbr_sig", sector_buffer[510] == 0x55 && sector_buffer[511] == 0xAA);
+            shellJsonStr(&json, "fs", strncmp((char*)&sector_buffer[54], "FAT", 3) == 0 ? "FAT" :
+                                      strncmp((char*)&sector_buffer[82], "FAT32", 5) == 0 ? "FAT32" : "");
+            ret = 0;
+        }
+    }
+    
+    USER_DiskioStats_t stats;
+    USER_GetStats(&stats);
+    shellJsonObject(&json, "dma");
+    shellJsonU64(&json, "reads", stats.reads);
+    shellJsonU64(&json, "read_sectors", stats.read_sectors);
+    shellJsonU64(&json, "writes", stats.writes);
+    shellJsonU64(&json, "write_sectors", stats.write_sectors);
+    shellJsonU64(&json, "bounced", stats.bounced);
+    shellJsonU64(&json, "polled", stats.polled);
+    shellJsonU64(&json, "queued", stats.queued);
+    shellJsonU64(&json, "flushes", stats.flushes);
+    shellJsonU64(&json, "preerased", stats.preerased);
+    shellJsonU64(&json, "errors", stats.errors);
+    shellJsonU64(&json, "timeouts", stats.timeouts);
+    shellJsonClose(&json, '}');
+    shellJsonEnd(&json);
+    return ret;
+}
+
 /* SD卡诊断命令 */
 int cmd_sddiag(int argc, char *argv[])
 {
     Shell *shell = shellGetCurrent();
     if (!shell) return -1;
     
+    if (shellJsonMode()) {
+        return sddiagJson(shell);
+    }
+    
     SHELL_LOG_SYS_INFO("=== SD Card Diagnostic ===");
     
     // 检查SD卡状态
@@ -103,10 +175,20 @@ int cmd_sddiag(int argc, char *argv[])
         return -1;
     }
     
+    // 经diskio驱动读取，与FatFs和USB的IDMA传输互斥
+    USER_DiskioStats_t stats;
+    USER_GetStats(&stats);
+    SHELL_LOG_SYS_INFO("IDMA: %lu reads (%lu sectors), %lu writes (%lu sectors)",
+                       stats.reads, stats.read_sectors, stats.writes, stats.write_sectors);
+    SHELL_LOG_SYS_INFO("IDMA: %lu bounced, %lu polled, %lu errors, %lu timeouts",
+                       stats.bounced, stats.polled, stats.errors, stats.timeouts);
+    SHELL_LOG_SYS_INFO("Write-behind: %lu writes queued, %lu flushes, %lu pre-erased",
+                       stats.queued, stats.flushes, stats.preerased);
+    
     // 读取并显示MBR（第0扇区）
     static uint8_t sector_buffer[512];
-    status = HAL_SD_ReadBlocks(&hsd1, sector_buffer, 0, 1, 5000);
-    if (status == HAL_OK) {
+    DRESULT dres = disk_read(0, sector_buffer, 0, 1);
+    if (dres == RES_OK) {
         SHELL_LOG_SYS_INFO("=== MBR Content (first 32 bytes) ===");
         for (int i = 0; i < 32; i += 16) {
             SHELL_LOG_SYS_INFO("%04X: %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X",
@@ -135,7 +217,7 @@ int cmd_sddiag(int argc, char *argv[])
         }
         
     } else {
-        SHELL_LOG_SYS_ERROR("Failed to read MBR: %d", status);
+        SHELL_LOG_SYS_ERROR("Failed to read MBR: %d", dres);
         return -1;
     }
     
@@ -645,6 +727,16 @@ int cmd_meminfo(int argc, char *argv[])
     size_t free_heap = xPortGetFreeHeapSize();
     size_t min_free_heap = xPortGetMinimumEverFreeHeapSize();
     
+    if (shellJsonMode()) {
+        ShellJson_t json;
+        shellJsonBegin(&json, shell, "meminfo");
+        shellJsonU64(&json, "free", free_heap);
+        shellJsonU64(&json, "min_free", min_free_heap);
+        shellJsonU64(&json, "total", configTOTAL_HEAP_SIZE);
+        shellJsonEnd(&json);
+        return 0;
+    }
+    
     SHELL_LOG_MEM_INFO("Memory status requested");
     
     SHELL_LOG_MEM_INFO("=== Memory Information ===");
@@ -790,12 +882,59 @@ int cmd_usb_debug(int argc, char *argv[])
 SHELL_EXPORT_CMD(SHELL_CMD_PERMISSION(0)|SHELL_CMD_TYPE(SHELL_TYPE_CMD_MAIN), 
                  usb_debug, cmd_usb_debug, detailed USB device debugging information);
 
+/**
+ * @brief taskinfo as one JSON record
+ *        run is the run time counter (µs, see Timebase), run_total the sum
+ * @param shell Shell object
+ * @return 0 on success, -1 on error
+ */
+static int taskinfoJson(Shell *shell)
+{
+    static const char *const states[] = {"running", "ready", "blocked", "suspended", "deleted"};
+    ShellJson_t json;
+    
+    shellJsonBegin(&json, shell, "taskinfo");
+    shellJsonU64(&json, "tick", xTaskGetTickCount());
+    shellJsonU64(&json, "tick_hz", configTICK_RATE_HZ);
+    
+    UBaseType_t count = uxTaskGetNumberOfTasks();
+    TaskStatus_t *tasks = pvPortMalloc(count * sizeof(TaskStatus_t));
+    if (tasks == NULL) {
+        shellJsonStr(&json, "error", "no memory");
+        shellJsonEnd(&json);
+        return -1;
+    }
+    uint32_t total = 0;
+    count = uxTaskGetSystemState(tasks, count, &total);
+    shellJsonU64(&json, "run_total", total);
+    shellJsonArray(&json, "tasks");
+    for (UBaseType_t i = 0; i < count; i++) {
+        shellJsonObject(&json, NULL);
+        shellJsonStr(&json, "name", tasks[i].pcTaskName);
+        shellJsonStr(&json, "state", tasks[i].eCurrentState <= eDeleted ?
+                                     states[tasks[i].eCurrentState] : "invalid");
+        shellJsonU64(&json, "prio", tasks[i].uxCurrentPriority);
+        shellJsonU64(&json, "stack_free", tasks[i].usStackHighWaterMark);
+        shellJsonU64(&json, "num", tasks[i].xTaskNumber);
+        shellJsonU64(&json, "run", tasks[i].ulRunTimeCounter);
+        shellJsonClose(&json, '}');
+    }
+    shellJsonClose(&json, ']');
+    shellJsonEnd(&json);
+    vPortFree(tasks);
+    return 0;
+}
+
 /* 任务信息命令 */
 int cmd_taskinfo(int argc, char *argv[])
 {
     Shell *shell = shellGetCurrent();
     if (!shell) return -1;
     
+    if (shellJsonMode()) {
+        return taskinfoJson(shell);
+    }
+    
     SHELL_LOG_TASK_INFO("Task information requested");
     
     SHELL_LOG_TASK_INFO("=== FreeRTOS Task Information ===");
@@ -835,7 +974,11 @@ int cmd_reboot(int argc, char *argv[])
     SHELL_LOG_SYS_WARNING("System rebooting...");
     
     SHELL_LOG_SYS_INFO("System rebooting in 100ms...");
-    HAL_Delay(100);
+    /* 等待日志drain任务把缓冲区输出完（HAL_Delay忙等会饿死低优先级的drain任务） */
+    shellLogFlush(100);
+    /* 文件输出端缓冲的不足一簇的数据写入SD卡并同步，否则复位后丢失 */
+    shellLogFileFlush();
+    shell_uart_flush(100);
     NVIC_SystemReset();
     return 0;
 }
@@ -953,6 +1096,109 @@ int cmd_setclock(int argc, char *argv[])
 SHELL_EXPORT_CMD(SHELL_CMD_PERMISSION(0)|SHELL_CMD_TYPE(SHELL_TYPE_CMD_MAIN), 
                  setclock, cmd_setclock, switch system clock profile);
 
+/* 控制台波特率命令 */
+int cmd_baud(int argc, char *argv[])
+{
+    if (argc < 2) {
+        SHELL_LOG_UART_INFO("Current baud: %lu (max %lu, PCLK1 %lu Hz)",
+                            shell_uart_get_baud(), shell_uart_max_baud(), HAL_RCC_GetPCLK1Freq());
+        SHELL_LOG_UART_INFO("Usage: baud <rate> [timeout_ms]  - switch, confirm with Enter at the new rate");
+        SHELL_LOG_UART_INFO("       baud reset                - back to %lu without handshake",
+                            (unsigned long)SHELL_UART_DEFAULT_BAUD);
+        return 0;
+    }
+    
+    if (strcmp(argv[1], "reset") == 0) {
+        shellLogFlush(100);
+        if (shell_uart_set_baud(SHELL_UART_DEFAULT_BAUD) != 0) {
+            SHELL_LOG_UART_ERROR("Cannot set %lu baud at the current clock",
+                                 (unsigned long)SHELL_UART_DEFAULT_BAUD);
+            return -1;
+        }
+        SHELL_LOG_UART_INFO("Baud rate: %lu", shell_uart_get_baud());
+        return 0;
+    }
+    
+    uint32_t baud = strtoul(argv[1], NULL, 0);
+    uint32_t timeout = (argc > 2) ? strtoul(argv[2], NULL, 0) : 10000;
+    uint32_t old = shell_uart_get_baud();
+    
+    switch (shell_uart_negotiate_baud(baud, timeout)) {
+    case 0:
+        SHELL_LOG_UART_INFO("Baud rate switched: %lu -> %lu", old, baud);
+        return 0;
+    case -1:
+        SHELL_LOG_UART_ERROR("%lu baud not reachable within %d.%d%% at PCLK1 %lu Hz (max %lu)",
+                             baud, SHELL_UART_BAUD_ERR_MAX / 10, SHELL_UART_BAUD_ERR_MAX % 10,
+                             HAL_RCC_GetPCLK1Freq(), shell_uart_max_baud());
+        break;
+    case -2:
+        SHELL_LOG_UART_ERROR("UART init at %lu baud failed, kept %lu", baud, old);
+        break;
+    case -3:
+        SHELL_LOG_UART_WARNING("No confirmation within %lu ms, kept %lu baud", timeout, old);
+        break;
+    default:
+        SHELL_LOG_UART_WARNING("Framing errors at %lu baud, kept %lu baud", baud, old);
+        break;
+    }
+    return -1;
+}
+SHELL_EXPORT_CMD(SHELL_CMD_PERMISSION(0)|SHELL_CMD_TYPE(SHELL_TYPE_CMD_MAIN), 
+                 baud, cmd_baud, switch console baud rate);
+
+/* 控制台UART统计命令 */
+int cmd_uartstat(int argc, char *argv[])
+{
+    ShellUartStats_t s;
+    
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        shell_uart_stats_reset();
+        SHELL_LOG_UART_INFO("UART statistics cleared");
+        return 0;
+    }
+    if (argc > 2 && strcmp(argv[1], "fifo") == 0) {
+        uint8_t enable = (strcmp(argv[2], "on") == 0);
+        // 重新初始化UART前把排队的输出发完
+        shellLogFlush(100);
+        if (shell_uart_set_fifo(enable) != 0) {
+            SHELL_LOG_UART_ERROR("UART reinit failed");
+            return -1;
+        }
+        SHELL_LOG_UART_INFO("FIFO %s", enable ? "enabled" : "disabled");
+        return 0;
+    }
+    if (argc > 1) {
+        SHELL_LOG_UART_INFO("Usage: uartstat [reset | fifo on|off]");
+        return -1;
+    }
+    
+    taskENTER_CRITICAL();
+    memcpy(&s, (const void *)&shell_uart_stats, sizeof(s));
+    taskEXIT_CRITICAL();
+    
+    uint32_t irqs = s.irq_uart + s.irq_dma_rx + s.irq_dma_tx;
+    uint32_t bytes = s.rx_bytes + s.tx_bytes;
+    
+    SHELL_LOG_UART_INFO("Mode: %s, FIFO %s, %lu baud",
+                        SHELL_UART_USE_DMA ? "DMA" : "FIFO IRQ",
+                        shell_uart_get_fifo() ? "on" : "off", shell_uart_get_baud());
+    SHELL_LOG_UART_INFO("IRQs:   USART3 %lu, DMA RX %lu, DMA TX %lu",
+                        s.irq_uart, s.irq_dma_rx, s.irq_dma_tx);
+    SHELL_LOG_UART_INFO("RX:     %lu bytes in %lu events, %lu dropped",
+                        s.rx_bytes, s.rx_events, s.rx_dropped);
+    SHELL_LOG_UART_INFO("TX:     %lu bytes", s.tx_bytes);
+    SHELL_LOG_UART_INFO("Errors: FE %lu, NE %lu, ORE %lu, PE %lu",
+                        s.err_fe, s.err_ne, s.err_ore, s.err_pe);
+    if (bytes > 0) {
+        uint32_t per100 = (uint32_t)((uint64_t)irqs * 10000U / bytes);
+        SHELL_LOG_UART_INFO("IRQs per 100 bytes: %lu.%02lu", per100 / 100U, per100 % 100U);
+    }
+    return 0;
+}
+SHELL_EXPORT_CMD(SHELL_CMD_PERMISSION(0)|SHELL_CMD_TYPE(SHELL_TYPE_CMD_MAIN), 
+                 uartstat, cmd_uartstat, console UART interrupt statistics);
+
 /* 版本信息命令 */
 int cmd_version(int argc, char *argv[])
 {
@@ -1010,24 +1256,24 @@ int cmd_hexdump(int argc, char *argv[])
         int ascii_pos = 0;
         
         // 格式化地址
-        hex_pos += snprintf(hex_line + hex_pos, sizeof(hex_line) - hex_pos, "%08lX: ", addr + i);
+        hex_pos += shellFmtSnprintf(hex_line + hex_pos, sizeof(hex_line) - hex_pos, "%08lX: ", addr + i);
         
         // 打印十六进制
         for (uint32_t j = 0; j < 16 && (i + j) < len; j++) {
-            hex_pos += snprintf(hex_line + hex_pos, sizeof(hex_line) - hex_pos, "%02X ", ptr[i + j]);
+            hex_pos += shellFmtSnprintf(hex_line + hex_pos, sizeof(hex_line) - hex_pos, "%02X ", ptr[i + j]);
         }
         
         // 补齐空格
         for (uint32_t j = len - i; j < 16; j++) {
-            hex_pos += snprintf(hex_line + hex_pos, sizeof(hex_line) - hex_pos, "   ");
+            hex_pos += shellFmtSnprintf(hex_line + hex_pos, sizeof(hex_line) - hex_pos, "   ");
         }
         
-        hex_pos += snprintf(hex_line + hex_pos, sizeof(hex_line) - hex_pos, " |");
+        hex_pos += shellFmtSnprintf(hex_line + hex_pos, sizeof(hex_line) - hex_pos, " |");
         
         // 打印ASCII
         for (uint32_t j = 0; j < 16 && (i + j) < len; j++) {
             char c = ptr[i + j];
-            ascii_pos += snprintf(ascii_line + ascii_pos, sizeof(ascii_line) - ascii_pos, 
+            ascii_pos += shellFmtSnprintf(ascii_line + ascii_pos, sizeof(ascii_line) - ascii_pos, 
                                 "%c", (c >= 32 && c <= 126) ? c : '.');
         }
         
@@ -1041,6 +1287,337 @@ int cmd_hexdump(int argc, char *argv[])
 SHELL_EXPORT_CMD(SHELL_CMD_PERMISSION(0)|SHELL_CMD_TYPE(SHELL_TYPE_CMD_MAIN), 
                  hexdump, cmd_hexdump, hex dump memory);
 
+/* 脚本执行命令 */
+#define RUN_LINE_MAX            128
+#define RUN_PATH_MAX            64
+
+/**
+ * @brief Run a shell script from the SD card
+ *        Every line goes through shellRun() like a typed command; empty
+ *        lines and lines starting with '#' are skipped. With -o/-a the
+ *        output of the script goes to a file instead of the console.
+ */
+int cmd_run(int argc, char *argv[])
+{
+    static uint8_t running;
+    static FIL script;
+    static char line[RUN_LINE_MAX];
+    char path[RUN_PATH_MAX] = "";
+    char out[RUN_PATH_MAX] = "";
+    uint8_t timing = 0;
+    uint8_t append = 0;
+    Shell *shell = shellGetCurrent();
+    if (!shell) return -1;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0) {
+            timing = 1;
+        } else if ((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "-a") == 0) && i + 1 < argc) {
+            append = (argv[i][1] == 'a');
+            strncpy(out, argv[++i], sizeof(out) - 1);
+        } else {
+            strncpy(path, argv[i], sizeof(path) - 1);
+        }
+    }
+    // 参数指向shell的解析缓冲区，执行第一行后就会被覆盖，上面已复制
+    if (path[0] == '\0') {
+        SHELL_LOG_USER_INFO("Usage: run [-t] [-o|-a <out>] <script>");
+        SHELL_LOG_USER_INFO("  -t        print the execution time of every line");
+        SHELL_LOG_USER_INFO("  -o <out>  write the output to a file (-a appends)");
+        return -1;
+    }
+    if (running) {
+        SHELL_LOG_USER_ERROR("run: scripts cannot be nested");
+        return -1;
+    }
+    
+    FRESULT res = FATFS_Mount();
+    if (res == FR_OK) {
+        res = f_open(&script, path, FA_READ);
+    }
+    if (res != FR_OK) {
+        SHELL_LOG_USER_ERROR("run: cannot open %s: %d", path, res);
+        return -1;
+    }
+    if (out[0] != '\0') {
+        // 控制台上已排队的输出先发完，避免与脚本输出交错
+        shellLogFlush(1000);
+        res = shellLogRedirectOpen(out, append);
+        if (res != FR_OK) {
+            f_close(&script);
+            SHELL_LOG_USER_ERROR("run: cannot open %s: %d", out, res);
+            return -1;
+        }
+    }
+    
+    running = 1;
+    uint32_t lines = 0;
+    uint32_t number = 0;
+    uint64_t start = Timebase_GetUs();
+    while (f_gets(line, sizeof(line), &script) != NULL) {
+        number++;
+        size_t len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+        char *cmd = line;
+        while (*cmd == ' ' || *cmd == '\t') {
+            cmd++;
+        }
+        if (*cmd == '\0' || *cmd == '#') {
+            continue;
+        }
+        
+        uint64_t t0 = Timebase_GetUs();
+        shellRun(shell, cmd);
+        uint64_t t1 = Timebase_GetUs();
+        lines++;
+        if (timing) {
+            SHELL_LOG_USER_INFO("[run] line %lu: %lu us", number, (uint32_t)(t1 - t0));
+        }
+    }
+    uint32_t total_us = (uint32_t)(Timebase_GetUs() - start);
+    running = 0;
+    
+    res = f_error(&script) ? FR_DISK_ERR : FR_OK;
+    f_close(&script);
+    if (out[0] != '\0') {
+        uint32_t bytes = 0;
+        FRESULT out_res = shellLogRedirectClose(&bytes);
+        if (out_res != FR_OK) {
+            SHELL_LOG_USER_ERROR("run: writing %s failed: %d", out, out_res);
+            return -1;
+        }
+        SHELL_LOG_USER_INFO("run: %lu bytes written to %s", bytes, out);
+    }
+    if (res != FR_OK) {
+        SHELL_LOG_USER_ERROR("run: read error in %s after line %lu", path, number);
+        return -1;
+    }
+    SHELL_LOG_USER_INFO("run: %lu commands in %lu.%03lu ms", lines,
+                        total_us / 1000U, total_us % 1000U);
+    return 0;
+}
+SHELL_EXPORT_CMD(SHELL_CMD_PERMISSION(0)|SHELL_CMD_TYPE(SHELL_TYPE_CMD_MAIN), 
+                 run, cmd_run, run a shell script from the SD card);
+
+/**
+ * @brief Check whether a line contains a string
+ * @param line Line (not terminated)
+ * @param len Line length
+ * @param text String to find
+ * @param nocase Ignore ASCII case
+ * @return 1 if found
+ */
+static int grepMatch(const char *line, uint32_t len, const char *text, uint8_t nocase)
+{
+    uint32_t n = strlen(text);
+    
+    for (uint32_t i = 0; i + n <= len; i++) {
+        uint32_t j = 0;
+        while (j < n) {
+            char a = line[i + j];
+            char b = text[j];
+            if (nocase) {
+                a = (a >= 'A' && a <= 'Z') ? (char)(a + 32) : a;
+                b = (b >= 'A' && b <= 'Z') ? (char)(b + 32) : b;
+            }
+            if (a != b) {
+                break;
+            }
+            j++;
+        }
+        if (j == n) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* 管道过滤命令：按字符串筛选输入行 */
+int cmd_grep(int argc, char *argv[])
+{
+    Shell *shell = shellGetCurrent();
+    if (!shell) return -1;
+    
+    uint8_t invert = 0, nocase = 0, count_only = 0;
+    const char *text = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            invert = 1;
+        } else if (strcmp(argv[i], "-i") == 0) {
+            nocase = 1;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            count_only = 1;
+        } else {
+            text = argv[i];
+        }
+    }
+    if (text == NULL || shellPipeInput(NULL) == NULL) {
+        SHELL_LOG_USER_INFO("Usage: <command> | grep [-v] [-i] [-c] <text>");
+        return -1;
+    }
+    
+    uint32_t pos = 0, len, matches = 0;
+    const char *line;
+    while ((line = shellPipeReadLine(&pos, &len)) != NULL) {
+        if (grepMatch(line, len, text, nocase) == !invert) {
+            matches++;
+            if (!count_only) {
+                shell->write((char *)line, (unsigned short)len);
+                shell->write("\r\n", 2);
+            }
+        }
+    }
+    if (count_only) {
+        shellPrint(shell, "%lu\r\n", matches);
+    }
+    return matches ? 0 : 1;
+}
+SHELL_EXPORT_CMD(SHELL_CMD_PERMISSION(0)|SHELL_CMD_TYPE(SHELL_TYPE_CMD_MAIN)|SHELL_CMD_DISABLE_RETURN, 
+                 grep, cmd_grep, print piped lines containing a string);
+
+/* 管道过滤命令：只输出前N行 */
+int cmd_head(int argc, char *argv[])
+{
+    Shell *shell = shellGetCurrent();
+    if (!shell) return -1;
+    
+    uint32_t lines = 10;
+    if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+        lines = strtoul(argv[2], NULL, 0);
+    } else if (argc > 1) {
+        lines = strtoul(argv[1], NULL, 0);
+    }
+    if (shellPipeInput(NULL) == NULL) {
+        SHELL_LOG_USER_INFO("Usage: <command> | head [-n] [lines]");
+        return -1;
+    }
+    
+    uint32_t pos = 0, len;
+    const char *line;
+    while (lines > 0 && (line = shellPipeReadLine(&pos, &len)) != NULL) {
+        shell->write((char *)line, (unsigned short)len);
+        shell->write("\r\n", 2);
+        lines--;
+    }
+    return 0;
+}
+SHELL_EXPORT_CMD(SHELL_CMD_PERMISSION(0)|SHELL_CMD_TYPE(SHELL_TYPE_CMD_MAIN)|SHELL_CMD_DISABLE_RETURN, 
+                 head, cmd_head, print the first piped lines);
+
+/* 诊断命令输出格式 */
+int cmd_outfmt(int argc, char *argv[])
+{
+    if (argc > 1) {
+        if (strcmp(argv[1], "json") == 0) {
+            shellJsonSetMode(1);
+        } else if (strcmp(argv[1], "text") == 0) {
+            shellJsonSetMode(0);
+        } else {
+            SHELL_LOG_USER_INFO("Usage: outfmt [text|json]");
+            return -1;
+        }
+    }
+    SHELL_LOG_USER_INFO("Output format: %s", shellJsonMode() ? "json" : "text");
+    return 0;
+}
+SHELL_EXPORT_CMD(SHELL_CMD_PERMISSION(0)|SHELL_CMD_TYPE(SHELL_TYPE_CMD_MAIN), 
+                 outfmt, cmd_outfmt, select text or JSON output of diagnostic commands);
+
+/**
+ * @brief Run one fmtbench case through newlib vsnprintf and shellFmtVsnprintf
+ * @param iterations Calls per formatter
+ * @param format Format string
+ * @param ... Arguments
+ * @return 1 if both outputs match
+ */
+static int fmtbenchCase(uint32_t iterations, const char *format, ...)
+{
+    char ref[96];
+    char out[96];
+    va_list args;
+    va_list copy;
+    uint32_t start;
+    
+    va_start(args, format);
+    start = Timebase_GetCycles32();
+    for (uint32_t i = 0; i < iterations; i++) {
+        va_copy(copy, args);
+        vsnprintf(ref, sizeof(ref), format, copy);
+        va_end(copy);
+    }
+    uint32_t libc_cycles = (Timebase_GetCycles32() - start) / iterations;
+    
+    start = Timebase_GetCycles32();
+    for (uint32_t i = 0; i < iterations; i++) {
+        va_copy(copy, args);
+        shellFmtVsnprintf(out, sizeof(out), format, copy);
+        va_end(copy);
+    }
+    uint32_t fmt_cycles = (Timebase_GetCycles32() - start) / iterations;
+    va_end(args);
+    
+    int same = (strcmp(ref, out) == 0);
+    uint32_t ratio = fmt_cycles ? libc_cycles * 100U / fmt_cycles : 0;
+    SHELL_LOG_USER_INFO("%-30s %7lu %7lu %3lu.%02lux %s", format, libc_cycles, fmt_cycles, 
+              ratio / 100U, ratio % 100U, same ? "ok" : "DIFF");
+    if (!same) {
+        SHELL_LOG_USER_WARNING("  newlib:   \"%s\"", ref);
+        SHELL_LOG_USER_WARNING("  shellFmt: \"%s\"", out);
+    }
+    return same;
+}
+
+/* 格式化基准命令：对比newlib与shell_fmt的每次调用周期数，并核对输出 */
+int cmd_fmtbench(int argc, char *argv[])
+{
+    uint32_t iterations = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1000;
+    int same = 0;
+    int total = 0;
+    
+    if (iterations == 0 || iterations > 100000) {
+        SHELL_LOG_USER_ERROR("Usage: fmtbench [iterations 1-100000]");
+        return -1;
+    }
+    
+    SHELL_LOG_USER_INFO("=== Format Benchmark (%lu iterations, cycles/call @ %lu Hz) ===", 
+              iterations, Timebase_GetCoreClock());
+    SHELL_LOG_USER_INFO("%-30s %7s %7s %8s", "Format", "newlib", "shell", "speedup");
+    same += fmtbenchCase(iterations, "%d", -123456); total++;
+    same += fmtbenchCase(iterations, "%u", 4000000000U); total++;
+    same += fmtbenchCase(iterations, "%lu", 550000000UL); total++;
+    same += fmtbenchCase(iterations, "%x", 0xBEEFU); total++;
+    same += fmtbenchCase(iterations, "%08lX", 0x24000000UL); total++;
+    same += fmtbenchCase(iterations, "%02X %02X %02X", 0x0AU, 0xA5U, 0xFFU); total++;
+    same += fmtbenchCase(iterations, "%s", "HAL_OK"); total++;
+    same += fmtbenchCase(iterations, "%-10s|%5s", "uart", "on"); total++;
+    same += fmtbenchCase(iterations, "%c%c", 'O', 'K'); total++;
+    same += fmtbenchCase(iterations, "%.1f", 37.5); total++;
+    same += fmtbenchCase(iterations, "%.3f", 3.14159); total++;
+    same += fmtbenchCase(iterations, "Memory usage: %.1f%% (%u/%u bytes)", 
+                         78.1, 25600U, 32768U); total++;
+    same += fmtbenchCase(iterations, "Clock: %lu Hz (%.1f MHz)", 
+                         550000000UL, 550.0); total++;
+    SHELL_LOG_USER_INFO("%d/%d outputs identical", same, total);
+    return (same == total) ? 0 : -1;
+}
+SHELL_EXPORT_CMD(SHELL_CMD_PERMISSION(0)|SHELL_CMD_TYPE(SHELL_TYPE_CMD_MAIN), 
+                 fmtbench, cmd_fmtbench, compare printf engine cycles with newlib);
+
+/**
+ * @brief logctl crash output: write straight to the console
+ * @param data Data
+ * @param len Data length
+ */
+static void logctlCrashWrite(const char *data, uint16_t len)
+{
+    Shell *shell = shellGetCurrent();
+    if (shell) {
+        shell->write((char *)data, len);
+    }
+}
+
 /* 日志控制命令 */
 int cmd_logctl(int argc, char *argv[])
 {
@@ -1055,6 +1632,13 @@ int cmd_logctl(int argc, char *argv[])
         SHELL_LOG_USER_INFO("  module <mod> <level>      - Set module log level");
         SHELL_LOG_USER_INFO("  color <on|off>            - Enable/disable color output");
         SHELL_LOG_USER_INFO("  timestamp <on|off>        - Enable/disable timestamp");
+        SHELL_LOG_USER_INFO("  dedup <on|off>            - Collapse repeated messages");
+        SHELL_LOG_USER_INFO("  sink [name on|off]        - List sinks / enable or disable a sink");
+        SHELL_LOG_USER_INFO("  sink <name> level <0-4>   - Set sink minimum level");
+        SHELL_LOG_USER_INFO("  file <path|off>           - Log to a file on the SD card");
+        SHELL_LOG_USER_INFO("  flush                     - Write pending log file data");
+        SHELL_LOG_USER_INFO("  crash [clear]             - Dump/clear the crash log buffer");
+        SHELL_LOG_USER_INFO("  stats [reset]             - Per module/level counts and CPU cost");
         SHELL_LOG_USER_INFO("  test                      - Test all log levels");
         SHELL_LOG_USER_INFO("");
         SHELL_LOG_USER_INFO("Log Levels: 0=DEBUG, 1=INFO, 2=WARNING, 3=ERROR, 4=NONE");
@@ -1071,14 +1655,163 @@ int cmd_logctl(int argc, char *argv[])
                   g_shell_log_config.color_enabled ? "Yes" : "No");
         SHELL_LOG_USER_INFO("Timestamp Enabled: %s", 
                   g_shell_log_config.timestamp_enabled ? "Yes" : "No");
+        SHELL_LOG_USER_INFO("Dedup Enabled: %s", 
+                  g_shell_log_config.dedup_enabled ? "Yes" : "No");
         SHELL_LOG_USER_INFO("");
-        SHELL_LOG_USER_INFO("Module Levels:");
+        SHELL_LOG_USER_INFO("Module Levels (runtime / compiled-in):");
         for (int i = 0; i < SHELL_LOG_MODULE_MAX; i++) {
-            SHELL_LOG_USER_INFO("  %s: %d (%s)", 
+            SHELL_LOG_USER_INFO("  %s: %d (%s) / %d (%s)", 
                       shellLogGetModuleName(i),
                       g_shell_log_config.module_levels[i],
-                      shellLogGetLevelName(g_shell_log_config.module_levels[i]));
+                      shellLogGetLevelName(g_shell_log_config.module_levels[i]),
+                      SHELL_LOG_COMPILE_LEVEL_OF(i),
+                      shellLogGetLevelName((ShellLogLevel_t)SHELL_LOG_COMPILE_LEVEL_OF(i)));
+        }
+        
+        ShellLogRingStatus_t ring;
+        shellLogGetRingStatus(&ring);
+        SHELL_LOG_USER_INFO("");
+        SHELL_LOG_USER_INFO("Async Ring: %s", SHELL_LOG_ASYNC ? "Enabled" : "Disabled");
+        SHELL_LOG_USER_INFO("  Used: %lu / %lu bytes (high water %lu)", 
+                  ring.used, ring.size, ring.high_water);
+        SHELL_LOG_USER_INFO("  Dropped: %lu messages, %lu bytes", 
+                  ring.dropped, ring.dropped_bytes);
+    }
+    else if (strcmp(argv[1], "sink") == 0) {
+        if (argc < 3) {
+            const char *path;
+            FRESULT res = shellLogFileStatus(&path);
+            SHELL_LOG_USER_INFO("=== Log Sinks ===");
+            for (uint8_t i = 0; shellLogGetSink(i) != NULL; i++) {
+                ShellLogSink_t *sink = shellLogGetSink(i);
+                SHELL_LOG_USER_INFO("  %-6s %-3s level %d (%s)%s", 
+                          sink->name, sink->enabled ? "on" : "off",
+                          sink->level, shellLogGetLevelName(sink->level),
+                          sink->task_only ? " [drain task]" : "");
+            }
+            SHELL_LOG_USER_INFO("Log file: %s (last result %d)", path ? path : "closed", res);
+            SHELL_LOG_USER_INFO("Crash buffer: %lu / %d bytes, %lu reset(s)", 
+                      shellLogCrashUsed(), SHELL_LOG_CRASH_SIZE, shellLogCrashBoots());
+            USBD_LOG_StatsTypeDef usb;
+            USBD_LOG_GetStats(&usb);
+            SHELL_LOG_USER_INFO("USB stream: %s, %lu frames, %lu bytes, %lu transfers, %lu dropped", 
+                      usb.connected ? "configured" : "not configured",
+                      usb.frames, usb.bytes, usb.transfers, usb.dropped);
+            return 0;
+        }
+        ShellLogSink_t *sink = shellLogFindSink(argv[2]);
+        if (sink == NULL) {
+            SHELL_LOG_USER_ERROR("Unknown sink: %s", argv[2]);
+            return -1;
+        }
+        if (argc >= 5 && strcmp(argv[3], "level") == 0) {
+            int level = atoi(argv[4]);
+            if (level < 0 || level > 4) {
+                SHELL_LOG_USER_ERROR("Error: Invalid level %d. Valid range: 0-4", level);
+                return -1;
+            }
+            sink->level = (ShellLogLevel_t)level;
+            SHELL_LOG_USER_INFO("Sink %s level set to %d (%s)", 
+                      sink->name, level, shellLogGetLevelName((ShellLogLevel_t)level));
+        }
+        else if (argc >= 4 && strcmp(sink->name, "file") == 0) {
+            SHELL_LOG_USER_ERROR("Use 'logctl file <path|off>' for the file sink");
+            return -1;
+        }
+        else if (argc >= 4) {
+            sink->enabled = (strcmp(argv[3], "on") == 0) ? 1 : 0;
+            SHELL_LOG_USER_INFO("Sink %s %s", sink->name, sink->enabled ? "enabled" : "disabled");
+        }
+        else {
+            SHELL_LOG_USER_ERROR("Usage: logctl sink <name> <on|off|level <0-4>>");
+            return -1;
+        }
+    }
+    else if (strcmp(argv[1], "file") == 0) {
+        if (argc < 3) {
+            SHELL_LOG_USER_ERROR("Usage: logctl file <path|off>");
+            return -1;
+        }
+        if (strcmp(argv[2], "off") == 0) {
+            FRESULT res = shellLogFileClose();
+            if (res != FR_OK) {
+                SHELL_LOG_USER_ERROR("Log file close failed: %d", res);
+                return -1;
+            }
+            SHELL_LOG_USER_INFO("Log file closed");
+        } else {
+            FRESULT res = shellLogFileOpen(argv[2]);
+            if (res != FR_OK) {
+                SHELL_LOG_USER_ERROR("Cannot open log file %s: %d", argv[2], res);
+                return -1;
+            }
+            SHELL_LOG_USER_INFO("Logging to %s", argv[2]);
+        }
+    }
+    else if (strcmp(argv[1], "flush") == 0) {
+        shellLogFlush(1000);
+        FRESULT res = shellLogFileFlush();
+        if (res != FR_OK) {
+            SHELL_LOG_USER_ERROR("Log file flush failed: %d", res);
+            return -1;
+        }
+        SHELL_LOG_USER_INFO("Log file flushed");
+    }
+    else if (strcmp(argv[1], "crash") == 0) {
+        if (argc >= 3 && strcmp(argv[2], "clear") == 0) {
+            shellLogCrashClear();
+            SHELL_LOG_USER_INFO("Crash log buffer cleared");
+            return 0;
+        }
+        /* 直接写控制台，避免转储内容再次进入崩溃缓冲区 */
+        uint32_t used = shellLogCrashDump(logctlCrashWrite);
+        SHELL_LOG_USER_INFO("Crash log: %lu bytes, %lu reset(s)", used, shellLogCrashBoots());
+    }
+    else if (strcmp(argv[1], "stats") == 0) {
+        if (!SHELL_LOG_STATS) {
+            SHELL_LOG_USER_ERROR("Log statistics are disabled (SHELL_LOG_STATS)");
+            return -1;
+        }
+        if (argc >= 3 && strcmp(argv[2], "reset") == 0) {
+            shellLogResetStats();
+            SHELL_LOG_USER_INFO("Log statistics cleared");
+            return 0;
+        }
+        
+        /* 先取快照，避免本命令的输出计入正在打印的USER统计 */
+        static ShellLogStats_t snap[SHELL_LOG_MODULE_MAX][SHELL_LOG_LEVEL_NONE];
+        uint64_t elapsed_us = Timebase_GetUs() - shellLogStatsSince();
+        for (int m = 0; m < SHELL_LOG_MODULE_MAX; m++) {
+            for (int l = 0; l < SHELL_LOG_LEVEL_NONE; l++) {
+                shellLogGetStats((ShellLogModule_t)m, (ShellLogLevel_t)l, &snap[m][l]);
+            }
         }
+        
+        uint64_t total_us = 0;
+        SHELL_LOG_USER_INFO("=== Log Statistics (%lu.%03lu s) ===", 
+                  (unsigned long)(elapsed_us / 1000000U), 
+                  (unsigned long)(elapsed_us / 1000U % 1000U));
+        SHELL_LOG_USER_INFO("Module Level    Emitted Suppressed      Bytes    Kcycles       us  CPU");
+        for (int m = 0; m < SHELL_LOG_MODULE_MAX; m++) {
+            for (int l = 0; l < SHELL_LOG_LEVEL_NONE; l++) {
+                ShellLogStats_t *s = &snap[m][l];
+                if (s->emitted == 0 && s->suppressed == 0) {
+                    continue;
+                }
+                uint32_t us = Timebase_CyclesToUs(s->cycles);
+                uint32_t permille = elapsed_us ? (uint32_t)((uint64_t)us * 1000U / elapsed_us) : 0;
+                total_us += us;
+                SHELL_LOG_USER_INFO("%-6s %-7s %10lu %10lu %10lu %10lu %8lu %2lu.%lu%%", 
+                          shellLogGetModuleName((ShellLogModule_t)m),
+                          shellLogGetLevelName((ShellLogLevel_t)l),
+                          s->emitted, s->suppressed, s->bytes,
+                          (unsigned long)(s->cycles / 1000U), us,
+                          permille / 10U, permille % 10U);
+            }
+        }
+        uint32_t permille = elapsed_us ? (uint32_t)(total_us * 1000U / elapsed_us) : 0;
+        SHELL_LOG_USER_INFO("Total CPU: %lu us (%lu.%lu%%)", 
+                  (unsigned long)total_us, permille / 10U, permille % 10U);
     }
     else if (strcmp(argv[1], "level") == 0) {
         if (argc < 3) {
@@ -1114,6 +1847,11 @@ int cmd_logctl(int argc, char *argv[])
         SHELL_LOG_USER_INFO("Module %s log level set to %d (%s)", 
                   shellLogGetModuleName((ShellLogModule_t)module),
                   level, shellLogGetLevelName((ShellLogLevel_t)level));
+        if (level < SHELL_LOG_COMPILE_LEVEL_OF(module)) {
+            SHELL_LOG_USER_WARNING("Levels below %s are compiled out for module %s", 
+                      shellLogGetLevelName((ShellLogLevel_t)SHELL_LOG_COMPILE_LEVEL_OF(module)),
+                      shellLogGetModuleName((ShellLogModule_t)module));
+        }
     }
     else if (strcmp(argv[1], "color") == 0) {
         if (argc < 3) {
@@ -1133,6 +1871,15 @@ int cmd_logctl(int argc, char *argv[])
         shellLogSetTimestampEnabled(enable);
         SHELL_LOG_USER_INFO("Timestamp output %s", enable ? "enabled" : "disabled");
     }
+    else if (strcmp(argv[1], "dedup") == 0) {
+        if (argc < 3) {
+            SHELL_LOG_USER_ERROR("Usage: logctl dedup <on|off>");
+            return -1;
+        }
+        uint8_t enable = (strcmp(argv[2], "on") == 0) ? 1 : 0;
+        shellLogSetDedupEnabled(enable);
+        SHELL_LOG_USER_INFO("Repeated message collapsing %s", enable ? "enabled" : "disabled");
+    }
     else if (strcmp(argv[1], "test") == 0) {
         SHELL_LOG_USER_INFO("Testing all log levels for all modules:");
         for (int module = 0; module < SHELL_LOG_MODULE_MAX; module++) {
@@ -1215,6 +1962,16 @@ int cmd_usb_stats(int argc, char *argv[])
         return 0;
     }
     
+    if (shellJsonMode()) {
+        ShellJson_t json;
+        shellJsonBegin(&json, shell, "usb_stats");
+        shellJsonU64(&json, "reads", usb_read_count);
+        shellJsonU64(&json, "writes", usb_write_count);
+        shellJsonU64(&json, "single_reads", usb_single_sector_reads);
+        shellJsonEnd(&json);
+        return 0;
+    }
+    
     SHELL_LOG_USER_INFO("=== USB Storage Performance Statistics ===");
     SHELL_LOG_USER_INFO("Total reads: %lu", usb_read_count);
     SHELL_LOG_USER_INFO("Total writes: %lu", usb_write_count);
@@ -1239,4 +1996,102 @@ int cmd_usb_stats(int argc, char *argv[])
     return 0;
 }
 SHELL_EXPORT_CMD(SHELL_CMD_PERMISSION(0)|SHELL_CMD_TYPE(SHELL_TYPE_CMD_MAIN), 
-                 usb_stats, cmd_usb_stats, show USB storage performance statistics);
\ No newline at end of file
+                 usb_stats, cmd_usb_stats, show USB storage performance statistics);
+
+/* SD卡扇区缓存与预读缓存命令 */
+int cmd_sdcache(int argc, char *argv[])
+{
+    Shell *shell = shellGetCurrent();
+    if (!shell) return -1;
+    
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        USER_ResetStats();
+        SHELL_LOG_USER_INFO("SD statistics reset");
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "ra") == 0) {
+        if (argc < 3) {
+            SHELL_LOG_USER_ERROR("Usage: sdcache ra <sectors>  (0-%u, 0 disables)", USER_READ_AHEAD_MAX);
+            return -1;
+        }
+        uint32_t sectors = strtoul(argv[2], NULL, 0);
+        if (sectors > USER_READ_AHEAD_MAX) {
+            SHELL_LOG_USER_ERROR("Read-ahead limited to %u sectors", USER_READ_AHEAD_MAX);
+            return -1;
+        }
+        USER_SetReadAhead(sectors);
+        SHELL_LOG_USER_INFO("Read-ahead: %lu sectors (%lu KB)", sectors, sectors / 2);
+        return 0;
+    }
+    if (argc > 1 && (strcmp(argv[1], "on") == 0 || strcmp(argv[1], "off") == 0)) {
+        uint8_t enable = (strcmp(argv[1], "on") == 0);
+        if (USER_SetCache(enable) != 0) {
+            SHELL_LOG_USER_ERROR(enable ? "Sector cache needs the SD write-back task (access the card from a task first)"
+                                        : "Writing back dirty sectors failed, cache left enabled");
+            return -1;
+        }
+        SHELL_LOG_USER_INFO("Sector cache %s", enable ? "enabled" : "disabled, dirty sectors written");
+        return 0;
+    }
+    
+    USER_DiskioStats_t stats;
+    USER_GetStats(&stats);
+    uint32_t cached = stats.ra_hits + stats.ra_misses;
+    uint32_t hit_rate = cached ? (stats.ra_hits * 100U) / cached : 0;
+    uint32_t lookups = stats.cache.hits + stats.cache.misses;
+    uint32_t cache_rate = lookups ? (stats.cache.hits * 100U) / lookups : 0;
+    const char *store = (SD_CACHE_STORE == SD_CACHE_STORE_PSRAM) ? "PSRAM" : "AXI SRAM";
+    
+    if (shellJsonMode()) {
+        ShellJson_t json;
+        shellJsonBegin(&json, shell, "sdcache");
+        shellJsonU64(&json, "read_ahead", USER_GetReadAhead());
+        shellJsonU64(&json, "hits", stats.ra_hits);
+        shellJsonU64(&json, "misses", stats.ra_misses);
+        shellJsonU64(&json, "bypassed", stats.ra_bypassed);
+        shellJsonU64(&json, "invalidated", stats.ra_invalidated);
+        shellJsonU64(&json, "fetched_sectors", stats.ra_sectors);
+        shellJsonU64(&json, "reads", stats.reads);
+        shellJsonU64(&json, "read_sectors", stats.read_sectors);
+        shellJsonObject(&json, "sector_cache");
+        shellJsonBool(&json, "enabled", USER_GetCache());
+        shellJsonStr(&json, "store", store);
+        shellJsonU64(&json, "lines", SD_CACHE_LINES);
+        shellJsonU64(&json, "ways", SD_CACHE_WAYS);
+        shellJsonU64(&json, "valid", stats.cache.valid);
+        shellJsonU64(&json, "dirty", stats.cache.dirty);
+        shellJsonU64(&json, "hits", stats.cache.hits);
+        shellJsonU64(&json, "misses", stats.cache.misses);
+        shellJsonU64(&json, "bypassed", stats.cache.bypassed);
+        shellJsonU64(&json, "write_hits", stats.cache.write_hits);
+        shellJsonU64(&json, "write_allocs", stats.cache.write_allocs);
+        shellJsonU64(&json, "evictions", stats.cache.evictions);
+        shellJsonU64(&json, "writebacks", stats.cache.writebacks);
+        shellJsonClose(&json, '}');
+        shellJsonEnd(&json);
+        return 0;
+    }
+    
+    SHELL_LOG_USER_INFO("=== SD Sector Cache ===");
+    SHELL_LOG_USER_INFO("%s: %u lines x %u ways in %s (%u KB), %lu valid, %lu dirty",
+                        USER_GetCache() ? "Enabled" : "Disabled", SD_CACHE_LINES, SD_CACHE_WAYS,
+                        store, SD_CACHE_LINES / 2, stats.cache.valid, stats.cache.dirty);
+    SHELL_LOG_USER_INFO("Read hits: %lu, misses: %lu (%lu%% hit rate), bypassed: %lu",
+                        stats.cache.hits, stats.cache.misses, cache_rate, stats.cache.bypassed);
+    SHELL_LOG_USER_INFO("Write hits: %lu, allocations: %lu, write-backs: %lu, evictions: %lu",
+                        stats.cache.write_hits, stats.cache.write_allocs, stats.cache.writebacks,
+                        stats.cache.evictions);
+    
+    SHELL_LOG_USER_INFO("=== SD Read-Ahead Cache ===");
+    SHELL_LOG_USER_INFO("Read-ahead: %lu sectors (%lu KB)%s", USER_GetReadAhead(),
+                        USER_GetReadAhead() / 2, USER_GetReadAhead() ? "" : ", disabled");
+    SHELL_LOG_USER_INFO("Hits: %lu, misses: %lu (%lu%% hit rate)", stats.ra_hits, stats.ra_misses, hit_rate);
+    SHELL_LOG_USER_INFO("Bypassed: %lu, invalidated by writes: %lu", stats.ra_bypassed, stats.ra_invalidated);
+    SHELL_LOG_USER_INFO("Fetched: %lu sectors in %lu bursts for %lu reads (%lu sectors)",
+                        stats.ra_sectors, stats.ra_misses, stats.reads, stats.read_sectors);
+    SHELL_LOG_USER_INFO("Use 'sdcache on|off' for the sector cache, 'sdcache ra <sectors>' to resize read-ahead,");
+    SHELL_LOG_USER_INFO("'sdcache reset' to clear statistics");
+    return 0;
+}
+SHELL_EXPORT_CMD(SHELL_CMD_PERMISSION(0)|SHELL_CMD_TYPE(SHELL_TYPE_CMD_MAIN), 
+                 sdcache, cmd_sdcache, SD sector cache and read-ahead statistics and control);
\ No newline at end of file
@@ -311,8 +311,11 @@ static size_t shellExtParseNumber(char *string)
     }
     if (type == NUM_TYPE_FLOAT && devide != 0)
     {
+        size_t bits = 0;
         valueFloat = (float)valueInt / devide * sign;
-        return *(size_t *)(&valueFloat);
+        /* 按位返回float，64位主机上size_t比float宽，只拷贝float的4字节 */
+        memcpy(&bits, &valueFloat, sizeof(valueFloat));
+        return bits;
     }
     else
     {
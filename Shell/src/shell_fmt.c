@@ -0,0 +1,473 @@
+/**
+ * @file shell_fmt.c
+ * @author Letter (NevermindZZT@gmail.com)
+ * @brief Small reentrant printf engine for the shell and log output paths
+ * @version 1.0.0
+ * @date 2025-01-16
+ *
+ * @copyright (c) 2025 Letter
+ *
+ */
+
+#include "shell_fmt.h"
+#include <stdint.h>
+#include <string.h>
+
+#define FMT_LEFT        0x01U   /* '-' */
+#define FMT_PLUS        0x02U   /* '+' */
+#define FMT_SPACE       0x04U   /* ' ' */
+#define FMT_ALT         0x08U   /* '#' */
+#define FMT_ZERO        0x10U   /* '0' */
+#define FMT_UPPER       0x20U   /* X, F */
+
+/* 整数最长为64位八进制22位，浮点整数部分最长20位加小数 */
+#define FMT_NUM_MAX     32
+
+typedef struct {
+    char *buffer;
+    size_t size;
+    size_t pos;             /* Untruncated length */
+} ShellFmtOut_t;
+
+typedef struct {
+    unsigned int flags;
+    int width;
+    int prec;               /* -1 if not given */
+} ShellFmtSpec_t;
+
+static const uint32_t fmt_pow10[SHELL_FMT_FLOAT_PREC_MAX + 1] = {
+    1U, 10U, 100U, 1000U, 10000U, 100000U, 1000000U, 10000000U, 100000000U, 1000000000U,
+};
+
+/**
+ * @brief Append characters, counting what does not fit
+ * @param out Output state
+ * @param data Characters
+ * @param len Number of characters
+ */
+static void shellFmtPut(ShellFmtOut_t *out, const char *data, size_t len)
+{
+    if (out->pos + 1U < out->size) {
+        size_t room = out->size - 1U - out->pos;
+        memcpy(out->buffer + out->pos, data, (len < room) ? len : room);
+    }
+    out->pos += len;
+}
+
+/**
+ * @brief Append a character repeated
+ * @param out Output state
+ * @param c Character
+ * @param count Repeat count (nothing if <= 0)
+ */
+static void shellFmtFill(ShellFmtOut_t *out, char c, int count)
+{
+    for (; count > 0; count--) {
+        if (out->pos + 1U < out->size) {
+            out->buffer[out->pos] = c;
+        }
+        out->pos++;
+    }
+}
+
+/**
+ * @brief Write a converted field with sign/prefix, zero padding and width
+ * @param out Output state
+ * @param spec Conversion spec
+ * @param prefix Sign and radix prefix ("", "-", "0x", ...)
+ * @param body Digits or text
+ * @param len Body length
+ * @param zeros Leading zeros required by the precision
+ */
+static void shellFmtField(ShellFmtOut_t *out, const ShellFmtSpec_t *spec, const char *prefix,
+                          const char *body, int len, int zeros)
+{
+    int prefix_len = (int)strlen(prefix);
+    int pad = spec->width - prefix_len - zeros - len;
+
+    if (!(spec->flags & FMT_LEFT) && !(spec->flags & FMT_ZERO)) {
+        shellFmtFill(out, ' ', pad);
+    }
+    shellFmtPut(out, prefix, (size_t)prefix_len);
+    if (!(spec->flags & FMT_LEFT) && (spec->flags & FMT_ZERO)) {
+        shellFmtFill(out, '0', pad);
+    }
+    shellFmtFill(out, '0', zeros);
+    shellFmtPut(out, body, (size_t)len);
+    if (spec->flags & FMT_LEFT) {
+        shellFmtFill(out, ' ', pad);
+    }
+}
+
+/**
+ * @brief Convert an unsigned value to digits, right aligned in tmp
+ * @param end One past the end of the digit buffer
+ * @param value Value
+ * @param base 8, 10 or 16
+ * @param upper Uppercase hex digits
+ * @return First digit
+ */
+static char *shellFmtDigits(char *end, uint64_t value, unsigned int base, int upper)
+{
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char *p = end;
+
+    /* 32位范围内避免调用64位除法库函数 */
+    while (value > 0xFFFFFFFFU) {
+        *--p = digits[value % base];
+        value /= base;
+    }
+    uint32_t v = (uint32_t)value;
+    do {
+        *--p = digits[v % base];
+        v /= base;
+    } while (v != 0);
+    return p;
+}
+
+/**
+ * @brief Format an integer conversion
+ * @param out Output state
+ * @param spec Conversion spec
+ * @param value Magnitude
+ * @param negative Value is negative (signed conversions only)
+ * @param conv Conversion character
+ */
+static void shellFmtInteger(ShellFmtOut_t *out, ShellFmtSpec_t *spec, uint64_t value,
+                            int negative, char conv)
+{
+    char tmp[FMT_NUM_MAX];
+    char *end = tmp + sizeof(tmp);
+    const char *prefix = "";
+    unsigned int base = (conv == 'o') ? 8U : (conv == 'x' || conv == 'X' || conv == 'p') ? 16U : 10U;
+    char *p;
+    int len;
+
+    if (conv == 'd' || conv == 'i') {
+        prefix = negative ? "-" : (spec->flags & FMT_PLUS) ? "+" : (spec->flags & FMT_SPACE) ? " " : "";
+    }
+
+    if (spec->prec >= 0) {
+        spec->flags &= ~FMT_ZERO;   /* 指定精度时忽略0标志 */
+    }
+    if (spec->prec == 0 && value == 0) {
+        p = end;                    /* "%.0d" of 0 prints nothing */
+    } else {
+        p = shellFmtDigits(end, value, base, conv == 'X');
+    }
+    len = (int)(end - p);
+
+    if (conv == 'p' || ((spec->flags & FMT_ALT) && value != 0 && base == 16U)) {
+        prefix = (conv == 'X') ? "0X" : "0x";
+    }
+    int zeros = (spec->prec > len) ? spec->prec - len : 0;
+    if ((spec->flags & FMT_ALT) && base == 8U && zeros == 0 && (len == 0 || *p != '0')) {
+        zeros = 1;
+    }
+    shellFmtField(out, spec, prefix, p, len, zeros);
+}
+
+/**
+ * @brief Format a fixed-point %f conversion without the libc float printf
+ *        Rounds half to even like glibc; exact for precisions up to
+ *        SHELL_FMT_FLOAT_PREC_MAX and magnitudes below 2^64
+ * @param out Output state
+ * @param spec Conversion spec
+ * @param value Value
+ */
+static void shellFmtFloat(ShellFmtOut_t *out, ShellFmtSpec_t *spec, double value)
+{
+    char tmp[FMT_NUM_MAX];
+    char *end = tmp + sizeof(tmp);
+    char *p = end;
+    int negative = (value < 0.0) || (value == 0.0 && 1.0 / value < 0.0);
+    const char *prefix = negative ? "-" : (spec->flags & FMT_PLUS) ? "+"
+                       : (spec->flags & FMT_SPACE) ? " " : "";
+    int prec = (spec->prec < 0) ? 6 : spec->prec;
+    int extra = 0;
+    int shift = 0;
+
+    if (negative) {
+        value = -value;
+    }
+    if (value != value || value > 1.7976931348623157e308) {
+        int upper = (spec->flags & FMT_UPPER) != 0;
+        spec->flags &= ~FMT_ZERO;
+        shellFmtField(out, spec, prefix, (value != value) ? (upper ? "NAN" : "nan")
+                                                          : (upper ? "INF" : "inf"), 3, 0);
+        return;
+    }
+    if (prec > SHELL_FMT_FLOAT_PREC_MAX) {
+        extra = prec - SHELL_FMT_FLOAT_PREC_MAX;
+        prec = SHELL_FMT_FLOAT_PREC_MAX;
+    }
+    /* 超出64位的整数部分只保留有效数字，其余补0 */
+    while (value >= 18446744073709551616.0) {
+        value /= 10.0;
+        shift++;
+    }
+
+    uint64_t ipart = (uint64_t)value;
+    double frac = value - (double)ipart;
+    double scaled = frac * (double)fmt_pow10[prec];
+    uint32_t fpart = (uint32_t)scaled;
+    double rest = scaled - (double)fpart;
+    if (rest == 0.5) {
+        /* 乘法舍入可能制造出0.5，用fma求出精确余量再判断，真正的0.5才按偶数舍入 */
+        double error = __builtin_fma(frac, (double)fmt_pow10[prec], -scaled);
+        rest += (error > 0.0) ? 0.25 : (error < 0.0) ? -0.25 : 0.0;
+    }
+    if (rest > 0.5 || (rest == 0.5 && (prec ? (fpart & 1U) : (uint32_t)(ipart & 1U)))) {
+        if (prec == 0) {
+            ipart++;
+        } else if (++fpart >= fmt_pow10[prec]) {
+            fpart = 0;
+            ipart++;
+        }
+    }
+
+    /* 从右向左：小数部分、小数点、整数部分 */
+    for (int i = 0; i < prec; i++) {
+        *--p = (char)('0' + fpart % 10U);
+        fpart /= 10U;
+    }
+    if (prec > 0 || extra > 0 || (spec->flags & FMT_ALT)) {
+        *--p = '.';
+    }
+    int frac_len = (int)(end - p);
+    char *digits = shellFmtDigits(p, ipart, 10U, 0);
+    int int_len = (int)(p - digits);
+
+    /* 整数部分的补零和超出精度上限的补零单独输出 */
+    int pad = spec->width - (int)strlen(prefix) - int_len - shift - frac_len - extra;
+    if (!(spec->flags & FMT_LEFT) && !(spec->flags & FMT_ZERO)) {
+        shellFmtFill(out, ' ', pad);
+    }
+    shellFmtPut(out, prefix, strlen(prefix));
+    if (!(spec->flags & FMT_LEFT) && (spec->flags & FMT_ZERO)) {
+        shellFmtFill(out, '0', pad);
+    }
+    shellFmtPut(out, digits, (size_t)int_len);
+    shellFmtFill(out, '0', shift);
+    shellFmtPut(out, p, (size_t)frac_len);
+    shellFmtFill(out, '0', extra);
+    if (spec->flags & FMT_LEFT) {
+        shellFmtFill(out, ' ', pad);
+    }
+}
+
+/**
+ * @brief Format into a buffer (C99 vsnprintf semantics)
+ * @param buffer Output buffer (may be NULL if size is 0)
+ * @param size Buffer size
+ * @param format Format string
+ * @param args Arguments
+ * @return Untruncated output length
+ */
+int shellFmtVsnprintf(char *buffer, size_t size, const char *format, va_list args)
+{
+    ShellFmtOut_t out = { buffer, size, 0 };
+    const char *f = format;
+
+    while (*f) {
+        /* 普通字符整段拷贝 */
+        const char *start = f;
+        while (*f && *f != '%') {
+            f++;
+        }
+        if (f != start) {
+            shellFmtPut(&out, start, (size_t)(f - start));
+        }
+        if (*f == '\0') {
+            break;
+        }
+
+        const char *conv_start = f++;
+        ShellFmtSpec_t spec = { 0, 0, -1 };
+
+        for (;; f++) {
+            if (*f == '-') spec.flags |= FMT_LEFT;
+            else if (*f == '+') spec.flags |= FMT_PLUS;
+            else if (*f == ' ') spec.flags |= FMT_SPACE;
+            else if (*f == '#') spec.flags |= FMT_ALT;
+            else if (*f == '0') spec.flags |= FMT_ZERO;
+            else break;
+        }
+        if (*f == '*') {
+            spec.width = va_arg(args, int);
+            if (spec.width < 0) {
+                spec.flags |= FMT_LEFT;
+                spec.width = -spec.width;
+            }
+            f++;
+        } else {
+            while (*f >= '0' && *f <= '9') {
+                spec.width = spec.width * 10 + (*f++ - '0');
+            }
+        }
+        if (*f == '.') {
+            f++;
+            spec.prec = 0;
+            if (*f == '*') {
+                spec.prec = va_arg(args, int);
+                if (spec.prec < 0) {
+                    spec.prec = -1;
+                }
+                f++;
+            } else {
+                while (*f >= '0' && *f <= '9') {
+                    spec.prec = spec.prec * 10 + (*f++ - '0');
+                }
+            }
+        }
+        if (spec.flags & FMT_LEFT) {
+            spec.flags &= ~FMT_ZERO;
+        }
+
+        /* 长度修饰：0=int, 1=long, 2=long long, 3=size_t/ptrdiff_t, 4=intmax_t, 5=long double,
+           -1=short, -2=char */
+        int length = 0;
+        switch (*f) {
+        case 'h':
+            length = (f[1] == 'h') ? -2 : -1;
+            f += (f[1] == 'h') ? 2 : 1;
+            break;
+        case 'l':
+            length = (f[1] == 'l') ? 2 : 1;
+            f += (f[1] == 'l') ? 2 : 1;
+            break;
+        case 'z':
+        case 't':
+            length = 3;
+            f++;
+            break;
+        case 'j':
+            length = 4;
+            f++;
+            break;
+        case 'L':
+            length = 5;
+            f++;
+            break;
+        default:
+            break;
+        }
+
+        char conv = *f;
+        if (conv == '\0') {
+            /* 格式串末尾不完整的转换说明（单独的%）不输出，和glibc一样在此结束 */
+            break;
+        }
+        f++;
+
+        switch (conv) {
+        case 'd':
+        case 'i': {
+            int64_t v;
+            switch (length) {
+            case -2: v = (signed char)va_arg(args, int); break;
+            case -1: v = (short)va_arg(args, int); break;
+            case 1: v = va_arg(args, long); break;
+            case 2: v = va_arg(args, long long); break;
+            case 3: v = (int64_t)va_arg(args, ptrdiff_t); break;
+            case 4: v = (int64_t)va_arg(args, intmax_t); break;
+            default: v = va_arg(args, int); break;
+            }
+            uint64_t mag = (v < 0) ? (uint64_t)0 - (uint64_t)v : (uint64_t)v;
+            shellFmtInteger(&out, &spec, mag, v < 0, conv);
+            break;
+        }
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X': {
+            uint64_t v;
+            switch (length) {
+            case -2: v = (unsigned char)va_arg(args, unsigned int); break;
+            case -1: v = (unsigned short)va_arg(args, unsigned int); break;
+            case 1: v = va_arg(args, unsigned long); break;
+            case 2: v = va_arg(args, unsigned long long); break;
+            case 3: v = va_arg(args, size_t); break;
+            case 4: v = (uint64_t)va_arg(args, uintmax_t); break;
+            default: v = va_arg(args, unsigned int); break;
+            }
+            shellFmtInteger(&out, &spec, v, 0, conv);
+            break;
+        }
+        case 'p':
+            shellFmtInteger(&out, &spec, (uintptr_t)va_arg(args, void *), 0, 'p');
+            break;
+        case 'c': {
+            char c = (char)va_arg(args, int);
+            spec.flags &= ~FMT_ZERO;
+            shellFmtField(&out, &spec, "", &c, 1, 0);
+            break;
+        }
+        case 's': {
+            const char *s = va_arg(args, const char *);
+            if (s == NULL) {
+                s = "(null)";
+            }
+            size_t len = 0;
+            while (s[len] && (spec.prec < 0 || len < (size_t)spec.prec)) {
+                len++;
+            }
+            spec.flags &= ~FMT_ZERO;
+            shellFmtField(&out, &spec, "", s, (int)len, 0);
+            break;
+        }
+        case 'F':
+            spec.flags |= FMT_UPPER;
+            /* fall through */
+        case 'f':
+            shellFmtFloat(&out, &spec, (length == 5) ? (double)va_arg(args, long double)
+                                                     : va_arg(args, double));
+            break;
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            /* 不支持的浮点格式原样输出，保持参数对齐 */
+            if (length == 5) {
+                (void)va_arg(args, long double);
+            } else {
+                (void)va_arg(args, double);
+            }
+            shellFmtPut(&out, conv_start, (size_t)(f - conv_start));
+            break;
+        case 'n':
+            (void)va_arg(args, void *);
+            break;
+        case '%':
+            shellFmtPut(&out, "%", 1);
+            break;
+        default:
+            shellFmtPut(&out, conv_start, (size_t)(f - conv_start));
+            break;
+        }
+    }
+
+    if (size > 0) {
+        buffer[(out.pos < size) ? out.pos : size - 1U] = '\0';
+    }
+    return (int)out.pos;
+}
+
+/**
+ * @brief Format into a buffer (C99 snprintf semantics)
+ * @param buffer Output buffer
+ * @param size Buffer size
+ * @param format Format string
+ * @param ... Arguments
+ * @return Untruncated output length
+ */
+int shellFmtSnprintf(char *buffer, size_t size, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int len = shellFmtVsnprintf(buffer, size, format, args);
+    va_end(args);
+    return len;
+}
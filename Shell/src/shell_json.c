@@ -0,0 +1,260 @@
+/**
+ * @file shell_json.c
+ * @author Letter (NevermindZZT@gmail.com)
+ * @brief Compact JSON records for machine-readable command output
+ * @version 1.0.0
+ * @date 2025-01-16
+ *
+ * @copyright (c) 2025 Letter
+ *
+ */
+
+#include "shell_json.h"
+#include "shell_log.h"
+#include "FreeRTOS.h"
+#include <string.h>
+
+#if SHELL_JSON_RECORD_MAX > SHELL_LOG_RAW_RECORD_MAX
+#error "SHELL_JSON_RECORD_MAX must not exceed SHELL_LOG_RAW_RECORD_MAX"
+#endif
+
+static uint8_t json_mode;
+
+/**
+ * @brief Select the output format of the diagnostic commands
+ * @param enable 1 for JSON records, 0 for text
+ */
+void shellJsonSetMode(uint8_t enable)
+{
+    json_mode = enable ? 1 : 0;
+}
+
+/**
+ * @brief Get the output format of the diagnostic commands
+ * @return 1 for JSON records, 0 for text
+ */
+uint8_t shellJsonMode(void)
+{
+    return json_mode;
+}
+
+/**
+ * @brief Write the buffered bytes to the shell
+ * @param json Writer
+ */
+static void shellJsonFlush(ShellJson_t *json)
+{
+    if (json->len > 0) {
+        json->shell->write(json->buf, json->len);
+        json->len = 0;
+    }
+}
+
+/**
+ * @brief Append one character
+ * @param json Writer
+ * @param c Character
+ */
+static void shellJsonPut(ShellJson_t *json, char c)
+{
+    if (json->len == json->size) {
+        shellJsonFlush(json);
+    }
+    json->buf[json->len++] = c;
+}
+
+/**
+ * @brief Append a string without escaping
+ * @param json Writer
+ * @param str String
+ */
+static void shellJsonPuts(ShellJson_t *json, const char *str)
+{
+    while (*str) {
+        shellJsonPut(json, *str++);
+    }
+}
+
+/**
+ * @brief Append a quoted, escaped string
+ * @param json Writer
+ * @param str String
+ */
+static void shellJsonQuote(ShellJson_t *json, const char *str)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    shellJsonPut(json, '"');
+    for (; *str; str++) {
+        unsigned char c = (unsigned char)*str;
+        if (c == '"' || c == '\\') {
+            shellJsonPut(json, '\\');
+            shellJsonPut(json, (char)c);
+        } else if (c < 0x20) {
+            shellJsonPuts(json, "\\u00");
+            shellJsonPut(json, hex[c >> 4]);
+            shellJsonPut(json, hex[c & 0x0F]);
+        } else {
+            shellJsonPut(json, (char)c);
+        }
+    }
+    shellJsonPut(json, '"');
+}
+
+/**
+ * @brief Start a member: separator and "key":
+ * @param json Writer
+ * @param key Member name, NULL inside an array
+ */
+static void shellJsonKey(ShellJson_t *json, const char *key)
+{
+    if (json->comma) {
+        shellJsonPut(json, ',');
+    }
+    if (key) {
+        shellJsonQuote(json, key);
+        shellJsonPut(json, ':');
+    }
+    json->comma = 1;
+}
+
+/**
+ * @brief Start a record: {"cmd":"<cmd>"
+ * @param json Writer
+ * @param shell Output shell
+ * @param cmd Command name
+ */
+void shellJsonBegin(ShellJson_t *json, Shell *shell, const char *cmd)
+{
+    json->shell = shell;
+    json->buf = pvPortMalloc(SHELL_JSON_RECORD_MAX);
+    json->size = SHELL_JSON_RECORD_MAX;
+    if (json->buf == NULL) {
+        /* 堆不足时退回分块输出 */
+        json->buf = json->chunk;
+        json->size = sizeof(json->chunk);
+    }
+    json->len = 0;
+    json->comma = 0;
+    shellJsonPut(json, '{');
+    shellJsonStr(json, "cmd", cmd);
+}
+
+/**
+ * @brief Finish the record with "}\r\n" and write it out
+ * @param json Writer
+ */
+void shellJsonEnd(ShellJson_t *json)
+{
+    shellJsonPuts(json, "}\r\n");
+    shellJsonFlush(json);
+    if (json->buf != json->chunk) {
+        vPortFree(json->buf);
+    }
+    json->buf = json->chunk;
+    json->size = sizeof(json->chunk);
+}
+
+/**
+ * @brief Add an unsigned number
+ * @param json Writer
+ * @param key Member name, NULL inside an array
+ * @param value Value
+ */
+void shellJsonU64(ShellJson_t *json, const char *key, uint64_t value)
+{
+    char tmp[20];
+    int n = 0;
+
+    shellJsonKey(json, key);
+    /* 64位除法只在值超过32位时使用 */
+    while (value > 0xFFFFFFFFULL) {
+        tmp[n++] = (char)('0' + value % 10U);
+        value /= 10U;
+    }
+    uint32_t low = (uint32_t)value;
+    do {
+        tmp[n++] = (char)('0' + low % 10U);
+        low /= 10U;
+    } while (low != 0);
+    while (n > 0) {
+        shellJsonPut(json, tmp[--n]);
+    }
+}
+
+/**
+ * @brief Add a signed number
+ * @param json Writer
+ * @param key Member name, NULL inside an array
+ * @param value Value
+ */
+void shellJsonInt(ShellJson_t *json, const char *key, int32_t value)
+{
+    if (value < 0) {
+        shellJsonKey(json, key);
+        shellJsonPut(json, '-');
+        json->comma = 0;
+        shellJsonU64(json, NULL, (uint64_t)(-(int64_t)value));
+    } else {
+        shellJsonU64(json, key, (uint64_t)value);
+    }
+}
+
+/**
+ * @brief Add a string
+ * @param json Writer
+ * @param key Member name, NULL inside an array
+ * @param value String
+ */
+void shellJsonStr(ShellJson_t *json, const char *key, const char *value)
+{
+    shellJsonKey(json, key);
+    shellJsonQuote(json, value ? value : "");
+}
+
+/**
+ * @brief Add true or false
+ * @param json Writer
+ * @param key Member name, NULL inside an array
+ * @param value Value
+ */
+void shellJsonBool(ShellJson_t *json, const char *key, uint8_t value)
+{
+    shellJsonKey(json, key);
+    shellJsonPuts(json, value ? "true" : "false");
+}
+
+/**
+ * @brief Open a nested object
+ * @param json Writer
+ * @param key Member name, NULL inside an array
+ */
+void shellJsonObject(ShellJson_t *json, const char *key)
+{
+    shellJsonKey(json, key);
+    shellJsonPut(json, '{');
+    json->comma = 0;
+}
+
+/**
+ * @brief Open a nested array
+ * @param json Writer
+ * @param key Member name, NULL inside an array
+ */
+void shellJsonArray(ShellJson_t *json, const char *key)
+{
+    shellJsonKey(json, key);
+    shellJsonPut(json, '[');
+    json->comma = 0;
+}
+
+/**
+ * @brief Close the innermost object or array
+ * @param json Writer
+ * @param close '}' or ']'
+ */
+void shellJsonClose(ShellJson_t *json, char close)
+{
+    shellJsonPut(json, close);
+    json->comma = 1;
+}
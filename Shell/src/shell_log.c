@@ -10,10 +10,16 @@
  */
 
 #include "shell_log.h"
+#include "shell_fmt.h"
+#include "shell_port.h"
 #include "main.h"
+#include "dwt_timebase.h"
+#include "FreeRTOS.h"
+#include "task.h"
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
+#include <stddef.h>
 
 /* Global log configuration */
 ShellLogConfig_t g_shell_log_config = {
@@ -28,7 +34,8 @@ ShellLogConfig_t g_shell_log_config = {
         [SHELL_LOG_MODULE_USER] = SHELL_LOG_LEVEL_DEBUG,
     },
     .color_enabled = 1,
-    .timestamp_enabled = 1
+    .timestamp_enabled = 1,
+    .dedup_enabled = 1
 };
 
 /* Module name strings */
@@ -58,12 +65,145 @@ static const char* level_colors[SHELL_LOG_LEVEL_NONE] = {
     [SHELL_LOG_LEVEL_ERROR] = SHELL_LOG_COLOR_ERROR,
 };
 
+/*
+ * Precomputed "[LEVEL:MODULE] " prefixes (with color codes when enabled),
+ * copied into each line instead of going through the formatter. Rebuilt into the
+ * spare table on a color change, then published with a single pointer store
+ * so concurrent loggers always see a complete table.
+ */
+#define LOG_PREFIX_MAX          32
+
+typedef struct {
+    uint8_t len;
+    char text[LOG_PREFIX_MAX - 1];
+} ShellLogPrefix_t;
+
+typedef ShellLogPrefix_t ShellLogPrefixTable_t[SHELL_LOG_LEVEL_NONE][SHELL_LOG_MODULE_MAX];
+
+static ShellLogPrefixTable_t log_prefix_tables[2];
+static ShellLogPrefixTable_t *volatile log_prefix = NULL;
+
+/* Registered output sinks */
+static ShellLogSink_t *log_sinks[SHELL_LOG_SINK_MAX];
+static uint8_t log_sink_count = 0;
+
+/* Output capture (run -o): output of one task goes to a callback instead of the sinks.
+   Read by every logging context, so the pair is only changed inside a critical section */
+static TaskHandle_t volatile log_capture_task = NULL;
+static ShellLogCapture_t volatile log_capture = NULL;
+
+/* Dispatch flags */
+#define LOG_DISPATCH_DRAIN      0x01U   /* Called from the drain task (task-only sinks allowed) */
+#define LOG_DISPATCH_TEXT_ONLY  0x02U   /* Binary sinks already got this message */
+
+#if SHELL_LOG_STATS
+static ShellLogStats_t log_stats[SHELL_LOG_MODULE_MAX][SHELL_LOG_LEVEL_NONE];
+static uint64_t log_stats_since;
+#endif
+
+#if SHELL_LOG_ASYNC
+
+#if (SHELL_LOG_RING_SIZE & (SHELL_LOG_RING_SIZE - 1)) != 0
+#error "SHELL_LOG_RING_SIZE must be a power of two"
+#endif
+
+/* 记录加上环尾的填充不超过整个环，空环时总能放下 */
+#if SHELL_LOG_RAW_RECORD_MAX > SHELL_LOG_RING_SIZE / 2
+#error "SHELL_LOG_RAW_RECORD_MAX must not exceed half of SHELL_LOG_RING_SIZE"
+#endif
+
+/*
+ * Ring record layout: one 32-bit header word followed by the payload,
+ * padded to 4 bytes. The header is written last (release) and is the
+ * commit flag: a zero header means "reserved but not yet written".
+ *
+ *   bits  0..15  payload length
+ *   bits 16..20  timestamp length of a LOG line (skipped by dedup)
+ *   bits 21..23  level of a LOG line (sink filter)
+ *   bits 24..27  record type
+ *   bits 28..31  module of a LOG line (statistics)
+ */
+#define LOG_REC_EMPTY       0U
+#define LOG_REC_PAD         1U
+#define LOG_REC_RAW         2U
+#define LOG_REC_LOG         3U
+#define LOG_REC_DEFER       4U
+
+#define LOG_REC_HDR(len, aux, type) \
+    ((uint32_t)(len) | ((uint32_t)(aux) << 16) | ((uint32_t)(type) << 24))
+#define LOG_REC_LEN(hdr)        ((hdr) & 0xFFFFU)
+#define LOG_REC_AUX(hdr)        (((hdr) >> 16) & 0xFFU)
+#define LOG_LINE_AUX(stamp, lvl) ((uint8_t)(((stamp) & 0x1FU) | ((uint32_t)(lvl) << 5)))
+#define LOG_LINE_STAMP(aux)     ((aux) & 0x1FU)
+#define LOG_LINE_LEVEL(aux)     ((ShellLogLevel_t)((aux) >> 5))
+#define LOG_REC_TYPE(hdr)       (((hdr) >> 24) & 0x0FU)
+#define LOG_REC_MODULE(hdr)     ((ShellLogModule_t)((hdr) >> 28))
+#define LOG_REC_TYPE_MOD(type, module) ((uint32_t)(type) | ((uint32_t)(module) << 4))
+#define LOG_REC_SIZE(len)       ((sizeof(uint32_t) + (len) + 3U) & ~3U)
+#define LOG_RING_MASK           (SHELL_LOG_RING_SIZE - 1U)
+
+typedef struct {
+    uint32_t data[SHELL_LOG_RING_SIZE / sizeof(uint32_t)];
+    volatile uint32_t head;         /* 生产者预留位置（自由递增） */
+    volatile uint32_t tail;         /* 消费者读取位置（自由递增） */
+    volatile uint32_t high_water;
+    volatile uint32_t dropped;
+    volatile uint32_t dropped_bytes;
+    uint32_t dropped_reported;
+} ShellLogRing_t;
+
+static ShellLogRing_t log_ring;
+static TaskHandle_t log_drain_task = NULL;
+static TaskHandle_t log_console_task = NULL;
+static char log_drain_line[SHELL_LOG_LINE_MAX];
+
+/* 重复消息折叠状态（仅drain任务访问） */
+static struct {
+    uint8_t valid;
+    uint8_t flags;
+    ShellLogLevel_t level;
+    uint32_t hash;
+    uint32_t len;
+    uint32_t repeats;
+    TickType_t since;               /* 本轮第一次重复的时间 */
+} log_dedup;
+
+#endif /* SHELL_LOG_ASYNC */
+
+/**
+ * @brief Build the level/module prefix table for the current color setting
+ */
+static void shellLogBuildPrefixes(void)
+{
+    ShellLogPrefixTable_t *table = (log_prefix == &log_prefix_tables[0])
+                                   ? &log_prefix_tables[1] : &log_prefix_tables[0];
+
+    for (int level = 0; level < SHELL_LOG_LEVEL_NONE; level++) {
+        for (int module = 0; module < SHELL_LOG_MODULE_MAX; module++) {
+            ShellLogPrefix_t *prefix = &(*table)[level][module];
+            int n;
+            if (g_shell_log_config.color_enabled) {
+                n = shellFmtSnprintf(prefix->text, sizeof(prefix->text), "%s[%s:%s]%s ",
+                             level_colors[level], level_names[level], module_names[module],
+                             SHELL_COLOR_RESET);
+            } else {
+                n = shellFmtSnprintf(prefix->text, sizeof(prefix->text), "[%s:%s] ",
+                             level_names[level], module_names[module]);
+            }
+            prefix->len = (n < (int)sizeof(prefix->text)) ? (uint8_t)n
+                                                          : (uint8_t)(sizeof(prefix->text) - 1);
+        }
+    }
+    __DMB();
+    log_prefix = table;
+}
+
 /**
  * @brief Initialize shell logging system
  */
 void shellLogInit(void)
 {
-    /* Already initialized with default values */
+    shellLogBuildPrefixes();
 }
 
 /**
@@ -96,6 +236,7 @@ void shellLogSetModuleLevel(ShellLogModule_t module, ShellLogLevel_t level)
 void shellLogSetColorEnabled(uint8_t enable)
 {
     g_shell_log_config.color_enabled = enable ? 1 : 0;
+    shellLogBuildPrefixes();
 }
 
 /**
@@ -107,6 +248,15 @@ void shellLogSetTimestampEnabled(uint8_t enable)
     g_shell_log_config.timestamp_enabled = enable ? 1 : 0;
 }
 
+/**
+ * @brief Enable/disable collapsing of repeated messages
+ * @param enable 1 to enable, 0 to disable
+ */
+void shellLogSetDedupEnabled(uint8_t enable)
+{
+    g_shell_log_config.dedup_enabled = enable ? 1 : 0;
+}
+
 /**
  * @brief Get module name string
  * @param module Module ID
@@ -146,6 +296,342 @@ const char* shellLogGetLevelColor(ShellLogLevel_t level)
     return SHELL_COLOR_RESET;
 }
 
+/**
+ * @brief Register an output sink
+ * @param sink Sink descriptor (must stay valid)
+ * @return 0 on success, -1 if the table is full
+ */
+int shellLogAddSink(ShellLogSink_t *sink)
+{
+    if (sink == NULL || log_sink_count >= SHELL_LOG_SINK_MAX) {
+        return -1;
+    }
+    log_sinks[log_sink_count] = sink;
+    log_sink_count++;
+    return 0;
+}
+
+/**
+ * @brief Get a registered sink by index
+ * @param index Sink index
+ * @return Sink or NULL
+ */
+ShellLogSink_t* shellLogGetSink(uint8_t index)
+{
+    return (index < log_sink_count) ? log_sinks[index] : NULL;
+}
+
+/**
+ * @brief Find a registered sink by name
+ * @param name Sink name
+ * @return Sink or NULL
+ */
+ShellLogSink_t* shellLogFindSink(const char *name)
+{
+    for (uint8_t i = 0; i < log_sink_count; i++) {
+        if (strcmp(log_sinks[i]->name, name) == 0) {
+            return log_sinks[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Check whether a sink takes a message of this level in this context
+ * @param sink Sink
+ * @param level Message level
+ * @param flags LOG_DISPATCH_* flags
+ * @return 1 if the sink accepts the message
+ */
+static inline int shellLogSinkAccepts(const ShellLogSink_t *sink, ShellLogLevel_t level,
+                                      uint8_t flags)
+{
+    return sink->enabled && level >= sink->level && !sink->at_produce &&
+           (!sink->task_only || (flags & LOG_DISPATCH_DRAIN));
+}
+
+/**
+ * @brief Write one log line to the at_produce sinks (logging context)
+ * @param line Complete line
+ * @param len Line length
+ * @param level Line level
+ */
+static void shellLogDispatchProduce(const char *line, uint16_t len, ShellLogLevel_t level)
+{
+    for (uint8_t i = 0; i < log_sink_count; i++) {
+        ShellLogSink_t *sink = log_sinks[i];
+        if (sink->at_produce && sink->enabled && level >= sink->level) {
+            sink->write(line, len);
+        }
+    }
+}
+
+/**
+ * @brief Send one binary frame to every binary sink that accepts its level
+ * @param type SHELL_LOG_BIN_* frame type
+ * @param module Module ID (0xFF if unknown)
+ * @param level Message level
+ * @param time_us Timestamp (0 if it is part of a text payload)
+ * @param payload Payload
+ * @param len Payload length
+ * @param flags LOG_DISPATCH_* flags
+ */
+static void shellLogDispatchBin(uint8_t type, uint8_t module, ShellLogLevel_t level,
+                                uint64_t time_us, const void *payload, uint16_t len,
+                                uint8_t flags)
+{
+    ShellLogBinHeader_t hdr;
+    uint8_t built = 0;
+
+    for (uint8_t i = 0; i < log_sink_count; i++) {
+        ShellLogSink_t *sink = log_sinks[i];
+        if (!sink->write_bin || !shellLogSinkAccepts(sink, level, flags)) {
+            continue;
+        }
+        if (!built) {
+            hdr.sync = SHELL_LOG_BIN_SYNC;
+            hdr.type = type;
+            hdr.level = (uint8_t)level;
+            hdr.module = module;
+            hdr.reserved = 0;
+            hdr.len = len;
+            hdr.seq = 0;
+            hdr.time_us = time_us;
+            built = 1;
+        }
+        sink->write_bin(&hdr, payload);
+    }
+}
+
+#if SHELL_LOG_ASYNC
+/**
+ * @brief Check whether any text sink takes a message of this level
+ * @param level Message level
+ * @param flags LOG_DISPATCH_* flags
+ * @return 1 if the message has to be formatted
+ */
+static int shellLogTextWanted(ShellLogLevel_t level, uint8_t flags)
+{
+    for (uint8_t i = 0; i < log_sink_count; i++) {
+        if (!log_sinks[i]->write_bin && shellLogSinkAccepts(log_sinks[i], level, flags)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+#endif /* SHELL_LOG_ASYNC */
+
+/**
+ * @brief Write one log line to every sink that accepts its level
+ * @param line Complete line
+ * @param len Line length
+ * @param level Line level
+ * @param flags LOG_DISPATCH_* flags
+ */
+static void shellLogDispatchLine(const char *line, uint16_t len, ShellLogLevel_t level,
+                                 uint8_t flags)
+{
+    for (uint8_t i = 0; i < log_sink_count; i++) {
+        ShellLogSink_t *sink = log_sinks[i];
+        if (sink->write_bin == NULL && shellLogSinkAccepts(sink, level, flags)) {
+            sink->write(line, len);
+        }
+    }
+    if (!(flags & LOG_DISPATCH_TEXT_ONLY)) {
+        shellLogDispatchBin(SHELL_LOG_BIN_TEXT, 0xFF, level, 0, line, len, flags);
+    }
+}
+
+#if SHELL_LOG_ASYNC
+/**
+ * @brief Write raw console output (shell echo, prompt) to console sinks
+ * @param data Data
+ * @param len Data length
+ */
+static void shellLogDispatchRaw(const char *data, uint16_t len)
+{
+    for (uint8_t i = 0; i < log_sink_count; i++) {
+        ShellLogSink_t *sink = log_sinks[i];
+        if (sink->enabled && sink->write_raw) {
+            sink->write_raw(data, len);
+        }
+    }
+}
+#endif /* SHELL_LOG_ASYNC */
+
+/**
+ * @brief Pass output of the capturing task to the capture callback
+ * @param data Data
+ * @param len Data length
+ * @return 1 if the data was captured, 0 if it goes to the sinks
+ */
+static int shellLogCaptureWrite(const char *data, uint16_t len)
+{
+    ShellLogCapture_t capture;
+    TaskHandle_t task;
+
+    /* 没有捕获时不进临界区 */
+    if (log_capture == NULL || __get_IPSR() != 0U
+        || xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) {
+        return 0;
+    }
+    UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+    capture = log_capture;
+    task = log_capture_task;
+    taskEXIT_CRITICAL_FROM_ISR(saved);
+    if (capture == NULL || xTaskGetCurrentTaskHandle() != task) {
+        return 0;
+    }
+    capture(data, len);
+    return 1;
+}
+
+/**
+ * @brief Divert the output of one task to a callback
+ * @param task FreeRTOS task handle, NULL to stop capturing
+ * @param capture Callback
+ */
+void shellLogSetCapture(void *task, ShellLogCapture_t capture)
+{
+    /* 任务和回调一起更新，其他任务不会用到半更新的状态 */
+    UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+    log_capture_task = (TaskHandle_t)task;
+    log_capture = (task != NULL) ? capture : NULL;
+    taskEXIT_CRITICAL_FROM_ISR(saved);
+}
+
+/**
+ * @brief Get the current output capture
+ * @param task Output capturing task (NULL if none)
+ * @param capture Output callback (NULL if none)
+ */
+void shellLogGetCapture(void **task, ShellLogCapture_t *capture)
+{
+    UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+    *capture = log_capture;
+    *task = (*capture != NULL) ? (void *)log_capture_task : NULL;
+    taskEXIT_CRITICAL_FROM_ISR(saved);
+}
+
+#if SHELL_LOG_ASYNC
+/**
+ * @brief Flush buffered sinks (drain task only)
+ */
+static void shellLogFlushSinks(void)
+{
+    for (uint8_t i = 0; i < log_sink_count; i++) {
+        if (log_sinks[i]->enabled && log_sinks[i]->flush) {
+            log_sinks[i]->flush();
+        }
+    }
+}
+#endif
+
+/**
+ * @brief Add to the statistics of one module/level pair (any context)
+ * @param module Module ID
+ * @param level Log level
+ * @param emitted Messages emitted
+ * @param suppressed Messages suppressed
+ * @param bytes Output bytes
+ * @param cycles CPU cycles
+ */
+static void shellLogStatAdd(ShellLogModule_t module, ShellLogLevel_t level, uint32_t emitted,
+                            uint32_t suppressed, uint32_t bytes, uint32_t cycles)
+{
+#if SHELL_LOG_STATS
+    if ((uint32_t)module >= SHELL_LOG_MODULE_MAX || (uint32_t)level >= SHELL_LOG_LEVEL_NONE) {
+        return;
+    }
+    /* 64位累加不是原子操作，短临界区保护 */
+    UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+    ShellLogStats_t *stat = &log_stats[module][level];
+    stat->emitted += emitted;
+    stat->suppressed += suppressed;
+    stat->bytes += bytes;
+    stat->cycles += cycles;
+    taskEXIT_CRITICAL_FROM_ISR(saved);
+#else
+    (void)module;
+    (void)level;
+    (void)emitted;
+    (void)suppressed;
+    (void)bytes;
+    (void)cycles;
+#endif
+}
+
+/**
+ * @brief Start a cycle measurement for the statistics
+ * @return Cycle counter (0 if statistics are disabled)
+ */
+static inline uint32_t shellLogStatStart(void)
+{
+#if SHELL_LOG_STATS
+    return Timebase_GetCycles32();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Count a message suppressed outside shellLogPrint (rate limiter)
+ * @param module Module ID
+ * @param level Log level
+ */
+void shellLogCountSuppressed(ShellLogModule_t module, ShellLogLevel_t level)
+{
+    shellLogStatAdd(module, level, 0, 1, 0, 0);
+}
+
+/**
+ * @brief Get log statistics of one module/level pair
+ * @param module Module ID
+ * @param level Log level
+ * @param stats Output statistics (zero if SHELL_LOG_STATS is disabled)
+ */
+void shellLogGetStats(ShellLogModule_t module, ShellLogLevel_t level, ShellLogStats_t *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+#if SHELL_LOG_STATS
+    if ((uint32_t)module < SHELL_LOG_MODULE_MAX && (uint32_t)level < SHELL_LOG_LEVEL_NONE) {
+        UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+        *stats = log_stats[module][level];
+        taskEXIT_CRITICAL_FROM_ISR(saved);
+    }
+#endif
+}
+
+/**
+ * @brief Clear all log statistics
+ */
+void shellLogResetStats(void)
+{
+#if SHELL_LOG_STATS
+    uint64_t now = Timebase_GetUs();
+    UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+    memset(log_stats, 0, sizeof(log_stats));
+    log_stats_since = now;
+    taskEXIT_CRITICAL_FROM_ISR(saved);
+#endif
+}
+
+/**
+ * @brief Get the time the statistics were last cleared
+ * @return Microseconds since boot
+ */
+uint64_t shellLogStatsSince(void)
+{
+#if SHELL_LOG_STATS
+    return log_stats_since;
+#else
+    return 0;
+#endif
+}
+
 /**
  * @brief Check if log should be printed
  * @param module Module ID
@@ -167,6 +653,65 @@ static uint8_t shellLogShouldPrint(ShellLogModule_t module, ShellLogLevel_t leve
     return 1;
 }
 
+/**
+ * @brief Check if a level is enabled at runtime
+ * @param module Module ID
+ * @param level Log level
+ * @return 1 if enabled, 0 otherwise
+ */
+uint8_t shellLogIsEnabled(ShellLogModule_t module, ShellLogLevel_t level)
+{
+    return shellLogShouldPrint(module, level);
+}
+
+/**
+ * @brief Per-call-site token bucket
+ * @param limit Call site state
+ * @param rate Tokens refilled per second
+ * @param burst Bucket depth
+ * @param suppressed Output number of calls suppressed since the last allowed one
+ * @return 1 if the message may be printed, 0 if it is suppressed
+ */
+uint8_t shellLogRateLimit(ShellLogRateLimit_t *limit, uint32_t rate, uint32_t burst,
+                          uint32_t *suppressed)
+{
+    uint32_t now = HAL_GetTick();
+    uint32_t capacity = burst * 1000U;  /* 以千分之一令牌为单位 */
+    uint8_t allow = 0;
+    
+    /* 调用点可能同时位于任务和中断中 */
+    UBaseType_t state = taskENTER_CRITICAL_FROM_ISR();
+    
+    if (!limit->initialized) {
+        limit->initialized = 1;
+        limit->tokens = capacity;
+        limit->last_tick = now;
+    }
+    
+    uint32_t elapsed = now - limit->last_tick;
+    limit->last_tick = now;
+    if (rate == 0 || elapsed >= capacity / rate) {
+        limit->tokens = (rate == 0) ? limit->tokens : capacity;
+    } else {
+        limit->tokens += elapsed * rate;
+        if (limit->tokens > capacity) {
+            limit->tokens = capacity;
+        }
+    }
+    
+    if (limit->tokens >= 1000U) {
+        limit->tokens -= 1000U;
+        *suppressed = limit->suppressed;
+        limit->suppressed = 0;
+        allow = 1;
+    } else {
+        limit->suppressed++;
+    }
+    
+    taskEXIT_CRITICAL_FROM_ISR(state);
+    return allow;
+}
+
 /**
  * @brief Get any available shell (not necessarily active)
  * @return Shell* First available shell or NULL
@@ -178,61 +723,864 @@ static Shell* shellLogGetShell(void)
 }
 
 /**
- * @brief Core logging function
+ * @brief Deferred log record payload (stored in the ring)
+ */
+typedef struct {
+    uint64_t time_us;               /*!< Timestamp at the call site */
+    const char *format;             /*!< Format string (must stay valid) */
+    uint8_t module;                 /*!< ShellLogModule_t */
+    uint8_t level;                  /*!< ShellLogLevel_t */
+    uint8_t nargs;                  /*!< Number of valid args */
+    uint8_t reserved;
+    uint32_t args[SHELL_LOG_DEFER_MAX_ARGS];
+} ShellLogDeferredRecord_t;
+
+#if SHELL_LOG_ASYNC
+/**
+ * @brief Pass a deferred record unformatted to the at_produce sinks (logging context)
+ *        Only sinks with write_bin take it, as a SHELL_LOG_BIN_DEFER frame;
+ *        nothing is formatted, so the cost stays that of a copy
+ * @param rec Deferred record
+ */
+static void shellLogDispatchProduceDefer(const ShellLogDeferredRecord_t *rec)
+{
+    for (uint8_t i = 0; i < log_sink_count; i++) {
+        ShellLogSink_t *sink = log_sinks[i];
+        if (!sink->at_produce || !sink->write_bin || !sink->enabled || rec->level < sink->level) {
+            continue;
+        }
+        uint32_t payload[1 + SHELL_LOG_DEFER_MAX_ARGS];
+        ShellLogBinHeader_t hdr;
+        hdr.sync = SHELL_LOG_BIN_SYNC;
+        hdr.type = SHELL_LOG_BIN_DEFER;
+        hdr.level = rec->level;
+        hdr.module = rec->module;
+        hdr.reserved = 0;
+        hdr.len = (uint16_t)(sizeof(uint32_t) * (1U + rec->nargs));
+        hdr.seq = 0;
+        hdr.time_us = rec->time_us;
+        payload[0] = (uint32_t)(uintptr_t)rec->format;
+        memcpy(&payload[1], rec->args, rec->nargs * sizeof(uint32_t));
+        sink->write_bin(&hdr, payload);
+    }
+}
+#endif /* SHELL_LOG_ASYNC */
+
+/**
+ * @brief Get the log timestamp
+ * @return Microseconds since boot
+ */
+static uint64_t shellLogTimestamp(void)
+{
+#if SHELL_LOG_TIMESTAMP_US
+    return Timebase_GetUs();
+#else
+    return (uint64_t)HAL_GetTick() * 1000U;
+#endif
+}
+
+/**
+ * @brief Format the "[sec.frac] " timestamp without printf
+ * @param buffer Output buffer
+ * @param size Buffer size
+ * @param time_us Timestamp in microseconds
+ * @return Number of characters written (0 if it does not fit)
+ */
+static int shellLogFormatStamp(char *buffer, size_t size, uint64_t time_us)
+{
+    char tmp[24];
+    char *p = tmp + sizeof(tmp);
+    uint32_t seconds = (uint32_t)(time_us / 1000000U);
+#if SHELL_LOG_TIMESTAMP_US
+    uint32_t frac = (uint32_t)(time_us % 1000000U);
+    int digits = 6;
+#else
+    uint32_t frac = (uint32_t)(time_us % 1000000U) / 1000U;
+    int digits = 3;
+#endif
+
+    /* 从右向左填充 */
+    *--p = ' ';
+    *--p = ']';
+    while (digits-- > 0) {
+        *--p = (char)('0' + frac % 10U);
+        frac /= 10U;
+    }
+    *--p = '.';
+    do {
+        *--p = (char)('0' + seconds % 10U);
+        seconds /= 10U;
+    } while (seconds != 0);
+    *--p = '[';
+
+    size_t len = (size_t)(tmp + sizeof(tmp) - p);
+    if (len >= size) {
+        return 0;
+    }
+    memcpy(buffer, p, len);
+    buffer[len] = '\0';
+    return (int)len;
+}
+
+/**
+ * @brief Format the "[sec.us] [LEVEL:MODULE] " line header
+ * @param buffer Output buffer
+ * @param size Buffer size
+ * @param time_us Timestamp in microseconds
  * @param module Module ID
  * @param level Log level
- * @param format Format string
- * @param ... Arguments
+ * @param stamp_len Output length of the timestamp part (may be NULL)
+ * @return Number of characters written
  */
-void shellLogPrint(ShellLogModule_t module, ShellLogLevel_t level, const char* format, ...)
+static int shellLogFormatHeader(char *buffer, size_t size, uint64_t time_us,
+                                ShellLogModule_t module, ShellLogLevel_t level,
+                                int *stamp_len)
 {
-    Shell *shell = shellLogGetShell();
-    if (!shell || !shellLogShouldPrint(module, level)) {
-        return;
-    }
-    
-    char buffer[512];
-    va_list args;
-    va_start(args, format);
-    
-    /* Build log message */
     int offset = 0;
     
     /* Add timestamp if enabled */
     if (g_shell_log_config.timestamp_enabled) {
-        uint32_t tick = HAL_GetTick();
-        uint32_t seconds = tick / 1000;
-        uint32_t milliseconds = tick % 1000;
-        offset += snprintf(buffer + offset, sizeof(buffer) - offset, "[%lu.%03lu] ", 
-                          seconds, milliseconds);
+        offset += shellLogFormatStamp(buffer, size, time_us);
+    }
+    if (stamp_len) {
+        *stamp_len = offset;
     }
     
     /* Add colored level and module tag */
-    if (g_shell_log_config.color_enabled) {
-        offset += snprintf(buffer + offset, sizeof(buffer) - offset, "%s[%s:%s]%s ", 
+    ShellLogPrefixTable_t *table = log_prefix;
+    if (table != NULL && level < SHELL_LOG_LEVEL_NONE && module < SHELL_LOG_MODULE_MAX) {
+        const ShellLogPrefix_t *prefix = &(*table)[level][module];
+        if ((size_t)offset + prefix->len < size) {
+            memcpy(buffer + offset, prefix->text, prefix->len + 1U);
+            offset += prefix->len;
+        }
+    } else if (g_shell_log_config.color_enabled) {
+        offset += shellFmtSnprintf(buffer + offset, size - offset, "%s[%s:%s]%s ", 
                           shellLogGetLevelColor(level),
                           shellLogGetLevelName(level), 
                           shellLogGetModuleName(module),
                           SHELL_COLOR_RESET);
     } else {
-        offset += snprintf(buffer + offset, sizeof(buffer) - offset, "[%s:%s] ", 
+        offset += shellFmtSnprintf(buffer + offset, size - offset, "[%s:%s] ", 
                           shellLogGetLevelName(level), shellLogGetModuleName(module));
     }
-    
-    /* Add user message (without color) */
-    offset += vsnprintf(buffer + offset, sizeof(buffer) - offset, format, args);
+    return offset;
+}
+
+/**
+ * @brief Clamp a formatted line and terminate it with CRLF
+ * @param buffer Line buffer
+ * @param size Buffer size
+ * @param offset Untruncated length returned by the formatter
+ * @return Final line length
+ */
+static int shellLogFinishLine(char *buffer, size_t size, int offset)
+{
+    /* The formatter returns the untruncated length */
+    if (offset > (int)size - 3) {
+        offset = size - 3;
+    }
     
     /* Ensure newline */
     if (offset > 0 && buffer[offset - 1] != '\n') {
-        if (offset < sizeof(buffer) - 2) {
-            buffer[offset++] = '\r';
-            buffer[offset++] = '\n';
-            buffer[offset] = '\0';
+        buffer[offset++] = '\r';
+        buffer[offset++] = '\n';
+        buffer[offset] = '\0';
+    }
+    return offset;
+}
+
+/**
+ * @brief Format a message from a format string and raw 32-bit arguments
+ *        Each conversion is handed to shellFmtSnprintf with its real type, so the
+ *        result is identical to formatting the original call directly.
+ * @param buffer Output buffer
+ * @param size Buffer size
+ * @param format Format string
+ * @param args Raw arguments
+ * @param nargs Number of arguments
+ * @param checked Only dereference %s addresses passing SHELL_LOG_DEFER_PTR_VALID
+ * @return Untruncated message length
+ */
+static int shellLogFormatArgs(char *buffer, size_t size, const char *format,
+                              const uint32_t *args, uint32_t nargs, uint8_t checked)
+{
+    char spec[16];
+    uint32_t arg = 0;
+    int offset = 0;
+    
+    while (*format) {
+        if (*format != '%') {
+            if ((size_t)offset < size - 1) {
+                buffer[offset] = *format;
+            }
+            offset++;
+            format++;
+            continue;
+        }
+        
+        /* 截取一个完整的转换说明 %[flags][width][.prec][len]conv */
+        const char *start = format++;
+        uint8_t is_long = 0;
+        uint8_t is_size = 0;
+        while (*format && strchr("-+ #0123456789.", *format)) {
+            format++;
+        }
+        while (*format == 'l' || *format == 'h' || *format == 'z') {
+            is_long += (*format == 'l');
+            is_size |= (*format == 'z');
+            format++;
+        }
+        char conv = *format;
+        if (conv == '\0') {
+            break;
+        }
+        format++;
+        
+        char *out = buffer + ((size_t)offset < size ? offset : size - 1);
+        size_t room = ((size_t)offset < size) ? size - offset : 1;
+        uint32_t value = (conv != '%' && arg < nargs) ? args[arg] : 0;
+        int n;
+        
+        size_t spec_len = format - start;
+        if (spec_len >= sizeof(spec)) {
+            /* 说明过长无法转交，仍消耗其参数，后续转换与参数保持对应 */
+            n = shellFmtSnprintf(out, room, "<?>");
+            offset += (n > 0) ? n : 0;
+            arg += (conv != '%');
+            continue;
+        }
+        memcpy(spec, start, spec_len);
+        spec[spec_len] = '\0';
+        
+        /* %lld/%llu等64位参数和%lc无法用32位原始值还原，交给default */
+        if (is_long >= 2 || (is_long && conv == 'c')) {
+            conv = '?';
+        }
+        
+        switch (conv) {
+        case '%':
+            n = shellFmtSnprintf(out, room, "%%");
+            break;
+        case 'd':
+        case 'i':
+            if (is_size) {
+                n = shellFmtSnprintf(out, room, spec, (ptrdiff_t)(int32_t)value);
+            } else if (is_long) {
+                n = shellFmtSnprintf(out, room, spec, (long)(int32_t)value);
+            } else {
+                n = shellFmtSnprintf(out, room, spec, (int)(int32_t)value);
+            }
+            arg++;
+            break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+        case 'c':
+            if (is_size) {
+                n = shellFmtSnprintf(out, room, spec, (size_t)value);
+            } else if (is_long) {
+                n = shellFmtSnprintf(out, room, spec, (unsigned long)value);
+            } else {
+                n = shellFmtSnprintf(out, room, spec, (unsigned int)value);
+            }
+            arg++;
+            break;
+        case 's':
+            if (checked && value && !SHELL_LOG_DEFER_PTR_VALID(value)) {
+                /* 复位后RAM中的字符串已不可信 */
+                n = shellFmtSnprintf(out, room, "<str 0x%08lx>", (unsigned long)value);
+            } else {
+                n = shellFmtSnprintf(out, room, spec, value ? (const char *)(uintptr_t)value : "(null)");
+            }
+            arg++;
+            break;
+        case 'p':
+            n = shellFmtSnprintf(out, room, spec, (void *)(uintptr_t)value);
+            arg++;
+            break;
+        default:
+            /* 64位、浮点和宽字符参数无法用32位原始值还原 */
+            n = shellFmtSnprintf(out, room, "<%s?>", spec);
+            arg++;
+            break;
+        }
+        offset += (n > 0) ? n : 0;
+    }
+    
+    if (size > 0) {
+        buffer[((size_t)offset < size) ? offset : size - 1] = '\0';
+    }
+    return offset;
+}
+
+/**
+ * @brief Build the complete log line of a deferred record
+ * @param buffer Output buffer
+ * @param size Buffer size
+ * @param rec Deferred record
+ * @param stamp_len Output length of the timestamp part (may be NULL)
+ * @param checked Only dereference %s addresses passing SHELL_LOG_DEFER_PTR_VALID
+ * @return Line length
+ */
+static int shellLogFormatDeferred(char *buffer, size_t size, const ShellLogDeferredRecord_t *rec,
+                                  int *stamp_len, uint8_t checked)
+{
+    int offset = shellLogFormatHeader(buffer, size, rec->time_us,
+                                      (ShellLogModule_t)rec->module, (ShellLogLevel_t)rec->level,
+                                      stamp_len);
+    offset += shellLogFormatArgs(buffer + offset, size - offset, rec->format,
+                                 rec->args, rec->nargs, checked);
+    return shellLogFinishLine(buffer, size, offset);
+}
+
+/**
+ * @brief Format a deferred record read back from storage (e.g. after a reset)
+ * @param buffer Output buffer
+ * @param size Buffer size
+ * @param time_us Record timestamp
+ * @param module Module ID
+ * @param level Log level
+ * @param format Format string, already validated by the caller
+ * @param args Raw 32-bit arguments
+ * @param nargs Number of arguments
+ * @return Line length
+ */
+int shellLogFormatRecord(char *buffer, size_t size, uint64_t time_us, ShellLogModule_t module,
+                         ShellLogLevel_t level, const char *format, const uint32_t *args, uint32_t nargs)
+{
+    ShellLogDeferredRecord_t rec;
+    rec.time_us = time_us;
+    rec.format = format;
+    rec.module = (uint8_t)module;
+    rec.level = (uint8_t)level;
+    rec.nargs = (uint8_t)((nargs > SHELL_LOG_DEFER_MAX_ARGS) ? SHELL_LOG_DEFER_MAX_ARGS : nargs);
+    rec.reserved = 0;
+    memcpy(rec.args, args, rec.nargs * sizeof(uint32_t));
+    return shellLogFormatDeferred(buffer, size, &rec, NULL, 1);
+}
+
+#if SHELL_LOG_ASYNC
+
+/**
+ * @brief Check if running in interrupt context
+ * @return 1 in ISR, 0 in thread mode
+ */
+static inline uint8_t shellLogInIsr(void)
+{
+    return __get_IPSR() != 0U;
+}
+
+/**
+ * @brief Check if the drain task can take output
+ * @return 1 if output should go through the ring
+ */
+static inline uint8_t shellLogRingActive(void)
+{
+    /* 调度器启动前同步输出，保证启动阶段的日志不会滞留在环形缓冲区 */
+    return log_drain_task != NULL
+        && xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED;
+}
+
+/**
+ * @brief Reserve space for one record (lock-free, ISR safe)
+ * @param len Payload length
+ * @param offset Output byte offset of the record header in the ring
+ * @return 0 on success, -1 if the ring is full
+ */
+static int shellLogRingReserve(uint16_t len, uint32_t *offset)
+{
+    uint32_t need = LOG_REC_SIZE(len);
+    uint32_t head = __atomic_load_n(&log_ring.head, __ATOMIC_RELAXED);
+    uint32_t tail, pos, pad;
+
+    do {
+        tail = __atomic_load_n(&log_ring.tail, __ATOMIC_ACQUIRE);
+        pos = head & LOG_RING_MASK;
+        /* 记录不跨越环尾，剩余空间不足时用填充记录补齐 */
+        pad = (SHELL_LOG_RING_SIZE - pos < need) ? (SHELL_LOG_RING_SIZE - pos) : 0;
+        if (SHELL_LOG_RING_SIZE - (head - tail) < pad + need) {
+            return -1;
+        }
+    } while (!__atomic_compare_exchange_n(&log_ring.head, &head, head + pad + need,
+                                          1, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    uint32_t used = head + pad + need - tail;
+    if (used > log_ring.high_water) {
+        log_ring.high_water = used;     /* 统计值，允许竞争下的近似 */
+    }
+
+    if (pad) {
+        __atomic_store_n(&log_ring.data[pos / sizeof(uint32_t)],
+                         LOG_REC_HDR(pad - sizeof(uint32_t), 0, LOG_REC_PAD), __ATOMIC_RELEASE);
+    }
+    *offset = (head + pad) & LOG_RING_MASK;
+    return 0;
+}
+
+/**
+ * @brief Wake up the drain task
+ */
+static void shellLogWakeDrain(void)
+{
+    if (shellLogInIsr()) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(log_drain_task, &woken);
+        portYIELD_FROM_ISR(woken);
+    } else {
+        xTaskNotifyGive(log_drain_task);
+    }
+}
+
+/**
+ * @brief Push one record into the ring
+ * @param data Payload
+ * @param len Payload length
+ * @param aux Type specific header byte
+ * @param type Record type
+ * @return 0 on success, -1 if dropped
+ */
+static int shellLogRingPush(const char *data, uint16_t len, uint8_t aux, uint32_t type)
+{
+    uint32_t offset;
+
+    while (shellLogRingReserve(len, &offset) != 0) {
+        /* 控制台任务的输出（命令结果）不能丢，等待drain任务腾出空间 */
+        if (!shellLogInIsr()
+            && log_console_task != NULL
+            && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING
+            && xTaskGetCurrentTaskHandle() == log_console_task) {
+            shellLogWakeDrain();
+            vTaskDelay(pdMS_TO_TICKS(2));
+            continue;
+        }
+        __atomic_fetch_add(&log_ring.dropped, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&log_ring.dropped_bytes, len, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    memcpy(&log_ring.data[offset / sizeof(uint32_t) + 1], data, len);
+    __atomic_store_n(&log_ring.data[offset / sizeof(uint32_t)],
+                     LOG_REC_HDR(len, aux, type), __ATOMIC_RELEASE);
+    shellLogWakeDrain();
+    return 0;
+}
+
+/**
+ * @brief Print the pending "last message repeated" summary
+ */
+static void shellLogDedupFlush(void)
+{
+    if (log_dedup.repeats == 0) {
+        return;
+    }
+    char msg[64];
+    int n = shellFmtSnprintf(msg, sizeof(msg), "[LOG] Last message repeated %lu times\r\n",
+                     (unsigned long)log_dedup.repeats);
+    log_dedup.repeats = 0;
+    shellLogDispatchLine(msg, (uint16_t)n, log_dedup.level, log_dedup.flags);
+}
+
+/**
+ * @brief Write one log line, collapsing identical consecutive lines
+ *        USER lines are shell command output (table rows, hexdump) and are
+ *        never collapsed
+ * @param line Complete line
+ * @param len Line length
+ * @param stamp_len Length of the timestamp part (not compared)
+ * @param module Line module
+ * @param level Line level
+ * @param flags LOG_DISPATCH_* flags
+ */
+static void shellLogDrainLine(const char *line, uint32_t len, uint32_t stamp_len,
+                              ShellLogModule_t module, ShellLogLevel_t level, uint8_t flags)
+{
+    if (module == SHELL_LOG_MODULE_USER) {
+        shellLogDedupFlush();
+        log_dedup.valid = 0;
+    } else if (g_shell_log_config.dedup_enabled && stamp_len <= len) {
+        /* FNV-1a，比较时忽略时间戳 */
+        uint32_t hash = 2166136261U;
+        for (uint32_t i = stamp_len; i < len; i++) {
+            hash = (hash ^ (uint8_t)line[i]) * 16777619U;
+        }
+        if (log_dedup.valid && log_dedup.hash == hash && log_dedup.len == len - stamp_len) {
+            TickType_t now = xTaskGetTickCount();
+            if (log_dedup.repeats++ == 0) {
+                log_dedup.since = now;
+            } else if (now - log_dedup.since >= pdMS_TO_TICKS(SHELL_LOG_DEDUP_FLUSH_MS)) {
+                /* 持续的重复风暴中也定期给出汇总，之后继续折叠 */
+                shellLogDedupFlush();
+            }
+            return;
+        }
+        shellLogDedupFlush();
+        log_dedup.valid = 1;
+        log_dedup.flags = flags;
+        log_dedup.level = level;
+        log_dedup.hash = hash;
+        log_dedup.len = len - stamp_len;
+    }
+    shellLogDispatchLine(line, (uint16_t)len, level, flags);
+}
+
+/**
+ * @brief Write all committed records to the console
+ */
+static void shellLogRingDrain(void)
+{
+    uint32_t tail = log_ring.tail;
+
+    while (tail != __atomic_load_n(&log_ring.head, __ATOMIC_ACQUIRE)) {
+        uint32_t pos = tail & LOG_RING_MASK;
+        uint32_t *rec = &log_ring.data[pos / sizeof(uint32_t)];
+        uint32_t hdr = __atomic_load_n(rec, __ATOMIC_ACQUIRE);
+
+        if (LOG_REC_TYPE(hdr) == LOG_REC_EMPTY) {
+            break;      /* 生产者已预留但尚未提交，等待下一次通知 */
+        }
+
+        uint32_t len = LOG_REC_LEN(hdr);
+        switch (LOG_REC_TYPE(hdr)) {
+        case LOG_REC_RAW:
+            shellLogDedupFlush();
+            log_dedup.valid = 0;
+            shellLogDispatchRaw((const char *)(rec + 1), (uint16_t)len);
+            break;
+        case LOG_REC_LOG: {
+            uint32_t start = shellLogStatStart();
+            ShellLogLevel_t level = LOG_LINE_LEVEL(LOG_REC_AUX(hdr));
+            shellLogDrainLine((const char *)(rec + 1), len, LOG_LINE_STAMP(LOG_REC_AUX(hdr)),
+                              LOG_REC_MODULE(hdr), level, LOG_DISPATCH_DRAIN);
+            shellLogStatAdd(LOG_REC_MODULE(hdr), level, 0, 0, 0,
+                            shellLogStatStart() - start);
+            break;
+        }
+        case LOG_REC_DEFER: {
+            /* 延迟格式化：二进制输出端直接拿原始记录，只有文本输出端需要时才格式化 */
+            uint32_t start = shellLogStatStart();
+            ShellLogDeferredRecord_t deferred;
+            int stamp_len;
+            memcpy(&deferred, rec + 1, len);
+            ShellLogLevel_t level = (ShellLogLevel_t)deferred.level;
+            uint32_t payload[1 + SHELL_LOG_DEFER_MAX_ARGS];
+            uint16_t payload_len = (uint16_t)(sizeof(uint32_t) * (1U + deferred.nargs));
+            payload[0] = (uint32_t)(uintptr_t)deferred.format;
+            memcpy(&payload[1], deferred.args, deferred.nargs * sizeof(uint32_t));
+            shellLogDispatchBin(SHELL_LOG_BIN_DEFER, deferred.module, level, deferred.time_us,
+                                payload, payload_len, LOG_DISPATCH_DRAIN);
+            int n = 0;
+            if (shellLogTextWanted(level, LOG_DISPATCH_DRAIN)) {
+                n = shellLogFormatDeferred(log_drain_line, sizeof(log_drain_line), &deferred,
+                                           &stamp_len, 0);
+                shellLogDrainLine(log_drain_line, n, stamp_len,
+                                  (ShellLogModule_t)deferred.module, level,
+                                  LOG_DISPATCH_DRAIN | LOG_DISPATCH_TEXT_ONLY);
+            }
+            shellLogStatAdd((ShellLogModule_t)deferred.module, level, 0, 0,
+                            n ? (uint32_t)n : payload_len, shellLogStatStart() - start);
+            break;
+        }
+        default:
+            break;
+        }
+
+        /* 清零整个记录，保证以后落在此处的记录头在提交前读到的是0 */
+        memset(rec, 0, LOG_REC_SIZE(len));
+        tail += LOG_REC_SIZE(len);
+        __atomic_store_n(&log_ring.tail, tail, __ATOMIC_RELEASE);
+    }
+
+    uint32_t dropped = log_ring.dropped;
+    if (dropped != log_ring.dropped_reported) {
+        char msg[64];
+        int n = shellFmtSnprintf(msg, sizeof(msg), "[LOG] %lu message(s) dropped\r\n",
+                         (unsigned long)(dropped - log_ring.dropped_reported));
+        log_ring.dropped_reported = dropped;
+        shellLogDispatchLine(msg, (uint16_t)n, SHELL_LOG_LEVEL_WARNING, LOG_DISPATCH_DRAIN);
+    }
+}
+
+/**
+ * @brief Drain task: owns the console UART
+ * @param argument Unused
+ */
+static void shellLogDrainTask(void *argument)
+{
+    (void)argument;
+
+    while (1) {
+        /* 有未输出的重复计数时限时等待，超时后补打汇总行并刷新带缓冲的输出端 */
+        TickType_t wait = log_dedup.repeats ? pdMS_TO_TICKS(SHELL_LOG_DEDUP_FLUSH_MS)
+                                            : pdMS_TO_TICKS(SHELL_LOG_SINK_FLUSH_MS);
+        if (ulTaskNotifyTake(pdTRUE, wait) == 0) {
+            shellLogDedupFlush();
+            shellLogFlushSinks();
+        }
+        shellLogRingDrain();
+    }
+}
+
+/**
+ * @brief Create the drain task that owns the console output
+ * @return 0 on success, -1 if the task could not be created
+ */
+int shellLogStartDrain(void)
+{
+    TaskHandle_t handle = NULL;
+
+    if (log_drain_task != NULL) {
+        return 0;
+    }
+    if (xTaskCreate(shellLogDrainTask, "LogDrain",
+                    SHELL_LOG_DRAIN_TASK_STACK_SIZE / sizeof(StackType_t),
+                    NULL, SHELL_LOG_DRAIN_TASK_PRIORITY, &handle) != pdPASS) {
+        return -1;
+    }
+    log_drain_task = handle;
+    return 0;
+}
+
+/**
+ * @brief Register the task whose output must not be dropped
+ * @param task FreeRTOS task handle
+ */
+void shellLogSetConsoleTask(void *task)
+{
+    log_console_task = (TaskHandle_t)task;
+}
+
+/**
+ * @brief Queue raw console output behind pending logs
+ * @param data Data to write
+ * @param len Data length
+ * @return 0 if queued, -1 if the caller has to write it directly
+ */
+int shellLogWriteRaw(const char *data, uint16_t len)
+{
+    if (shellLogCaptureWrite(data, len)) {
+        return 0;
+    }
+    if (!shellLogRingActive()) {
+        return -1;
+    }
+    /* 一个记录内的数据不会被其他任务的输出打断（JSON记录整条写入） */
+    while (len > 0) {
+        uint16_t chunk = (len > SHELL_LOG_RAW_RECORD_MAX) ? SHELL_LOG_RAW_RECORD_MAX : len;
+        shellLogRingPush(data, chunk, 0, LOG_REC_RAW);
+        data += chunk;
+        len -= chunk;
+    }
+    return 0;
+}
+
+/**
+ * @brief Wait until all queued output has been written
+ * @param timeout_ms Maximum time to wait
+ * @return 0 if the ring is empty, -1 on timeout
+ */
+int shellLogFlush(uint32_t timeout_ms)
+{
+    uint32_t start = HAL_GetTick();
+
+    if (!shellLogRingActive()) {
+        return 0;
+    }
+    while (log_ring.tail != log_ring.head) {
+        if (shellLogInIsr() || xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) {
+            return -1;      /* 无法让出CPU给drain任务 */
+        }
+        if (HAL_GetTick() - start >= timeout_ms) {
+            return -1;
         }
+        xTaskNotifyGive(log_drain_task);
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    return 0;
+}
+
+/**
+ * @brief Get log ring buffer status
+ * @param status Output status
+ */
+void shellLogGetRingStatus(ShellLogRingStatus_t *status)
+{
+    if (status == NULL) {
+        return;
+    }
+    status->size = SHELL_LOG_RING_SIZE;
+    status->used = log_ring.head - log_ring.tail;
+    status->high_water = log_ring.high_water;
+    status->dropped = log_ring.dropped;
+    status->dropped_bytes = log_ring.dropped_bytes;
+}
+
+#else /* !SHELL_LOG_ASYNC */
+
+int shellLogStartDrain(void)
+{
+    return 0;
+}
+
+void shellLogSetConsoleTask(void *task)
+{
+    (void)task;
+}
+
+int shellLogWriteRaw(const char *data, uint16_t len)
+{
+    return shellLogCaptureWrite(data, len) ? 0 : -1;
+}
+
+int shellLogFlush(uint32_t timeout_ms)
+{
+    (void)timeout_ms;
+    return 0;
+}
+
+void shellLogGetRingStatus(ShellLogRingStatus_t *status)
+{
+    if (status != NULL) {
+        memset(status, 0, sizeof(*status));
     }
+}
+
+#endif /* SHELL_LOG_ASYNC */
+
+/**
+ * @brief Output one formatted log line
+ * @param shell Shell object
+ * @param buffer Line
+ * @param len Line length
+ * @param stamp_len Length of the timestamp part
+ * @param module Line module
+ * @param level Line level
+ */
+static void shellLogEmit(Shell *shell, const char *buffer, int len, int stamp_len,
+                         ShellLogModule_t module, ShellLogLevel_t level)
+{
+    (void)shell;
+    if (shellLogCaptureWrite(buffer, (uint16_t)len)) {
+        return;
+    }
+    /* 崩溃缓冲区在产生时写入，不依赖低优先级的drain任务 */
+    shellLogDispatchProduce(buffer, (uint16_t)len, level);
+#if SHELL_LOG_ASYNC
+    /* Queue for the drain task; the caller only pays for a memcpy */
+    if (shellLogRingActive()) {
+        shellLogRingPush(buffer, (uint16_t)len, LOG_LINE_AUX(stamp_len, level),
+                         LOG_REC_TYPE_MOD(LOG_REC_LOG, module));
+        return;
+    }
+#else
+    (void)stamp_len;
+    (void)module;
+#endif
+    
+    /* 同步输出：只写不会阻塞的输出端 */
+    shellLogDispatchLine(buffer, (uint16_t)len, level, 0);
+}
+
+/**
+ * @brief Core logging function
+ * @param module Module ID
+ * @param level Log level
+ * @param format Format string
+ * @param ... Arguments
+ */
+void shellLogPrint(ShellLogModule_t module, ShellLogLevel_t level, const char* format, ...)
+{
+    Shell *shell = shellLogGetShell();
+    if (!shell) {
+        return;
+    }
+    if (!shellLogShouldPrint(module, level)) {
+        shellLogStatAdd(module, level, 0, 1, 0, 0);
+        return;
+    }
+    
+    uint32_t start = shellLogStatStart();
+    char buffer[SHELL_LOG_LINE_MAX];
+    va_list args;
+    va_start(args, format);
     
-    /* Print to shell - this is the correct way to maintain shell control */
-    shellPrint(shell, "%s", buffer);
+    /* Build log message */
+    int stamp_len;
+    int offset = shellLogFormatHeader(buffer, sizeof(buffer), shellLogTimestamp(), module, level,
+                                      &stamp_len);
     
+    /* Add user message (without color) */
+    offset += shellFmtVsnprintf(buffer + offset, sizeof(buffer) - offset, format, args);
     va_end(args);
-}
\ No newline at end of file
+    
+    offset = shellLogFinishLine(buffer, sizeof(buffer), offset);
+    shellLogEmit(shell, buffer, offset, stamp_len, module, level);
+    shellLogStatAdd(module, level, 1, 0, (uint32_t)offset, shellLogStatStart() - start);
+}
+
+/**
+ * @brief Format and emit a deferred record at once (no drain task)
+ *        Kept out of line so the line buffer is not part of shellLogDeferred's
+ *        frame on the ring path, which may run in an ISR
+ * @param shell Shell instance
+ * @param rec Deferred record
+ * @param start Statistics start stamp
+ */
+static void __attribute__((noinline)) shellLogDeferredSync(Shell *shell, const ShellLogDeferredRecord_t *rec,
+                                                           uint32_t start)
+{
+    char buffer[SHELL_LOG_LINE_MAX];
+    int stamp_len;
+    int len = shellLogFormatDeferred(buffer, sizeof(buffer), rec, &stamp_len, 0);
+    shellLogEmit(shell, buffer, len, stamp_len, (ShellLogModule_t)rec->module, (ShellLogLevel_t)rec->level);
+    shellLogStatAdd((ShellLogModule_t)rec->module, (ShellLogLevel_t)rec->level, 1, 0, (uint32_t)len,
+                    shellLogStatStart() - start);
+}
+
+/**
+ * @brief Deferred logging function
+ * @param module Module ID
+ * @param level Log level
+ * @param format Format string (must stay valid until drained)
+ * @param args Raw 32-bit arguments
+ * @param nargs Number of arguments
+ */
+void shellLogDeferred(ShellLogModule_t module, ShellLogLevel_t level, const char *format,
+                      const uint32_t *args, uint32_t nargs)
+{
+    Shell *shell = shellLogGetShell();
+    if (!shell) {
+        return;
+    }
+    if (!shellLogShouldPrint(module, level)) {
+        shellLogStatAdd(module, level, 0, 1, 0, 0);
+        return;
+    }
+    
+    uint32_t start = shellLogStatStart();
+    ShellLogDeferredRecord_t rec;
+    rec.time_us = shellLogTimestamp();
+    rec.format = format;
+    rec.module = (uint8_t)module;
+    rec.level = (uint8_t)level;
+    rec.nargs = (uint8_t)((nargs > SHELL_LOG_DEFER_MAX_ARGS) ? SHELL_LOG_DEFER_MAX_ARGS : nargs);
+    rec.reserved = 0;
+    memcpy(rec.args, args, rec.nargs * sizeof(uint32_t));
+    
+#if SHELL_LOG_ASYNC
+    if (shellLogRingActive()) {
+        /* 调用方从不格式化：at_produce输出端（崩溃缓冲区）也只拿到原始记录 */
+        shellLogDispatchProduceDefer(&rec);
+        shellLogRingPush((const char *)&rec,
+                         (uint16_t)(offsetof(ShellLogDeferredRecord_t, args) + rec.nargs * sizeof(uint32_t)),
+                         0, LOG_REC_DEFER);
+        /* 输出字节数在drain任务格式化时统计 */
+        shellLogStatAdd(module, level, 1, 0, 0, shellLogStatStart() - start);
+        return;
+    }
+#endif
+    
+    /* 没有drain任务时立即格式化输出 */
+    shellLogDeferredSync(shell, &rec, start);
+}
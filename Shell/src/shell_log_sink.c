@@ -0,0 +1,749 @@
+/**
+ * @file shell_log_sink.c
+ * @author Letter (NevermindZZT@gmail.com)
+ * @brief Shell log sinks: RAM crash buffer and SD-card log file,
+ *        command output capture to a file or a RAM buffer
+ * @version 1.0.0
+ * @date 2025-01-16
+ *
+ * @copyright (c) 2025 Letter
+ *
+ */
+
+#include "shell_log_sink.h"
+#include "shell_fmt.h"
+#include "fatfs.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include <stdio.h>
+#include <string.h>
+
+#if (SHELL_LOG_CRASH_SIZE & (SHELL_LOG_CRASH_SIZE - 1)) != 0
+#error "SHELL_LOG_CRASH_SIZE must be a power of two"
+#endif
+
+#if (SHELL_LOG_FILE_BUF_SIZE % _MAX_SS) != 0
+#error "SHELL_LOG_FILE_BUF_SIZE must be a multiple of the sector size"
+#endif
+
+#define LOG_CRASH_MAGIC         0x4C4F4743U     /* "LOGC" */
+#define LOG_CRASH_MASK          (SHELL_LOG_CRASH_SIZE - 1U)
+#define LOG_CRASH_RECORD        '\x1E'          /* Starts a line holding a hex-encoded deferred record */
+#define LOG_CRASH_RECORD_HEAD   19U             /* time_us, module, level, nargs, format, format check */
+#define LOG_CRASH_RECORD_MAX    (LOG_CRASH_RECORD_HEAD + 4U * SHELL_LOG_DEFER_MAX_ARGS)
+#define LOG_FILE_PATH_MAX       64
+
+/**
+ * @brief Crash buffer
+ *        Lives in .noinit (DTCM, not cleared by the startup code) so the last
+ *        log lines survive a watchdog or fault reset. head counts every byte
+ *        ever written; check guards against a half-updated head.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t head;
+    uint32_t check;
+    uint32_t boots;
+    char data[SHELL_LOG_CRASH_SIZE];
+} ShellLogCrash_t;
+
+static ShellLogCrash_t log_crash __attribute__((section(".noinit")));
+
+/* 日志文件状态，write/flush由drain任务调用，open/close由shell任务调用 */
+static FIL log_file;
+static uint8_t log_file_buf[SHELL_LOG_FILE_BUF_SIZE] __attribute__((aligned(32)));
+static uint32_t log_file_fill;      /* Bytes buffered */
+static uint32_t log_file_target;    /* Bytes to buffer before the next f_write */
+static uint32_t log_file_chunk;     /* Write size: one cluster, at most the buffer */
+static uint8_t log_file_open;
+static uint8_t log_file_esc;        /* Inside an ANSI escape sequence */
+static FRESULT log_file_error = FR_OK;
+static char log_file_path[LOG_FILE_PATH_MAX];
+static SemaphoreHandle_t log_file_mutex;
+
+/* 命令输出重定向文件，只由执行命令的任务访问 */
+static FIL log_redirect_file;
+static uint8_t log_redirect_open;
+static uint8_t log_redirect_esc;
+static FRESULT log_redirect_error;
+static uint32_t log_redirect_bytes;
+static void *log_redirect_prev_task;
+static ShellLogCapture_t log_redirect_prev;
+
+/* 命令输出内存缓冲区（管道） */
+static char *log_buffer;
+static uint32_t log_buffer_size;
+static uint32_t log_buffer_len;
+static uint32_t log_buffer_dropped;
+static uint8_t log_buffer_esc;
+static void *log_buffer_prev_task;
+static ShellLogCapture_t log_buffer_prev;
+
+static void shellLogCrashWrite(const char *data, uint16_t len);
+static void shellLogCrashWriteBin(const ShellLogBinHeader_t *hdr, const void *payload);
+static void shellLogFileWrite(const char *data, uint16_t len);
+static void shellLogFileSinkFlush(void);
+
+static ShellLogSink_t log_crash_sink = {
+    .name = "crash",
+    .level = SHELL_LOG_LEVEL_DEBUG,
+    .enabled = 1,
+    .task_only = 0,
+    .at_produce = 1,
+    .write = shellLogCrashWrite,
+    .write_raw = NULL,
+    .flush = NULL,
+    .write_bin = shellLogCrashWriteBin,
+};
+
+static ShellLogSink_t log_file_sink = {
+    .name = "file",
+    .level = SHELL_LOG_LEVEL_DEBUG,
+    .enabled = 0,
+    .task_only = 1,
+    .at_produce = 0,
+    .write = shellLogFileWrite,
+    .write_raw = NULL,
+    .flush = shellLogFileSinkFlush,
+    .write_bin = NULL,
+};
+
+/**
+ * @brief Append data to the crash buffer (any context)
+ * @param data Data
+ * @param len Data length
+ */
+static void shellLogCrashAppend(const char *data, uint32_t len)
+{
+    UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+    uint32_t head = log_crash.head;
+
+    for (uint32_t i = 0; i < len; i++) {
+        log_crash.data[(head + i) & LOG_CRASH_MASK] = data[i];
+    }
+    log_crash.head = head + len;
+    log_crash.check = ~log_crash.head;
+    taskEXIT_CRITICAL_FROM_ISR(saved);
+}
+
+/**
+ * @brief Crash sink write callback (logging context, may be an ISR)
+ *        Called when the line is produced, so it is in the buffer even if the
+ *        drain task never runs again before a fault or watchdog reset
+ * @param data Line
+ * @param len Line length
+ */
+static void shellLogCrashWrite(const char *data, uint16_t len)
+{
+    shellLogCrashAppend(data, len);
+}
+
+/**
+ * @brief Crash sink binary callback: store a deferred record unformatted
+ *        (logging context, may be an ISR)
+ *        The record is kept as one hex line so the buffer stays line based;
+ *        shellLogCrashDump formats it when the buffer is read. The first bytes
+ *        of the format string are stored with its address to detect a format
+ *        pointer that no longer matches, e.g. after a firmware update.
+ * @param hdr Frame header
+ * @param payload Format address followed by the arguments
+ */
+static void shellLogCrashWriteBin(const ShellLogBinHeader_t *hdr, const void *payload)
+{
+    static const char hex[] = "0123456789abcdef";
+    uint8_t rec[LOG_CRASH_RECORD_MAX];
+    char line[2U * LOG_CRASH_RECORD_MAX + 2U];
+    const uint32_t *words = (const uint32_t *)payload;
+    const char *format;
+    uint32_t nargs;
+    uint32_t n = 0;
+
+    if (hdr->type != SHELL_LOG_BIN_DEFER || hdr->len < sizeof(uint32_t)) {
+        return;
+    }
+    nargs = hdr->len / sizeof(uint32_t) - 1U;
+    if (nargs > SHELL_LOG_DEFER_MAX_ARGS) {
+        nargs = SHELL_LOG_DEFER_MAX_ARGS;
+    }
+    format = (const char *)(uintptr_t)words[0];
+
+    /* time_us(8) module level nargs format(4) 格式串前4字节 args(4*n)，目标字节序 */
+    memcpy(&rec[0], &hdr->time_us, sizeof(uint64_t));
+    rec[8] = hdr->module;
+    rec[9] = hdr->level;
+    rec[10] = (uint8_t)nargs;
+    memcpy(&rec[11], &words[0], sizeof(uint32_t));
+    memset(&rec[15], 0, 4);
+    for (uint32_t i = 0; i < 4 && format[i] != '\0'; i++) {
+        rec[15 + i] = (uint8_t)format[i];
+    }
+    memcpy(&rec[LOG_CRASH_RECORD_HEAD], &words[1], nargs * sizeof(uint32_t));
+
+    line[n++] = LOG_CRASH_RECORD;
+    for (uint32_t i = 0; i < LOG_CRASH_RECORD_HEAD + nargs * sizeof(uint32_t); i++) {
+        line[n++] = hex[rec[i] >> 4];
+        line[n++] = hex[rec[i] & 0x0F];
+    }
+    line[n++] = '\n';
+    shellLogCrashAppend(line, n);
+}
+
+/**
+ * @brief Convert one hex digit
+ * @param c Character
+ * @return Value, or -1 if c is not a hex digit
+ */
+static int shellLogCrashHexValue(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+/**
+ * @brief Format a deferred record stored by shellLogCrashWriteBin
+ * @param hex Hex digits of the record (without marker and newline)
+ * @param len Number of digits
+ * @param write Output callback
+ */
+static void shellLogCrashDecode(const char *hex, uint32_t len, void (*write)(const char *data, uint16_t len))
+{
+    uint8_t rec[LOG_CRASH_RECORD_MAX];
+    uint32_t args[SHELL_LOG_DEFER_MAX_ARGS];
+    char line[SHELL_LOG_LINE_MAX];
+    uint64_t time_us;
+    uint32_t format;
+    uint32_t nargs;
+    int n;
+
+    if ((len & 1U) || len / 2U < LOG_CRASH_RECORD_HEAD || len / 2U > LOG_CRASH_RECORD_MAX) {
+        write("<bad record>\r\n", 14);
+        return;
+    }
+    for (uint32_t i = 0; i < len / 2U; i++) {
+        int hi = shellLogCrashHexValue(hex[2 * i]);
+        int lo = shellLogCrashHexValue(hex[2 * i + 1]);
+        if (hi < 0 || lo < 0) {
+            write("<bad record>\r\n", 14);
+            return;
+        }
+        rec[i] = (uint8_t)((hi << 4) | lo);
+    }
+    nargs = rec[10];
+    if (nargs > SHELL_LOG_DEFER_MAX_ARGS || len / 2U != LOG_CRASH_RECORD_HEAD + nargs * 4U) {
+        write("<bad record>\r\n", 14);
+        return;
+    }
+    memcpy(&time_us, &rec[0], sizeof(uint64_t));
+    memcpy(&format, &rec[11], sizeof(uint32_t));
+    memcpy(args, &rec[LOG_CRASH_RECORD_HEAD], nargs * sizeof(uint32_t));
+
+    if (format != 0 && SHELL_LOG_DEFER_PTR_VALID(format) &&
+        strncmp((const char *)(uintptr_t)format, (const char *)&rec[15], 4) == 0) {
+        n = shellLogFormatRecord(line, sizeof(line), time_us, (ShellLogModule_t)rec[8],
+                                 (ShellLogLevel_t)rec[9], (const char *)(uintptr_t)format, args, nargs);
+    } else {
+        /* 格式串已不在原处（如固件已更新），原样输出地址和参数 */
+        n = shellLogFormatRecord(line, sizeof(line), time_us, (ShellLogModule_t)rec[8],
+                                 (ShellLogLevel_t)rec[9], "<fmt 0x%08lx>", &format, 1);
+        n -= 2;     /* 去掉\r\n，追加参数 */
+        for (uint32_t i = 0; i < nargs; i++) {
+            n += shellFmtSnprintf(line + n, sizeof(line) - n, " 0x%08lx", (unsigned long)args[i]);
+        }
+        n += shellFmtSnprintf(line + n, sizeof(line) - n, "\r\n");
+    }
+    write(line, (uint16_t)n);
+}
+
+/**
+ * @brief Validate the crash buffer after reset
+ */
+static void shellLogCrashInit(void)
+{
+    char marker[48];
+
+    if (log_crash.magic != LOG_CRASH_MAGIC || log_crash.check != ~log_crash.head) {
+        /* 上电或内容已损坏 */
+        memset(&log_crash, 0, sizeof(log_crash));
+        log_crash.magic = LOG_CRASH_MAGIC;
+        log_crash.check = ~0U;
+        return;
+    }
+
+    log_crash.boots++;
+    int n = shellFmtSnprintf(marker, sizeof(marker), "\r\n---- reset (boot %lu) ----\r\n",
+                     (unsigned long)log_crash.boots);
+    shellLogCrashAppend(marker, (uint32_t)n);
+}
+
+/**
+ * @brief Get the number of bytes held in the crash buffer
+ * @return Byte count
+ */
+uint32_t shellLogCrashUsed(void)
+{
+    uint32_t head = log_crash.head;
+    return (head < SHELL_LOG_CRASH_SIZE) ? head : SHELL_LOG_CRASH_SIZE;
+}
+
+/**
+ * @brief Read from the crash buffer, oldest data first
+ * @param pos Offset from the oldest byte
+ * @param buf Output buffer
+ * @param len Maximum bytes to read
+ * @return Bytes read
+ * @note Lines logged while reading may overwrite the oldest part
+ */
+uint32_t shellLogCrashRead(uint32_t pos, char *buf, uint32_t len)
+{
+    uint32_t head = log_crash.head;
+    uint32_t used = (head < SHELL_LOG_CRASH_SIZE) ? head : SHELL_LOG_CRASH_SIZE;
+    uint32_t start = head - used;
+
+    if (pos >= used) {
+        return 0;
+    }
+    if (len > used - pos) {
+        len = used - pos;
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        buf[i] = log_crash.data[(start + pos + i) & LOG_CRASH_MASK];
+    }
+    return len;
+}
+
+/**
+ * @brief Write out the crash buffer, oldest data first
+ *        Text lines are passed through, deferred records are formatted here.
+ *        If the buffer has wrapped, output starts at the first complete line.
+ * @param write Output callback
+ * @return Bytes held in the buffer
+ * @note Lines logged while dumping may overwrite the oldest part
+ */
+uint32_t shellLogCrashDump(void (*write)(const char *data, uint16_t len))
+{
+    enum { LINE_START, LINE_TEXT, LINE_RECORD, LINE_SKIP };
+    char chunk[64];
+    char rec[2U * LOG_CRASH_RECORD_MAX];
+    uint32_t rec_len = 0;
+    uint32_t used = shellLogCrashUsed();
+    uint8_t state = (log_crash.head > SHELL_LOG_CRASH_SIZE) ? LINE_SKIP : LINE_START;
+
+    for (uint32_t pos = 0; pos < used; ) {
+        uint32_t n = shellLogCrashRead(pos, chunk, sizeof(chunk));
+        uint32_t text = 0;      /* Start of the text not yet written */
+        if (n == 0) {
+            break;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            char c = chunk[i];
+            if (state == LINE_RECORD) {
+                if (c == '\n') {
+                    shellLogCrashDecode(rec, rec_len, write);
+                    state = LINE_START;
+                } else if (rec_len < sizeof(rec)) {
+                    rec[rec_len++] = c;
+                } else {
+                    rec_len = sizeof(rec) + 1U;     /* Too long, reported as bad */
+                }
+                text = i + 1;
+            } else if (state == LINE_SKIP) {
+                state = (c == '\n') ? LINE_START : LINE_SKIP;
+                text = i + 1;
+            } else if (state == LINE_START && c == LOG_CRASH_RECORD) {
+                if (i > text) {
+                    write(chunk + text, (uint16_t)(i - text));
+                }
+                state = LINE_RECORD;
+                rec_len = 0;
+                text = i + 1;
+            } else {
+                state = (c == '\n') ? LINE_START : LINE_TEXT;
+            }
+        }
+        if (n > text) {
+            write(chunk + text, (uint16_t)(n - text));
+        }
+        pos += n;
+    }
+    return used;
+}
+
+/**
+ * @brief Clear the crash buffer
+ */
+void shellLogCrashClear(void)
+{
+    UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+    log_crash.head = 0;
+    log_crash.check = ~0U;
+    log_crash.boots = 0;
+    taskEXIT_CRITICAL_FROM_ISR(saved);
+}
+
+/**
+ * @brief Get the number of resets seen by the crash buffer
+ * @return Reset count since the last power-on or clear
+ */
+uint32_t shellLogCrashBoots(void)
+{
+    return log_crash.boots;
+}
+
+/**
+ * @brief Close the log file after an error and disable the sink
+ * @param res FatFs error
+ */
+static void shellLogFileFail(FRESULT res)
+{
+    log_file_error = res;
+    log_file_sink.enabled = 0;
+    log_file_open = 0;
+    log_file_fill = 0;
+    f_close(&log_file);
+}
+
+/**
+ * @brief Write the buffered data to the file (mutex held)
+ * @param sync Also sync the file
+ */
+static FRESULT shellLogFileCommit(uint8_t sync)
+{
+    FRESULT res = FR_OK;
+    UINT written;
+
+    if (log_file_fill > 0) {
+        res = f_write(&log_file, log_file_buf, log_file_fill, &written);
+        if (res == FR_OK && written != log_file_fill) {
+            res = FR_DENIED;    /* 卷已满 */
+        }
+        log_file_fill = 0;
+    }
+    if (res == FR_OK && sync) {
+        res = f_sync(&log_file);
+    }
+    if (res != FR_OK) {
+        shellLogFileFail(res);
+        return res;
+    }
+
+    /* 下一次写入对齐到簇边界，使f_write直接多扇区写 */
+    log_file_target = log_file_chunk - (uint32_t)(f_tell(&log_file) % log_file_chunk);
+    return FR_OK;
+}
+
+/**
+ * @brief Track ANSI escape sequences in a text stream
+ * @param esc Escape state of the stream
+ * @param c Next character
+ * @return 1 if the character belongs to an escape sequence
+ */
+static int shellLogAnsiSkip(uint8_t *esc, char c)
+{
+    if (*esc) {
+        /* CSI序列以0x40-0x7E结束 */
+        if (c >= 0x40 && c <= 0x7E && c != '[') {
+            *esc = 0;
+        }
+        return 1;
+    }
+    if (c == '\033') {
+        *esc = 1;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief File sink write callback (drain task)
+ *        Strips ANSI color sequences and writes whole clusters
+ * @param data Line
+ * @param len Line length
+ */
+static void shellLogFileWrite(const char *data, uint16_t len)
+{
+    if (log_file_mutex == NULL) {
+        return;
+    }
+    xSemaphoreTake(log_file_mutex, portMAX_DELAY);
+    for (uint16_t i = 0; i < len && log_file_open; i++) {
+        char c = data[i];
+        if (shellLogAnsiSkip(&log_file_esc, c)) {
+            continue;
+        }
+        log_file_buf[log_file_fill++] = (uint8_t)c;
+        if (log_file_fill >= log_file_target) {
+            shellLogFileCommit(0);
+        }
+    }
+    xSemaphoreGive(log_file_mutex);
+}
+
+/**
+ * @brief File sink flush callback (drain task, when idle)
+ */
+static void shellLogFileSinkFlush(void)
+{
+    shellLogFileFlush();
+}
+
+/**
+ * @brief Write buffered data and sync the log file
+ * @return FR_OK on success
+ */
+FRESULT shellLogFileFlush(void)
+{
+    FRESULT res = FR_OK;
+
+    if (log_file_mutex == NULL) {
+        return FR_NOT_READY;
+    }
+    xSemaphoreTake(log_file_mutex, portMAX_DELAY);
+    if (log_file_open) {
+        res = shellLogFileCommit(1);
+    }
+    xSemaphoreGive(log_file_mutex);
+    return res;
+}
+
+/**
+ * @brief Mount the volume and start appending log lines to a file
+ * @param path File path
+ * @return FR_OK on success
+ */
+FRESULT shellLogFileOpen(const char *path)
+{
+    FRESULT res;
+
+    if (log_file_mutex == NULL) {
+        return FR_NOT_READY;
+    }
+    if (strlen(path) >= LOG_FILE_PATH_MAX) {
+        return FR_INVALID_NAME;
+    }
+
+    res = FATFS_Mount();
+    if (res != FR_OK) {
+        return res;
+    }
+
+    shellLogFileClose();
+
+    xSemaphoreTake(log_file_mutex, portMAX_DELAY);
+    res = f_open(&log_file, path, FA_OPEN_APPEND | FA_WRITE);
+    if (res == FR_OK) {
+        uint32_t cluster = (uint32_t)USERFatFS.csize * _MAX_SS;
+        log_file_chunk = (cluster < SHELL_LOG_FILE_BUF_SIZE) ? cluster : SHELL_LOG_FILE_BUF_SIZE;
+        log_file_target = log_file_chunk - (uint32_t)(f_tell(&log_file) % log_file_chunk);
+        log_file_fill = 0;
+        log_file_esc = 0;
+        log_file_open = 1;
+        log_file_error = FR_OK;
+        strcpy(log_file_path, path);
+        log_file_sink.enabled = 1;
+    } else {
+        log_file_error = res;
+    }
+    xSemaphoreGive(log_file_mutex);
+    return res;
+}
+
+/**
+ * @brief Flush and close the log file
+ * @return FR_OK on success
+ */
+FRESULT shellLogFileClose(void)
+{
+    FRESULT res = FR_OK;
+
+    if (log_file_mutex == NULL) {
+        return FR_NOT_READY;
+    }
+    xSemaphoreTake(log_file_mutex, portMAX_DELAY);
+    log_file_sink.enabled = 0;
+    if (log_file_open) {
+        res = shellLogFileCommit(1);
+        if (log_file_open) {
+            log_file_open = 0;
+            FRESULT close_res = f_close(&log_file);
+            if (res == FR_OK) {
+                res = close_res;
+            }
+        }
+    }
+    xSemaphoreGive(log_file_mutex);
+    return res;
+}
+
+/**
+ * @brief Get log file state
+ * @param path Output current file path (may be NULL)
+ * @return Last FatFs error (FR_OK if none)
+ */
+FRESULT shellLogFileStatus(const char **path)
+{
+    if (path) {
+        *path = log_file_open ? log_file_path : NULL;
+    }
+    return log_file_error;
+}
+
+/**
+ * @brief Capture callback of the redirect file
+ *        Strips ANSI color sequences; FatFs buffers partial sectors
+ * @param data Output
+ * @param len Output length
+ */
+static void shellLogRedirectWrite(const char *data, uint16_t len)
+{
+    char chunk[128];
+    uint16_t fill = 0;
+    UINT written;
+
+    for (uint16_t i = 0; i <= len && log_redirect_error == FR_OK; i++) {
+        if (fill == sizeof(chunk) || (i == len && fill > 0)) {
+            log_redirect_error = f_write(&log_redirect_file, chunk, fill, &written);
+            if (log_redirect_error == FR_OK && written != fill) {
+                log_redirect_error = FR_DENIED;     /* 卷已满 */
+            }
+            log_redirect_bytes += written;
+            fill = 0;
+        }
+        if (i < len && !shellLogAnsiSkip(&log_redirect_esc, data[i])) {
+            chunk[fill++] = data[i];
+        }
+    }
+}
+
+/**
+ * @brief Redirect the output of the calling task to a file
+ * @param path File path
+ * @param append 1 to append, 0 to truncate
+ * @return FR_OK on success, FR_LOCKED if a redirect is already active
+ */
+FRESULT shellLogRedirectOpen(const char *path, uint8_t append)
+{
+    FRESULT res;
+
+    if (log_redirect_open) {
+        return FR_LOCKED;
+    }
+    res = FATFS_Mount();
+    if (res != FR_OK) {
+        return res;
+    }
+    res = f_open(&log_redirect_file, path,
+                 FA_WRITE | (append ? FA_OPEN_APPEND : FA_CREATE_ALWAYS));
+    if (res != FR_OK) {
+        return res;
+    }
+    log_redirect_open = 1;
+    log_redirect_esc = 0;
+    log_redirect_error = FR_OK;
+    log_redirect_bytes = 0;
+    shellLogGetCapture(&log_redirect_prev_task, &log_redirect_prev);
+    shellLogSetCapture(xTaskGetCurrentTaskHandle(), shellLogRedirectWrite);
+    return FR_OK;
+}
+
+/**
+ * @brief End the redirect and close the file
+ * @param bytes Output bytes written to the file (may be NULL)
+ * @return First write error, or the close result
+ */
+FRESULT shellLogRedirectClose(uint32_t *bytes)
+{
+    FRESULT res;
+
+    if (!log_redirect_open) {
+        return FR_INVALID_OBJECT;
+    }
+    shellLogSetCapture(log_redirect_prev_task, log_redirect_prev);
+    log_redirect_open = 0;
+    res = f_close(&log_redirect_file);
+    if (log_redirect_error != FR_OK) {
+        res = log_redirect_error;
+    }
+    if (bytes) {
+        *bytes = log_redirect_bytes;
+    }
+    return res;
+}
+
+/**
+ * @brief Capture callback of the RAM buffer
+ *        Strips ANSI color sequences, counts what does not fit
+ * @param data Output
+ * @param len Output length
+ */
+static void shellLogBufferWrite(const char *data, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++) {
+        if (shellLogAnsiSkip(&log_buffer_esc, data[i])) {
+            continue;
+        }
+        if (log_buffer_len < log_buffer_size) {
+            log_buffer[log_buffer_len++] = data[i];
+        } else {
+            log_buffer_dropped++;
+        }
+    }
+}
+
+/**
+ * @brief Capture the output of the calling task in a RAM buffer
+ * @param buf Buffer
+ * @param size Buffer size
+ * @return 0 on success, -1 if a buffer capture is already active
+ */
+int shellLogBufferOpen(char *buf, uint32_t size)
+{
+    if (log_buffer != NULL) {
+        return -1;
+    }
+    log_buffer = buf;
+    log_buffer_size = size;
+    log_buffer_len = 0;
+    log_buffer_dropped = 0;
+    log_buffer_esc = 0;
+    shellLogGetCapture(&log_buffer_prev_task, &log_buffer_prev);
+    shellLogSetCapture(xTaskGetCurrentTaskHandle(), shellLogBufferWrite);
+    return 0;
+}
+
+/**
+ * @brief End the RAM buffer capture
+ * @param dropped Output bytes that did not fit (may be NULL)
+ * @return Bytes captured
+ */
+uint32_t shellLogBufferClose(uint32_t *dropped)
+{
+    if (log_buffer == NULL) {
+        return 0;
+    }
+    shellLogSetCapture(log_buffer_prev_task, log_buffer_prev);
+    log_buffer = NULL;
+    if (dropped) {
+        *dropped = log_buffer_dropped;
+    }
+    return log_buffer_len;
+}
+
+/**
+ * @brief Register the crash and file sinks
+ */
+void shellLogSinkInit(void)
+{
+    shellLogCrashInit();
+    shellLogAddSink(&log_crash_sink);
+
+    log_file_mutex = xSemaphoreCreateMutex();
+    if (log_file_mutex != NULL) {
+        shellLogAddSink(&log_file_sink);
+    }
+}
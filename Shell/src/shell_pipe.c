@@ -0,0 +1,246 @@
+/**
+ * @file shell_pipe.c
+ * @author Letter (NevermindZZT@gmail.com)
+ * @brief Shell pipes and output redirection
+ * @version 1.0.0
+ * @date 2025-01-16
+ *
+ * @copyright (c) 2025 Letter
+ *
+ */
+
+#include "shell_pipe.h"
+#include "shell_log.h"
+#include "shell_log_sink.h"
+#include <string.h>
+
+#if SHELL_USING_PIPE == 1
+
+#define PIPE_LINE_MAX           128
+
+/* 两个缓冲区交替使用：当前段写一个，读上一段写的另一个 */
+static char pipe_buf[2][SHELL_PIPE_BUF_SIZE];
+static char pipe_line[PIPE_LINE_MAX];
+static const char *pipe_input;
+static uint32_t pipe_input_len;
+static uint8_t pipe_active;
+
+/**
+ * @brief Find the next unquoted `|` or `>`
+ * @param str String
+ * @return Operator position or NULL
+ */
+static char* shellPipeFindOp(char *str)
+{
+    uint8_t quoted = 0;
+
+    for (char *p = str; *p; p++) {
+        if (*p == '\\' && p[1] != '\0') {
+            p++;
+        } else if (*p == '"') {
+            quoted = !quoted;
+        } else if (!quoted && (*p == '|' || *p == '>')) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Strip leading and trailing blanks in place
+ * @param str String
+ * @return Start of the trimmed string
+ */
+static char* shellPipeTrim(char *str)
+{
+    char *end = str + strlen(str);
+
+    while (*str == ' ' || *str == '\t') {
+        str++;
+    }
+    while (end > str && (end[-1] == ' ' || end[-1] == '\t')) {
+        *--end = '\0';
+    }
+    return str;
+}
+
+/**
+ * @brief Split pipe_line into stages and the redirect target
+ * @param stage Output stage commands
+ * @param path Output redirect file, NULL if none
+ * @param append Output 1 for `>>`
+ * @return Number of stages, -1 on a syntax error (already reported)
+ */
+static int shellPipeSplit(char *stage[], char **path, uint8_t *append)
+{
+    int count = 0;
+    char *p = pipe_line;
+
+    *path = NULL;
+    *append = 0;
+    while (p != NULL) {
+        char *op = shellPipeFindOp(p);
+        char op_char = op ? *op : '\0';
+
+        if (op) {
+            *op = '\0';
+        }
+        if (count == SHELL_PIPE_STAGE_MAX) {
+            SHELL_LOG_USER_ERROR("pipe: at most %d commands", SHELL_PIPE_STAGE_MAX);
+            return -1;
+        }
+        stage[count] = shellPipeTrim(p);
+        if (stage[count][0] == '\0') {
+            SHELL_LOG_USER_ERROR("pipe: missing command");
+            return -1;
+        }
+        count++;
+
+        if (op_char == '>') {
+            if (op[1] == '>') {
+                *append = 1;
+                op++;
+            }
+            *path = shellPipeTrim(op + 1);
+            if (**path == '\0' || shellPipeFindOp(*path) != NULL) {
+                SHELL_LOG_USER_ERROR("pipe: '>' must be followed by a file name only");
+                return -1;
+            }
+            size_t n = strlen(*path);
+            if (n >= 2 && (*path)[0] == '"' && (*path)[n - 1] == '"') {
+                (*path)[n - 1] = '\0';
+                (*path)++;
+            }
+            break;
+        }
+        p = op ? op + 1 : NULL;
+    }
+    return count;
+}
+
+/**
+ * @brief Run one stage through the shell parser
+ * @param shell Shell object
+ * @param cmd Command line of the stage
+ */
+static void shellPipeRunStage(Shell *shell, const char *cmd)
+{
+    uint16_t len = (uint16_t)strlen(cmd);
+
+    memcpy(shell->parser.buffer, cmd, len + 1U);
+    shell->parser.length = len;
+    shellExecBuffer(shell);
+}
+
+/**
+ * @brief Run the command line as a pipeline if it contains `|` or `>`
+ * @param shell Shell object, the line is in parser.buffer
+ * @return 0 if the line was handled, -1 if it is a plain command
+ */
+int shellPipeExec(Shell *shell)
+{
+    char *stage[SHELL_PIPE_STAGE_MAX];
+    char *path;
+    uint8_t append;
+    int count;
+
+    if (shellPipeFindOp(shell->parser.buffer) == NULL) {
+        return -1;
+    }
+    shell->parser.length = shell->parser.cursor = 0;
+    shellWriteString(shell, "\r\n");
+
+    // 脚本中的管道行在外层管道内执行时会复用同一组缓冲区
+    if (pipe_active) {
+        SHELL_LOG_USER_ERROR("pipe: pipelines cannot be nested");
+        return 0;
+    }
+    if (strlen(shell->parser.buffer) >= sizeof(pipe_line)) {
+        SHELL_LOG_USER_ERROR("pipe: command line too long");
+        return 0;
+    }
+    strcpy(pipe_line, shell->parser.buffer);
+    count = shellPipeSplit(stage, &path, &append);
+    if (count < 0) {
+        return 0;
+    }
+
+    pipe_active = 1;
+    for (int i = 0; i < count; i++) {
+        if (i < count - 1) {
+            uint32_t dropped = 0;
+            char *buf = pipe_buf[i & 1];
+
+            shellLogBufferOpen(buf, SHELL_PIPE_BUF_SIZE);
+            shellPipeRunStage(shell, stage[i]);
+            pipe_input_len = shellLogBufferClose(&dropped);
+            pipe_input = buf;
+            if (dropped) {
+                SHELL_LOG_USER_WARNING("pipe: %lu bytes of '%s' output dropped (buffer %d bytes)",
+                                       dropped, stage[i], SHELL_PIPE_BUF_SIZE);
+            }
+        } else if (path) {
+            FRESULT res = shellLogRedirectOpen(path, append);
+            if (res != FR_OK) {
+                SHELL_LOG_USER_ERROR("pipe: cannot open %s: %d", path, res);
+                break;
+            }
+            shellPipeRunStage(shell, stage[i]);
+            uint32_t bytes = 0;
+            res = shellLogRedirectClose(&bytes);
+            if (res != FR_OK) {
+                SHELL_LOG_USER_ERROR("pipe: writing %s failed: %d", path, res);
+            } else {
+                SHELL_LOG_USER_INFO("%lu bytes written to %s", bytes, path);
+            }
+        } else {
+            shellPipeRunStage(shell, stage[i]);
+        }
+    }
+    pipe_input = NULL;
+    pipe_input_len = 0;
+    pipe_active = 0;
+    return 0;
+}
+
+/**
+ * @brief Get the input of the running pipeline stage
+ * @param len Output input length (may be NULL)
+ * @return Input data, NULL if the command is not reading from a pipe
+ */
+const char* shellPipeInput(uint32_t *len)
+{
+    if (len) {
+        *len = pipe_input_len;
+    }
+    return pipe_input;
+}
+
+/**
+ * @brief Get the next line of the pipe input
+ * @param pos Read offset, start at 0
+ * @param len Output line length without the line end
+ * @return Line (not terminated), NULL at the end of the input
+ */
+const char* shellPipeReadLine(uint32_t *pos, uint32_t *len)
+{
+    const char *line;
+    uint32_t n = 0;
+
+    if (pipe_input == NULL || *pos >= pipe_input_len) {
+        return NULL;
+    }
+    line = pipe_input + *pos;
+    while (*pos + n < pipe_input_len && line[n] != '\n') {
+        n++;
+    }
+    *pos += n + ((*pos + n < pipe_input_len) ? 1U : 0U);
+    // 日志行以CRLF结尾
+    while (n > 0 && line[n - 1] == '\r') {
+        n--;
+    }
+    *len = n;
+    return line;
+}
+
+#endif /* SHELL_USING_PIPE == 1 */
@@ -12,10 +12,13 @@
 #include "shell_port.h"
 #include "shell.h"
 #include "shell_log.h"
+#include "shell_log_sink.h"
+#include "shell_fmt.h"
 #include "FreeRTOS.h"
 #include "task.h"
 #include "semphr.h"
-#include "queue.h"
+#include "stream_buffer.h"
+#include "timers.h"
 #include "cmsis_os.h"
 #include <string.h>
 #include <stdarg.h>
@@ -26,14 +29,306 @@
 Shell shell;
 static char shellBuffer[SHELL_BUFFER_SIZE];
 static SemaphoreHandle_t shellMutex;
-static QueueHandle_t shellRxQueue;
+static StreamBufferHandle_t shellRxStream;
 static TaskHandle_t shellTaskHandle;
 
-/* UART接收缓冲区 */
-static uint8_t uart_rx_buffer[1];
-static volatile uint8_t uart_rx_flag = 0;
+/*
+ * UART接收：循环DMA（或FIFO阈值中断）+ 空闲线检测，由
+ * HAL_UARTEx_RxEventCallback()把新收到的一段数据整块写入流缓冲区。
+ * 接收缓冲区位于不可缓存的.dma_data_buffer，无需维护Cache。
+ */
+static uint8_t uart_rx_buf[SHELL_UART_RX_BUF_SIZE] __attribute__((section(".dma_data_buffer"))) __attribute__((aligned(32)));
+static uint16_t uart_rx_pos;                /* 接收缓冲区中已取走的位置 */
+static uint8_t uart_fifo_enabled = 1;       /* 使用8字节硬件FIFO */
+
+/* 控制台UART统计，中断计数在stm32h7xx_it.c中累加 */
+volatile ShellUartStats_t shell_uart_stats;
+
+/*
+ * UART发送双缓冲：写入方只把数据拷贝进填充缓冲区，DMA发送另一个缓冲区，
+ * 发送完成中断交换两者。缓冲区位于不可缓存的.dma_data_buffer，无需维护Cache。
+ */
+#define UART_TX_CHUNK               128     /* 每次临界区内最多拷贝的字节数 */
+#define UART_RX_CHUNK               64      /* shell任务每次从流缓冲区取出的最大字节数 */
+#define UART_BAUD_PROBE_MS          500     /* 协商时提示信息的重发间隔 */
+#define UART_BAUD_NEGOTIATE_FE      2       /* 协商期间帧错误达到此数立即回退 */
+
+static uint8_t uart_tx_buf[2][SHELL_UART_TX_BUF_SIZE] __attribute__((section(".dma_data_buffer"))) __attribute__((aligned(32)));
+static volatile uint16_t uart_tx_fill_len;  /* 填充缓冲区中的字节数 */
+static volatile uint8_t uart_tx_fill;       /* 正在填充的缓冲区 */
+static volatile uint8_t uart_tx_busy;       /* DMA正在发送另一个缓冲区 */
+static volatile uint8_t uart_tx_waiting;    /* 有写入方在等待空间 */
+static volatile uint8_t uart_tx_hold;       /* 正在重新初始化UART，暂不启动发送 */
+static SemaphoreHandle_t uart_tx_mutex;
+static SemaphoreHandle_t uart_tx_space;
+
+/* 波特率切换：帧错误在1秒窗口内计数，过多时由定时器任务回退到默认波特率 */
+static volatile uint32_t uart_fe_count;     /* 当前窗口内的帧错误数 */
+static volatile uint32_t uart_fe_window;    /* 窗口起点（ms） */
+static volatile uint8_t uart_baud_busy;     /* 正在协商或回退，不触发自动回退 */
 
 /* Private function prototypes -----------------------------------------------*/
+static void shell_uart_rx_start(void);
+static void shell_uart_fe_isr(void);
+
+/**
+ * @brief 启动DMA发送填充缓冲区（调用方已进入临界区）
+ */
+static void shell_uart_tx_kick(void)
+{
+    if (uart_tx_busy || uart_tx_hold || uart_tx_fill_len == 0) {
+        return;
+    }
+    
+    uint8_t index = uart_tx_fill;
+    uint16_t len = uart_tx_fill_len;
+    uart_tx_fill = index ^ 1U;
+    uart_tx_fill_len = 0;
+    uart_tx_busy = 1;
+#if SHELL_UART_USE_DMA == 1
+    HAL_StatusTypeDef status = HAL_UART_Transmit_DMA(SHELL_UART, uart_tx_buf[index], len);
+#else
+    HAL_StatusTypeDef status = HAL_UART_Transmit_IT(SHELL_UART, uart_tx_buf[index], len);
+#endif
+    if (status == HAL_OK) {
+        shell_uart_stats.tx_bytes += len;
+    } else {
+        // UART正被其他路径占用（如时钟切换后重新初始化），保留数据稍后重试
+        uart_tx_fill = index;
+        uart_tx_fill_len = len;
+        uart_tx_busy = 0;
+    }
+}
+
+/**
+ * @brief 拷贝数据到填充缓冲区（调用方已进入临界区）
+ * 
+ * @param data 数据
+ * @param len 长度
+ * 
+ * @return uint16_t 实际拷贝的字节数，缓冲区满时为0
+ */
+static uint16_t shell_uart_tx_put(const char *data, uint16_t len)
+{
+    uint16_t room = SHELL_UART_TX_BUF_SIZE - uart_tx_fill_len;
+    uint16_t n = (len < room) ? len : room;
+    
+    memcpy(&uart_tx_buf[uart_tx_fill][uart_tx_fill_len], data, n);
+    uart_tx_fill_len += n;
+    shell_uart_tx_kick();
+    return n;
+}
+
+/**
+ * @brief 发送完成或出错后切换缓冲区并唤醒等待的写入方（中断上下文）
+ */
+static void shell_uart_tx_done_isr(void)
+{
+    BaseType_t woken = pdFALSE;
+    UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+    
+    uart_tx_busy = 0;
+    shell_uart_tx_kick();
+    uint8_t wake = uart_tx_waiting;
+    uart_tx_waiting = 0;
+    taskEXIT_CRITICAL_FROM_ISR(saved);
+    
+    if (wake && uart_tx_space != NULL) {
+        xSemaphoreGiveFromISR(uart_tx_space, &woken);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+/**
+ * @brief 发送超时：中止卡住的DMA传输，避免输出永久停止
+ */
+static void shell_uart_tx_recover(void)
+{
+    if (uart_tx_busy && (SHELL_UART)->gState == HAL_UART_STATE_BUSY_TX) {
+        // 完成中断迟迟未到，丢弃正在发送的缓冲区
+        HAL_UART_AbortTransmit(SHELL_UART);
+    }
+    taskENTER_CRITICAL();
+    uart_tx_busy = 0;
+    shell_uart_tx_kick();
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief 写UART（日志drain任务、shell回显或同步回退路径调用）
+ *        任务上下文中只拷贝进DMA缓冲区，缓冲区满时阻塞等待；
+ *        中断中或调度器挂起时不阻塞，放不下的部分丢弃；
+ *        调度器启动前中断被屏蔽，直接轮询发送
+ * 
+ * @param data 数据
+ * @param len 长度
+ * 
+ * @return short 实际写入的字符长度
+ */
+short shell_uart_write(const char *data, unsigned short len)
+{
+    BaseType_t state = xTaskGetSchedulerState();
+    
+    if (uart_tx_mutex == NULL || state == taskSCHEDULER_NOT_STARTED) {
+        HAL_UART_Transmit(SHELL_UART, (uint8_t *)data, len, 0xFFFF);
+        return len;
+    }
+    
+    if (__get_IPSR() != 0U || state == taskSCHEDULER_SUSPENDED) {
+        UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+        uint16_t n = shell_uart_tx_put(data, len);
+        taskEXIT_CRITICAL_FROM_ISR(saved);
+        return (short)n;
+    }
+    
+    // 超时按一个缓冲区在当前波特率下的发送时间估算
+    TickType_t timeout = pdMS_TO_TICKS(SHELL_UART_TX_BUF_SIZE * 10U * 1000U
+                                       / (SHELL_UART)->Init.BaudRate + 100U);
+    unsigned short remaining = len;
+    
+    xSemaphoreTake(uart_tx_mutex, portMAX_DELAY);
+    while (remaining > 0) {
+        uint16_t chunk = (remaining > UART_TX_CHUNK) ? UART_TX_CHUNK : remaining;
+        
+        taskENTER_CRITICAL();
+        uint16_t n = shell_uart_tx_put(data, chunk);
+        if (n == 0) {
+            uart_tx_waiting = 1;
+        }
+        taskEXIT_CRITICAL();
+        
+        if (n == 0) {
+            if (xSemaphoreTake(uart_tx_space, timeout) != pdTRUE) {
+                shell_uart_tx_recover();
+            }
+            continue;
+        }
+        data += n;
+        remaining -= n;
+    }
+    xSemaphoreGive(uart_tx_mutex);
+    return len;
+}
+
+/**
+ * @brief 等待DMA发送缓冲区全部发出
+ * 
+ * @param timeout_ms 最长等待时间
+ * 
+ * @return int 0 发送完成，-1 超时或无法等待
+ */
+int shell_uart_flush(uint32_t timeout_ms)
+{
+    uint32_t start = HAL_GetTick();
+    
+    while (uart_tx_busy || uart_tx_fill_len != 0) {
+        if (__get_IPSR() != 0U || xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) {
+            return -1;
+        }
+        if (HAL_GetTick() - start >= timeout_ms) {
+            return -1;
+        }
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    return 0;
+}
+
+/**
+ * @brief UART发送完成回调函数
+ */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance == USART3) {
+        shell_uart_tx_done_isr();
+    }
+}
+
+/**
+ * @brief UART错误回调函数
+ */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance == USART3) {
+        uint32_t error = huart->ErrorCode;
+        
+        // DMA发送出错时HAL已结束本次传输，丢弃该缓冲区并继续发送下一个
+        if (uart_tx_busy && huart->gState == HAL_UART_STATE_READY) {
+            shell_uart_tx_done_isr();
+        }
+        if ((error & HAL_UART_ERROR_PE) != 0U) {
+            shell_uart_stats.err_pe++;
+        }
+        if ((error & HAL_UART_ERROR_NE) != 0U) {
+            shell_uart_stats.err_ne++;
+        }
+        if ((error & HAL_UART_ERROR_ORE) != 0U) {
+            shell_uart_stats.err_ore++;
+        }
+        if ((error & HAL_UART_ERROR_FE) != 0U) {
+            shell_uart_stats.err_fe++;
+            shell_uart_fe_isr();
+        }
+        // 溢出等阻塞性错误会中止DMA接收，重新启动；噪声、帧错误时接收继续
+        if (shellRxStream != NULL && huart->RxState == HAL_UART_STATE_READY) {
+            shell_uart_rx_start();
+        }
+    }
+}
+
+/**
+ * @brief 日志行输出后重新显示命令行提示符和已输入内容
+ */
+void shell_refresh_line(void)
+{
+    // 如果shell不处于活动状态（即不在执行命令）且有命令行输入
+    if (shell.status.isActive || shell.parser.length == 0) {
+        return;
+    }
+    
+    // 重新显示提示符
+    shell_uart_write("\r\n", 2);
+    shell_uart_write(shell.info.user->data.user.name, 
+                     strlen(shell.info.user->data.user.name));
+    shell_uart_write(":/$ ", 4);
+    
+    // 重新显示已输入的内容
+    shell_uart_write(shell.parser.buffer, shell.parser.length);
+}
+
+/**
+ * @brief UART日志输出端：写一行日志并重新显示命令行
+ * 
+ * @param data 日志行
+ * @param len 长度
+ */
+static void shell_uart_sink_write(const char *data, uint16_t len)
+{
+    shell_uart_write(data, len);
+    shell_refresh_line();
+}
+
+/**
+ * @brief UART日志输出端：写shell回显和提示符
+ * 
+ * @param data 数据
+ * @param len 长度
+ */
+static void shell_uart_sink_write_raw(const char *data, uint16_t len)
+{
+    shell_uart_write(data, len);
+}
+
+static ShellLogSink_t shellUartSink = {
+    .name = "uart",
+    .level = SHELL_LOG_LEVEL_DEBUG,
+    .enabled = 1,
+    .task_only = 0,
+    .at_produce = 0,
+    .write = shell_uart_sink_write,
+    .write_raw = shell_uart_sink_write_raw,
+    .flush = NULL,
+    .write_bin = NULL,
+};
 
 /**
  * @brief shell写字符串
@@ -45,33 +340,18 @@ static volatile uint8_t uart_rx_flag = 0;
  */
 short shell_write(char *data, unsigned short len)
 {
-    HAL_UART_Transmit(SHELL_UART, (uint8_t *)data, len, 0xFFFF);
-    
-    // 检查是否需要重新显示命令行提示符和已输入内容
-    // 如果是换行符或回车符，不需要重新显示
-    if (len == 1 && (data[0] == '\r' || data[0] == '\n')) {
+    // 与日志共用环形缓冲区，保证回显/提示符与日志的输出顺序
+    if (shellLogWriteRaw(data, len) == 0) {
         return len;
     }
     
-    // 检查是否是日志输出（包含换行符）
+    shell_uart_write(data, len);
+    
+    // 同步输出时，日志行之后需要重新显示命令行
     for (int i = 0; i < len; i++) {
         if (data[i] == '\r' || data[i] == '\n') {
-            // 如果shell不处于活动状态（即不在执行命令）且有命令行输入
-            if (!shell.status.isActive && shell.parser.length > 0) {
-                // 等待一小段时间，确保日志输出完成
-                for (volatile int j = 0; j < 1000; j++);
-                
-                // 重新显示提示符
-                HAL_UART_Transmit(SHELL_UART, (uint8_t *)"\r\n", 2, 0xFFFF);
-                HAL_UART_Transmit(SHELL_UART, (uint8_t *)shell.info.user->data.user.name, 
-                                 strlen(shell.info.user->data.user.name), 0xFFFF);
-                HAL_UART_Transmit(SHELL_UART, (uint8_t *)":/$ ", 4, 0xFFFF);
-                
-                // 重新显示已输入的内容
-                if (shell.parser.length > 0) {
-                    HAL_UART_Transmit(SHELL_UART, (uint8_t *)shell.parser.buffer, 
-                                     shell.parser.length, 0xFFFF);
-                }
+            if (len > 1) {
+                shell_refresh_line();
             }
             break;
         }
@@ -82,6 +362,7 @@ short shell_write(char *data, unsigned short len)
 
 /**
  * @brief shell读字符
+ *        阻塞直到收到至少一个字节，返回当前已收到的全部字节（最多len个）
  * 
  * @param data 字符缓冲区
  * @param len 读取长度
@@ -90,12 +371,7 @@ short shell_write(char *data, unsigned short len)
  */
 short shell_read(char *data, unsigned short len)
 {
-    uint8_t byte;
-    if (xQueueReceive(shellRxQueue, &byte, 0) == pdTRUE) {
-        *data = byte;
-        return 1;
-    }
-    return 0;
+    return (short)xStreamBufferReceive(shellRxStream, data, len, portMAX_DELAY);
 }
 
 /**
@@ -129,28 +405,387 @@ static int shell_unlock(Shell *shell)
 }
 
 /**
- * @brief UART接收完成回调函数
+ * @brief 启动空闲线接收（已在接收时不做任何事）
  */
-void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+static void shell_uart_rx_start(void)
 {
-    if (huart->Instance == USART3) {
-        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-        
-        // 将接收到的字符放入队列
-        BaseType_t result = xQueueSendFromISR(shellRxQueue, &uart_rx_buffer[0], &xHigherPriorityTaskWoken);
-        if (result != pdTRUE) {
-            // 队列满了，记录警告但不影响正常运行
-            // 注意：在中断中不能使用日志系统，因为它可能会阻塞
+    if ((SHELL_UART)->RxState != HAL_UART_STATE_READY) {
+        return;
+    }
+    uart_rx_pos = 0;
+#if SHELL_UART_USE_DMA == 1
+    HAL_UARTEx_ReceiveToIdle_DMA(SHELL_UART, uart_rx_buf, SHELL_UART_RX_BUF_SIZE);
+#else
+    HAL_UARTEx_ReceiveToIdle_IT(SHELL_UART, uart_rx_buf, SHELL_UART_RX_BUF_SIZE);
+#endif
+}
+
+/**
+ * @brief 设置FIFO阈值并打开或关闭FIFO（HAL_UART_Init会清除阈值）
+ *        接收3/4满（6字节）触发，发送FIFO空时一次补充8字节
+ */
+static void shell_uart_fifo_config(void)
+{
+    HAL_UARTEx_SetTxFifoThreshold(SHELL_UART, UART_TXFIFO_THRESHOLD_8_8);
+    HAL_UARTEx_SetRxFifoThreshold(SHELL_UART, UART_RXFIFO_THRESHOLD_3_4);
+    if (uart_fifo_enabled) {
+        HAL_UARTEx_EnableFifoMode(SHELL_UART);
+    } else {
+        HAL_UARTEx_DisableFifoMode(SHELL_UART);
+    }
+}
+
+/**
+ * @brief 中止并重新启动接收（UART重新初始化后调用）
+ */
+void shell_uart_rx_restart(void)
+{
+    if (shellRxStream == NULL) {
+        return;
+    }
+    HAL_UART_AbortReceive(SHELL_UART);
+    shell_uart_rx_start();
+}
+
+/**
+ * @brief 把DMA缓冲区中的一段数据写入流缓冲区（中断上下文）
+ * 
+ * @param data 数据
+ * @param len 长度
+ * @param woken 是否唤醒了更高优先级任务
+ */
+static void shell_uart_rx_push(const uint8_t *data, uint16_t len, BaseType_t *woken)
+{
+    size_t sent = xStreamBufferSendFromISR(shellRxStream, data, len, woken);
+    shell_uart_stats.rx_bytes += len;
+    if (sent < len) {
+        // 流缓冲区满，在中断中不能使用日志系统，只计数
+        shell_uart_stats.rx_dropped += len - sent;
+    }
+}
+
+/**
+ * @brief UART接收事件回调函数（DMA半满、全满或线路空闲）
+ * 
+ * @param huart UART句柄
+ * @param Size 接收缓冲区中已写入的位置
+ */
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+    if (huart->Instance != USART3 || shellRxStream == NULL) {
+        return;
+    }
+    
+    BaseType_t woken = pdFALSE;
+    
+    shell_uart_stats.rx_events++;
+    if (Size != uart_rx_pos) {
+        if (Size > uart_rx_pos) {
+            shell_uart_rx_push(&uart_rx_buf[uart_rx_pos], Size - uart_rx_pos, &woken);
+        } else {
+            // DMA已回绕：先取缓冲区尾部，再取开头
+            shell_uart_rx_push(&uart_rx_buf[uart_rx_pos],
+                               SHELL_UART_RX_BUF_SIZE - uart_rx_pos, &woken);
+            shell_uart_rx_push(uart_rx_buf, Size, &woken);
         }
-        
-        // 重新启动接收
-        HAL_StatusTypeDef status = HAL_UART_Receive_IT(SHELL_UART, uart_rx_buffer, 1);
-        if (status != HAL_OK) {
-            // UART接收重启失败，但在中断中无法记录日志
+        uart_rx_pos = Size;
+    }
+    if (uart_rx_pos >= SHELL_UART_RX_BUF_SIZE) {
+        uart_rx_pos = 0;
+    }
+    // 中断接收在空闲或缓冲区满时结束，从缓冲区开头重新接收
+    shell_uart_rx_start();
+    
+    portYIELD_FROM_ISR(woken);
+}
+
+/**
+ * @brief 计算波特率在当前内核时钟下的分频配置
+ * 
+ * @param baud 波特率
+ * @param over8 输出是否使用8倍过采样
+ * 
+ * @return uint32_t 实际波特率的误差（千分比），无法实现时为UINT32_MAX
+ */
+static uint32_t shell_uart_baud_check(uint32_t baud, uint8_t *over8)
+{
+    // USART3内核时钟为D2PCLK1，预分频为1
+    uint64_t fck = HAL_RCC_GetPCLK1Freq();
+    
+    if (baud == 0U || fck == 0U) {
+        return UINT32_MAX;
+    }
+    
+    // 先试16倍过采样（抗噪声更好），分频值太小时改用8倍过采样
+    for (uint8_t ovs = 0; ovs < 2U; ovs++) {
+        uint64_t clk = fck << ovs;      /* 8倍过采样时USARTDIV = 2 * fck / baud */
+        uint64_t div = (clk + baud / 2U) / baud;
+        if (div < 16U || div > 0xFFFFU) {
+            continue;
         }
+        uint64_t real = div * baud;
+        uint64_t diff = (real > clk) ? real - clk : clk - real;
+        uint32_t err = (uint32_t)(diff * 1000U / clk);
+        if (err <= SHELL_UART_BAUD_ERR_MAX || ovs == 1U) {
+            *over8 = ovs;
+            return err;
+        }
+    }
+    return UINT32_MAX;
+}
+
+/**
+ * @brief 按新波特率重新初始化UART并重新启动接收（任务上下文）
+ * 
+ * @param baud 波特率
+ * @param over8 是否使用8倍过采样
+ * 
+ * @return HAL_StatusTypeDef 初始化结果
+ */
+static HAL_StatusTypeDef shell_uart_reinit(uint32_t baud, uint8_t over8)
+{
+    HAL_StatusTypeDef status;
+    uint8_t locked = 0;
+    
+    // 持有发送互斥量直到重新初始化完成：其他任务（日志drain、定时器任务回退时的shell）
+    // 的写入在此等待，不会在flush之后、HAL_UART_Init期间启动新的DMA发送
+    if (uart_tx_mutex != NULL && __get_IPSR() == 0U
+        && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+        xSemaphoreTake(uart_tx_mutex, portMAX_DELAY);
+        locked = 1;
+    }
+    
+    // 正在发送的数据发完再切换，HAL_UART_Init会关闭UART
+    shell_uart_flush(100);
+    // 中断中的写入只进缓冲区，初始化完成后再发送
+    taskENTER_CRITICAL();
+    uart_tx_hold = 1;
+    taskEXIT_CRITICAL();
+    HAL_UART_AbortReceive(SHELL_UART);
+    
+    (SHELL_UART)->Init.BaudRate = baud;
+    (SHELL_UART)->Init.OverSampling = over8 ? UART_OVERSAMPLING_8 : UART_OVERSAMPLING_16;
+    status = HAL_UART_Init(SHELL_UART);
+    if (status == HAL_OK) {
+        shell_uart_fifo_config();
+    }
+    
+    taskENTER_CRITICAL();
+    uart_tx_hold = 0;
+    shell_uart_tx_kick();
+    taskEXIT_CRITICAL();
+    if (locked) {
+        xSemaphoreGive(uart_tx_mutex);
+    }
+    
+    uart_fe_count = 0;
+    uart_fe_window = HAL_GetTick();
+    if (shellRxStream != NULL) {
+        shell_uart_rx_start();
+    }
+    return status;
+}
+
+/**
+ * @brief 获取当前波特率
+ * 
+ * @return uint32_t 波特率
+ */
+uint32_t shell_uart_get_baud(void)
+{
+    return (SHELL_UART)->Init.BaudRate;
+}
+
+/**
+ * @brief 获取当前内核时钟下可用的最高波特率（8倍过采样）
+ * 
+ * @return uint32_t 波特率
+ */
+uint32_t shell_uart_max_baud(void)
+{
+    return HAL_RCC_GetPCLK1Freq() / 8U;
+}
+
+/**
+ * @brief 直接切换波特率（无握手）
+ * 
+ * @param baud 波特率
+ * 
+ * @return int 0 成功，-1 当前时钟下无法实现，-2 初始化失败
+ */
+int shell_uart_set_baud(uint32_t baud)
+{
+    uint8_t over8;
+    
+    if (shell_uart_baud_check(baud, &over8) > SHELL_UART_BAUD_ERR_MAX) {
+        return -1;
+    }
+    return (shell_uart_reinit(baud, over8) == HAL_OK) ? 0 : -2;
+}
+
+/**
+ * @brief 打开或关闭硬件FIFO（以当前波特率重新初始化UART）
+ * 
+ * @param enable 1 打开，0 关闭
+ * 
+ * @return int 0 成功，其他同shell_uart_set_baud()
+ */
+int shell_uart_set_fifo(uint8_t enable)
+{
+    uart_fifo_enabled = enable ? 1U : 0U;
+    return shell_uart_set_baud((SHELL_UART)->Init.BaudRate);
+}
+
+/**
+ * @brief 硬件FIFO是否打开
+ * 
+ * @return uint8_t 1 打开，0 关闭
+ */
+uint8_t shell_uart_get_fifo(void)
+{
+    return uart_fifo_enabled;
+}
+
+/**
+ * @brief 清零控制台UART统计
+ */
+void shell_uart_stats_reset(void)
+{
+    taskENTER_CRITICAL();
+    memset((void *)&shell_uart_stats, 0, sizeof(shell_uart_stats));
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief 系统时钟切换后按新的内核时钟重新初始化UART
+ *        当前波特率无法实现时回退到默认波特率
+ * 
+ * @return HAL_StatusTypeDef 初始化结果
+ */
+HAL_StatusTypeDef shell_uart_apply_clock(void)
+{
+    uint32_t baud = (SHELL_UART)->Init.BaudRate;
+    uint8_t over8 = 0;
+    
+    if (shell_uart_baud_check(baud, &over8) > SHELL_UART_BAUD_ERR_MAX) {
+        baud = SHELL_UART_DEFAULT_BAUD;
+        if (shell_uart_baud_check(baud, &over8) > SHELL_UART_BAUD_ERR_MAX) {
+            over8 = 0;      /* 极低主频下默认波特率也不准确，照常初始化 */
+        }
+    }
+    return shell_uart_reinit(baud, over8);
+}
+
+/**
+ * @brief 带握手的波特率切换（shell任务中调用）
+ *        先以旧波特率发出切换通知，切换后以新波特率周期发送提示，
+ *        收到无帧错误的回车即确认；超时或出现帧错误时回到旧波特率
+ * 
+ * @param baud 目标波特率
+ * @param timeout_ms 等待确认的时间
+ * 
+ * @return int 0 已确认，-1 当前时钟下无法实现，-2 初始化失败，
+ *             -3 超时未确认，-4 帧错误
+ */
+int shell_uart_negotiate_baud(uint32_t baud, uint32_t timeout_ms)
+{
+    uint32_t old = (SHELL_UART)->Init.BaudRate;
+    uint8_t over8, old_over8 = 0;
+    char msg[64];
+    int result = -3;
+    int n;
+    
+    if (shell_uart_baud_check(baud, &over8) > SHELL_UART_BAUD_ERR_MAX) {
+        return -1;
+    }
+    shell_uart_baud_check(old, &old_over8);
+    
+    uart_baud_busy = 1;
+    
+    // 通知以旧波特率发出，前面排队的日志先输出完
+    n = shellFmtSnprintf(msg, sizeof(msg), "\r\nbaud: switching to %lu\r\n", (unsigned long)baud);
+    shellLogFlush(100);
+    shell_uart_write(msg, (unsigned short)n);
+    
+    if (shell_uart_reinit(baud, over8) != HAL_OK) {
+        result = -2;
+    } else {
+        uint32_t start = HAL_GetTick();
+        uint32_t probe = start - UART_BAUD_PROBE_MS;
         
-        // 如果有更高优先级任务被唤醒，进行任务切换
-        portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+        // 丢弃切换过程中收到的乱码
+        xStreamBufferReset(shellRxStream);
+        n = shellFmtSnprintf(msg, sizeof(msg), "\r\nbaud: %lu, press Enter to confirm\r\n",
+                             (unsigned long)baud);
+        while (HAL_GetTick() - start < timeout_ms) {
+            char c;
+            
+            if (uart_fe_count >= UART_BAUD_NEGOTIATE_FE) {
+                result = -4;
+                break;
+            }
+            if (HAL_GetTick() - probe >= UART_BAUD_PROBE_MS) {
+                probe = HAL_GetTick();
+                shell_uart_write(msg, (unsigned short)n);
+            }
+            if (xStreamBufferReceive(shellRxStream, &c, 1, pdMS_TO_TICKS(50)) == 1
+                && (c == '\r' || c == '\n') && uart_fe_count == 0U) {
+                result = 0;
+                break;
+            }
+        }
+    }
+    
+    if (result == 0) {
+        n = shellFmtSnprintf(msg, sizeof(msg), "baud: %lu confirmed\r\n", (unsigned long)baud);
+        shell_uart_write(msg, (unsigned short)n);
+    } else {
+        shell_uart_reinit(old, old_over8);
+        xStreamBufferReset(shellRxStream);
+    }
+    
+    uart_baud_busy = 0;
+    return result;
+}
+
+/**
+ * @brief 帧错误过多时回退到默认波特率（定时器任务中执行）
+ */
+static void shell_uart_fallback(void *param1, uint32_t param2)
+{
+    uint32_t baud = (SHELL_UART)->Init.BaudRate;
+    
+    (void)param1;
+    (void)param2;
+    if (shell_uart_set_baud(SHELL_UART_DEFAULT_BAUD) == 0) {
+        // 定时器任务栈很小，使用延迟格式化的日志
+        SHELL_LOG_DEFER_WARNING(SHELL_LOG_MODULE_UART, "Framing errors at %lu baud, fell back to %lu",
+                                baud, (uint32_t)SHELL_UART_DEFAULT_BAUD);
+    }
+    uart_baud_busy = 0;
+}
+
+/**
+ * @brief 统计帧错误，1秒内过多时请求回退（中断上下文）
+ */
+static void shell_uart_fe_isr(void)
+{
+    uint32_t now = HAL_GetTick();
+    
+    if (now - uart_fe_window >= 1000U) {
+        uart_fe_window = now;
+        uart_fe_count = 0;
+    }
+    uart_fe_count++;
+    
+    if (uart_fe_count >= SHELL_UART_FE_FALLBACK && !uart_baud_busy
+        && (SHELL_UART)->Init.BaudRate != SHELL_UART_DEFAULT_BAUD) {
+        BaseType_t woken = pdFALSE;
+        uart_baud_busy = 1;
+        if (xTimerPendFunctionCallFromISR(shell_uart_fallback, NULL, 0, &woken) != pdPASS) {
+            uart_baud_busy = 0;
+        }
+        portYIELD_FROM_ISR(woken);
     }
 }
 
@@ -167,12 +802,16 @@ static void shell_task_function(void *argument)
     SHELL_LOG_SYS_INFO("Shell version: %s", SHELL_VERSION);
     SHELL_LOG_SYS_INFO("Type 'help' to see available commands");
     
-    // 启动UART中断接收
-    HAL_UART_Receive_IT(SHELL_UART, uart_rx_buffer, 1);
+    // 启动UART循环DMA接收
+    shell_uart_rx_start();
     
+    // 无输入时阻塞在流缓冲区上，不占用CPU，也不打断tickless空闲
     while (1) {
-        shellTask(shell);
-        vTaskDelay(pdMS_TO_TICKS(1));
+        char rx[UART_RX_CHUNK];
+        short n = shell->read(rx, sizeof(rx));
+        for (short i = 0; i < n; i++) {
+            shellHandler(shell, rx[i]);
+        }
     }
 }
 
@@ -187,12 +826,21 @@ void shell_init(void)
         return;
     }
     
-    // 创建接收队列
-    shellRxQueue = xQueueCreate(SHELL_RX_QUEUE_SIZE, sizeof(uint8_t));
-    if (shellRxQueue == NULL) {
+    // 创建接收流缓冲区，单写（UART中断）单读（shell任务）
+    shellRxStream = xStreamBufferCreate(SHELL_RX_STREAM_SIZE, 1);
+    if (shellRxStream == NULL) {
         return;
     }
     
+    // MX_USART3_UART_Init()关闭了FIFO，按shell的阈值重新配置
+    shell_uart_fifo_config();
+    
+    // DMA发送：写入互斥锁和"有空间"通知；创建失败时退回轮询发送
+    uart_tx_space = xSemaphoreCreateBinary();
+    if (uart_tx_space != NULL) {
+        uart_tx_mutex = xSemaphoreCreateMutex();
+    }
+    
     // 配置shell
     shell.write = shell_write;
     shell.read = shell_read;
@@ -202,6 +850,10 @@ void shell_init(void)
     // 初始化shell核心
     shellInit(&shell, shellBuffer, SHELL_BUFFER_SIZE);
     
+    // 注册日志输出端：UART控制台、RAM崩溃缓冲区、SD卡日志文件
+    shellLogAddSink(&shellUartSink);
+    shellLogSinkInit();
+    
     // 创建shell任务
     BaseType_t result = xTaskCreate(
         shell_task_function,
@@ -215,6 +867,10 @@ void shell_init(void)
     if (result != pdPASS) {
         return;
     }
+    
+    // 创建日志输出任务，此后日志和shell输出都由它写UART
+    shellLogSetConsoleTask(shellTaskHandle);
+    shellLogStartDrain();
 }
 
 /**
@@ -224,7 +880,7 @@ void shell_init_log_output(void)
 {
     SHELL_LOG_SYS_INFO("Shell system initialized successfully");
     SHELL_LOG_SYS_DEBUG("Shell mutex created successfully");
-    SHELL_LOG_SYS_DEBUG("Shell RX queue created successfully (size: %d)", SHELL_RX_QUEUE_SIZE);
+    SHELL_LOG_SYS_DEBUG("Shell RX stream buffer created successfully (size: %d)", SHELL_RX_STREAM_SIZE);
     SHELL_LOG_SYS_DEBUG("Shell core initialized (buffer size: %d)", SHELL_BUFFER_SIZE);
 }
 
@@ -243,7 +899,7 @@ void shell_task_create(void)
  */
 uint8_t* shell_get_rx_buffer(void)
 {
-    return uart_rx_buffer;
+    return uart_rx_buf;
 }
 
 /**
@@ -261,7 +917,7 @@ void shell_printf(const char *fmt, ...)
         va_start(args, fmt);
         // 使用日志系统替代直接的shellPrint
         char buffer[256];
-        vsnprintf(buffer, sizeof(buffer), fmt, args);
+        shellFmtVsnprintf(buffer, sizeof(buffer), fmt, args);
         SHELL_LOG_USER_INFO("%s", buffer);
         va_end(args);
         
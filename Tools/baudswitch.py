@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Switch the shell console to a higher baud rate and confirm the handshake.
+
+The firmware `baud <rate>` command announces the switch at the old rate,
+reinitialises USART3 and then prints a prompt at the new rate every 500 ms
+until it receives Enter. Without a confirmation, or on framing errors, it
+goes back to the old rate. This script performs the host side:
+
+    baudswitch.py COM5 2000000                 # from the default 115200
+    baudswitch.py /dev/ttyUSB0 921600 --from 2000000
+
+Afterwards reopen the terminal program at the new rate.
+"""
+
+import argparse
+import sys
+import time
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port", help="serial port")
+    parser.add_argument("baud", type=int, help="target baud rate")
+    parser.add_argument("--from", dest="old", type=int, default=115200,
+                        help="current baud rate (default 115200)")
+    parser.add_argument("--timeout", type=float, default=5.0,
+                        help="seconds to wait for each step")
+    args = parser.parse_args()
+
+    try:
+        import serial
+    except ImportError:
+        sys.exit("pyserial is required (pip install pyserial)")
+
+    ser = serial.Serial(args.port, args.old, timeout=0.1)
+    ser.reset_input_buffer()
+    ser.write(b"baud %d %d\r" % (args.baud, int(args.timeout * 1000)))
+
+    # Announcement still comes at the old rate
+    deadline = time.monotonic() + args.timeout
+    seen = bytearray()
+    while b"baud: switching" not in seen:
+        if time.monotonic() > deadline:
+            sys.exit("no switch announcement at %d baud:\n%s"
+                     % (args.old, seen.decode("utf-8", "replace")))
+        seen += ser.read(256)
+    time.sleep(0.05)
+
+    ser.baudrate = args.baud
+    ser.reset_input_buffer()
+
+    # Answer each prompt at the new rate with Enter
+    deadline = time.monotonic() + args.timeout
+    seen = bytearray()
+    while b"confirmed" not in seen:
+        if time.monotonic() > deadline:
+            sys.exit("no confirmation at %d baud, the device falls back to %d"
+                     % (args.baud, args.old))
+        chunk = ser.read(256)
+        seen += chunk
+        if b"press Enter" in chunk:
+            ser.write(b"\r")
+    ser.close()
+    print("console now at %d baud" % args.baud)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,239 @@
+#!/usr/bin/env python3
+"""Decode the binary log stream of the USB vendor interface.
+
+The firmware (USB_DEVICE/App/usbd_log_if.c) sends ShellLogBinHeader_t frames
+on bulk IN endpoint 0x82 of interface 1:
+
+    uint16 sync (0xA55A), uint8 type, uint8 level, uint8 module, uint8 reserved,
+    uint16 len, uint32 seq, uint64 time_us, payload[len]      (little endian)
+
+TEXT frames (type 1) carry a formatted line. DEFER frames (type 2) carry the
+address of the format string followed by the raw 32-bit arguments; pass the
+firmware ELF with --elf to turn them back into text.
+
+Examples:
+    logdecode.py --elf Debug/swcode.elf                 # live from USB (pyusb)
+    logdecode.py --elf Debug/swcode.elf --save raw.bin  # live, keep a capture
+    logdecode.py --elf Debug/swcode.elf --file raw.bin  # decode a capture
+
+On Windows bind interface 1 (MI_01) to WinUSB first, e.g. with Zadig; the
+mass storage interface keeps its normal driver.
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+SYNC = 0xA55A
+HEADER = struct.Struct("<HBBBBHIQ")
+TYPE_TEXT = 1
+TYPE_DEFER = 2
+
+LEVELS = ["DEBUG", "INFO", "WARN", "ERROR"]
+MODULES = ["SYS", "CLK", "MEM", "TASK", "UART", "FATFS", "USER"]
+
+CONVERSION = re.compile(r"%([-+ #0]*)(\d+|\*)?(?:\.(\d+|\*))?(hh|h|ll|l|z|t|j)?([diouxXcsp%])")
+ANSI = re.compile(r"\x1b\[[0-9;]*[A-Za-z]")
+
+
+class Elf:
+    """Reads NUL terminated strings from the loadable sections of the ELF."""
+
+    def __init__(self, path):
+        try:
+            from elftools.elf.elffile import ELFFile
+        except ImportError:
+            sys.exit("pyelftools is required for --elf (pip install pyelftools)")
+        self.segments = []
+        with open(path, "rb") as f:
+            elf = ELFFile(f)
+            for section in elf.iter_sections():
+                addr = section["sh_addr"]
+                if addr and section["sh_type"] == "SHT_PROGBITS":
+                    self.segments.append((addr, section.data()))
+
+    def string(self, addr):
+        for base, data in self.segments:
+            if base <= addr < base + len(data):
+                end = data.find(b"\0", addr - base)
+                if end < 0:
+                    end = len(data)
+                return data[addr - base:end].decode("utf-8", "replace")
+        return None
+
+
+def format_c(fmt, args, elf):
+    """Apply a C format string to 32-bit arguments like shellLogFormatArgs()."""
+    out = []
+    pos = 0
+    argi = 0
+
+    def next_arg():
+        nonlocal argi
+        value = args[argi] if argi < len(args) else 0
+        argi += 1
+        return value
+
+    for m in CONVERSION.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, prec, length, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        if width == "*":
+            width = str(struct.unpack("<i", struct.pack("<I", next_arg()))[0])
+        if prec == "*":
+            prec = str(next_arg())
+        if length == "ll":
+            out.append("<64-bit arg>")
+            next_arg()
+            continue
+        spec = "%" + flags + (width or "") + ("." + prec if prec is not None else "")
+        value = next_arg()
+        if conv in "di":
+            if length == "hh":
+                value = struct.unpack("<b", struct.pack("<B", value & 0xFF))[0]
+            elif length == "h":
+                value = struct.unpack("<h", struct.pack("<H", value & 0xFFFF))[0]
+            else:
+                value = struct.unpack("<i", struct.pack("<I", value))[0]
+            out.append((spec + "d") % value)
+        elif conv in "ouxX":
+            if length == "hh":
+                value &= 0xFF
+            elif length == "h":
+                value &= 0xFFFF
+            out.append((spec + (conv if conv != "u" else "d")) % value)
+        elif conv == "c":
+            out.append((spec + "c") % chr(value & 0xFF))
+        elif conv == "p":
+            out.append((spec + "s") % ("0x%x" % value))
+        elif conv == "s":
+            text = elf.string(value) if elf else None
+            out.append((spec + "s") % (text if text is not None else "<str@0x%08x>" % value))
+    out.append(fmt[pos:])
+    return "".join(out)
+
+
+def decode_defer(level, module, time_us, payload, elf, color):
+    words = struct.unpack("<%dI" % (len(payload) // 4), payload[:len(payload) // 4 * 4])
+    fmt_addr, args = words[0], list(words[1:])
+    fmt = elf.string(fmt_addr) if elf else None
+    if fmt is None:
+        message = "fmt@0x%08x %s" % (fmt_addr, " ".join("0x%08x" % a for a in args))
+    else:
+        message = format_c(fmt, args, elf)
+    level_name = LEVELS[level] if level < len(LEVELS) else str(level)
+    module_name = MODULES[module] if module < len(MODULES) else str(module)
+    line = "[%d.%06d] [%s:%s] %s" % (time_us // 1000000, time_us % 1000000,
+                                     level_name, module_name, message)
+    return line if color else ANSI.sub("", line)
+
+
+class Decoder:
+    def __init__(self, elf, color):
+        self.elf = elf
+        self.color = color
+        self.buf = bytearray()
+        self.seq = None
+        self.lost = 0
+
+    def feed(self, data):
+        self.buf += data
+        lines = []
+        while True:
+            start = self.buf.find(struct.pack("<H", SYNC))
+            if start < 0:
+                del self.buf[:max(0, len(self.buf) - 1)]
+                break
+            if start:
+                del self.buf[:start]
+            if len(self.buf) < HEADER.size:
+                break
+            sync, ftype, level, module, _, length, seq, time_us = HEADER.unpack_from(self.buf)
+            if ftype not in (TYPE_TEXT, TYPE_DEFER):
+                del self.buf[:2]
+                continue
+            if len(self.buf) < HEADER.size + length:
+                break
+            payload = bytes(self.buf[HEADER.size:HEADER.size + length])
+            del self.buf[:HEADER.size + length]
+
+            if self.seq is not None and seq != (self.seq + 1) & 0xFFFFFFFF:
+                missed = (seq - self.seq - 1) & 0xFFFFFFFF
+                self.lost += missed
+                lines.append("[logdecode] %d frame(s) lost" % missed)
+            self.seq = seq
+
+            if ftype == TYPE_TEXT:
+                text = payload.decode("utf-8", "replace").rstrip("\r\n")
+                lines.append(text if self.color else ANSI.sub("", text))
+            else:
+                lines.append(decode_defer(level, module, time_us, payload, self.elf, self.color))
+        return lines
+
+
+def usb_reader(vid, pid):
+    try:
+        import usb.core
+        import usb.util
+    except ImportError:
+        sys.exit("pyusb is required for live capture (pip install pyusb)")
+    dev = usb.core.find(idVendor=vid, idProduct=pid)
+    if dev is None:
+        sys.exit("device %04x:%04x not found" % (vid, pid))
+    try:
+        if dev.is_kernel_driver_active(1):
+            dev.detach_kernel_driver(1)
+    except (NotImplementedError, usb.core.USBError):
+        pass
+    usb.util.claim_interface(dev, 1)
+    while True:
+        try:
+            yield bytes(dev.read(0x82, 16384, timeout=1000))
+        except usb.core.USBTimeoutError:
+            continue
+
+
+def file_reader(path):
+    with open(path, "rb") as f:
+        while True:
+            chunk = f.read(65536)
+            if not chunk:
+                break
+            yield chunk
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--elf", help="firmware ELF used to resolve deferred format strings")
+    parser.add_argument("--file", help="decode a raw capture instead of reading USB")
+    parser.add_argument("--save", help="also write the raw stream to this file")
+    parser.add_argument("--vid", type=lambda v: int(v, 0), default=0x0483)
+    parser.add_argument("--pid", type=lambda v: int(v, 0), default=0x572A)
+    parser.add_argument("--no-color", action="store_true", help="strip ANSI color codes")
+    args = parser.parse_args()
+
+    elf = Elf(args.elf) if args.elf else None
+    decoder = Decoder(elf, not args.no_color)
+    source = file_reader(args.file) if args.file else usb_reader(args.vid, args.pid)
+    save = open(args.save, "wb") if args.save else None
+    try:
+        for chunk in source:
+            if save:
+                save.write(chunk)
+            for line in decoder.feed(chunk):
+                print(line, flush=True)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if save:
+            save.close()
+    if decoder.lost:
+        print("[logdecode] %d frame(s) lost in total" % decoder.lost, file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
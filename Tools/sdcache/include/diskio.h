@@ -0,0 +1,23 @@
+/**
+ * @file diskio.h
+ * @brief Host stand-in for the FatFs disk I/O types used by sd_cache.c
+ */
+
+#ifndef _DISKIO_DEFINED
+#define _DISKIO_DEFINED
+
+#include <stdint.h>
+
+typedef unsigned char BYTE;
+typedef unsigned int UINT;
+typedef uint32_t DWORD;
+
+typedef enum {
+    RES_OK = 0,
+    RES_ERROR,
+    RES_WRPRT,
+    RES_NOTRDY,
+    RES_PARERR
+} DRESULT;
+
+#endif /* _DISKIO_DEFINED */
@@ -0,0 +1,427 @@
+/**
+ * @file sdcachesim.c
+ * @brief Replay of disk access traces through the SD sector cache on the host
+ *        FATFS/Target/sd_cache.c is compiled unchanged on top of a RAM disk.
+ *        Each trace runs twice, with the cache disabled and enabled, and the
+ *        lower layer calls (SD commands on the target) are counted. Every read
+ *        is checked against a reference image that takes the writes directly,
+ *        and after the final clean the RAM disk must equal that image.
+ *
+ *        With -p N every Nth lower layer call of a task is interrupted by the
+ *        next USB operations of the trace, like the OTG_HS interrupt preempting
+ *        a task during its SD transfer: before the data reaches the card for
+ *        writes, after it was read for reads. USB writes may overlap the
+ *        sectors a task is reading or writing back, but not the sectors of a
+ *        task write in progress (either order would be correct there).
+ *
+ *        sdcachesim [-p N] [-v] trace ...
+ *
+ *        Trace lines, '#' starts a comment:
+ *          R <sector> [count]    read from a task
+ *          W <sector> [count]    write from a task
+ *          r / w                 the same from the USB interrupt
+ *          S                     CTRL_SYNC
+ *          I <ms>                idle time, dirty lines are written back
+ *                                after SIM_IDLE_MS like the SDWrite task does
+ */
+
+#include "sd_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SIM_LINE_MAX            128
+#define SIM_IDLE_MS             500U    /* SD_CACHE_IDLE_MS in user_diskio.c */
+#define SIM_COUNT_MAX           128U
+#define SIM_PREEMPT_LOOKAHEAD   16U
+#define SIM_PREEMPT_BURST       4U      /* USB operations per interruption */
+
+typedef struct {
+    char op;
+    DWORD sector;
+    UINT count;
+    uint8_t done;       /* Already run as a preemption */
+} SimOp;
+
+typedef struct {
+    uint32_t reads;
+    uint32_t read_sectors;
+    uint32_t writes;
+    uint32_t write_sectors;
+} SimCounters;
+
+static uint8_t *sim_disk;       /* Card contents */
+static uint8_t *sim_ref;        /* Reference image, written directly */
+static DWORD sim_sectors;
+static SimCounters sim_lower;
+static uint32_t sim_errors;
+static uint8_t sim_verbose;
+static uint8_t sim_store[SD_CACHE_LINES * SD_CACHE_SECTOR_SIZE];
+
+/* 抢占模拟 */
+static uint32_t sim_preempt_every;
+static uint32_t sim_preempt_calls;
+static uint32_t sim_preempted;
+static SimOp *sim_ops;
+static size_t sim_op_count;
+static size_t sim_op_next;          /* First operation not yet run */
+static const SimOp *sim_task_op;    /* Task operation in progress */
+static uint8_t sim_task_overlap;    /* A USB write hit the sectors of the task read */
+static uint32_t sim_serial;
+static uint32_t sim_mismatches;
+
+static void simPreempt(uint8_t ctx);
+
+static DRESULT simLowerRead(uint8_t ctx, BYTE *buff, DWORD sector, UINT count)
+{
+    if (sector + count > sim_sectors) {
+        return RES_PARERR;
+    }
+    memcpy(buff, &sim_disk[(size_t)sector * SD_CACHE_SECTOR_SIZE], (size_t)count * SD_CACHE_SECTOR_SIZE);
+    sim_lower.reads++;
+    sim_lower.read_sectors += count;
+    simPreempt(ctx);
+    return RES_OK;
+}
+
+static DRESULT simLowerWrite(uint8_t ctx, const BYTE *buff, DWORD sector, UINT count)
+{
+    if (sector + count > sim_sectors) {
+        return RES_PARERR;
+    }
+    simPreempt(ctx);
+    memcpy(&sim_disk[(size_t)sector * SD_CACHE_SECTOR_SIZE], buff, (size_t)count * SD_CACHE_SECTOR_SIZE);
+    sim_lower.writes++;
+    sim_lower.write_sectors += count;
+    return RES_OK;
+}
+
+/* 单线程回放，中断上下文只在simPreempt()处打断任务，锁为空 */
+static const SD_CacheOps_t sim_cache_ops = {
+    .read = simLowerRead,
+    .write = simLowerWrite,
+    .lock = NULL,
+    .unlock = NULL,
+    .dirtied = NULL,
+};
+
+/**
+ * @brief Fill a sector with data unique to this write
+ * @param buf Sector buffer
+ * @param sector Sector number
+ * @param serial Write number
+ */
+static void simPattern(uint8_t *buf, DWORD sector, uint32_t serial)
+{
+    for (uint32_t i = 0; i < SD_CACHE_SECTOR_SIZE; i += 8) {
+        memcpy(&buf[i], &sector, 4);
+        memcpy(&buf[i + 4], &serial, 4);
+    }
+}
+
+/**
+ * @brief Load a trace
+ * @param path Trace file
+ * @param count Output number of operations
+ * @return Operations (malloc), NULL on error
+ */
+static SimOp* simLoad(const char *path, size_t *count)
+{
+    char line[SIM_LINE_MAX];
+    size_t cap = 256;
+    size_t n = 0;
+    SimOp *ops = malloc(cap * sizeof(*ops));
+    FILE *f = fopen(path, "r");
+    unsigned lineno = 0;
+
+    if (f == NULL || ops == NULL) {
+        perror(path);
+        free(ops);
+        if (f) fclose(f);
+        return NULL;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        char op;
+        unsigned long a = 0;
+        unsigned long b = 1;
+        int fields;
+
+        lineno++;
+        line[strcspn(line, "#\r\n")] = '\0';
+        fields = sscanf(line, " %c %lu %lu", &op, &a, &b);
+        if (fields <= 0) {
+            continue;
+        }
+        if (strchr("RWrwSI", op) == NULL || (strchr("RWrwI", op) && fields < 2)
+            || b == 0 || b > SIM_COUNT_MAX) {
+            fprintf(stderr, "%s:%u: bad line\n", path, lineno);
+            free(ops);
+            fclose(f);
+            return NULL;
+        }
+        if (n == cap) {
+            cap *= 2;
+            ops = realloc(ops, cap * sizeof(*ops));
+            if (ops == NULL) {
+                fclose(f);
+                return NULL;
+            }
+        }
+        ops[n].op = op;
+        ops[n].sector = (DWORD)a;
+        ops[n].count = (op == 'S' || op == 'I') ? 0U : (UINT)b;
+        n++;
+    }
+    fclose(f);
+    *count = n;
+    return ops;
+}
+
+/**
+ * @brief Check whether two sector ranges overlap
+ */
+static int simOverlap(const SimOp *a, const SimOp *b)
+{
+    return a->count && b->count && a->sector < b->sector + b->count && b->sector < a->sector + a->count;
+}
+
+/**
+ * @brief Run one operation of the trace
+ * @param i Operation index
+ */
+static void simExec(size_t i)
+{
+    static uint8_t buf[2][SIM_COUNT_MAX * SD_CACHE_SECTOR_SIZE];
+    SimOp *op = &sim_ops[i];
+    uint8_t ctx = (op->op == 'r' || op->op == 'w') ? SD_CACHE_CTX_POLL : SD_CACHE_CTX_TASK;
+    uint8_t *data = buf[ctx];
+    size_t off = (size_t)op->sector * SD_CACHE_SECTOR_SIZE;
+    size_t len = (size_t)op->count * SD_CACHE_SECTOR_SIZE;
+    DRESULT res = RES_OK;
+
+    op->done = 1;
+    if (ctx == SD_CACHE_CTX_TASK) {
+        sim_task_op = op;
+        sim_task_overlap = 0;
+    }
+    switch (op->op) {
+    case 'R':
+    case 'r':
+        res = SD_CacheRead(ctx, data, op->sector, op->count);
+        /* 读取期间被重叠的USB写入打断，新旧数据都正确 */
+        if (res == RES_OK && !(ctx == SD_CACHE_CTX_TASK && sim_task_overlap)
+            && memcmp(data, &sim_ref[off], len) != 0) {
+            if (sim_verbose) {
+                printf("  stale read of %lu+%u at op %zu\n", (unsigned long)op->sector, op->count, i + 1);
+            }
+            sim_mismatches++;
+        }
+        break;
+    case 'W':
+    case 'w':
+        for (UINT s = 0; s < op->count; s++) {
+            simPattern(&data[s * SD_CACHE_SECTOR_SIZE], op->sector + s, ++sim_serial);
+        }
+        memcpy(&sim_ref[off], data, len);
+        res = SD_CacheWrite(ctx, data, op->sector, op->count);
+        break;
+    case 'S':
+        res = SD_CacheClean(SD_CACHE_CTX_TASK);
+        break;
+    case 'I':
+        if (op->sector >= SIM_IDLE_MS) {
+            res = SD_CacheClean(SD_CACHE_CTX_TASK);
+        }
+        break;
+    }
+    if (res != RES_OK) {
+        sim_errors++;
+    }
+    if (ctx == SD_CACHE_CTX_TASK) {
+        sim_task_op = NULL;
+    }
+}
+
+/**
+ * @brief Interrupt a task lower layer call with the next USB operations
+ * @param ctx Context of the lower layer call
+ */
+static void simPreempt(uint8_t ctx)
+{
+    const SimOp *task = sim_task_op;
+    uint32_t burst = 0;
+
+    if (!sim_preempt_every || ctx != SD_CACHE_CTX_TASK || task == NULL
+        || ++sim_preempt_calls % sim_preempt_every != 0) {
+        return;
+    }
+    for (size_t i = sim_op_next + 1; i < sim_op_count && i <= sim_op_next + SIM_PREEMPT_LOOKAHEAD; i++) {
+        SimOp *op = &sim_ops[i];
+
+        if (op->done || (op->op != 'r' && op->op != 'w')) {
+            continue;
+        }
+        /* 任务自己的写入进行中，重叠的USB访问先后都对，不模拟 */
+        if (task->op == 'W' && simOverlap(op, task)) {
+            continue;
+        }
+        if (op->op == 'w' && task->op == 'R' && simOverlap(op, task)) {
+            sim_task_overlap = 1;
+        }
+        sim_preempted++;
+        simExec(i);
+        if (++burst == SIM_PREEMPT_BURST) {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Replay a trace once
+ * @param cached 1 with the cache enabled
+ * @param stats Output cache statistics
+ * @return Number of data mismatches
+ */
+static uint32_t simRun(uint8_t cached, SD_CacheStats_t *stats)
+{
+    size_t bytes = (size_t)sim_sectors * SD_CACHE_SECTOR_SIZE;
+
+    memset(sim_disk, 0, bytes);
+    memset(sim_ref, 0, bytes);
+    memset(&sim_lower, 0, sizeof(sim_lower));
+    for (size_t i = 0; i < sim_op_count; i++) {
+        sim_ops[i].done = 0;
+    }
+    sim_serial = 0;
+    sim_mismatches = 0;
+    sim_preempt_calls = 0;
+    sim_preempted = 0;
+    SD_CacheInit(&sim_cache_ops, sim_store);
+    if (cached) {
+        SD_CacheSetEnabled(SD_CACHE_CTX_TASK, 1U);
+    }
+
+    for (sim_op_next = 0; sim_op_next < sim_op_count; sim_op_next++) {
+        if (!sim_ops[sim_op_next].done) {
+            simExec(sim_op_next);
+        }
+    }
+
+    SD_CacheGetStats(stats);
+    if (SD_CacheClean(SD_CACHE_CTX_TASK) != RES_OK || memcmp(sim_disk, sim_ref, bytes) != 0) {
+        printf("  final image differs from the reference\n");
+        sim_mismatches++;
+    }
+    return sim_mismatches;
+}
+
+/**
+ * @brief Print the lower layer counters of one run
+ * @param label Row label
+ * @param c Counters
+ */
+static void simPrintLower(const char *label, const SimCounters *c)
+{
+    printf("  %-9s %7u commands: %6u reads (%7u sectors), %6u writes (%7u sectors)\n",
+           label, c->reads + c->writes, c->reads, c->read_sectors, c->writes, c->write_sectors);
+}
+
+/**
+ * @brief Replay a trace uncached and cached and compare
+ * @param path Trace file
+ * @return 0 if both runs returned correct data
+ */
+static int simTrace(const char *path)
+{
+    size_t count = 0;
+    SimOp *ops = simLoad(path, &count);
+    SimCounters plain;
+    SD_CacheStats_t stats;
+    uint32_t mismatches;
+    DWORD end = 0;
+
+    if (ops == NULL) {
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (ops[i].count && ops[i].sector + ops[i].count > end) {
+            end = ops[i].sector + ops[i].count;
+        }
+    }
+    sim_sectors = end ? end : 1;
+    sim_disk = malloc((size_t)sim_sectors * SD_CACHE_SECTOR_SIZE);
+    sim_ref = malloc((size_t)sim_sectors * SD_CACHE_SECTOR_SIZE);
+    if (sim_disk == NULL || sim_ref == NULL) {
+        fprintf(stderr, "out of memory for %lu sectors\n", (unsigned long)sim_sectors);
+        free(ops);
+        free(sim_disk);
+        free(sim_ref);
+        return -1;
+    }
+
+    printf("\n%s: %zu operations, %lu sectors\n", path, count, (unsigned long)sim_sectors);
+    sim_ops = ops;
+    sim_op_count = count;
+    mismatches = simRun(0, &stats);
+    plain = sim_lower;
+    mismatches += simRun(1, &stats);
+
+    simPrintLower("uncached", &plain);
+    simPrintLower("cached", &sim_lower);
+    uint32_t before = plain.reads + plain.writes;
+    uint32_t after = sim_lower.reads + sim_lower.writes;
+    uint32_t lookups = stats.hits + stats.misses;
+    printf("  commands  %7.1f%% fewer\n", before ? 100.0 * (before - (double)after) / before : 0.0);
+    printf("  cache     %u hits, %u misses (%.1f%%), %u bypassed, %u write hits, %u write allocs\n",
+           stats.hits, stats.misses, lookups ? 100.0 * stats.hits / lookups : 0.0,
+           stats.bypassed, stats.write_hits, stats.write_allocs);
+    printf("            %u evictions, %u write-backs, %u dirty before the final clean\n",
+           stats.evictions, stats.writebacks, stats.dirty);
+    if (sim_preempt_every) {
+        printf("  preempted %u task calls by USB operations\n", sim_preempted);
+    }
+    printf("  data      %s\n", mismatches ? "MISMATCH" : "ok");
+
+    free(ops);
+    free(sim_disk);
+    free(sim_ref);
+    return mismatches ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    int ret = 0;
+
+    while ((opt = getopt(argc, argv, "p:v")) != -1) {
+        switch (opt) {
+        case 'p':
+            sim_preempt_every = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'v':
+            sim_verbose = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-p N] [-v] trace ...\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind == argc) {
+        fprintf(stderr, "usage: %s [-p N] [-v] trace ...\n", argv[0]);
+        return 2;
+    }
+
+    printf("SD sector cache: %u sets x %u ways, %u KB\n",
+           SD_CACHE_SETS, SD_CACHE_WAYS, SD_CACHE_LINES * SD_CACHE_SECTOR_SIZE / 1024U);
+    for (int i = optind; i < argc; i++) {
+        if (simTrace(argv[i]) != 0) {
+            ret = 1;
+        }
+    }
+    if (sim_errors) {
+        printf("\n%u operations failed\n", sim_errors);
+        ret = 1;
+    }
+    return ret;
+}
@@ -0,0 +1,184 @@
+/**
+ * @file host_ff.c
+ * @brief RAM disk behind the host FatFs stand-in
+ *        The FatFs sources are not part of this tree, so the file calls the
+ *        log sinks make are implemented directly on memory: a few named
+ *        files, a byte budget for the volume, injectable errors and a log of
+ *        the f_write calls.
+ */
+
+#include "host_ff.h"
+#include "fatfs.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define HOST_FF_FILES           4
+#define HOST_FF_PATH_MAX        64
+
+typedef struct {
+    char path[HOST_FF_PATH_MAX];
+    char *data;
+    uint32_t size;
+} HostFile_t;
+
+typedef struct {
+    uint32_t offset;
+    uint32_t len;
+} HostWrite_t;
+
+FATFS USERFatFS;
+
+static HostFile_t host_files[HOST_FF_FILES];
+static uint32_t host_free;
+static FRESULT host_fail = FR_OK;
+static HostWrite_t host_write_log[HOST_FF_WRITE_LOG];
+static uint32_t host_write_count;
+
+void host_ff_format(uint16_t csize, uint32_t capacity)
+{
+    for (int i = 0; i < HOST_FF_FILES; i++) {
+        free(host_files[i].data);
+    }
+    memset(host_files, 0, sizeof(host_files));
+    USERFatFS.csize = csize;
+    host_free = capacity;
+    host_fail = FR_OK;
+    host_write_count = 0;
+}
+
+void host_ff_fail(FRESULT res)
+{
+    host_fail = res;
+}
+
+/**
+ * @brief Find a file
+ * @param path File path
+ * @return File slot, -1 if the file does not exist
+ */
+static int hostFileFind(const char *path)
+{
+    for (int i = 0; i < HOST_FF_FILES; i++) {
+        if (host_files[i].path[0] != '\0' && strcmp(host_files[i].path, path) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char *host_ff_file(const char *path, uint32_t *size)
+{
+    int slot = hostFileFind(path);
+
+    if (slot < 0) {
+        *size = 0;
+        return NULL;
+    }
+    *size = host_files[slot].size;
+    return host_files[slot].data;
+}
+
+uint32_t host_ff_writes(void)
+{
+    return host_write_count;
+}
+
+void host_ff_write_at(uint32_t index, uint32_t *offset, uint32_t *len)
+{
+    if (index < HOST_FF_WRITE_LOG && index < host_write_count) {
+        *offset = host_write_log[index].offset;
+        *len = host_write_log[index].len;
+    } else {
+        *offset = 0;
+        *len = 0;
+    }
+}
+
+FRESULT FATFS_Mount(void)
+{
+    return FR_OK;
+}
+
+FRESULT f_open(FIL *fp, const char *path, BYTE mode)
+{
+    int slot = hostFileFind(path);
+
+    if (strlen(path) >= HOST_FF_PATH_MAX) {
+        return FR_INVALID_NAME;
+    }
+    if (slot < 0) {
+        if ((mode & (FA_CREATE_NEW | FA_CREATE_ALWAYS | FA_OPEN_ALWAYS)) == 0) {
+            return FR_NO_FILE;
+        }
+        for (slot = 0; slot < HOST_FF_FILES && host_files[slot].path[0] != '\0'; slot++) {
+        }
+        if (slot == HOST_FF_FILES) {
+            return FR_TOO_MANY_OPEN_FILES;
+        }
+        strcpy(host_files[slot].path, path);
+    } else if (mode & FA_CREATE_NEW) {
+        return FR_EXIST;
+    } else if (mode & FA_CREATE_ALWAYS) {
+        host_free += host_files[slot].size;
+        host_files[slot].size = 0;
+    }
+    fp->slot = slot;
+    fp->flag = mode;
+    fp->fptr = ((mode & FA_OPEN_APPEND) == FA_OPEN_APPEND) ? host_files[slot].size : 0;
+    return FR_OK;
+}
+
+FRESULT f_close(FIL *fp)
+{
+    if (fp->flag == 0) {
+        return FR_INVALID_OBJECT;
+    }
+    fp->flag = 0;
+    return FR_OK;
+}
+
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw)
+{
+    HostFile_t *file;
+    uint32_t end;
+
+    *bw = 0;
+    if (fp->flag == 0) {
+        return FR_INVALID_OBJECT;
+    }
+    if (host_fail != FR_OK) {
+        return host_fail;
+    }
+    if (host_write_count < HOST_FF_WRITE_LOG) {
+        host_write_log[host_write_count].offset = fp->fptr;
+        host_write_log[host_write_count].len = btw;
+    }
+    host_write_count++;
+
+    /* 卷满时和FatFs一样只写入能放下的部分，返回FR_OK */
+    file = &host_files[fp->slot];
+    end = fp->fptr + btw;
+    if (end > file->size) {
+        uint32_t grow = end - file->size;
+        if (grow > host_free) {
+            grow = host_free;
+            end = file->size + grow;
+            btw = end - fp->fptr;
+        }
+        file->data = realloc(file->data, end);
+        host_free -= grow;
+        file->size = end;
+    }
+    memcpy(file->data + fp->fptr, buff, btw);
+    fp->fptr += btw;
+    *bw = btw;
+    return FR_OK;
+}
+
+FRESULT f_sync(FIL *fp)
+{
+    if (fp->flag == 0) {
+        return FR_INVALID_OBJECT;
+    }
+    return host_fail;
+}
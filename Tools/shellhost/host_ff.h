@@ -0,0 +1,51 @@
+/**
+ * @file host_ff.h
+ * @brief RAM disk behind the host FatFs stand-in (include/ff.h)
+ *        Files are byte arrays on a volume of a given capacity; every
+ *        f_write is logged so tests can check write sizes and alignment.
+ */
+
+#ifndef __HOST_FF_H__
+#define __HOST_FF_H__
+
+#include "ff.h"
+#include <stdint.h>
+
+/**
+ * @brief Delete all files and set the volume geometry
+ * @param csize Sectors per cluster
+ * @param capacity Bytes that can be written before the volume is full
+ */
+void host_ff_format(uint16_t csize, uint32_t capacity);
+
+/**
+ * @brief Make the following f_write/f_sync calls fail
+ * @param res Result to return, FR_OK to stop failing
+ */
+void host_ff_fail(FRESULT res);
+
+/**
+ * @brief Get the contents of a file
+ * @param path File path
+ * @param size Output file size
+ * @return File data, NULL if the file does not exist
+ */
+const char *host_ff_file(const char *path, uint32_t *size);
+
+/**
+ * @brief Get the number of f_write calls since host_ff_format()
+ * @return Write count
+ */
+uint32_t host_ff_writes(void);
+
+/**
+ * @brief Get one logged f_write call
+ * @param index Write index (only the first HOST_FF_WRITE_LOG are kept)
+ * @param offset Output file offset
+ * @param len Output bytes requested
+ */
+void host_ff_write_at(uint32_t index, uint32_t *offset, uint32_t *len);
+
+#define HOST_FF_WRITE_LOG       64
+
+#endif /* __HOST_FF_H__ */
@@ -0,0 +1,380 @@
+/**
+ * @file host_port.c
+ * @brief Host port of the letter-shell core
+ *        Implements the HAL, FreeRTOS and timebase calls made by shell.c,
+ *        shell_ext.c, shell_log.c and shell_log_sink.c on top of POSIX (clock_gettime,
+ *        pthreads), and the shell port hooks (write/read/lock/unlock) with
+ *        a counting stdout console.
+ */
+
+#define _GNU_SOURCE
+#include "host_port.h"
+#include "shell_log.h"
+#include "dwt_timebase.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Shell对象，shell_log.c通过extern引用 */
+Shell shell;
+static char shellBuffer[SHELL_BUFFER_SIZE];
+
+static uint8_t host_echo;
+static uint64_t host_out_bytes;
+static uint64_t host_start_ns;
+
+/* ---------------------------------------------------------------------------
+ * Time
+ * ------------------------------------------------------------------------- */
+
+/**
+ * @brief Monotonic time
+ * @return Nanoseconds
+ */
+uint64_t host_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint32_t HAL_GetTick(void)
+{
+    return (uint32_t)((host_now_ns() - host_start_ns) / 1000000ULL);
+}
+
+uint64_t Timebase_GetCycles(void)
+{
+    return host_now_ns() - host_start_ns;
+}
+
+uint64_t Timebase_GetUs(void)
+{
+    return (host_now_ns() - host_start_ns) / 1000ULL;
+}
+
+uint32_t Timebase_GetCoreClock(void)
+{
+    return 1000000000U;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return HAL_GetTick();
+}
+
+/* ---------------------------------------------------------------------------
+ * Heap and critical sections
+ * ------------------------------------------------------------------------- */
+
+void *pvPortMalloc(size_t size)
+{
+    return malloc(size);
+}
+
+void vPortFree(void *ptr)
+{
+    free(ptr);
+}
+
+size_t xPortGetFreeHeapSize(void)
+{
+    return configTOTAL_HEAP_SIZE;
+}
+
+static pthread_mutex_t host_critical;
+static pthread_once_t host_critical_once = PTHREAD_ONCE_INIT;
+
+static void hostCriticalInit(void)
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&host_critical, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+UBaseType_t hostEnterCritical(void)
+{
+    pthread_once(&host_critical_once, hostCriticalInit);
+    pthread_mutex_lock(&host_critical);
+    return 0;
+}
+
+void hostExitCritical(UBaseType_t state)
+{
+    (void)state;
+    pthread_mutex_unlock(&host_critical);
+}
+
+/* ---------------------------------------------------------------------------
+ * Tasks: one pthread each, notifications as a counting condition
+ * ------------------------------------------------------------------------- */
+
+struct HostTask {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+    TaskFunction_t code;
+    void *param;
+};
+
+static __thread struct HostTask *host_current;
+static struct HostTask host_main_task = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void *hostTaskEntry(void *arg)
+{
+    struct HostTask *task = arg;
+
+    host_current = task;
+    task->code(task->param);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stack,
+                       void *param, UBaseType_t priority, TaskHandle_t *handle)
+{
+    struct HostTask *task = calloc(1, sizeof(*task));
+
+    (void)name;
+    (void)stack;
+    (void)priority;
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_cond_init(&task->cond, NULL);
+    task->code = code;
+    task->param = param;
+    if (pthread_create(&task->thread, NULL, hostTaskEntry, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    if (handle) {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskGetSchedulerState(void)
+{
+    return taskSCHEDULER_RUNNING;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return host_current ? host_current : &host_main_task;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = {
+        .tv_sec = ticks / 1000U,
+        .tv_nsec = (long)(ticks % 1000U) * 1000000L,
+    };
+    nanosleep(&ts, NULL);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken)
+{
+    xTaskNotifyGive(task);
+    if (woken) {
+        *woken = pdFALSE;
+    }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait)
+{
+    struct HostTask *task = xTaskGetCurrentTaskHandle();
+    uint32_t value;
+
+    pthread_mutex_lock(&task->lock);
+    if (task->notify == 0 && wait == portMAX_DELAY) {
+        while (task->notify == 0) {
+            pthread_cond_wait(&task->cond, &task->lock);
+        }
+    } else if (task->notify == 0 && wait > 0) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += wait / 1000U;
+        ts.tv_nsec += (long)(wait % 1000U) * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        while (task->notify == 0
+               && pthread_cond_timedwait(&task->cond, &task->lock, &ts) == 0) {
+        }
+    }
+    value = task->notify;
+    if (value > 0) {
+        task->notify = clear ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+/* ---------------------------------------------------------------------------
+ * Mutexes (timeouts other than portMAX_DELAY are not needed)
+ * ------------------------------------------------------------------------- */
+
+struct HostMutex {
+    pthread_mutex_t lock;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    struct HostMutex *sem = calloc(1, sizeof(*sem));
+
+    if (sem != NULL) {
+        pthread_mutex_init(&sem->lock, NULL);
+    }
+    return sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait)
+{
+    (void)wait;
+    pthread_mutex_lock(&sem->lock);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    pthread_mutex_unlock(&sem->lock);
+    return pdTRUE;
+}
+
+/* ---------------------------------------------------------------------------
+ * Shell port hooks and console sink
+ * ------------------------------------------------------------------------- */
+
+/**
+ * @brief Console output: count, and copy to stdout when echo is on
+ * @param data Data
+ * @param len Data length
+ */
+static void hostConsoleWrite(const char *data, uint16_t len)
+{
+    __atomic_fetch_add(&host_out_bytes, len, __ATOMIC_RELAXED);
+    if (host_echo) {
+        fwrite(data, 1, len, stdout);
+    }
+}
+
+static ShellLogSink_t host_console_sink = {
+    .name = "stdout",
+    .level = SHELL_LOG_LEVEL_DEBUG,
+    .enabled = 1,
+    .task_only = 0,
+    .at_produce = 0,
+    .write = hostConsoleWrite,
+    .write_raw = hostConsoleWrite,
+    .flush = NULL,
+    .write_bin = NULL,
+};
+
+/**
+ * @brief shell写，与固件的shell_write()相同：先尝试走日志环形缓冲区
+ */
+static short hostShellWrite(char *data, unsigned short len)
+{
+    if (shellLogWriteRaw(data, len) != 0) {
+        hostConsoleWrite(data, len);
+    }
+    return (short)len;
+}
+
+/**
+ * @brief shell读，输入由基准程序直接送入shellHandler()
+ */
+static short hostShellRead(char *data, unsigned short len)
+{
+    (void)data;
+    (void)len;
+    return 0;
+}
+
+static pthread_mutex_t host_shell_mutex;
+
+static int hostShellLock(Shell *sh)
+{
+    (void)sh;
+    pthread_mutex_lock(&host_shell_mutex);
+    return 0;
+}
+
+static int hostShellUnlock(Shell *sh)
+{
+    (void)sh;
+    pthread_mutex_unlock(&host_shell_mutex);
+    return 0;
+}
+
+/**
+ * @brief Initialize the shell, the log system and the console sink
+ * @param echo 1 to copy the console output to stdout
+ */
+void host_shell_init(uint8_t echo)
+{
+    pthread_mutexattr_t attr;
+
+    host_start_ns = host_now_ns();
+    host_echo = echo;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&host_shell_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    shellLogInit();
+    shellLogAddSink(&host_console_sink);
+
+    shell.write = hostShellWrite;
+    shell.read = hostShellRead;
+    shell.lock = hostShellLock;
+    shell.unlock = hostShellUnlock;
+    shellInit(&shell, shellBuffer, SHELL_BUFFER_SIZE);
+
+    shellLogSetConsoleTask(xTaskGetCurrentTaskHandle());
+    shellLogStartDrain();
+}
+
+/**
+ * @brief Copy the console output to stdout or not
+ * @param echo 1 to copy
+ */
+void host_set_echo(uint8_t echo)
+{
+    shellLogFlush(1000);
+    host_echo = echo;
+}
+
+/**
+ * @brief Bytes written to the console so far
+ * @return Byte count
+ */
+uint64_t host_out_count(void)
+{
+    return __atomic_load_n(&host_out_bytes, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,41 @@
+/**
+ * @file host_port.h
+ * @brief Host port of the letter-shell core
+ */
+
+#ifndef __HOST_PORT_H__
+#define __HOST_PORT_H__
+
+#include "shell.h"
+#include <stdint.h>
+
+/* shell_port.h的命令行缓冲区大小，与固件相同 */
+#include "shell_port.h"
+
+extern Shell shell;
+
+/**
+ * @brief Initialize the shell, the log system and the console sink
+ * @param echo 1 to copy the console output to stdout
+ */
+void host_shell_init(uint8_t echo);
+
+/**
+ * @brief Copy the console output to stdout or not
+ * @param echo 1 to copy
+ */
+void host_set_echo(uint8_t echo);
+
+/**
+ * @brief Bytes written to the console so far
+ * @return Byte count
+ */
+uint64_t host_out_count(void);
+
+/**
+ * @brief Monotonic time
+ * @return Nanoseconds
+ */
+uint64_t host_now_ns(void);
+
+#endif /* __HOST_PORT_H__ */
@@ -0,0 +1,40 @@
+/**
+ * @file FreeRTOS.h
+ * @brief Host stand-in for the FreeRTOS kernel API used by the shell sources
+ *        Tasks are pthreads, task notifications a mutex and condition
+ *        variable, critical sections one recursive mutex (host_port.c).
+ */
+
+#ifndef INC_FREERTOS_H
+#define INC_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+
+#define pdFALSE                     ((BaseType_t)0)
+#define pdTRUE                      ((BaseType_t)1)
+#define pdPASS                      pdTRUE
+#define pdFAIL                      pdFALSE
+#define portMAX_DELAY               ((TickType_t)0xFFFFFFFFUL)
+#define configTICK_RATE_HZ          1000U
+#define configTOTAL_HEAP_SIZE       ((size_t)65536)
+#define pdMS_TO_TICKS(ms)           ((TickType_t)(ms))
+
+#define portYIELD_FROM_ISR(x)       ((void)(x))
+
+UBaseType_t hostEnterCritical(void);
+void hostExitCritical(UBaseType_t state);
+
+#define taskENTER_CRITICAL()                hostEnterCritical()
+#define taskEXIT_CRITICAL()                 hostExitCritical(0)
+#define taskENTER_CRITICAL_FROM_ISR()       hostEnterCritical()
+#define taskEXIT_CRITICAL_FROM_ISR(x)       hostExitCritical(x)
+
+#include "portable.h"
+
+#endif /* INC_FREERTOS_H */
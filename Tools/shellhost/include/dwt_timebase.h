@@ -0,0 +1,22 @@
+/**
+ * @file dwt_timebase.h
+ * @brief Host stand-in for Core/Inc/dwt_timebase.h
+ *        Backed by CLOCK_MONOTONIC. The "core clock" is 1 GHz, so one cycle
+ *        is one nanosecond and cycle counts read directly as nanoseconds.
+ */
+
+#ifndef __DWT_TIMEBASE_H
+#define __DWT_TIMEBASE_H
+
+#include "main.h"
+
+uint64_t Timebase_GetCycles(void);
+uint64_t Timebase_GetUs(void);
+uint32_t Timebase_GetCoreClock(void);
+
+static inline uint32_t Timebase_GetCycles32(void)
+{
+    return (uint32_t)Timebase_GetCycles();
+}
+
+#endif /* __DWT_TIMEBASE_H */
@@ -0,0 +1,15 @@
+/**
+ * @file fatfs.h
+ * @brief Host stand-in for the FatFs application header (FATFS/App/fatfs.h)
+ */
+
+#ifndef __fatfs_H
+#define __fatfs_H
+
+#include "ff.h"
+
+extern FATFS USERFatFS;
+
+FRESULT FATFS_Mount(void);
+
+#endif /* __fatfs_H */
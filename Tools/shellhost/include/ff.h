@@ -0,0 +1,69 @@
+/**
+ * @file ff.h
+ * @brief Host stand-in for the FatFs file API used by shell_log_sink.c
+ *        Only the calls and fields the log sinks use; the files live in
+ *        memory (host_ff.c). Names and values follow FatFs R0.12c.
+ */
+
+#ifndef _FATFS
+#define _FATFS
+
+#include <stdint.h>
+
+#define _MAX_SS             512
+
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef unsigned int UINT;
+typedef uint32_t DWORD;
+typedef DWORD FSIZE_t;
+
+typedef enum {
+    FR_OK = 0,
+    FR_DISK_ERR,
+    FR_INT_ERR,
+    FR_NOT_READY,
+    FR_NO_FILE,
+    FR_NO_PATH,
+    FR_INVALID_NAME,
+    FR_DENIED,
+    FR_EXIST,
+    FR_INVALID_OBJECT,
+    FR_WRITE_PROTECTED,
+    FR_INVALID_DRIVE,
+    FR_NOT_ENABLED,
+    FR_NO_FILESYSTEM,
+    FR_MKFS_ABORTED,
+    FR_TIMEOUT,
+    FR_LOCKED,
+    FR_NOT_ENOUGH_CORE,
+    FR_TOO_MANY_OPEN_FILES,
+    FR_INVALID_PARAMETER
+} FRESULT;
+
+typedef struct {
+    WORD csize;             /* Sectors per cluster */
+} FATFS;
+
+typedef struct {
+    FSIZE_t fptr;           /* File read/write pointer */
+    BYTE flag;              /* FA_* mode, 0 if closed */
+    int slot;               /* RAM disk file */
+} FIL;
+
+#define FA_READ             0x01
+#define FA_WRITE            0x02
+#define FA_OPEN_EXISTING    0x00
+#define FA_CREATE_NEW       0x04
+#define FA_CREATE_ALWAYS    0x08
+#define FA_OPEN_ALWAYS      0x10
+#define FA_OPEN_APPEND      0x30
+
+#define f_tell(fp)          ((fp)->fptr)
+
+FRESULT f_open(FIL *fp, const char *path, BYTE mode);
+FRESULT f_close(FIL *fp);
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw);
+FRESULT f_sync(FIL *fp);
+
+#endif /* _FATFS */
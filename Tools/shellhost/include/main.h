@@ -0,0 +1,11 @@
+/**
+ * @file main.h
+ * @brief Host stand-in for Core/Inc/main.h
+ */
+
+#ifndef __MAIN_H
+#define __MAIN_H
+
+#include "stm32h7xx_hal.h"
+
+#endif /* __MAIN_H */
@@ -0,0 +1,15 @@
+/**
+ * @file portable.h
+ * @brief Host stand-in for the FreeRTOS heap API
+ */
+
+#ifndef PORTABLE_H
+#define PORTABLE_H
+
+#include <stddef.h>
+
+void *pvPortMalloc(size_t size);
+void vPortFree(void *ptr);
+size_t xPortGetFreeHeapSize(void);
+
+#endif /* PORTABLE_H */
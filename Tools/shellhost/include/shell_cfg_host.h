@@ -0,0 +1,19 @@
+/**
+ * @file shell_cfg_host.h
+ * @brief Shell configuration of the host build
+ *        The firmware configuration, minus the parts that need the board:
+ *        pipes write through the FatFs-backed capture in shell_log_sink.c.
+ *        Format strings live in the host image, not in the STM32 flash.
+ */
+
+#ifndef __SHELL_CFG_HOST_H__
+#define __SHELL_CFG_HOST_H__
+
+#include "shell_cfg_user.h"
+
+#undef SHELL_USING_PIPE
+#define SHELL_USING_PIPE            0
+
+#define SHELL_LOG_DEFER_PTR_VALID(p)    ((p) != 0)
+
+#endif /* __SHELL_CFG_HOST_H__ */
@@ -0,0 +1,38 @@
+/**
+ * @file stm32h7xx_hal.h
+ * @brief Host stand-in for the HAL header used by the shell sources
+ *        Only what Shell/inc and Shell/src reference on the host build.
+ */
+
+#ifndef __STM32H7xx_HAL_H
+#define __STM32H7xx_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum {
+    HAL_OK = 0x00U,
+    HAL_ERROR = 0x01U,
+    HAL_BUSY = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+/* shell_port.h只声明huart3，主机构建不会引用其内容 */
+typedef struct {
+    void *Instance;
+} UART_HandleTypeDef;
+
+uint32_t HAL_GetTick(void);
+
+/* 主机上没有中断上下文 */
+static inline uint32_t __get_IPSR(void)
+{
+    return 0U;
+}
+
+static inline void __DMB(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#endif /* __STM32H7xx_HAL_H */
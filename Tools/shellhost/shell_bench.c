@@ -0,0 +1,238 @@
+/**
+ * @file shell_bench.c
+ * @brief Shell benchmark on the host
+ *        Measures command lookup, parse + dispatch, shellPrint() and log
+ *        output of the letter-shell core, then replays command streams
+ *        byte by byte through shellHandler() like UART input.
+ *
+ *        shellbench [-n iterations] [-r repeats] [-v] [stream ...]
+ */
+
+#include "host_port.h"
+#include "shell.h"
+#include "shell_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BENCH_LINE_MAX          256
+#define BENCH_STREAM_MAX        256
+
+extern ShellCommand* shellSeekCommand(Shell *shell, const char *cmd,
+                                      ShellCommand *base, unsigned short compareLength);
+
+/* 基准测试命令，与固件命令一样由链接器收集到shellCommand段 */
+static int bench_nop(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+    return 0;
+}
+SHELL_EXPORT_CMD(SHELL_CMD_PERMISSION(0)|SHELL_CMD_TYPE(SHELL_TYPE_CMD_MAIN)|SHELL_CMD_DISABLE_RETURN,
+                 bench_nop, bench_nop, do nothing);
+
+static int bench_print(int argc, char *argv[])
+{
+    int lines = (argc > 1) ? atoi(argv[1]) : 1;
+
+    for (int i = 0; i < lines; i++) {
+        shellPrint(shellGetCurrent(), "line %d of %d: sector %08lX, %lu bytes\r\n",
+                   i, lines, 0x1000UL + (unsigned long)i, 512UL);
+    }
+    return 0;
+}
+SHELL_EXPORT_CMD(SHELL_CMD_PERMISSION(0)|SHELL_CMD_TYPE(SHELL_TYPE_CMD_MAIN)|SHELL_CMD_DISABLE_RETURN,
+                 bench_print, bench_print, print lines with shellPrint);
+
+static int bench_log(int argc, char *argv[])
+{
+    int lines = (argc > 1) ? atoi(argv[1]) : 1;
+
+    for (int i = 0; i < lines; i++) {
+        SHELL_LOG_USER_INFO("line %d of %d: sector %08lX, %lu bytes",
+                            i, lines, 0x1000UL + (unsigned long)i, 512UL);
+    }
+    return 0;
+}
+SHELL_EXPORT_CMD(SHELL_CMD_PERMISSION(0)|SHELL_CMD_TYPE(SHELL_TYPE_CMD_MAIN)|SHELL_CMD_DISABLE_RETURN,
+                 bench_log, bench_log, print lines with SHELL_LOG);
+
+/**
+ * @brief Name of a command table entry
+ * @param cmd Entry
+ * @return Name, NULL for keys
+ */
+static const char* benchName(const ShellCommand *cmd)
+{
+    int type = cmd->attr.attrs.type;
+
+    if (type == SHELL_TYPE_KEY) {
+        return NULL;
+    }
+    if (type <= SHELL_TYPE_CMD_FUNC) {
+        return cmd->data.cmd.name;
+    }
+    if (type == SHELL_TYPE_USER) {
+        return cmd->data.user.name;
+    }
+    return cmd->data.var.name;
+}
+
+/**
+ * @brief Time shellSeekCommand() for every name in the table
+ * @param iterations Passes over the table
+ */
+static void benchSeek(uint32_t iterations)
+{
+    ShellCommand *base = shell.commandList.base;
+    uint32_t lookups = 0;
+    uint64_t start = host_now_ns();
+
+    for (uint32_t n = 0; n < iterations; n++) {
+        for (int i = 0; i < shell.commandList.count; i++) {
+            const char *name = benchName(&base[i]);
+            if (name) {
+                shellSeekCommand(&shell, name, base, 0);
+                lookups++;
+            }
+        }
+    }
+    uint64_t ns = host_now_ns() - start;
+    printf("seek     %4d entries       %9.1f ns/lookup\n",
+           shell.commandList.count, lookups ? (double)ns / lookups : 0.0);
+}
+
+/**
+ * @brief Time shellRun() of one command line
+ * @param label Row label
+ * @param line Command line
+ * @param iterations Runs
+ * @param lines Output lines per run (0: report per command)
+ */
+static void benchRun(const char *label, const char *line, uint32_t iterations, uint32_t lines)
+{
+    uint64_t bytes = host_out_count();
+    uint64_t start = host_now_ns();
+
+    for (uint32_t n = 0; n < iterations; n++) {
+        shellRun(&shell, line);
+    }
+    uint64_t caller = host_now_ns() - start;
+    shellLogFlush(10000);
+    uint64_t total = host_now_ns() - start;
+    bytes = host_out_count() - bytes;
+
+    uint32_t div = iterations * (lines ? lines : 1);
+    printf("%-8s %-20s %9.1f ns/%s caller, %9.1f ns with output, %5.1f bytes\n",
+           label, line, (double)caller / div, lines ? "line" : "cmd ",
+           (double)total / div, (double)bytes / div);
+}
+
+/**
+ * @brief Replay a command stream through shellHandler()
+ *        Every byte goes through echo, line editing, history, parser and
+ *        dispatch like UART input; reports the caller cost of every line.
+ *        The log ring is drained after each line outside the timed part,
+ *        shellLogFlush() polls at tick granularity
+ * @param path Stream file, one command per line
+ * @param repeats Replays
+ * @return 0 on success
+ */
+static int benchReplay(const char *path, uint32_t repeats)
+{
+    static char lines[BENCH_STREAM_MAX][BENCH_LINE_MAX];
+    static uint64_t ns[BENCH_STREAM_MAX];
+    static uint64_t bytes[BENCH_STREAM_MAX];
+    int count = 0;
+    FILE *f = fopen(path, "r");
+
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    while (count < BENCH_STREAM_MAX && fgets(lines[count], BENCH_LINE_MAX, f)) {
+        lines[count][strcspn(lines[count], "\r\n")] = '\0';
+        if (lines[count][0] != '\0' && lines[count][0] != '#') {
+            count++;
+        }
+    }
+    fclose(f);
+    memset(ns, 0, sizeof(ns));
+    memset(bytes, 0, sizeof(bytes));
+
+    for (uint32_t r = 0; r < repeats; r++) {
+        for (int i = 0; i < count; i++) {
+            uint64_t out = host_out_count();
+            uint64_t start = host_now_ns();
+            for (const char *p = lines[i]; *p; p++) {
+                shellHandler(&shell, *p);
+            }
+            shellHandler(&shell, '\r');
+            ns[i] += host_now_ns() - start;
+            shellLogFlush(10000);
+            bytes[i] += host_out_count() - out;
+        }
+    }
+
+    uint64_t total_ns = 0;
+    uint64_t total_bytes = 0;
+    printf("\nreplay %s (%d lines x %u)\n", path, count, repeats);
+    for (int i = 0; i < count; i++) {
+        printf("  %-40.40s %10.1f us %8.0f bytes\n", lines[i],
+               (double)ns[i] / repeats / 1000.0, (double)bytes[i] / repeats);
+        total_ns += ns[i];
+        total_bytes += bytes[i];
+    }
+    printf("  %-40s %10.1f us %8.0f bytes\n", "total",
+           (double)total_ns / repeats / 1000.0, (double)total_bytes / repeats);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t iterations = 10000;
+    uint32_t repeats = 10;
+    uint8_t echo = 0;
+    int opt;
+    int ret = 0;
+
+    while ((opt = getopt(argc, argv, "n:r:v")) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            repeats = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'v':
+            echo = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n iterations] [-r repeats] [-v] [stream ...]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (iterations == 0 || repeats == 0) {
+        fprintf(stderr, "iterations and repeats must be positive\n");
+        return 2;
+    }
+
+    host_shell_init(echo);
+    shellLogFlush(1000);
+
+    printf("letter-shell host benchmark: %s log output, %u iterations\n",
+           SHELL_LOG_ASYNC ? "async" : "sync", iterations);
+    benchSeek(iterations / 10 ? iterations / 10 : 1);
+    benchRun("run", "bench_nop", iterations, 0);
+    benchRun("run", "bench_nop a b 0x10 \"c d\"", iterations, 0);
+    benchRun("print", "bench_print 10", iterations / 10 ? iterations / 10 : 1, 10);
+    benchRun("log", "bench_log 10", iterations / 10 ? iterations / 10 : 1, 10);
+
+    for (int i = optind; i < argc; i++) {
+        if (benchReplay(argv[i], repeats) != 0) {
+            ret = 1;
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,881 @@
+/**
+ * @file shell_test.c
+ * @brief Correctness tests of the shell log paths on the host
+ *        The printf engine (shell_fmt.c) is compared byte for byte with
+ *        glibc, including the returned lengths and truncation.
+ *        Deferred records (SHELL_LOG_DEFER_*) are drained and formatted by
+ *        shell_log.c and compared byte for byte with glibc formatting the
+ *        same call directly. Repeat collapsing is checked by counting the
+ *        lines that reach a sink. The crash and file sinks of
+ *        shell_log_sink.c run on the RAM disk of host_ff.c. Command lookup
+ *        and key matching through the command index (shell.c) are compared
+ *        with the linear scan on a copy of the command table. The printf
+ *        engine entry points are wrapped at link time to count the calls
+ *        made by the logging thread.
+ *
+ *        shelltest [-v]
+ */
+
+#include "host_port.h"
+#include "host_ff.h"
+#include "shell_fmt.h"
+#include "shell_log.h"
+#include "shell_log_sink.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <limits.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_LINE_MAX           512
+
+/* 参数列表原样展开：CHECK_DEFER(fmt, (直接调用的参数), (延迟记录的32位参数)) */
+#define TEST_ARGS(...)          __VA_ARGS__
+
+/* -no-pie链接，字符串常量位于4GB以下，可以像固件一样作为32位参数记录 */
+#define TEST_PTR(p)             ((uint32_t)(uintptr_t)(p))
+
+static int test_verbose;
+static int test_run;
+static int test_failed;
+
+/* 捕获的最后一行日志，以及行数和其中的重复汇总行数 */
+static char test_line[TEST_LINE_MAX];
+static uint16_t test_line_len;
+static int test_lines;
+static int test_summaries;
+
+/* 置1时测试输出端在写入中阻塞，模拟drain任务得不到运行 */
+static volatile int test_gate;
+static volatile int test_gate_blocked;
+
+/* 本线程调用printf引擎的次数（drain线程的调用不计入） */
+static __thread int test_fmt_calls;
+
+int __real_shellFmtVsnprintf(char *buffer, size_t size, const char *format, va_list args);
+
+/**
+ * @brief Link-time wrapper of shellFmtVsnprintf: count the call
+ */
+int __wrap_shellFmtVsnprintf(char *buffer, size_t size, const char *format, va_list args)
+{
+    test_fmt_calls++;
+    return __real_shellFmtVsnprintf(buffer, size, format, args);
+}
+
+/**
+ * @brief Link-time wrapper of shellFmtSnprintf: count the call
+ */
+int __wrap_shellFmtSnprintf(char *buffer, size_t size, const char *format, ...)
+{
+    va_list args;
+    int n;
+
+    test_fmt_calls++;
+    va_start(args, format);
+    n = __real_shellFmtVsnprintf(buffer, size, format, args);
+    va_end(args);
+    return n;
+}
+
+/**
+ * @brief Record a check result
+ * @param ok Check passed
+ * @param file Source file
+ * @param line Source line
+ * @param expect Expected text
+ * @param got Actual text
+ */
+static void testReport(int ok, const char *file, int line, const char *expect, const char *got)
+{
+    test_run++;
+    if (!ok) {
+        test_failed++;
+        printf("FAIL %s:%d\n  expect \"%s\"\n  got    \"%s\"\n", file, line, expect, got);
+    } else if (test_verbose) {
+        printf("ok   %s:%d \"%s\"\n", file, line, got);
+    }
+}
+
+/**
+ * @brief Check a count
+ * @param file Source file
+ * @param line Source line
+ * @param what Counter name
+ * @param expect Expected count
+ * @param got Actual count
+ */
+static void testCount(const char *file, int line, const char *what, int expect, int got)
+{
+    char want[64];
+    char have[64];
+
+    snprintf(want, sizeof(want), "%s %d", what, expect);
+    snprintf(have, sizeof(have), "%s %d", what, got);
+    testReport(expect == got, file, line, want, have);
+}
+
+#define CHECK_COUNT(what, expect, got)  testCount(__FILE__, __LINE__, what, expect, got)
+
+/* ---------------------------------------------------------------------------
+ * printf engine (shellFmtVsnprintf)
+ * ------------------------------------------------------------------------- */
+
+/**
+ * @brief Compare a shellFmtSnprintf result with the glibc one
+ * @param file Source file
+ * @param line Source line
+ * @param expect glibc output
+ * @param expect_len glibc return value
+ * @param got shellFmtSnprintf output
+ * @param got_len shellFmtSnprintf return value
+ */
+static void testFmtCompare(const char *file, int line, const char *expect, int expect_len,
+                           const char *got, int got_len)
+{
+    char want[TEST_LINE_MAX];
+    char have[TEST_LINE_MAX];
+
+    snprintf(want, sizeof(want), "%s\" (%d)", expect, expect_len);
+    snprintf(have, sizeof(have), "%s\" (%d)", got, got_len);
+    testReport(expect_len == got_len && strcmp(expect, got) == 0, file, line, want, have);
+}
+
+/* 缓冲区大小为size时两者的输出和返回值（未截断长度）都要一致 */
+#define CHECK_FMT_N(size, format, ...) \
+    do { \
+        char _expect[TEST_LINE_MAX]; \
+        char _got[TEST_LINE_MAX]; \
+        int _expect_len = snprintf(_expect, size, format, ##__VA_ARGS__); \
+        int _got_len = shellFmtSnprintf(_got, size, format, ##__VA_ARGS__); \
+        testFmtCompare(__FILE__, __LINE__, _expect, _expect_len, _got, _got_len); \
+    } while (0)
+
+#define CHECK_FMT(format, ...)  CHECK_FMT_N(TEST_LINE_MAX, format, ##__VA_ARGS__)
+
+/* 故意测试被忽略的标志组合和截断，关闭对应的格式检查 */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat"
+#pragma GCC diagnostic ignored "-Wformat-truncation"
+
+static void testFormat(void)
+{
+    /* 非常量格式串，编译器不检查，用于不完整的转换说明 */
+    const char *volatile trailing = "end %";
+    const char *volatile trailing_spec = "end %-08l";
+    char got[TEST_LINE_MAX];
+    int len;
+
+    /* 标志 */
+    CHECK_FMT("[%d] [%-6d] [%+d] [% d] [%06d]", 42, 42, 42, 42, -42);
+    CHECK_FMT("[%+06d] [%-+6d] [% 06d] [%+ d] [%-06d]", 42, 42, 42, 42, 42);
+    CHECK_FMT("[%#o] [%#o] [%#x] [%#X] [%#x]", 0U, 8U, 0U, 255U, 255U);
+    CHECK_FMT("[%#.0o] [%#5o] [%#08x] [%#-8x]", 0U, 8U, 255U, 255U);
+
+    /* 宽度和精度 */
+    CHECK_FMT("[%8.3d] [%-8.3x] [%.0d] [%.0x] [%5.0d]", -7, 10U, 0, 0U, 0);
+    CHECK_FMT("[%08.3d] [%.10u] [%3d] [%1d]", 5, 12345U, 123456, -1);
+    CHECK_FMT("[%*d] [%*d] [%.*d] [%.*d] [%*.*d]", 6, 7, -6, 7, 3, 5, -1, 5, 6, 3, 9);
+    CHECK_FMT("[%c] [%5c] [%-5c]", 'a', 'b', 'c');
+    CHECK_FMT("[%s] [%8s] [%-8s] [%.3s] [%-10.3s] [%.0s]",
+              "text", "text", "text", "text", "text", "text");
+    CHECK_FMT("[%p] [%20p] [%-20p]", (void *)0x24001000, (void *)0x24001000, (void *)0x1);
+    CHECK_FMT("100%% done");
+
+    /* 长度修饰 */
+    CHECK_FMT("%hhd %hhu %hhx %hd %hu %hx", 200, 300, 0x1FF, 70000, 70000, 0x12345);
+    CHECK_FMT("%ld %ld %lu %lx %lo", LONG_MIN, LONG_MAX, ULONG_MAX, ULONG_MAX, ULONG_MAX);
+    CHECK_FMT("%lld %lld %llu %llx %llX", LLONG_MIN, LLONG_MAX, ULLONG_MAX, 0x123456789ABCDEFULL,
+              0xFEDCBA9876543210ULL);
+    CHECK_FMT("%zu %zx %zd %td %td", SIZE_MAX, (size_t)4096, (ptrdiff_t)-5, PTRDIFF_MIN,
+              PTRDIFF_MAX);
+    CHECK_FMT("%jd %ju %jx", INTMAX_MIN, UINTMAX_MAX, (uintmax_t)0xABCDEF);
+    CHECK_FMT("[%-+20lld] [%020llu] [%#24llo]", -1LL, 1ULL << 63, ULLONG_MAX);
+
+    /* %f：舍入（半数取偶，按二进制真实值）、宽度、标志、特殊值 */
+    CHECK_FMT("%.0f %.0f %.0f %.0f %.0f", 0.5, 1.5, 2.5, 3.5, -0.5);
+    CHECK_FMT("%.2f %.2f %.2f %.2f", 0.125, 0.375, 1.005, 2.675);
+    CHECK_FMT("%.1f %.1f %.1f %.3f", 0.05, 0.25, 0.35, 1.0005);
+    CHECK_FMT("%f %f %f %f", 0.0, -0.0, 1e-7, 999999.9999996);
+    CHECK_FMT("%f %.9f %.9f", 3.14159265358979, 0.1, 2.0 / 3.0);
+    CHECK_FMT("%.3f %.0f %f", 1e19, 18446744073709549568.0, 4294967295.5);
+    CHECK_FMT("[%10.3f] [%-10.2f] [%+.1f] [% .1f] [%010.2f] [%+010.2f]",
+              3.14159, 2.5, 1.25, 1.25, -3.14159, 3.14159);
+    CHECK_FMT("[%#.0f] [%.0f] [%F] [%.12f]", 3.0, 3.0, 1.5, 0.5);
+    CHECK_FMT("[%f] [%F] [%-6f] [%+f] [%06f]", __builtin_inf(), -__builtin_inf(),
+              __builtin_nan(""), __builtin_inf(), __builtin_inf());
+    CHECK_FMT("%Lf %.2Lf", 1.25L, -2.675L);
+
+    /* 截断：输出在缓冲区内截断，返回值仍为完整长度 */
+    CHECK_FMT_N(1, "%d", 12345);
+    CHECK_FMT_N(5, "hello %s", "world");
+    CHECK_FMT_N(6, "[%8d]", -42);
+    CHECK_FMT_N(8, "%.3f", 2.0 / 3.0);
+
+    /* 格式串末尾不完整的转换说明：在此结束，不输出 */
+    len = shellFmtSnprintf(got, sizeof(got), trailing, 1);
+    testFmtCompare(__FILE__, __LINE__, "end ", 4, got, len);
+    len = shellFmtSnprintf(got, sizeof(got), trailing_spec, 1);
+    testFmtCompare(__FILE__, __LINE__, "end ", 4, got, len);
+}
+
+#pragma GCC diagnostic pop
+
+/* ---------------------------------------------------------------------------
+ * Deferred records (shellLogFormatArgs)
+ * ------------------------------------------------------------------------- */
+
+/**
+ * @brief Test sink: keep the last line
+ * @param data Line
+ * @param len Line length
+ */
+static void testSinkWrite(const char *data, uint16_t len)
+{
+    while (test_gate) {
+        test_gate_blocked = 1;
+        vTaskDelay(1);
+    }
+    test_gate_blocked = 0;
+    if (len >= sizeof(test_line)) {
+        len = sizeof(test_line) - 1;
+    }
+    memcpy(test_line, data, len);
+    test_line[len] = '\0';
+    test_line_len = len;
+    test_lines++;
+    if (strstr(test_line, "Last message repeated") != NULL) {
+        test_summaries++;
+    }
+}
+
+static ShellLogSink_t test_sink = {
+    .name = "test",
+    .level = SHELL_LOG_LEVEL_DEBUG,
+    .enabled = 1,
+    .task_only = 0,
+    .at_produce = 0,
+    .write = testSinkWrite,
+    .write_raw = NULL,
+    .flush = NULL,
+    .write_bin = NULL,
+};
+
+/**
+ * @brief Drain the deferred record and compare its message with the expected text
+ *        The message follows the timestamp and level prefix, so only the end of
+ *        the line is compared
+ * @param file Source file
+ * @param line Source line
+ * @param expect Expected message
+ */
+static void testDeferCheck(const char *file, int line, const char *expect)
+{
+    char want[TEST_LINE_MAX];
+    const char *msg = "";
+
+    shellLogFlush(1000);
+    snprintf(want, sizeof(want), "%s\r\n", expect);
+    size_t want_len = strlen(want);
+    if (test_line_len >= want_len) {
+        msg = test_line + test_line_len - want_len;
+    }
+    testReport(strcmp(msg, want) == 0, file, line, want, test_line);
+    test_line[0] = '\0';
+    test_line_len = 0;
+}
+
+#define CHECK_DEFER(format, direct, raw) \
+    do { \
+        char _expect[TEST_LINE_MAX]; \
+        snprintf(_expect, sizeof(_expect), format, TEST_ARGS direct); \
+        SHELL_LOG_DEFER_INFO(SHELL_LOG_MODULE_SYSTEM, format, TEST_ARGS raw); \
+        testDeferCheck(__FILE__, __LINE__, _expect); \
+    } while (0)
+
+#define CHECK_DEFER_TEXT(expect, format, raw) \
+    do { \
+        SHELL_LOG_DEFER_INFO(SHELL_LOG_MODULE_SYSTEM, format, TEST_ARGS raw); \
+        testDeferCheck(__FILE__, __LINE__, expect); \
+    } while (0)
+
+static void testDeferred(void)
+{
+    static const char name[] = "usb0";
+    int32_t neg = -1234567;
+    uint32_t big = 0xDEADBEEFU;
+
+    CHECK_DEFER("plain %d", (42), (42));
+    CHECK_DEFER("neg %d %i", (neg, -1), ((uint32_t)neg, (uint32_t)-1));
+    CHECK_DEFER("width [%8d] [%-8d] [%08d]", (neg, 77, -77),
+                ((uint32_t)neg, 77, (uint32_t)-77));
+    CHECK_DEFER("flags [%+d] [% d] [%+.3d]", (5, 5, -5), (5, 5, (uint32_t)-5));
+    CHECK_DEFER("unsigned %u %lu", (big, (unsigned long)big), (big, big));
+    CHECK_DEFER("long %ld %li", ((long)neg, (long)INT32_MIN), ((uint32_t)neg, (uint32_t)INT32_MIN));
+    CHECK_DEFER("hex %x %X %#x %#010lx", (big, big, 255U, (unsigned long)big),
+                (big, big, 255U, big));
+    CHECK_DEFER("octal %o %#o", (8U, 8U), (8U, 8U));
+    CHECK_DEFER("short %hd %hu %hhx", ((short)-2, (unsigned short)65535, (unsigned char)0x1FF),
+                ((uint32_t)-2, 65535, 0x1FF));
+    CHECK_DEFER("size %zu %zx", ((size_t)big, (size_t)4096), (big, 4096));
+    CHECK_DEFER("char [%c] [%3c] [%-3c]", ('A', 'b', 'c'), ('A', 'b', 'c'));
+    CHECK_DEFER("string [%s] [%8s] [%-8s] [%.2s]", (name, name, name, name),
+                (TEST_PTR(name), TEST_PTR(name), TEST_PTR(name), TEST_PTR(name)));
+    CHECK_DEFER("pointer %p", ((void *)(uintptr_t)0x24001000U), (0x24001000U));
+    CHECK_DEFER("percent 100%% of %u", (3U), (3U));
+    CHECK_DEFER("six %d %d %d %d %d %d", (1, 2, 3, 4, 5, 6), (1, 2, 3, 4, 5, 6));
+    CHECK_DEFER_TEXT("null (null)", "null %s", (0));
+
+    /* 32位原始值无法还原的转换输出<spec?>，并消耗一个参数，后续参数仍对应 */
+    CHECK_DEFER_TEXT("ll <%lld?> then 7", "ll %lld then %d", (1, 7));
+    CHECK_DEFER_TEXT("ull <%llu?> <%llx?> then 8", "ull %llu %llx then %d", (1, 2, 8));
+    CHECK_DEFER_TEXT("wide <%lc?> then 9", "wide %lc then %d", ('x', 9));
+    CHECK_DEFER_TEXT("float <%f?> then 10", "float %f then %d", (0, 10));
+    /* 超过15个字符的转换说明输出<?>并消耗参数 */
+    CHECK_DEFER_TEXT("long spec <?> then 11", "long spec %-0000000000000008d then %d", (5, 11));
+    CHECK_DEFER_TEXT("missing 12 0", "missing %d %d", (12));
+}
+
+/* ---------------------------------------------------------------------------
+ * Command index (shellSeekCommand, key matching in shellHandler)
+ * ------------------------------------------------------------------------- */
+
+extern ShellCommand* shellSeekCommand(Shell *shell,
+                                      const char *cmd,
+                                      ShellCommand *base,
+                                      unsigned short compareLength);
+
+/* 同名条目无法用SHELL_EXPORT_CMD/SHELL_EXPORT_KEY定义（标识符重复），
+   放在一个数组里定义，命令表中的顺序即数组顺序 */
+#define TEST_CMD(_attr, _name) \
+    { \
+        .attr.value = (_attr)|SHELL_CMD_TYPE(SHELL_TYPE_CMD_MAIN), \
+        .data.cmd.name = _name, \
+        .data.cmd.function = (int (*)())testCmdNop, \
+        .data.cmd.desc = "index test" \
+    }
+
+#define TEST_KEY(_attr, _value, _func) \
+    { \
+        .attr.value = (_attr)|SHELL_CMD_TYPE(SHELL_TYPE_KEY), \
+        .data.key.value = _value, \
+        .data.key.function = _func, \
+        .data.key.desc = "index test" \
+    }
+
+static int testCmdNop(void)
+{
+    return 0;
+}
+
+/**
+ * @brief Test key function: write a tag to the shell that matched the key
+ * @param shell Shell
+ * @param tag Tag
+ */
+static void testKeyWrite(Shell *shell, const char *tag)
+{
+    shell->write((char *)tag, (unsigned short)strlen(tag));
+}
+
+static void testKeyDenied(Shell *shell)
+{
+    testKeyWrite(shell, "<denied>");
+}
+
+static void testKeyFirst(Shell *shell)
+{
+    testKeyWrite(shell, "<first>");
+}
+
+static void testKeySecond(Shell *shell)
+{
+    testKeyWrite(shell, "<second>");
+}
+
+static void testKeyShort(Shell *shell)
+{
+    testKeyWrite(shell, "<short>");
+}
+
+/* 同名命令保持命令表顺序；无权限（默认用户权限为0）的条目排在有权限的同名条目之前；
+   前缀相同的名称在命令表中与字母顺序相反。
+   三字节按键：无权限的一项在前，同键值的两项保持命令表顺序；另有一个两字节按键 */
+enum {
+    TEST_CMD_DUP1, TEST_CMD_DUP2, TEST_CMD_PERM1, TEST_CMD_PERM2,
+    TEST_CMD_PRE_C, TEST_CMD_PRE_B, TEST_CMD_PRE_A, TEST_CMD_PRE,
+};
+
+SHELL_USED const ShellCommand testCommands[] SHELL_SECTION("shellCommand") = {
+    [TEST_CMD_DUP1] = TEST_CMD(SHELL_CMD_PERMISSION(0), "idxdup"),
+    [TEST_CMD_DUP2] = TEST_CMD(SHELL_CMD_PERMISSION(0), "idxdup"),
+    [TEST_CMD_PERM1] = TEST_CMD(SHELL_CMD_PERMISSION(0x80), "idxperm"),
+    [TEST_CMD_PERM2] = TEST_CMD(SHELL_CMD_PERMISSION(0), "idxperm"),
+    [TEST_CMD_PRE_C] = TEST_CMD(SHELL_CMD_PERMISSION(0x80), "idxpre_c"),
+    [TEST_CMD_PRE_B] = TEST_CMD(SHELL_CMD_PERMISSION(0), "idxpre_b"),
+    [TEST_CMD_PRE_A] = TEST_CMD(SHELL_CMD_PERMISSION(0), "idxpre_a"),
+    [TEST_CMD_PRE] = TEST_CMD(SHELL_CMD_PERMISSION(0), "idxpre"),
+    TEST_KEY(SHELL_CMD_PERMISSION(0x80), 0x1D5A0100, testKeyDenied),
+    TEST_KEY(SHELL_CMD_PERMISSION(0), 0x1D5A0100, testKeyFirst),
+    TEST_KEY(SHELL_CMD_PERMISSION(0), 0x1D5A0100, testKeySecond),
+    TEST_KEY(SHELL_CMD_PERMISSION(0), 0x1D5B0000, testKeyShort),
+};
+
+/* 两个测试shell的输出 */
+#define TEST_SHELL_OUT_MAX      (1024 * 1024)
+
+static char *test_out[2];
+static uint32_t test_out_len[2];
+static Shell test_shell[2];
+static char test_shell_buffer[2][512];
+
+/**
+ * @brief Test shell write: keep the output of each test shell
+ * @param shell Test shell
+ * @param data Data
+ * @param len Data length
+ * @return Bytes kept
+ */
+static signed short testShellWrite(Shell *shell, char *data, unsigned short len)
+{
+    int i = (shell == &test_shell[1]);
+
+    if (len > TEST_SHELL_OUT_MAX - test_out_len[i]) {
+        len = (unsigned short)(TEST_SHELL_OUT_MAX - test_out_len[i]);
+    }
+    memcpy(test_out[i] + test_out_len[i], data, len);
+    test_out_len[i] += len;
+    return (signed short)len;
+}
+
+static signed short testShellWrite0(char *data, unsigned short len)
+{
+    return testShellWrite(&test_shell[0], data, len);
+}
+
+static signed short testShellWrite1(char *data, unsigned short len)
+{
+    return testShellWrite(&test_shell[1], data, len);
+}
+
+static int testShellLock(Shell *shell)
+{
+    (void)shell;
+    return 0;
+}
+
+/**
+ * @brief Name of a command table entry, NULL for keys and parameter parsers
+ * @param command Entry
+ * @return Name
+ */
+static const char *testCommandName(const ShellCommand *command)
+{
+    if (command->attr.attrs.type <= SHELL_TYPE_CMD_FUNC) {
+        return command->data.cmd.name;
+    }
+    if (command->attr.attrs.type <= SHELL_TYPE_VAR_NODE) {
+        return command->data.var.name;
+    }
+    if (command->attr.attrs.type <= SHELL_TYPE_USER) {
+        return command->data.user.name;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Look a name up through the index (test_shell[0]) and by linear scan
+ *        (test_shell[1], same table at another address)
+ * @param cmd Name
+ * @param compareLength Prefix length, 0 for a full match
+ * @param found Output: table position of the indexed result, -1 if none
+ * @return 1 if both give the same table position
+ */
+static int testSeekSame(const char *cmd, unsigned short compareLength, int *found)
+{
+    ShellCommand *base_idx = test_shell[0].commandList.base;
+    ShellCommand *base_lin = test_shell[1].commandList.base;
+    ShellCommand *idx = shellSeekCommand(&test_shell[0], cmd, base_idx, compareLength);
+    ShellCommand *lin = shellSeekCommand(&test_shell[1], cmd, base_lin, compareLength);
+    int pos_idx = idx ? (int)(idx - base_idx) : -1;
+    int pos_lin = lin ? (int)(lin - base_lin) : -1;
+
+    if (found) {
+        *found = pos_idx;
+    }
+    if (pos_idx != pos_lin && test_verbose) {
+        printf("  seek \"%s\" length %u: index %d, linear %d\n", cmd, compareLength, pos_idx, pos_lin);
+    }
+    return pos_idx == pos_lin;
+}
+
+/**
+ * @brief Name at a table position, "" if none
+ */
+static const char *testNameAt(int pos)
+{
+    ShellCommand *base = test_shell[0].commandList.base;
+    const char *name = (pos >= 0) ? testCommandName(&base[pos]) : NULL;
+    return name ? name : "";
+}
+
+static void testCommandIndex(void)
+{
+    static const char *const missing[] = {
+        "", "a", "idx", "idxpre_", "idxpre_d", "idxperm_", "zzzz", "~", "help2", "HELP",
+    };
+    static const char *const tokens[] = {
+        "\x1b[A", "\x1b[B", "\x1b[C", "\x1b[D", "\x1b[3~", "\x1b[1~", "\x1b[4~", "\x1bOP",
+        "\x1b", "\x1b[", "\x1d\x5a\x01", "\x1d\x5a", "\x1d\x5a\x02", "\x1d\x5b", "\x1d",
+        "\t", "\x7f", "\x08", "idx", "pre_", "dup", "he", "lp", "a", "z", " ", "_", "0",
+    };
+    ShellCommand *table;
+    ShellCommand *base;
+    uint32_t count;
+    uint32_t seed = 1;
+    int found;
+    int mismatch = 0;
+    int checked = 0;
+
+    test_out[0] = malloc(TEST_SHELL_OUT_MAX);
+    test_out[1] = malloc(TEST_SHELL_OUT_MAX);
+    test_shell[0].write = testShellWrite0;
+    test_shell[1].write = testShellWrite1;
+    for (int i = 0; i < 2; i++) {
+        test_shell[i].lock = testShellLock;
+        test_shell[i].unlock = testShellLock;
+        shellInit(&test_shell[i], test_shell_buffer[i], sizeof(test_shell_buffer[i]));
+    }
+
+    /* 索引只为链接得到的命令表建立，test_shell[1]改用其副本，走线性查找 */
+    base = test_shell[0].commandList.base;
+    count = test_shell[0].commandList.count;
+    table = malloc(count * sizeof(ShellCommand));
+    memcpy(table, base, count * sizeof(ShellCommand));
+    test_shell[1].commandList.base = table;
+
+    /* 每个名称的完整匹配和每个长度的前缀匹配 */
+    for (uint32_t i = 0; i < count; i++) {
+        const char *name = testCommandName(&base[i]);
+        if (name == NULL) {
+            continue;
+        }
+        for (unsigned short len = 0; len <= strlen(name) + 1; len++) {
+            mismatch += !testSeekSame(name, len, NULL);
+            checked++;
+        }
+    }
+    for (uint32_t i = 0; i < sizeof(missing) / sizeof(missing[0]); i++) {
+        for (unsigned short len = 0; len <= strlen(missing[i]) + 1; len++) {
+            mismatch += !testSeekSame(missing[i], len, NULL);
+            checked++;
+        }
+    }
+    CHECK_COUNT("seek mismatches", 0, mismatch);
+    if (test_verbose) {
+        printf("  %d lookups compared over %lu table entries\n", checked, (unsigned long)count);
+    }
+
+    /* 结果本身：同名取命令表中第一项，跳过无权限项，前缀匹配取命令表中最靠前的一项 */
+    testSeekSame("idxdup", 0, &found);
+    CHECK_COUNT("duplicate takes first entry", 1, &base[found] == &testCommands[TEST_CMD_DUP1]);
+    testSeekSame("idxperm", 0, &found);
+    CHECK_COUNT("denied entry skipped", 1, &base[found] == &testCommands[TEST_CMD_PERM2]);
+    testSeekSame("idxpre_", 7, &found);
+    CHECK_COUNT("prefix takes lowest entry", 1, strcmp(testNameAt(found), "idxpre_b") == 0);
+    testSeekSame("idxpre_c", 0, &found);
+    CHECK_COUNT("denied prefix entry", -1, found);
+
+    /* 同一按键流分别送入两个shell，输出（含回显、补全、历史和按键函数的标记）应逐字节相同 */
+    test_out_len[0] = 0;
+    test_out_len[1] = 0;
+    for (int n = 0; n < 5000; n++) {
+        seed = seed * 1103515245U + 12345U;
+        const char *token = tokens[(seed >> 16) % (sizeof(tokens) / sizeof(tokens[0]))];
+        for (const char *p = token; *p; p++) {
+            shellHandler(&test_shell[0], *p);
+            shellHandler(&test_shell[1], *p);
+        }
+    }
+    CHECK_COUNT("key stream output kept", 1, test_out_len[0] < TEST_SHELL_OUT_MAX);
+    test_out[0][test_out_len[0] < TEST_SHELL_OUT_MAX ? test_out_len[0] : TEST_SHELL_OUT_MAX - 1] = '\0';
+    test_out[1][test_out_len[1] < TEST_SHELL_OUT_MAX ? test_out_len[1] : TEST_SHELL_OUT_MAX - 1] = '\0';
+    CHECK_COUNT("key stream output identical", 1,
+                test_out_len[0] == test_out_len[1]
+                && memcmp(test_out[0], test_out[1], test_out_len[0]) == 0);
+    CHECK_COUNT("three-byte key fired", 1, strstr(test_out[0], "<first>") != NULL);
+    CHECK_COUNT("two-byte key fired", 1, strstr(test_out[0], "<short>") != NULL);
+    CHECK_COUNT("duplicate key not fired", 0, strstr(test_out[0], "<second>") != NULL);
+    CHECK_COUNT("denied key not fired", 0, strstr(test_out[0], "<denied>") != NULL);
+
+    shellRemove(&test_shell[0]);
+    shellRemove(&test_shell[1]);
+    free(table);
+    free(test_out[0]);
+    free(test_out[1]);
+}
+
+/* ---------------------------------------------------------------------------
+ * Repeat collapsing (shellLogDrainLine, drain task only)
+ * ------------------------------------------------------------------------- */
+
+#if SHELL_LOG_ASYNC
+
+static void testDedup(void)
+{
+    shellLogSetDedupEnabled(1);
+
+    /* 命令输出（USER）的相同行全部输出 */
+    shellLogFlush(1000);
+    test_lines = 0;
+    test_summaries = 0;
+    for (int i = 0; i < 4; i++) {
+        SHELL_LOG_USER_INFO("0000: 00 00 00 00 00 00 00 00");
+    }
+    shellLogFlush(1000);
+    CHECK_COUNT("user lines", 4, test_lines);
+
+    /* 诊断日志的相同行折叠，下一条不同的行之前给出汇总 */
+    test_lines = 0;
+    test_summaries = 0;
+    for (int i = 0; i < 4; i++) {
+        SHELL_LOG_SYS_WARNING("link down");
+    }
+    SHELL_LOG_SYS_WARNING("link up");
+    shellLogFlush(1000);
+    CHECK_COUNT("collapsed lines", 3, test_lines);
+    CHECK_COUNT("collapsed summaries", 1, test_summaries);
+
+    /* 持续的重复：不等不同的行出现，每SHELL_LOG_DEDUP_FLUSH_MS给出汇总 */
+    test_lines = 0;
+    test_summaries = 0;
+    uint64_t end = host_now_ns() + (SHELL_LOG_DEDUP_FLUSH_MS * 5ULL / 2ULL) * 1000000ULL;
+    while (host_now_ns() < end) {
+        SHELL_LOG_SYS_WARNING("storm");
+        vTaskDelay(10);
+    }
+    shellLogFlush(1000);
+    CHECK_COUNT("storm summaries", 2, test_summaries);
+    SHELL_LOG_SYS_WARNING("storm over");
+    shellLogFlush(1000);
+}
+
+/* ---------------------------------------------------------------------------
+ * Crash and file sinks (shell_log_sink.c on the host_ff.c RAM disk)
+ * ------------------------------------------------------------------------- */
+
+/**
+ * @brief Check that a text contains a string
+ * @param file Source file
+ * @param line Source line
+ * @param text Text (NUL-terminated)
+ * @param expect Expected string
+ */
+static void testContains(const char *file, int line, const char *text, const char *expect)
+{
+    size_t len = strlen(text);
+
+    /* 失败时只打印末尾部分 */
+    testReport(strstr(text, expect) != NULL, file, line, expect,
+               (len > 160) ? text + len - 160 : text);
+}
+
+#define CHECK_CONTAINS(text, expect)    testContains(__FILE__, __LINE__, text, expect)
+
+static char test_dump[SHELL_LOG_CRASH_SIZE * 2];
+static uint32_t test_dump_len;
+
+/**
+ * @brief shellLogCrashDump output: collect the text
+ * @param data Data
+ * @param len Data length
+ */
+static void testDumpWrite(const char *data, uint16_t len)
+{
+    if (len > sizeof(test_dump) - 1 - test_dump_len) {
+        len = (uint16_t)(sizeof(test_dump) - 1 - test_dump_len);
+    }
+    memcpy(test_dump + test_dump_len, data, len);
+    test_dump_len += len;
+    test_dump[test_dump_len] = '\0';
+}
+
+/**
+ * @brief Dump the crash buffer into test_dump
+ */
+static void testDump(void)
+{
+    test_dump_len = 0;
+    test_dump[0] = '\0';
+    shellLogCrashDump(testDumpWrite);
+}
+
+static void testDeferNoFormat(void)
+{
+    shellLogFlush(1000);
+
+    /* drain任务运行时延迟记录在调用方只做复制，崩溃缓冲区也保存原始记录 */
+    test_fmt_calls = 0;
+    SHELL_LOG_DEFER_INFO(SHELL_LOG_MODULE_SYSTEM, "no format %d %s", 3, TEST_PTR("here"));
+    CHECK_COUNT("DEFER_INFO formatter calls", 0, test_fmt_calls);
+    SHELL_LOG_DEFER_ERROR(SHELL_LOG_MODULE_SYSTEM, "no format %d", 4);
+    CHECK_COUNT("DEFER_ERROR formatter calls", 0, test_fmt_calls);
+    shellLogFlush(1000);
+    CHECK_CONTAINS(test_line, "no format 4\r\n");
+
+    /* 读取时才格式化 */
+    testDump();
+    CHECK_CONTAINS(test_dump, "no format 3 here\r\n");
+    CHECK_CONTAINS(test_dump, "no format 4\r\n");
+    CHECK_COUNT("records decoded", 0, strchr(test_dump, '\x1E') != NULL);
+}
+
+static void testCrashSink(void)
+{
+    static char crash[SHELL_LOG_CRASH_SIZE + 1];
+    uint32_t n;
+
+    shellLogFlush(1000);
+    shellLogCrashClear();
+
+    /* drain任务阻塞在测试输出端里，之后的行只能在产生时进入崩溃缓冲区 */
+    test_gate = 1;
+    SHELL_LOG_SYS_INFO("drain held");
+    for (int i = 0; i < 1000 && !test_gate_blocked; i++) {
+        vTaskDelay(1);
+    }
+    CHECK_COUNT("drain held", 1, test_gate_blocked);
+    SHELL_LOG_SYS_ERROR("crash text %d", 1);
+    SHELL_LOG_DEFER_ERROR(SHELL_LOG_MODULE_SYSTEM, "crash defer %d", 2);
+    testDump();
+    test_gate = 0;
+    shellLogFlush(1000);
+
+    CHECK_CONTAINS(test_dump, "crash text 1\r\n");
+    CHECK_CONTAINS(test_dump, "crash defer 2\r\n");
+
+    /* 格式串地址与保存的开头不符时原样输出地址和参数 */
+    static char moved[] = "moved %d";
+    SHELL_LOG_DEFER_ERROR(SHELL_LOG_MODULE_SYSTEM, moved, 5);
+    moved[0] = 'M';
+    testDump();
+    char expect[64];
+    snprintf(expect, sizeof(expect), "<fmt 0x%08lx> 0x00000005\r\n", (unsigned long)TEST_PTR(moved));
+    CHECK_CONTAINS(test_dump, expect);
+    shellLogFlush(1000);
+
+    /* drain任务恢复后不会重复写入 */
+    n = shellLogCrashRead(0, crash, SHELL_LOG_CRASH_SIZE);
+    crash[n] = '\0';
+    char *first = strstr(crash, "crash text 1");
+    CHECK_COUNT("crash text once", 1, first != NULL && strstr(first + 1, "crash text 1") == NULL);
+}
+
+static void testFileSink(void)
+{
+    const uint32_t cluster = 2 * _MAX_SS;
+    const char *data;
+    uint32_t size;
+    uint32_t offset;
+    uint32_t len;
+    UINT written;
+    FIL fil;
+
+    /* 已有100字节的文件：第一次写入补齐到簇边界，之后整簇写入 */
+    host_ff_format(2, 1U << 20);
+    f_open(&fil, "0:/log.txt", FA_CREATE_ALWAYS | FA_WRITE);
+    f_write(&fil, "0123456789012345678901234567890123456789012345678901234567890123456789"
+                  "012345678901234567890123456789", 100, &written);
+    f_close(&fil);
+    uint32_t base = host_ff_writes();
+
+    CHECK_COUNT("file open", FR_OK, shellLogFileOpen("0:/log.txt"));
+    for (int i = 0; i < 60; i++) {
+        SHELL_LOG_SYS_INFO("\033[1mfile line\033[0m %02d of the RAM disk test", i);
+    }
+    shellLogFlush(1000);
+    uint32_t burst = host_ff_writes() - base;
+    CHECK_COUNT("file close", FR_OK, shellLogFileClose());
+
+    CHECK_COUNT("cluster writes", 1, burst >= 3);
+    host_ff_write_at(base, &offset, &len);
+    CHECK_COUNT("first write end", (int)cluster, (int)(offset + len));
+    for (uint32_t i = 1; i < burst; i++) {
+        host_ff_write_at(base + i, &offset, &len);
+        CHECK_COUNT("whole cluster", (int)cluster, (int)len);
+        CHECK_COUNT("aligned", 0, (int)(offset % cluster));
+    }
+
+    data = host_ff_file("0:/log.txt", &size);
+    char *text = calloc(1, size + 1);
+    memcpy(text, data, size);
+    CHECK_COUNT("ansi stripped", 0, memchr(text, '\033', size) != NULL);
+    CHECK_COUNT("old data kept", 0, memcmp(text, "0123456789", 10));
+    CHECK_CONTAINS(text + 100, "file line 00 of the RAM disk test\r\n");
+    CHECK_CONTAINS(text + 100, "file line 59 of the RAM disk test\r\n");
+    free(text);
+
+    /* 写入错误：关闭文件并禁用输出端 */
+    const char *path = "";
+    CHECK_COUNT("file open", FR_OK, shellLogFileOpen("0:/err.txt"));
+    host_ff_fail(FR_DISK_ERR);
+    SHELL_LOG_SYS_INFO("lost line");
+    shellLogFlush(1000);
+    CHECK_COUNT("flush error", FR_DISK_ERR, shellLogFileFlush());
+    CHECK_COUNT("status error", FR_DISK_ERR, shellLogFileStatus(&path));
+    CHECK_COUNT("file closed", 1, path == NULL);
+    CHECK_COUNT("sink disabled", 0, shellLogFindSink("file")->enabled);
+    host_ff_fail(FR_OK);
+
+    /* 卷已满：写满为止，报告FR_DENIED */
+    host_ff_format(2, 3000);
+    CHECK_COUNT("file open", FR_OK, shellLogFileOpen("0:/full.txt"));
+    for (int i = 0; i < 100; i++) {
+        SHELL_LOG_SYS_INFO("filling the volume %d", i);
+    }
+    shellLogFlush(1000);
+    shellLogFileFlush();
+    CHECK_COUNT("volume full", FR_DENIED, shellLogFileStatus(NULL));
+    host_ff_file("0:/full.txt", &size);
+    CHECK_COUNT("volume size", 3000, (int)size);
+}
+#endif /* SHELL_LOG_ASYNC */
+
+int main(int argc, char *argv[])
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        switch (opt) {
+        case 'v':
+            test_verbose = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    host_shell_init(0);
+    shellLogAddSink(&test_sink);
+    shellLogSinkInit();
+    shellLogFlush(1000);
+
+    testFormat();
+    testDeferred();
+    testCommandIndex();
+#if SHELL_LOG_ASYNC
+    testDedup();
+    testDeferNoFormat();
+    testCrashSink();
+    testFileSink();
+#endif
+
+    printf("%d checks, %d failed\n", test_run, test_failed);
+    return test_failed ? 1 : 0;
+}
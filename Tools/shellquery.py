@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+"""Run diagnostic shell commands in JSON mode and print their records.
+
+The firmware `outfmt json` command switches usb_stats, meminfo, taskinfo and
+sddiag to one compact JSON object per command on a single line that starts
+with '{'. This script sends the commands over the console UART and prints the
+records as a JSON array, ready for a dashboard or a CSV converter:
+
+    shellquery.py COM5 meminfo taskinfo
+    shellquery.py /dev/ttyUSB0 usb_stats --baud 2000000 --interval 1
+
+The console is switched back to text output afterwards.
+"""
+
+import argparse
+import json
+import sys
+import time
+
+
+def query(ser, command, timeout):
+    """Send one command and return its JSON record."""
+    ser.reset_input_buffer()
+    ser.write(command.encode() + b"\r")
+    deadline = time.monotonic() + timeout
+    buf = bytearray()
+    while time.monotonic() < deadline:
+        buf += ser.read(4096)
+        # Only complete lines; the last element may still be arriving
+        for line in buf.split(b"\n")[:-1]:
+            line = line.strip()
+            if line.startswith(b"{") and line.endswith(b"}"):
+                return json.loads(line.decode("utf-8", "replace"))
+    raise TimeoutError("no JSON record from '%s'" % command)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port", help="serial port")
+    parser.add_argument("commands", nargs="+", help="commands to run")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--timeout", type=float, default=3.0,
+                        help="seconds to wait for each record")
+    parser.add_argument("--interval", type=float,
+                        help="repeat every N seconds, one array per line")
+    args = parser.parse_args()
+
+    try:
+        import serial
+    except ImportError:
+        sys.exit("pyserial is required (pip install pyserial)")
+
+    ser = serial.Serial(args.port, args.baud, timeout=0.05)
+    ser.write(b"outfmt json\r")
+    time.sleep(0.1)
+    try:
+        while True:
+            records = [query(ser, cmd, args.timeout) for cmd in args.commands]
+            print(json.dumps(records), flush=True)
+            if args.interval is None:
+                break
+            time.sleep(args.interval)
+    except (KeyboardInterrupt, TimeoutError) as e:
+        if isinstance(e, TimeoutError):
+            print(e, file=sys.stderr)
+    finally:
+        ser.write(b"outfmt text\r")
+        ser.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -27,7 +27,8 @@
 #include "usbd_storage_if.h"
 
 /* USER CODE BEGIN Includes */
-
+#include "usbd_msc_log.h"
+#include "usbd_log_if.h"
 /* USER CODE END Includes */
 
 /* USER CODE BEGIN PV */
@@ -72,7 +73,8 @@ void MX_USB_DEVICE_Init(void)
   {
     Error_Handler();
   }
-  if (USBD_RegisterClass(&hUsbDeviceHS, &USBD_MSC) != USBD_OK)
+  /* MSC + vendor log stream composite, see usbd_msc_log.c */
+  if (USBD_RegisterClass(&hUsbDeviceHS, &USBD_MSC_LOG) != USBD_OK)
   {
     Error_Handler();
   }
@@ -86,6 +88,8 @@ void MX_USB_DEVICE_Init(void)
   }
 
   /* USER CODE BEGIN USB_DEVICE_Init_PostTreatment */
+  USBD_LOG_Init();
+
   //HAL_PWREx_EnableUSBVoltageDetector();
   
   /* 
@@ -0,0 +1,216 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_log_if.c
+  * @brief          : Binary log stream over the USB vendor interface.
+  ******************************************************************************
+  * @attention
+  *
+  * Registers the "usb" log sink. Frames (ShellLogBinHeader_t + payload) are
+  * packed into one of two buffers; while one is on the bulk IN endpoint the
+  * other fills, so a busy stream sends large transfers and an idle one sends
+  * each frame at once. Nothing ever waits for the host: when both buffers are
+  * in use the frame is dropped and the gap shows up in the sequence numbers.
+  *
+  * The buffers and the transfer state are only touched with the USB interrupt
+  * masked (taskENTER_CRITICAL_FROM_ISR) or from the USB interrupt itself.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_log_if.h"
+#include "usbd_msc_log.h"
+#include "shell_log.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stddef.h>
+#include <string.h>
+
+/* Private variables ---------------------------------------------------------*/
+/* DMA of the OTG core reads these, cleaned from the D-Cache before each transfer */
+static uint8_t usbd_log_buf[2][USBD_LOG_BUF_SIZE] __attribute__((section(".dma_buffer"))) __attribute__((aligned(32)));
+
+static USBD_HandleTypeDef *usbd_log_dev = NULL;   /* Set while configured */
+static uint16_t usbd_log_mps = 64U;
+static uint8_t usbd_log_fill = 0U;                /* Buffer being filled */
+static uint32_t usbd_log_len = 0U;                /* Bytes in the fill buffer */
+static uint32_t usbd_log_tx_len = 0U;             /* Transfer in flight, 0 = idle */
+static uint8_t usbd_log_zlp = 0U;                 /* Terminating ZLP in flight */
+static uint32_t usbd_log_seq = 0U;
+static USBD_LOG_StatsTypeDef usbd_log_stats;
+static uint8_t usbd_log_registered = 0U;
+
+static void USBD_LOG_WriteBin(const ShellLogBinHeader_t *hdr, const void *payload);
+
+static ShellLogSink_t usbd_log_sink = {
+    .name = "usb",
+    .level = SHELL_LOG_LEVEL_DEBUG,
+    .enabled = 1,
+    .task_only = 0,
+    .at_produce = 0,
+    .write = NULL,
+    .write_raw = NULL,
+    .flush = NULL,
+    .write_bin = USBD_LOG_WriteBin,
+};
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Start a transfer of the fill buffer if the endpoint is idle
+  * @note   USB interrupt masked or called from it
+  * @retval None
+  */
+static void USBD_LOG_Kick(void)
+{
+  uint8_t *buf;
+
+  if (usbd_log_dev == NULL || usbd_log_tx_len != 0U || usbd_log_len == 0U)
+  {
+    return;
+  }
+
+  buf = usbd_log_buf[usbd_log_fill];
+  usbd_log_tx_len = usbd_log_len;
+  usbd_log_fill ^= 1U;
+  usbd_log_len = 0U;
+
+  SCB_CleanDCache_by_Addr((uint32_t *)buf, (int32_t)((usbd_log_tx_len + 31U) & ~31U));
+  (void)USBD_LL_Transmit(usbd_log_dev, USBD_LOG_EPIN_ADDR, buf, usbd_log_tx_len);
+}
+
+/**
+  * @brief  "usb" sink: queue one binary frame (any context, never blocks)
+  * @param  hdr: frame header
+  * @param  payload: frame payload
+  * @retval None
+  */
+static void USBD_LOG_WriteBin(const ShellLogBinHeader_t *hdr, const void *payload)
+{
+  uint32_t size = sizeof(ShellLogBinHeader_t) + hdr->len;
+  UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+
+  if (usbd_log_dev == NULL)
+  {
+    taskEXIT_CRITICAL_FROM_ISR(saved);
+    return;
+  }
+
+  uint32_t seq = usbd_log_seq++;
+
+  if (usbd_log_len + size > USBD_LOG_BUF_SIZE)
+  {
+    USBD_LOG_Kick();
+  }
+  if (usbd_log_len + size > USBD_LOG_BUF_SIZE)
+  {
+    usbd_log_stats.dropped++;
+    taskEXIT_CRITICAL_FROM_ISR(saved);
+    return;
+  }
+
+  uint8_t *dst = &usbd_log_buf[usbd_log_fill][usbd_log_len];
+  memcpy(dst, hdr, sizeof(ShellLogBinHeader_t));
+  memcpy(dst + offsetof(ShellLogBinHeader_t, seq), &seq, sizeof(seq));
+  memcpy(dst + sizeof(ShellLogBinHeader_t), payload, hdr->len);
+  usbd_log_len += size;
+  usbd_log_stats.frames++;
+  usbd_log_stats.bytes += size;
+
+  USBD_LOG_Kick();
+  taskEXIT_CRITICAL_FROM_ISR(saved);
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Register the "usb" log sink (once)
+  * @retval None
+  */
+void USBD_LOG_Init(void)
+{
+  if (usbd_log_registered == 0U)
+  {
+    if (shellLogAddSink(&usbd_log_sink) == 0)
+    {
+      usbd_log_registered = 1U;
+    }
+  }
+}
+
+/**
+  * @brief  Get stream statistics
+  * @param  stats: output
+  * @retval None
+  */
+void USBD_LOG_GetStats(USBD_LOG_StatsTypeDef *stats)
+{
+  UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+  *stats = usbd_log_stats;
+  stats->connected = (usbd_log_dev != NULL) ? 1U : 0U;
+  taskEXIT_CRITICAL_FROM_ISR(saved);
+}
+
+/**
+  * @brief  Interface configured by the host
+  * @param  pdev: device instance
+  * @param  mps: bulk IN max packet size
+  * @retval None
+  */
+void USBD_LOG_Connected(USBD_HandleTypeDef *pdev, uint16_t mps)
+{
+  UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+  usbd_log_mps = mps;
+  usbd_log_fill = 0U;
+  usbd_log_len = 0U;
+  usbd_log_tx_len = 0U;
+  usbd_log_zlp = 0U;
+  usbd_log_dev = pdev;
+  taskEXIT_CRITICAL_FROM_ISR(saved);
+}
+
+/**
+  * @brief  Interface deconfigured (reset, disconnect or USBD_DeInit)
+  * @retval None
+  */
+void USBD_LOG_Disconnected(void)
+{
+  UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+  usbd_log_dev = NULL;
+  usbd_log_len = 0U;
+  usbd_log_tx_len = 0U;
+  usbd_log_zlp = 0U;
+  taskEXIT_CRITICAL_FROM_ISR(saved);
+}
+
+/**
+  * @brief  Bulk IN transfer finished
+  * @param  pdev: device instance
+  * @retval None
+  */
+void USBD_LOG_TxComplete(USBD_HandleTypeDef *pdev)
+{
+  /* A transfer that ends on a packet boundary needs a ZLP so the host read returns */
+  if (usbd_log_zlp == 0U && usbd_log_tx_len != 0U && (usbd_log_tx_len % usbd_log_mps) == 0U)
+  {
+    usbd_log_zlp = 1U;
+    (void)USBD_LL_Transmit(pdev, USBD_LOG_EPIN_ADDR, NULL, 0U);
+    return;
+  }
+
+  usbd_log_zlp = 0U;
+  usbd_log_tx_len = 0U;
+  usbd_log_stats.transfers++;
+  USBD_LOG_Kick();
+}
+
+/**
+  * @brief  Endpoint halt cleared by the host: drop the transfer in flight
+  * @retval None
+  */
+void USBD_LOG_TxAbort(void)
+{
+  usbd_log_zlp = 0U;
+  usbd_log_tx_len = 0U;
+  USBD_LOG_Kick();
+}
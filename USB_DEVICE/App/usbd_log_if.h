@@ -0,0 +1,55 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_log_if.h
+  * @brief          : Header for usbd_log_if.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * Binary log stream over the vendor interface of USBD_MSC_LOG.
+  * Host side decoder: Tools/logdecode.py
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_LOG_IF_H__
+#define __USBD_LOG_IF_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_def.h"
+
+/* Exported defines ----------------------------------------------------------*/
+/* Size of each of the two transmit buffers (multiple of 32 for cache maintenance) */
+#ifndef USBD_LOG_BUF_SIZE
+#define USBD_LOG_BUF_SIZE             2048U
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct
+{
+  uint32_t frames;      /* Frames queued for the host */
+  uint32_t bytes;       /* Bytes queued for the host */
+  uint32_t dropped;     /* Frames dropped (buffers full or host not reading) */
+  uint32_t transfers;   /* Bulk IN transfers completed */
+  uint8_t connected;    /* Configured by the host */
+} USBD_LOG_StatsTypeDef;
+
+/* Exported functions --------------------------------------------------------*/
+void USBD_LOG_Init(void);
+void USBD_LOG_GetStats(USBD_LOG_StatsTypeDef *stats);
+
+/* Called by USBD_MSC_LOG (USB interrupt context) */
+void USBD_LOG_Connected(USBD_HandleTypeDef *pdev, uint16_t mps);
+void USBD_LOG_Disconnected(void);
+void USBD_LOG_TxComplete(USBD_HandleTypeDef *pdev);
+void USBD_LOG_TxAbort(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_LOG_IF_H__ */
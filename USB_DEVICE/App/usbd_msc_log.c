@@ -0,0 +1,270 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_msc_log.c
+  * @brief          : MSC + vendor log stream composite class.
+  ******************************************************************************
+  * @attention
+  *
+  * The MSC class of the USB device library is used unchanged for interface 0.
+  * This wrapper only adds the configuration descriptor for both interfaces
+  * and routes requests and endpoint events of interface 1 (bulk IN 0x82) to
+  * usbd_log_if.c. Everything else is forwarded to USBD_MSC.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_msc_log.h"
+#include "usbd_log_if.h"
+#include "usbd_ctlreq.h"
+
+/* Private macro -------------------------------------------------------------*/
+#define USBD_MSC_LOG_CFG_DESC(desc_type, msc_mps, log_mps)                     \
+  {                                                                            \
+    0x09,                     /* bLength: Configuration Descriptor size */     \
+    (desc_type),              /* bDescriptorType */                            \
+    LOBYTE(USB_MSC_LOG_CONFIG_DESC_SIZ),                                       \
+    HIBYTE(USB_MSC_LOG_CONFIG_DESC_SIZ),                                       \
+    0x02,                     /* bNumInterfaces: MSC + log */                  \
+    0x01,                     /* bConfigurationValue */                        \
+    0x04,                     /* iConfiguration */                             \
+    0xC0,                     /* bmAttributes: self powered */                 \
+    USBD_MAX_POWER,           /* MaxPower */                                   \
+    /* Interface 0: Mass Storage, BOT */                                       \
+    0x09, USB_DESC_TYPE_INTERFACE,                                             \
+    0x00,                     /* bInterfaceNumber */                           \
+    0x00,                     /* bAlternateSetting */                          \
+    0x02,                     /* bNumEndpoints */                              \
+    0x08, 0x06, 0x50,         /* MSC, SCSI transparent, BOT */                 \
+    0x05,                     /* iInterface */                                 \
+    0x07, USB_DESC_TYPE_ENDPOINT, MSC_EPIN_ADDR, 0x02,                         \
+    LOBYTE(msc_mps), HIBYTE(msc_mps), 0x00,                                    \
+    0x07, USB_DESC_TYPE_ENDPOINT, MSC_EPOUT_ADDR, 0x02,                        \
+    LOBYTE(msc_mps), HIBYTE(msc_mps), 0x00,                                    \
+    /* Interface 1: vendor specific log stream */                              \
+    0x09, USB_DESC_TYPE_INTERFACE,                                             \
+    USBD_LOG_INTERFACE,       /* bInterfaceNumber */                           \
+    0x00,                     /* bAlternateSetting */                          \
+    0x01,                     /* bNumEndpoints */                              \
+    0xFF, 0x00, 0x00,         /* Vendor specific */                            \
+    0x00,                     /* iInterface */                                 \
+    0x07, USB_DESC_TYPE_ENDPOINT, USBD_LOG_EPIN_ADDR, 0x02,                    \
+    LOBYTE(log_mps), HIBYTE(log_mps), 0x00                                     \
+  }
+
+/* Private function prototypes -----------------------------------------------*/
+static uint8_t USBD_MSC_LOG_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t USBD_MSC_LOG_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t USBD_MSC_LOG_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+static uint8_t USBD_MSC_LOG_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t USBD_MSC_LOG_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t *USBD_MSC_LOG_GetHSCfgDesc(uint16_t *length);
+static uint8_t *USBD_MSC_LOG_GetFSCfgDesc(uint16_t *length);
+static uint8_t *USBD_MSC_LOG_GetOtherSpeedCfgDesc(uint16_t *length);
+static uint8_t *USBD_MSC_LOG_GetDeviceQualifierDesc(uint16_t *length);
+
+/* Private variables ---------------------------------------------------------*/
+USBD_ClassTypeDef USBD_MSC_LOG =
+{
+  USBD_MSC_LOG_Init,
+  USBD_MSC_LOG_DeInit,
+  USBD_MSC_LOG_Setup,
+  NULL, /*EP0_TxSent*/
+  NULL, /*EP0_RxReady*/
+  USBD_MSC_LOG_DataIn,
+  USBD_MSC_LOG_DataOut,
+  NULL, /*SOF */
+  NULL,
+  NULL,
+  USBD_MSC_LOG_GetHSCfgDesc,
+  USBD_MSC_LOG_GetFSCfgDesc,
+  USBD_MSC_LOG_GetOtherSpeedCfgDesc,
+  USBD_MSC_LOG_GetDeviceQualifierDesc,
+};
+
+__ALIGN_BEGIN static uint8_t USBD_MSC_LOG_HSCfgDesc[USB_MSC_LOG_CONFIG_DESC_SIZ] __ALIGN_END =
+  USBD_MSC_LOG_CFG_DESC(USB_DESC_TYPE_CONFIGURATION, MSC_MAX_HS_PACKET, USBD_LOG_HS_MPS);
+
+__ALIGN_BEGIN static uint8_t USBD_MSC_LOG_FSCfgDesc[USB_MSC_LOG_CONFIG_DESC_SIZ] __ALIGN_END =
+  USBD_MSC_LOG_CFG_DESC(USB_DESC_TYPE_CONFIGURATION, MSC_MAX_FS_PACKET, USBD_LOG_FS_MPS);
+
+__ALIGN_BEGIN static uint8_t USBD_MSC_LOG_OtherSpeedCfgDesc[USB_MSC_LOG_CONFIG_DESC_SIZ] __ALIGN_END =
+  USBD_MSC_LOG_CFG_DESC(USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION, MSC_MAX_FS_PACKET, USBD_LOG_FS_MPS);
+
+__ALIGN_BEGIN static uint8_t USBD_MSC_LOG_ItfState[2] __ALIGN_END = {0U, 0U};
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Initialize both interfaces
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t USBD_MSC_LOG_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  uint16_t mps;
+  uint8_t ret;
+
+  ret = USBD_MSC.Init(pdev, cfgidx);
+  if (ret != (uint8_t)USBD_OK)
+  {
+    return ret;
+  }
+
+  mps = (pdev->dev_speed == USBD_SPEED_HIGH) ? USBD_LOG_HS_MPS : USBD_LOG_FS_MPS;
+  (void)USBD_LL_OpenEP(pdev, USBD_LOG_EPIN_ADDR, USBD_EP_TYPE_BULK, mps);
+  pdev->ep_in[USBD_LOG_EPIN_ADDR & 0xFU].is_used = 1U;
+
+  USBD_LOG_Connected(pdev, mps);
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  DeInitialize both interfaces
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t USBD_MSC_LOG_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  USBD_LOG_Disconnected();
+
+  (void)USBD_LL_CloseEP(pdev, USBD_LOG_EPIN_ADDR);
+  pdev->ep_in[USBD_LOG_EPIN_ADDR & 0xFU].is_used = 0U;
+
+  return USBD_MSC.DeInit(pdev, cfgidx);
+}
+
+/**
+  * @brief  Handle requests addressed to the log interface or its endpoint,
+  *         forward everything else to the MSC class
+  * @param  pdev: device instance
+  * @param  req: USB request
+  * @retval status
+  */
+static uint8_t USBD_MSC_LOG_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
+{
+  uint8_t recipient = req->bmRequest & USB_REQ_RECIPIENT_MASK;
+
+  if (recipient == USB_REQ_RECIPIENT_INTERFACE && LOBYTE(req->wIndex) == USBD_LOG_INTERFACE)
+  {
+    if ((req->bmRequest & USB_REQ_TYPE_MASK) != USB_REQ_TYPE_STANDARD ||
+        pdev->dev_state != USBD_STATE_CONFIGURED)
+    {
+      USBD_CtlError(pdev, req);
+      return (uint8_t)USBD_FAIL;
+    }
+
+    switch (req->bRequest)
+    {
+      case USB_REQ_GET_STATUS:
+        (void)USBD_CtlSendData(pdev, USBD_MSC_LOG_ItfState, 2U);
+        break;
+
+      case USB_REQ_GET_INTERFACE:
+        (void)USBD_CtlSendData(pdev, USBD_MSC_LOG_ItfState, 1U);
+        break;
+
+      case USB_REQ_SET_INTERFACE:
+        if (req->wValue != 0U)
+        {
+          USBD_CtlError(pdev, req);
+          return (uint8_t)USBD_FAIL;
+        }
+        break;
+
+      default:
+        USBD_CtlError(pdev, req);
+        return (uint8_t)USBD_FAIL;
+    }
+    return (uint8_t)USBD_OK;
+  }
+
+  if (recipient == USB_REQ_RECIPIENT_ENDPOINT && LOBYTE(req->wIndex) == USBD_LOG_EPIN_ADDR)
+  {
+    /* The core has already cleared the stall, restart the stream */
+    if ((req->bmRequest & USB_REQ_TYPE_MASK) == USB_REQ_TYPE_STANDARD &&
+        req->bRequest == USB_REQ_CLEAR_FEATURE)
+    {
+      (void)USBD_LL_FlushEP(pdev, USBD_LOG_EPIN_ADDR);
+      USBD_LOG_TxAbort();
+      return (uint8_t)USBD_OK;
+    }
+    USBD_CtlError(pdev, req);
+    return (uint8_t)USBD_FAIL;
+  }
+
+  return USBD_MSC.Setup(pdev, req);
+}
+
+/**
+  * @brief  Data sent on a non-control IN endpoint
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t USBD_MSC_LOG_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  if (epnum == (USBD_LOG_EPIN_ADDR & 0x7FU))
+  {
+    USBD_LOG_TxComplete(pdev);
+    return (uint8_t)USBD_OK;
+  }
+  return USBD_MSC.DataIn(pdev, epnum);
+}
+
+/**
+  * @brief  Data received on a non-control OUT endpoint (MSC only)
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t USBD_MSC_LOG_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  return USBD_MSC.DataOut(pdev, epnum);
+}
+
+/**
+  * @brief  Return the high speed configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t *USBD_MSC_LOG_GetHSCfgDesc(uint16_t *length)
+{
+  *length = (uint16_t)sizeof(USBD_MSC_LOG_HSCfgDesc);
+  return USBD_MSC_LOG_HSCfgDesc;
+}
+
+/**
+  * @brief  Return the full speed configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t *USBD_MSC_LOG_GetFSCfgDesc(uint16_t *length)
+{
+  *length = (uint16_t)sizeof(USBD_MSC_LOG_FSCfgDesc);
+  return USBD_MSC_LOG_FSCfgDesc;
+}
+
+/**
+  * @brief  Return the other speed configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t *USBD_MSC_LOG_GetOtherSpeedCfgDesc(uint16_t *length)
+{
+  *length = (uint16_t)sizeof(USBD_MSC_LOG_OtherSpeedCfgDesc);
+  return USBD_MSC_LOG_OtherSpeedCfgDesc;
+}
+
+/**
+  * @brief  Return the device qualifier descriptor of the MSC class
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t *USBD_MSC_LOG_GetDeviceQualifierDesc(uint16_t *length)
+{
+  return USBD_MSC.GetDeviceQualifierDescriptor(length);
+}
@@ -0,0 +1,41 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_msc_log.h
+  * @brief          : Header for usbd_msc_log.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * Composite class: the MSC class of the USB device library (interface 0)
+  * plus a vendor-specific interface (interface 1) with one bulk IN endpoint
+  * that streams binary log frames (see usbd_log_if.c).
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_MSC_LOG_H__
+#define __USBD_MSC_LOG_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_msc.h"
+
+/* Exported defines ----------------------------------------------------------*/
+#define USBD_LOG_INTERFACE            1U      /* Vendor interface number */
+#define USBD_LOG_EPIN_ADDR            0x82U   /* Bulk IN endpoint */
+#define USBD_LOG_FS_MPS               64U
+#define USBD_LOG_HS_MPS               512U
+
+#define USB_MSC_LOG_CONFIG_DESC_SIZ   (USB_MSC_CONFIG_DESC_SIZ + 9U + 7U)
+
+/* Exported variables --------------------------------------------------------*/
+extern USBD_ClassTypeDef USBD_MSC_LOG;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_MSC_LOG_H__ */
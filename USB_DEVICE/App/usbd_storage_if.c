@@ -75,7 +75,13 @@ uint32_t usb_single_sector_reads = 0;
 #define STORAGE_BLK_SIZ                  0x200
 
 /* USER CODE BEGIN PRIVATE_DEFINES */
+/* 读写路径每个日志调用点的限速：每秒条数 / 突发条数 */
+#define STORAGE_LOG_RATE                 2
+#define STORAGE_LOG_BURST                4
 
+#define STORAGE_TRACE(format, ...) \
+  SHELL_LOG_DEFER_RATELIMIT(SHELL_LOG_MODULE_SYSTEM, SHELL_LOG_LEVEL_INFO, \
+                            STORAGE_LOG_RATE, STORAGE_LOG_BURST, format, ##__VA_ARGS__)
 /* USER CODE END PRIVATE_DEFINES */
 
 /**
@@ -282,76 +288,40 @@ int8_t STORAGE_Read_HS(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t bl
   usb_read_count++;
   if(blk_len == 1) {
     usb_single_sector_reads++;
-    /* 单扇区读取：每100次记录一次，减少日志洪水 */
-    if(usb_single_sector_reads % 100 == 0) {
-      SHELL_LOG_FATFS_INFO("USB Read Progress - Single sector reads: %lu/%lu", 
-                          usb_single_sector_reads, usb_read_count);
-    }
+    /* 单扇区读取：限速为每秒一条，减少日志洪水 */
+    SHELL_LOG_DEFER_RATELIMIT(SHELL_LOG_MODULE_FATFS, SHELL_LOG_LEVEL_INFO, 1, 1,
+                              "USB Read Progress - Single sector reads: %lu/%lu", 
+                              usb_single_sector_reads, usb_read_count);
   } else {
     /* 多扇区读取仍使用DEBUG级别进行详细跟踪 */
-    SHELL_LOG_FATFS_DEBUG("USB Read Multi - Addr: 0x%08lX, Len: %d", blk_addr, blk_len);
+    SHELL_LOG_DEFER_RATELIMIT(SHELL_LOG_MODULE_FATFS, SHELL_LOG_LEVEL_DEBUG, 10, 20,
+                              "USB Read Multi - Addr: 0x%08lX, Len: %d", blk_addr, blk_len);
   }
 
   /*
-   * 混合缓存管理策略：
-   * - .dma_buffer段(可缓存)：USB中间件结构体
-   * - .dma_data_buffer段(不可缓存)：USB数据传输缓冲区
-   * 检查缓冲区地址判断需要的缓存策略
+   * buf是MSC句柄中的bot_data，位于不可缓存的.dma_data_buffer（见USBD_static_malloc），
+   * OTG_HS DMA与CPU看到的数据一致；SD侧的DMA缓冲区策略由user_diskio.c统一处理，
+   * 这里不做Cache维护
    */
-  SHELL_LOG_SYS_INFO("USB Read: LUN=%d, buf=0x%08lX, addr=%lu, len=%d", 
+  STORAGE_TRACE("USB Read: LUN=%d, buf=0x%08lX, addr=%lu, len=%d", 
                     lun, (uint32_t)buf, blk_addr, blk_len);
   
   // 在读取前显示缓冲区状态
-  SHELL_LOG_SYS_INFO("Buffer before read: [0-3] = %02X %02X %02X %02X", 
+  STORAGE_TRACE("Buffer before read: [0-3] = %02X %02X %02X %02X", 
                     buf[0], buf[1], buf[2], buf[3]);
   
-  uint32_t buf_addr = (uint32_t)buf;
-  
-  // 检查缓冲区是否在不可缓存区域 (0x30004000 及以上)
-  if (buf_addr >= 0x30004000) {
-    SHELL_LOG_SYS_INFO("Buffer in non-cacheable region, no cache operations needed");
-  } else {
-    SHELL_LOG_SYS_INFO("Buffer in cacheable region, applying cache management");
-    uint32_t data_size = blk_len * 512;
-    
-    // 向下对齐起始地址到32字节边界
-    uint32_t aligned_start = buf_addr & ~0x1F;
-    // 向上对齐结束地址到32字节边界
-    uint32_t aligned_end = (buf_addr + data_size + 31) & ~0x1F;
-    uint32_t cache_size = aligned_end - aligned_start;
-    
-    SHELL_LOG_SYS_INFO("Cache: buf=0x%08lX, size=%lu, aligned=0x%08lX-0x%08lX (%lu bytes)", 
-                      buf_addr, data_size, aligned_start, aligned_end, cache_size);
-    
-    /* DMA前：清理并失效对齐区域的缓存 */
-    SCB_CleanInvalidateDCache_by_Addr((uint32_t*)aligned_start, cache_size);
-    __DSB();
-  }
-  
   /* 执行读取 */
-  SHELL_LOG_SYS_INFO("About to call disk_read...");
+  STORAGE_TRACE("About to call disk_read...");
   res = disk_read(lun, buf, blk_addr, blk_len);
-  SHELL_LOG_SYS_INFO("disk_read returned: %d", res);
-  
-  if (buf_addr < 0x30004000) {
-    /* DMA后：失效缓存让CPU看到新数据 */
-    uint32_t data_size = blk_len * 512;
-    uint32_t aligned_start = buf_addr & ~0x1F;
-    uint32_t aligned_end = (buf_addr + data_size + 31) & ~0x1F;
-    uint32_t cache_size = aligned_end - aligned_start;
-    
-    __DSB();
-    SCB_InvalidateDCache_by_Addr((uint32_t*)aligned_start, cache_size);
-    __DSB();
-  }
+  STORAGE_TRACE("disk_read returned: %d", res);
   
   // 在读取后显示缓冲区状态
-  SHELL_LOG_SYS_INFO("Buffer after read: [0-3] = %02X %02X %02X %02X", 
+  STORAGE_TRACE("Buffer after read: [0-3] = %02X %02X %02X %02X", 
                     buf[0], buf[1], buf[2], buf[3]);
 
   if (res == RES_OK)
   {
-    SHELL_LOG_SYS_INFO("USB Storage Read successful");
+    STORAGE_TRACE("USB Storage Read successful");
     return (USBD_OK);
   }
   else
@@ -378,23 +348,15 @@ int8_t STORAGE_Write_HS(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t b
   /* 性能统计 */
   usb_write_count++;
   if(blk_len == 1) {
-    /* 单扇区写入：每50次记录一次 */
-    if(usb_write_count % 50 == 0) {
-      SHELL_LOG_FATFS_INFO("USB Write Progress - Count: %lu", usb_write_count);
-    }
+    /* 单扇区写入：限速为每秒一条 */
+    SHELL_LOG_DEFER_RATELIMIT(SHELL_LOG_MODULE_FATFS, SHELL_LOG_LEVEL_INFO, 1, 1,
+                              "USB Write Progress - Count: %lu", usb_write_count);
   } else {
-    SHELL_LOG_FATFS_DEBUG("USB Write Multi - Addr: 0x%08lX, Len: %d", blk_addr, blk_len);
+    SHELL_LOG_DEFER_RATELIMIT(SHELL_LOG_MODULE_FATFS, SHELL_LOG_LEVEL_DEBUG, 10, 20,
+                              "USB Write Multi - Addr: 0x%08lX, Len: %d", blk_addr, blk_len);
   }
 
-  /*
-   * DMA缓存一致性操作: 写入前确保数据已写回内存
-   * 关键修复: 使用实际缓冲区地址和大小，不进行对齐计算
-   */
-  uint32_t cache_size = blk_len * 512;
-  
-  /* 在DMA写入前，确保CPU缓存中的数据已写回内存 */
-  SCB_CleanDCache_by_Addr((uint32_t*)buf, cache_size);
-  
+  /* buf位于不可缓存区域，Cache维护由user_diskio.c按需进行 */
   res = disk_write(lun, buf, blk_addr, blk_len);
 
   if (res == RES_OK)
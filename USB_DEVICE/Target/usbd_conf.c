@@ -408,12 +408,16 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
   HAL_PCD_RegisterIsoInIncpltCallback(&hpcd_USB_OTG_HS, PCD_ISOINIncompleteCallback);
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
   /* USER CODE BEGIN TxRx_HS_Configuration */
-  /* 优化FIFO配置以避免内存溢出 - 总计不超过1KB */
+  /* FIFO大小以32位字为单位，OTG_HS共4KB（1024字） */
   HAL_PCDEx_SetRxFiFo(&hpcd_USB_OTG_HS, 0x200);
-  HAL_PCDEx_SetTxFiFo(&hpcd_USB_OTG_HS, 0, 0x80);
-  HAL_PCDEx_SetTxFiFo(&hpcd_USB_OTG_HS, 1, 0x174);
-
-  /* 总FIFO使用: 128 + 64 + 128 = 320字节，远低于1KB限制 */
+  /* EP0 IN: 控制传输包长64字节，2个包 */
+  HAL_PCDEx_SetTxFiFo(&hpcd_USB_OTG_HS, 0, 0x20);
+  HAL_PCDEx_SetTxFiFo(&hpcd_USB_OTG_HS, 1, 0x150);
+  /* EP2 IN: 日志流（usbd_log_if.c），高速描述符声明USBD_LOG_HS_MPS（512字节），
+     FIFO至少要放下一个最大包 */
+  HAL_PCDEx_SetTxFiFo(&hpcd_USB_OTG_HS, 2, 0x80);
+
+  /* 总FIFO使用: 512 + 32 + 336 + 128 = 1008字，低于1024字限制 */
   /* USER CODE END TxRx_HS_Configuration */
   }
   return USBD_OK;
@@ -674,8 +678,8 @@ USBD_StatusTypeDef USBD_LL_SetTestMode(USBD_HandleTypeDef *pdev, uint8_t testmod
 void *USBD_static_malloc(uint32_t size)
 {
   UNUSED(size);
-  /* 性能优化: DMA兼容的内存分配，确保32字节对齐并位于DMA可访问区域 */
-  static uint32_t mem[(sizeof(USBD_MSC_BOT_HandleTypeDef)/4)+16] __attribute__((section(".dma_buffer"))) __attribute__((aligned(32)));/* On 32-byte boundary for DMA */
+  /* MSC句柄含OTG_HS DMA直接收发的CBW/CSW和bot_data，放在不可缓存区域，无需Cache维护 */
+  static uint32_t mem[(sizeof(USBD_MSC_BOT_HandleTypeDef)/4)+16] __attribute__((section(".dma_data_buffer"))) __attribute__((aligned(32)));/* On 32-byte boundary for DMA */
   return mem;
 }
 